@@ -25,6 +25,11 @@ Environment:
 
 #include "DmfIncludeInternal.h"
 
+#if defined(USE_DMF_LOCK_PROFILING)
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#endif // defined(USE_DMF_LOCK_PROFILING)
+
 #include "DmfCall.tmh"
 
 // DMF dispatches all callbacks it receives from WDF to each Module in the Module Collection
@@ -2187,18 +2192,27 @@ Return Value:
 
     parentDmfObject = DMF_ModuleToObject(DmfModule);
 
-    // Dispatch callback to the given Parent DMF Module first.
+    returnValue = FALSE;
+
+    // Open the given Parent DMF Module now if its open was deferred until first use.
+    // If it cannot be opened, it does not see the File Create.
     //
-    DmfAssert(parentDmfObject->ModuleDescriptor.CallbacksWdf->ModuleFileCreate != NULL);
-    returnValue = (parentDmfObject->ModuleDescriptor.CallbacksWdf->ModuleFileCreate)(DmfModule,
-                                                                                     Device,
-                                                                                     Request,
-                                                                                     FileObject);
-    if (returnValue)
+    if ((ModuleOpenedDuringType_Invalid == parentDmfObject->OpenDeferredDuring) ||
+        NT_SUCCESS(DMF_ModuleDeferredOpen(DmfModule)))
     {
-        // It is handled...do not submit to children.
+        // Dispatch callback to the given Parent DMF Module first.
         //
-        goto Exit;
+        DmfAssert(parentDmfObject->ModuleDescriptor.CallbacksWdf->ModuleFileCreate != NULL);
+        returnValue = (parentDmfObject->ModuleDescriptor.CallbacksWdf->ModuleFileCreate)(DmfModule,
+                                                                                         Device,
+                                                                                         Request,
+                                                                                         FileObject);
+        if (returnValue)
+        {
+            // It is handled...do not submit to children.
+            //
+            goto Exit;
+        }
     }
 
     // Dispatch callback to Child DMF Modules after trying parent Module and only if parent Module
@@ -2581,7 +2595,15 @@ Return Value:
         goto Exit;
     }
 
-    if (dmfObject->ModuleDescriptor.OpenOption == DMF_MODULE_OPEN_OPTION_OPEN_Create)
+    if ((dmfObject->ModuleDescriptor.OpenOption == DMF_MODULE_OPEN_OPTION_OPEN_Create) &&
+        (dmfObject->ModuleAttributes.OpenOnFirstUse))
+    {
+        // The given Parent DMF Module is opened the first time it is used instead.
+        //
+        DMF_ModuleDeferredOpenArm(DmfModule,
+                                  ModuleOpenedDuringType_Create);
+    }
+    else if (dmfObject->ModuleDescriptor.OpenOption == DMF_MODULE_OPEN_OPTION_OPEN_Create)
     {
         // Dispatch Open callback to the given Parent DMF Module next.
         //
@@ -2714,8 +2736,9 @@ Return Value:
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _Must_inspect_result_
+static
 NTSTATUS
-DMF_ModuleReference(
+DMF_ModuleReferenceIfOpen(
     _In_ DMFMODULE DmfModule
     )
 /*++
@@ -2723,8 +2746,7 @@ DMF_ModuleReference(
 Routine Description:
 
     If a Module is open, acquires a reference to the Module so it remains open until 
-    DMF_ModuleDereference is called.  Use this in Module Methods when a Module is 
-    opened in notification callback.
+    DMF_ModuleDereference is called.
 
 Arguments:
 
@@ -2767,6 +2789,55 @@ Return Value:
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleReference(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    If a Module is open, acquires a reference to the Module so it remains open until 
+    DMF_ModuleDereference is called.  Use this in Module Methods when a Module is 
+    opened in notification callback.
+    If the Module's open was deferred until first use (DMF_MODULE_ATTRIBUTES.OpenOnFirstUse),
+    the Module is opened first.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+   STATUS_SUCCESS - Module is open and reference has been acquired.
+   STATUS_INVALID_DEVICE_STATE - Module is not open.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    ntStatus = DMF_ModuleReferenceIfOpen(DmfModule);
+    if ((! NT_SUCCESS(ntStatus)) &&
+        (dmfObject->ModuleAttributes.OpenOnFirstUse))
+    {
+        // The Module is only checked for a deferred open when it is not open, so Modules
+        // that are already open do not pay for it.
+        //
+        ntStatus = DMF_ModuleDeferredOpen(DmfModule);
+        if (NT_SUCCESS(ntStatus))
+        {
+            ntStatus = DMF_ModuleReferenceIfOpen(DmfModule);
+        }
+    }
+
+    return ntStatus;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
 DMF_ModuleDereference(
@@ -2883,6 +2954,211 @@ Return Value:
     FuncExit(DMF_TRACE, "DmfModule=0x%p [%s]", DmfModule, dmfObject->ClientModuleInstanceName);
 }
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleDeferredOpenArm(
+    _In_ DMFMODULE DmfModule,
+    _In_ ModuleOpenedDuringType OpenDeferredDuring
+    )
+/*++
+
+Routine Description:
+
+    Instead of opening a Module that sets DMF_MODULE_ATTRIBUTES.OpenOnFirstUse, remember
+    that it should be opened the first time it is used. The Module's type tag is changed so that
+    its Methods open it (see DMF_HandleValidate_ModuleTypeMismatch()).
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+    OpenDeferredDuring - The callback during which the Module would have been opened.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    DmfAssert(dmfObject->ModuleAttributes.OpenOnFirstUse);
+    DmfAssert(dmfObject->OpenDeferredLock != NULL);
+
+    WdfWaitLockAcquire(dmfObject->OpenDeferredLock,
+                       NULL);
+
+    DmfAssert(ModuleOpenedDuringType_Invalid == dmfObject->OpenDeferredDuring);
+    DmfAssert(ModuleOpenedDuringType_Invalid == dmfObject->ModuleOpenedDuring);
+    dmfObject->OpenDeferredDuring = OpenDeferredDuring;
+    DMF_ModuleTypeTagOpenDeferredSet(DmfModule,
+                                     TRUE);
+
+    WdfWaitLockRelease(dmfObject->OpenDeferredLock);
+
+    TraceInformation(DMF_TRACE, "DmfModule=0x%p [%s] Open deferred until first use OpenDeferredDuring=%d", DmfModule, dmfObject->ClientModuleInstanceName, OpenDeferredDuring);
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleDeferredOpenCancel(
+    _In_ DMFMODULE DmfModule,
+    _In_ ModuleOpenedDuringType OpenDeferredDuring
+    )
+/*++
+
+Routine Description:
+
+    Cancel the deferred open of a Module that sets DMF_MODULE_ATTRIBUTES.OpenOnFirstUse.
+    This is called before the Module is automatically closed. After it returns, the Module
+    cannot be opened on first use. If the Module has already been opened on first use, its
+    ModuleOpenedDuring is set to OpenDeferredDuring, so the caller closes it as usual.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+    OpenDeferredDuring - The callback during which the Module would have been opened.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    DmfAssert(dmfObject->ModuleAttributes.OpenOnFirstUse);
+    DmfAssert(dmfObject->OpenDeferredLock != NULL);
+
+    // Wait for an open on first use that is in progress to finish.
+    //
+    WdfWaitLockAcquire(dmfObject->OpenDeferredLock,
+                       NULL);
+
+    if (dmfObject->OpenDeferredDuring == OpenDeferredDuring)
+    {
+        // The Module was never used so it was never opened.
+        //
+        dmfObject->OpenDeferredDuring = ModuleOpenedDuringType_Invalid;
+        TraceInformation(DMF_TRACE, "DmfModule=0x%p [%s] Deferred open canceled", DmfModule, dmfObject->ClientModuleInstanceName);
+    }
+
+    // Methods no longer try to open the Module (including when it failed to open on first use).
+    //
+    DMF_ModuleTypeTagOpenDeferredSet(DmfModule,
+                                     FALSE);
+
+    WdfWaitLockRelease(dmfObject->OpenDeferredLock);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleDeferredOpen(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Open a Module whose open was deferred until first use (DMF_MODULE_ATTRIBUTES.OpenOnFirstUse).
+    If several callers use the Module for the first time at the same time, only one opens it
+    and the others wait for it to be open.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+   STATUS_SUCCESS - Module is open.
+   STATUS_INVALID_DEVICE_STATE - Module is not open and cannot be opened now (the deferred open
+                                 has been canceled or the caller is not running at PASSIVE_LEVEL).
+   Otherwise, the NTSTATUS code of the Module's Open.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    DmfAssert(dmfObject->ModuleAttributes.OpenOnFirstUse);
+    DmfAssert(dmfObject->OpenDeferredLock != NULL);
+
+#if !defined(DMF_USER_MODE)
+    if (KeGetCurrentIrql() != PASSIVE_LEVEL)
+    {
+        // Modules are only opened at PASSIVE_LEVEL.
+        //
+        ntStatus = STATUS_INVALID_DEVICE_STATE;
+        goto Exit;
+    }
+#endif // !defined(DMF_USER_MODE)
+
+    if (dmfObject->OpenDeferredThreadId == DmfGetCurrentThreadId())
+    {
+        // The Module's Open is calling its own Methods. Like for other Modules,
+        // the Module is not open until Open returns.
+        //
+        ntStatus = STATUS_INVALID_DEVICE_STATE;
+        goto Exit;
+    }
+
+    WdfWaitLockAcquire(dmfObject->OpenDeferredLock,
+                       NULL);
+
+    if (ModuleOpenedDuringType_Invalid == dmfObject->OpenDeferredDuring)
+    {
+        // Either another caller has opened the Module or the Module has been closed.
+        //
+        if (dmfObject->ModuleOpenedDuring != ModuleOpenedDuringType_Invalid)
+        {
+            ntStatus = STATUS_SUCCESS;
+        }
+        else
+        {
+            ntStatus = STATUS_INVALID_DEVICE_STATE;
+        }
+    }
+    else
+    {
+        dmfObject->OpenDeferredThreadId = DmfGetCurrentThreadId();
+        ntStatus = DMF_Internal_Open(DmfModule);
+        dmfObject->OpenDeferredThreadId = NULL;
+        if (NT_SUCCESS(ntStatus))
+        {
+            // Indicate when the Module would have been opened so that it is closed
+            // when it would have been closed.
+            // Internal Open has set this value to Manual by default.
+            //
+            DmfAssert(ModuleOpenedDuringType_Manual == dmfObject->ModuleOpenedDuring);
+            dmfObject->ModuleOpenedDuring = dmfObject->OpenDeferredDuring;
+            DMF_ModuleTypeTagOpenDeferredSet(DmfModule,
+                                             FALSE);
+            TraceInformation(DMF_TRACE, "DmfModule=0x%p [%s] Opened on first use", DmfModule, dmfObject->ClientModuleInstanceName);
+        }
+        else
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_Internal_Open ntStatus=%!STATUS!", ntStatus);
+        }
+
+        // The Module is only opened once. If it fails to open, it stays closed and its
+        // type tag is left as is, so that its Methods fail until the deferred open is canceled.
+        //
+        dmfObject->OpenDeferredDuring = ModuleOpenedDuringType_Invalid;
+    }
+
+    WdfWaitLockRelease(dmfObject->OpenDeferredLock);
+
+Exit:
+
+    return ntStatus;
+}
+
 VOID
 DMF_ModuleClose(
     _In_ DMFMODULE DmfModule
@@ -2948,6 +3224,14 @@ Return Value:
     //
     if (dmfObject->ModuleDescriptor.OpenOption == DMF_MODULE_OPEN_OPTION_OPEN_Create)
     {
+        if (dmfObject->ModuleAttributes.OpenOnFirstUse)
+        {
+            // Only close this Module if it has been used.
+            //
+            DMF_ModuleDeferredOpenCancel(DmfModule,
+                                         ModuleOpenedDuringType_Create);
+        }
+
         if (dmfObject->ModuleOpenedDuring == ModuleOpenedDuringType_Create)
         {
             DmfAssert(dmfObject->InternalCallbacksDmf.DeviceClose != NULL);
@@ -3025,16 +3309,29 @@ Return Value:
 --*/
 {
     DMF_OBJECT* dmfObject;
+#if defined(USE_DMF_LOCK_PROFILING)
+    BOOLEAN lockContended;
+#endif // defined(USE_DMF_LOCK_PROFILING)
 
     dmfObject = DMF_ModuleToObject(DmfModule);
 
     DmfAssert(dmfObject != NULL);
-    DmfAssert(dmfObject->InternalCallbacksInternal.AuxiliaryLock != NULL);
-    (dmfObject->InternalCallbacksInternal.AuxiliaryLock)(DmfModule,
-                                                         DMF_DEFAULT_LOCK_INDEX);
+    DmfAssert(dmfObject->InternalCallbacksInternal.DefaultLock != NULL);
+#if defined(USE_DMF_LOCK_PROFILING)
+    lockContended = DMF_LockProfileContendedGet(&dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX]);
+#endif // defined(USE_DMF_LOCK_PROFILING)
+    (dmfObject->InternalCallbacksInternal.DefaultLock)(DmfModule);
     DmfAssert(NULL == dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread);
+#if defined(DEBUG)
+    DmfAssert(0 == dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldSharedCount);
+#endif // defined(DEBUG)
 
     dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread = DmfGetCurrentThreadId();
+#if defined(USE_DMF_LOCK_PROFILING)
+    DMF_LockProfileAcquired(&dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX],
+                            lockContended,
+                            _ReturnAddress());
+#endif // defined(USE_DMF_LOCK_PROFILING)
 }
 
 VOID
@@ -3065,10 +3362,83 @@ Return Value:
     
     DmfAssert(DmfGetCurrentThreadId() == dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread);
 
+#if defined(USE_DMF_LOCK_PROFILING)
+    DMF_LockProfileReleased(&dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX]);
+#endif // defined(USE_DMF_LOCK_PROFILING)
     dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread = NULL;
-    DmfAssert(dmfObject->InternalCallbacksInternal.AuxiliaryUnlock != NULL);
-    (dmfObject->InternalCallbacksInternal.AuxiliaryUnlock)(DmfModule,
-                                                           DMF_DEFAULT_LOCK_INDEX);
+    DmfAssert(dmfObject->InternalCallbacksInternal.DefaultUnlock != NULL);
+    (dmfObject->InternalCallbacksInternal.DefaultUnlock)(DmfModule);
+}
+
+VOID
+DMF_ModuleLockShared(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Invoke the Lock Shared Callback for a given DMF Module. Use it in Methods that only
+    read the Module's data. If the Module does not set DMF_MODULE_OPTIONS_READER_WRITER_LOCK,
+    the default lock is acquired exclusively.
+    NOTE: The lock is not recursive. The caller must not hold it in any mode.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    DmfAssert(dmfObject != NULL);
+    DmfAssert(dmfObject->InternalCallbacksInternal.DefaultLockShared != NULL);
+    (dmfObject->InternalCallbacksInternal.DefaultLockShared)(DmfModule);
+    DmfAssert(NULL == dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread);
+
+#if defined(DEBUG)
+    InterlockedIncrement(&dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldSharedCount);
+#endif // defined(DEBUG)
+}
+
+VOID
+DMF_ModuleUnlockShared(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Invoke the Unlock Shared Callback for a given DMF Module.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    DmfAssert(dmfObject != NULL);
+
+#if defined(DEBUG)
+    DmfAssert(dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldSharedCount > 0);
+    InterlockedDecrement(&dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldSharedCount);
+#endif // defined(DEBUG)
+    DmfAssert(dmfObject->InternalCallbacksInternal.DefaultUnlockShared != NULL);
+    (dmfObject->InternalCallbacksInternal.DefaultUnlockShared)(DmfModule);
 }
 
 #if defined(DEBUG)
@@ -3089,7 +3459,50 @@ Arguments:
 
 Return Value:
 
-    TRUE if the given DMF Module is currently locked; false, otherwise.
+    TRUE if the given DMF Module is currently locked (exclusive or shared); false, otherwise.
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    BOOLEAN lockHeld;
+
+    DmfAssert(DmfModule != NULL);
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    if ((dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldByThread != NULL) ||
+        (dmfObject->Synchronizations[DMF_DEFAULT_LOCK_INDEX].LockHeldSharedCount > 0))
+    {
+        lockHeld = TRUE;
+    }
+    else
+    {
+        lockHeld = FALSE;
+    }
+
+    return lockHeld;
+}
+
+BOOLEAN
+DMF_ModuleIsLockedExclusive(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Returns whether the given DMF Module's default lock is held exclusively. Code that
+    modifies the Module's data uses this instead of DMF_ModuleIsLocked() because a
+    shared owner may not modify it.
+    NOTE: This function is for debug purposes only.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    TRUE if the given DMF Module is currently locked exclusively; false, otherwise.
 
 --*/
 {
@@ -3235,6 +3648,9 @@ Return Value:
 --*/
 {
     DMF_OBJECT* dmfObject;
+#if defined(USE_DMF_LOCK_PROFILING)
+    BOOLEAN lockContended;
+#endif // defined(USE_DMF_LOCK_PROFILING)
 
     dmfObject = DMF_ModuleToObject(DmfModule);
     DmfAssert(dmfObject != NULL);
@@ -3242,6 +3658,14 @@ Return Value:
     DmfAssert(AuxiliaryLockIndex < dmfObject->ModuleDescriptor.NumberOfAuxiliaryLocks);
     DmfAssert(dmfObject->InternalCallbacksInternal.AuxiliaryLock != NULL);
 
+#if defined(USE_DMF_LOCK_PROFILING)
+    lockContended = FALSE;
+    if (AuxiliaryLockIndex < DMF_MAXIMUM_AUXILIARY_LOCKS)
+    {
+        lockContended = DMF_LockProfileContendedGet(&dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS]);
+    }
+#endif // defined(USE_DMF_LOCK_PROFILING)
+
     // Device lock is at 0. Auxiliary locks start from 1.
     // AuxiliaryLockIndex is 0 based.
     //
@@ -3254,6 +3678,11 @@ Return Value:
     {
         DmfAssert(NULL == dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS].LockHeldByThread);
         dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS].LockHeldByThread = DmfGetCurrentThreadId();
+#if defined(USE_DMF_LOCK_PROFILING)
+        DMF_LockProfileAcquired(&dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS],
+                                lockContended,
+                                _ReturnAddress());
+#endif // defined(USE_DMF_LOCK_PROFILING)
     }
     else
     {
@@ -3299,6 +3728,9 @@ Return Value:
         //
         DmfAssert(DmfGetCurrentThreadId() == dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS].LockHeldByThread);
 
+#if defined(USE_DMF_LOCK_PROFILING)
+        DMF_LockProfileReleased(&dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS]);
+#endif // defined(USE_DMF_LOCK_PROFILING)
         dmfObject->Synchronizations[AuxiliaryLockIndex + DMF_NUMBER_OF_DEFAULT_LOCKS].LockHeldByThread = NULL;
 
         DmfAssert(dmfObject->InternalCallbacksInternal.AuxiliaryUnlock != NULL);
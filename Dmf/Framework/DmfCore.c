@@ -50,7 +50,23 @@ DmfCallbacksInternal_Internal_Passive =
     DMF_Generic_Lock_Passive,
     DMF_Generic_Unlock_Passive,
     DMF_Generic_AuxiliaryLock_Passive,
-    DMF_Generic_AuxiliaryUnlock_Passive
+    DMF_Generic_AuxiliaryUnlock_Passive,
+    // Without a reader/writer lock, readers lock exclusively.
+    //
+    DMF_Generic_Lock_Passive,
+    DMF_Generic_Unlock_Passive
+};
+
+DMF_CALLBACKS_INTERNAL
+DmfCallbacksInternal_Internal_PassiveReaderWriter =
+{
+    sizeof(DMF_CALLBACKS_INTERNAL),
+    DMF_Generic_ReaderWriterLock_Passive,
+    DMF_Generic_ReaderWriterUnlock_Passive,
+    DMF_Generic_AuxiliaryLock_Passive,
+    DMF_Generic_AuxiliaryUnlock_Passive,
+    DMF_Generic_ReaderWriterLockShared_Passive,
+    DMF_Generic_ReaderWriterUnlockShared_Passive
 };
 
 DMF_CALLBACKS_WDF
@@ -107,7 +123,23 @@ DmfCallbacksInternal_Internal_Dispatch =
     DMF_Generic_Lock_Dispatch,
     DMF_Generic_Unlock_Dispatch,
     DMF_Generic_AuxiliaryLock_Dispatch,
-    DMF_Generic_AuxiliaryUnlock_Dispatch
+    DMF_Generic_AuxiliaryUnlock_Dispatch,
+    // Without a reader/writer lock, readers lock exclusively.
+    //
+    DMF_Generic_Lock_Dispatch,
+    DMF_Generic_Unlock_Dispatch
+};
+
+DMF_CALLBACKS_INTERNAL
+DmfCallbacksInternal_Internal_DispatchReaderWriter =
+{
+    sizeof(DMF_CALLBACKS_INTERNAL),
+    DMF_Generic_ReaderWriterLock_Dispatch,
+    DMF_Generic_ReaderWriterUnlock_Dispatch,
+    DMF_Generic_AuxiliaryLock_Dispatch,
+    DMF_Generic_AuxiliaryUnlock_Dispatch,
+    DMF_Generic_ReaderWriterLockShared_Dispatch,
+    DMF_Generic_ReaderWriterUnlockShared_Dispatch
 };
 
 DMF_CALLBACKS_WDF
@@ -243,45 +275,66 @@ Return Value:
 }
 #pragma code_seg()
 
+// DMF_ModuleCreate() allocates DMF_OBJECT and the parts of the Module whose sizes are
+// known when the Module is created in a single allocation, in this order:
+//
+// DMF_OBJECT
+// DMF_CALLBACKS_DMF
+// DMF_CALLBACKS_WDF
+// DMF_READER_WRITER_LOCK (if the Module sets DMF_MODULE_OPTIONS_READER_WRITER_LOCK)
+// Module Config (if the Module has a Config)
+// Client Module Instance Name
+//
+#define DMF_OBJECT_LAYOUT_ALIGN(Size)   (((Size) + (MEMORY_ALLOCATION_ALIGNMENT - 1)) & ~((size_t)(MEMORY_ALLOCATION_ALIGNMENT - 1)))
+
+typedef struct
+{
+    // Offsets of each part from the start of the allocation.
+    // Each part is aligned to MEMORY_ALLOCATION_ALIGNMENT.
+    //
+    size_t CallbacksDmfOffset;
+    size_t CallbacksWdfOffset;
+    size_t ReaderWriterLockOffset;
+    size_t ModuleConfigOffset;
+    size_t ClientModuleInstanceNameOffset;
+    // Sizes of the parts that are optional or have variable size. Zero if the part is not present.
+    //
+    size_t ReaderWriterLockSize;
+    size_t ModuleConfigSize;
+    size_t ClientModuleInstanceNameSize;
+    // Size of the allocation.
+    //
+    size_t TotalSize;
+} DMF_OBJECT_LAYOUT;
+
 #pragma code_seg("PAGE")
 static
-NTSTATUS
-DmfModuleInstanceNameInitialize(
-    _Inout_ DMF_OBJECT* DmfObject,
-    _In_ WDFMEMORY MemoryDmfObject,
+CHAR*
+DmfModuleInstanceNameGet(
+    _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor,
     _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes
     )
 /*++
 
 Routine Description:
 
-    Populate a given DMF_OBJECT structure with Client Module Instance Name.
+    Returns the Client Module Instance Name of a Module that is being created.
 
 Arguments:
 
-    DmfObject - The given DMF_OBJECT structure.
-    MemoryDmfObject - The corresponding WDFMEMORY object for DmfObject.
+    ModuleDescriptor - Pointer to the DMF_MODULE_DESCRIPTOR structure providing information about the Module.
     DmfModuleAttributes - Pointer to the initialized DMF_MODULE_ATTRIBUTES structure.
 
 Return Value:
 
-    NTSTATUS
+    The name. It is copied to the Module because the Client may not have statically allocated it.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES attributes;
-    size_t clientModuleInstanceNameSizeBytes;
     CHAR* clientModuleInstanceName;
 
     PAGED_CODE();
 
-    // Create space for the Client Module Instance Name. It needs to be allocated because
-    // the name that is passed in may not be statically allocated. A copy needs to be made
-    // in case the Client Driver has allocated the passed in name on the stack. We don't 
-    // want to force the Client Driver to maintain space for the name in cases where the 
-    // name is generated.
-    //
     DmfAssert(DmfModuleAttributes->ClientModuleInstanceName != NULL);
     if (*DmfModuleAttributes->ClientModuleInstanceName == '\0')
     {
@@ -289,7 +342,7 @@ Return Value:
         // (Client Driver only needs to set this string in cases where multiple instances of a 
         // DMF Module are instantiated.)
         //
-        clientModuleInstanceName = DmfObject->ModuleName;
+        clientModuleInstanceName = ModuleDescriptor->ModuleName;
     }
     else
     {
@@ -297,150 +350,173 @@ Return Value:
         //
         clientModuleInstanceName = DmfModuleAttributes->ClientModuleInstanceName;
     }
-    clientModuleInstanceNameSizeBytes = strlen(clientModuleInstanceName) + sizeof(CHAR);
-    DmfAssert(clientModuleInstanceNameSizeBytes > 1);
 
-    // Allocate space for the instance name. This name is useful during debugging.
+    return clientModuleInstanceName;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+DmfModuleLayoutGet(
+    _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_z_ CHAR* ClientModuleInstanceName,
+    _Out_ DMF_OBJECT_LAYOUT* Layout
+    )
+/*++
+
+Routine Description:
+
+    Calculates where each part of a Module that is being created is in the Module's
+    DMF_OBJECT allocation.
+
+Arguments:
+
+    ModuleDescriptor - Pointer to the DMF_MODULE_DESCRIPTOR structure providing information about the Module.
+    DmfModuleAttributes - Pointer to the initialized DMF_MODULE_ATTRIBUTES structure.
+    ClientModuleInstanceName - The Module's Client Module Instance Name.
+    Layout - Where each part of the Module is.
+
+Return Value:
+
+    None
+
+--*/
+{
+    size_t offset;
+
+    PAGED_CODE();
+
+    RtlZeroMemory(Layout,
+                  sizeof(DMF_OBJECT_LAYOUT));
+
+    offset = DMF_OBJECT_LAYOUT_ALIGN(sizeof(DMF_OBJECT));
+
+    Layout->CallbacksDmfOffset = offset;
+    offset += DMF_OBJECT_LAYOUT_ALIGN(sizeof(DMF_CALLBACKS_DMF));
+
+    Layout->CallbacksWdfOffset = offset;
+    offset += DMF_OBJECT_LAYOUT_ALIGN(sizeof(DMF_CALLBACKS_WDF));
+
+    Layout->ReaderWriterLockSize = DMF_ReaderWriterLockSizeGet(ModuleDescriptor->ModuleOptions,
+                                                               DmfModuleAttributes->PassiveLevel);
+    Layout->ReaderWriterLockOffset = offset;
+    offset += DMF_OBJECT_LAYOUT_ALIGN(Layout->ReaderWriterLockSize);
+
+    // NOTE: Because only proper Config initialization macros are exposed, there is no way for the 
+    //       Client to improperly initialize the Config (as it was in the past). It means, that if 
+    //       there is no Config size, the Module Author has not defined a Config.
     //
-    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-    attributes.ParentObject = MemoryDmfObject;
-    ntStatus = WdfMemoryCreate(&attributes,
-                               NonPagedPoolNx,
-                               DMF_TAG,
-                               clientModuleInstanceNameSizeBytes,
-                               &DmfObject->ClientModuleInstanceNameMemory,
-                               (VOID* *)&DmfObject->ClientModuleInstanceName);
-    if (! NT_SUCCESS(ntStatus))
+    if (DmfModuleAttributes->SizeOfModuleSpecificConfig != NULL)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate ClientModuleInstanceName");
-        goto Exit;
+        DmfAssert(ModuleDescriptor->ModuleConfigSize == DmfModuleAttributes->SizeOfModuleSpecificConfig);
+        Layout->ModuleConfigSize = ModuleDescriptor->ModuleConfigSize;
     }
-    RtlZeroMemory(DmfObject->ClientModuleInstanceName,
-                  clientModuleInstanceNameSizeBytes);
+    Layout->ModuleConfigOffset = offset;
+    offset += DMF_OBJECT_LAYOUT_ALIGN(Layout->ModuleConfigSize);
+
+    Layout->ClientModuleInstanceNameSize = strlen(ClientModuleInstanceName) + sizeof(CHAR);
+    DmfAssert(Layout->ClientModuleInstanceNameSize > 1);
+    Layout->ClientModuleInstanceNameOffset = offset;
+    offset += Layout->ClientModuleInstanceNameSize;
+
+    Layout->TotalSize = offset;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+DmfModuleInstanceNameInitialize(
+    _Inout_ DMF_OBJECT* DmfObject,
+    _In_z_ CHAR* ClientModuleInstanceName,
+    _In_ size_t ClientModuleInstanceNameSizeBytes
+    )
+/*++
+
+Routine Description:
+
+    Populate a given DMF_OBJECT structure with Client Module Instance Name.
+
+Arguments:
+
+    DmfObject - The given DMF_OBJECT structure. Its ClientModuleInstanceName points to
+                ClientModuleInstanceNameSizeBytes bytes of zeroed memory.
+    ClientModuleInstanceName - The name to copy.
+    ClientModuleInstanceNameSizeBytes - Size of the name including the terminating zero.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
     // Copy the string. The length passed is one more than the length but that
     // extra byte is terminating zero which will not be copied.
     //
     strncpy_s(DmfObject->ClientModuleInstanceName,
-              clientModuleInstanceNameSizeBytes,
-              clientModuleInstanceName,
-              clientModuleInstanceNameSizeBytes);
-    DmfAssert(clientModuleInstanceNameSizeBytes > 0);
-    DmfAssert(DmfObject->ClientModuleInstanceName[clientModuleInstanceNameSizeBytes - 1] == '\0');
+              ClientModuleInstanceNameSizeBytes,
+              ClientModuleInstanceName,
+              ClientModuleInstanceNameSizeBytes);
+    DmfAssert(ClientModuleInstanceNameSizeBytes > 0);
+    DmfAssert(DmfObject->ClientModuleInstanceName[ClientModuleInstanceNameSizeBytes - 1] == '\0');
     DmfAssert(DmfObject->ClientModuleInstanceName[0] != '\0');
-
-Exit:
-
-    return ntStatus;
 }
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
 static
-NTSTATUS
-DmfModuleChildObjectsInitialize(
+VOID
+DmfModuleConfigInitialize(
     _Inout_ DMF_OBJECT* DmfObject,
-    _In_ WDFMEMORY MemoryDmfObject,
     _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
-    _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor
+    _In_ size_t ModuleConfigSize
     )
 /*++
 
 Routine Description:
 
-    Initialize various child objects in a given DMF_OBJECT structure.
+    Save a copy of the Module Config in a given DMF_OBJECT structure for when the
+    Open happens later.
 
 Arguments:
 
-    DmfObject - The given DMF_OBJECT structure.
-    MemoryDmfObject - The corresponding WDFMEMORY object for DmfObject.
+    DmfObject - The given DMF_OBJECT structure. Its ModuleConfig points to ModuleConfigSize
+                bytes of memory if the Module has a Config.
     DmfModuleAttributes - Pointer to the initialized DMF_MODULE_ATTRIBUTES structure.
-    ModuleDescriptor - Pointer to the DMF_MODULE_DESCRIPTOR structure providing information about the Module.
+    ModuleConfigSize - Size of the Module Config. Zero if the Module has no Config.
 
 Return Value:
 
-    NTSTATUS
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES attributes;
-
     PAGED_CODE();
 
-    // Create the area for Module Config, if any.
-    //
-    DmfAssert(NULL == DmfObject->ModuleConfig);
-    if (DmfModuleAttributes->SizeOfModuleSpecificConfig != NULL)
+    if (ModuleConfigSize > 0)
     {
-        DmfAssert(ModuleDescriptor->ModuleConfigSize == DmfModuleAttributes->SizeOfModuleSpecificConfig);
-        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-        attributes.ParentObject = MemoryDmfObject;
-        ntStatus = WdfMemoryCreate(&attributes,
-                                   NonPagedPoolNx,
-                                   DMF_TAG,
-                                   ModuleDescriptor->ModuleConfigSize,
-                                   &DmfObject->ModuleConfigMemory,
-                                   &DmfObject->ModuleConfig);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate Module Config");
-            goto Exit;
-        }
-
-        // ModuleConfig will be fully overwritten in RtlCopyMemory below. 
-        // So zeroing out the buffer is not necessary.
-        //
-
-        // Save off the Module Config information for when the Open happens later.
-        //
         DmfAssert(DmfModuleAttributes->ModuleConfigPointer != NULL);
         DmfAssert(DmfObject->ModuleConfig != NULL);
         RtlCopyMemory(DmfObject->ModuleConfig,
                       DmfModuleAttributes->ModuleConfigPointer,
-                      ModuleDescriptor->ModuleConfigSize);
+                      ModuleConfigSize);
     }
     else
     {
-        // NOTE: Because only proper Config initialization macros are exposed, there is no way for the 
-        //       Client to improperly initialize the Config (as it was in the past). It means, that if 
-        //       this path executes, the Module Author has not defined a Config.
-        //
-    }
-
-    // Create WDFCOLLECTION to store the Interface Bindings of this Module.
-    //
-    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-    attributes.ParentObject = MemoryDmfObject;
-    ntStatus = WdfCollectionCreate(&attributes,
-                                   &DmfObject->InterfaceBindings);
-    if (!NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate Collection for InterfaceBindings.");
-        goto Exit;
+        DmfAssert(NULL == DmfObject->ModuleConfig);
     }
-
-    // Create a spin lock to protect access to the Interface Bindings Collection.
-    //
-    ntStatus = WdfSpinLockCreate(&attributes,
-                                 &DmfObject->InterfaceBindingsLock);
-    if (!NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "InterfaceBindingsLock create fails.");
-        goto Exit;
-    }
-
-Exit:
-
-    return ntStatus;
 }
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
 static
-NTSTATUS
+VOID
 DmfModuleCallbacksInitialize(
     _Inout_ DMF_OBJECT* DmfObject,
-    _In_ WDFMEMORY MemoryDmfObject,
     _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
     _In_ DMF_MODULE_DESCRIPTOR* ModuleDescriptor
     )
@@ -452,56 +528,23 @@ Routine Description:
 
 Arguments:
 
-    DmfObject - The given DMF_OBJECT structure.
-    MemoryDmfObject - The corresponding WDFMEMORY object for DmfObject.
+    DmfObject - The given DMF_OBJECT structure. Its ModuleDescriptor.CallbacksDmf and
+                ModuleDescriptor.CallbacksWdf point to zeroed memory.
     DmfModuleAttributes - Pointer to the initialized DMF_MODULE_ATTRIBUTES structure.
     ModuleDescriptor - Pointer to the DMF_MODULE_DESCRIPTOR structure providing information about the Module.
 
 Return Value:
 
-    NTSTATUS
+    None
 
 --*/
 {
-    NTSTATUS ntStatus;
-    WDF_OBJECT_ATTRIBUTES attributes;
     DMF_MODULE_EVENT_CALLBACKS* callbacks;
-    WDFMEMORY callbacksDmfMemory;
-    WDFMEMORY callbacksWdfMemory;
 
     PAGED_CODE();
 
-    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-    attributes.ParentObject = MemoryDmfObject;
-    ntStatus = WdfMemoryCreate(&attributes,
-                               NonPagedPoolNx,
-                               DMF_TAG,
-                               sizeof(DMF_CALLBACKS_DMF),
-                               &callbacksDmfMemory,
-                               (VOID* *)&DmfObject->ModuleDescriptor.CallbacksDmf);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate Callbacks Dmf");
-        goto Exit;
-    }
-
-    RtlZeroMemory(DmfObject->ModuleDescriptor.CallbacksDmf,
-                  sizeof(DMF_CALLBACKS_DMF));
-
-    ntStatus = WdfMemoryCreate(&attributes,
-                               NonPagedPoolNx,
-                               DMF_TAG,
-                               sizeof(DMF_CALLBACKS_WDF),
-                               &callbacksWdfMemory,
-                               (VOID* *)&DmfObject->ModuleDescriptor.CallbacksWdf);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate Callbacks Dmf");
-        goto Exit;
-    }
-
-    RtlZeroMemory(DmfObject->ModuleDescriptor.CallbacksWdf,
-                  sizeof(DMF_CALLBACKS_WDF));
+    DmfAssert(DmfObject->ModuleDescriptor.CallbacksDmf != NULL);
+    DmfAssert(DmfObject->ModuleDescriptor.CallbacksWdf != NULL);
 
     DmfCallbacksDmfInitialize(DmfObject->ModuleDescriptor.CallbacksDmf);
     DmfCallbacksWdfInitialize(DmfObject->ModuleDescriptor.CallbacksWdf);
@@ -531,7 +574,14 @@ Return Value:
         DmfAssert(! (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE));
         DmfObject->InternalCallbacksDmf = DmfCallbacksDmf_Internal_Dispatch;
         DmfObject->InternalCallbacksWdf = DmfCallbacksWdf_Internal_Dispatch;
-        DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_Dispatch;
+        if (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_READER_WRITER_LOCK)
+        {
+            DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_DispatchReaderWriter;
+        }
+        else
+        {
+            DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_Dispatch;
+        }
     }
     else if (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE)
     {
@@ -540,7 +590,14 @@ Return Value:
         DmfAssert(! (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH));
         DmfObject->InternalCallbacksDmf = DmfCallbacksDmf_Internal_Passive;
         DmfObject->InternalCallbacksWdf = DmfCallbacksWdf_Internal_Passive;
-        DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_Passive;
+        if (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_READER_WRITER_LOCK)
+        {
+            DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_PassiveReaderWriter;
+        }
+        else
+        {
+            DmfObject->InternalCallbacksInternal = DmfCallbacksInternal_Internal_Passive;
+        }
     }
     else
     {
@@ -716,6 +773,9 @@ Return Value:
 
     DmfObject->ModuleDescriptor.WdfAddCustomType = ModuleDescriptor->WdfAddCustomType;
     DmfAssert(DmfObject->ModuleDescriptor.WdfAddCustomType != NULL);
+    DmfObject->ModuleDescriptor.ModuleTypeTag = ModuleDescriptor->ModuleTypeTag;
+    DmfAssert(DmfObject->ModuleDescriptor.ModuleTypeTag != NULL);
+    DmfObject->ModuleTypeTag = ModuleDescriptor->ModuleTypeTag;
 
     // Handlers are always set. We don't need to check pointers everywhere.
     //
@@ -799,10 +859,8 @@ Return Value:
     DmfAssert(DmfObject->InternalCallbacksInternal.DefaultUnlock != NULL);
     DmfAssert(DmfObject->InternalCallbacksInternal.AuxiliaryLock != NULL);
     DmfAssert(DmfObject->InternalCallbacksInternal.AuxiliaryUnlock != NULL);
-
-Exit:
-
-    return ntStatus;
+    DmfAssert(DmfObject->InternalCallbacksInternal.DefaultLockShared != NULL);
+    DmfAssert(DmfObject->InternalCallbacksInternal.DefaultUnlockShared != NULL);
 }
 #pragma code_seg()
 
@@ -1086,6 +1144,10 @@ Return Value:
     PFN_WDF_OBJECT_CONTEXT_CLEANUP clientEvtCleanupCallback;
     WDF_OBJECT_ATTRIBUTES copyOfDmfModuleObjectAttributes;
     WDFOBJECT parentObject;
+    CHAR* clientModuleInstanceName;
+    DMF_OBJECT_LAYOUT layout;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    BOOLEAN moduleContextAllocate;
 
     PAGED_CODE();
 
@@ -1196,10 +1258,38 @@ Return Value:
         DmfModuleObjectAttributes->EvtCleanupCallback = DmfEvtDynamicModuleCleanupCallback;
     }
 
+    // Allocate DMF_OBJECT together with the parts of the Module that do not need to be
+    // separate objects. Modules are often created and destroyed dynamically, so it is
+    // important that this is fast.
+    //
+    clientModuleInstanceName = DmfModuleInstanceNameGet(ModuleDescriptor,
+                                                        DmfModuleAttributes);
+    DmfModuleLayoutGet(ModuleDescriptor,
+                       DmfModuleAttributes,
+                       clientModuleInstanceName,
+                       &layout);
+
+    // Allocate the Module Context with the DMFMODULE object as its context type unless
+    // the Client has set its own context type in the DMFMODULE's attributes.
+    //
+    moduleContextAllocate = FALSE;
+    if (ModuleDescriptor->ModuleContextAttributes != WDF_NO_OBJECT_ATTRIBUTES)
+    {
+        if (NULL == DmfModuleObjectAttributes->ContextTypeInfo)
+        {
+            DmfModuleObjectAttributes->ContextTypeInfo = ModuleDescriptor->ModuleContextAttributes->ContextTypeInfo;
+            DmfModuleObjectAttributes->ContextSizeOverride = ModuleDescriptor->ModuleContextAttributes->ContextSizeOverride;
+        }
+        else
+        {
+            moduleContextAllocate = TRUE;
+        }
+    }
+
     ntStatus = WdfMemoryCreate(DmfModuleObjectAttributes,
                                NonPagedPoolNx,
                                DMF_TAG,
-                               sizeof(DMF_OBJECT),
+                               layout.TotalSize,
                                &memoryDmfObject,
                                (VOID**)&dmfObject);
     if (! NT_SUCCESS(ntStatus))
@@ -1211,12 +1301,23 @@ Return Value:
     }
 
     RtlZeroMemory(dmfObject,
-                  sizeof(DMF_OBJECT));
+                  layout.TotalSize);
 
-    if (ModuleDescriptor->ModuleContextAttributes != WDF_NO_OBJECT_ATTRIBUTES)
+    if (layout.ReaderWriterLockSize > 0)
+    {
+        dmfObject->ReaderWriterLock = (DMF_READER_WRITER_LOCK*)((UCHAR*)dmfObject + layout.ReaderWriterLockOffset);
+    }
+    if (layout.ModuleConfigSize > 0)
     {
-        // Allocate Module Context.
-        // NOTE: This (ModuleContext) pointer is used only for debugging purposes.
+        dmfObject->ModuleConfig = (UCHAR*)dmfObject + layout.ModuleConfigOffset;
+    }
+    dmfObject->ClientModuleInstanceName = (CHAR*)dmfObject + layout.ClientModuleInstanceNameOffset;
+
+    // NOTE: This (ModuleContext) pointer is used only for debugging purposes.
+    //
+    if (moduleContextAllocate)
+    {
+        // Allocate Module Context in addition to the Client's context.
         //
         ntStatus = WdfObjectAllocateContext(memoryDmfObject,
                                             ModuleDescriptor->ModuleContextAttributes,
@@ -1227,6 +1328,13 @@ Return Value:
             goto Exit;
         }
     }
+    else if (ModuleDescriptor->ModuleContextAttributes != WDF_NO_OBJECT_ATTRIBUTES)
+    {
+        // Module Context was allocated with the DMFMODULE object.
+        //
+        dmfObject->ModuleContext = WdfObjectGetTypedContextWorker(memoryDmfObject,
+                                                                  ModuleDescriptor->ModuleContextAttributes->ContextTypeInfo);
+    }
 
     // Begin populating the DMF Object.
     //
@@ -1246,26 +1354,16 @@ Return Value:
 
     // Initialize Client Module Instance Name.
     //
-    ntStatus = DmfModuleInstanceNameInitialize(dmfObject,
-                                               memoryDmfObject,
-                                               DmfModuleAttributes);
-    if (!NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DmfModuleInstanceNameInitialize fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
-    }
+    DmfModuleInstanceNameInitialize(dmfObject,
+                                    clientModuleInstanceName,
+                                    layout.ClientModuleInstanceNameSize);
 
-    // Initialize child objects.
+    // Save the Module Config.
+    // NOTE: The Interface Bindings collection is created when the Module is first bound.
     //
-    ntStatus = DmfModuleChildObjectsInitialize(dmfObject, 
-                                              memoryDmfObject,
-                                              DmfModuleAttributes,
-                                              ModuleDescriptor);
-    if (!NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DmfModuleChildObjectsInitialize fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
-    }
+    DmfModuleConfigInitialize(dmfObject,
+                              DmfModuleAttributes,
+                              layout.ModuleConfigSize);
 
     // Initialize the callbacks to generic handlers.
     //
@@ -1314,14 +1412,56 @@ Return Value:
 
     // Initialize Callbacks.
     //
-    ntStatus = DmfModuleCallbacksInitialize(dmfObject,
-                                            memoryDmfObject,
-                                            DmfModuleAttributes,
-                                            ModuleDescriptor);
-    if (!NT_SUCCESS(ntStatus))
+    dmfObject->ModuleDescriptor.CallbacksDmf = (DMF_CALLBACKS_DMF*)((UCHAR*)dmfObject + layout.CallbacksDmfOffset);
+    dmfObject->ModuleDescriptor.CallbacksWdf = (DMF_CALLBACKS_WDF*)((UCHAR*)dmfObject + layout.CallbacksWdfOffset);
+    DmfModuleCallbacksInitialize(dmfObject,
+                                 DmfModuleAttributes,
+                                 ModuleDescriptor);
+
+    // Only Modules that DMF opens automatically can be opened on first use.
+    //
+    if ((dmfObject->ModuleAttributes.OpenOnFirstUse) &&
+        (ModuleDescriptor->OpenOption != DMF_MODULE_OPEN_OPTION_OPEN_Create) &&
+        (ModuleDescriptor->OpenOption != DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware) &&
+        (ModuleDescriptor->OpenOption != DMF_MODULE_OPEN_OPTION_OPEN_D0Entry))
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DmfModuleObjectCallbacksInitialize fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "OpenOnFirstUse ignored [%s] OpenOption=%d", dmfObject->ClientModuleInstanceName, ModuleDescriptor->OpenOption);
+        dmfObject->ModuleAttributes.OpenOnFirstUse = FALSE;
+    }
+
+    // A Module that handles Requests is opened when the first Request is routed to it. Modules can
+    // only be opened at PASSIVE_LEVEL, so this is only possible when the Client has indicated
+    // that its device presents Requests at PASSIVE_LEVEL. Otherwise, the Module would not see
+    // Requests presented at DISPATCH_LEVEL before it is opened.
+    //
+    if ((dmfObject->ModuleAttributes.OpenOnFirstUse) &&
+        ((dmfObject->ModuleDescriptor.CallbacksWdf->ModuleQueueIoRead != DMF_Generic_ModuleQueueIoRead) ||
+         (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleQueueIoWrite != DMF_Generic_ModuleQueueIoWrite) ||
+         (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleDeviceIoControl != DMF_Generic_ModuleDeviceIoControl) ||
+         (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleInternalDeviceIoControl != DMF_Generic_ModuleInternalDeviceIoControl)))
+    {
+        DMF_DEVICE_CONTEXT* dmfDeviceContext;
+
+        dmfDeviceContext = DmfDeviceContextGet(Device);
+        if ((NULL == dmfDeviceContext) ||
+            (! dmfDeviceContext->IsPassiveLevel))
+        {
+            TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "OpenOnFirstUse ignored [%s] Requests are not presented at PASSIVE_LEVEL", dmfObject->ClientModuleInstanceName);
+            dmfObject->ModuleAttributes.OpenOnFirstUse = FALSE;
+        }
+    }
+
+    if (dmfObject->ModuleAttributes.OpenOnFirstUse)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = memoryDmfObject;
+        ntStatus = WdfWaitLockCreate(&attributes,
+                                     &dmfObject->OpenDeferredLock);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfWaitLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
     }
 
     // Initialize the Module State.
@@ -1355,6 +1495,12 @@ Return Value:
     //
     DmfModuleInFlightRecorderInitialize(dmfObject);
 
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+    // Allocate counters for Method instrumentation.
+    //
+    DMF_MethodInstrumentationInitialize(dmfObject);
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
     // Create child Modules
     // Prepare to create a Module Collection.
     //
@@ -1416,8 +1562,12 @@ Exit:
     {
         if (memoryDmfObject != NULL)
         {
-            // All subsequent allocations after memoryDmfObject use memoryDmfObject as parent. So, this
-            // call deletes all the allocations made.
+            DmfAssert(dmfObject != NULL);
+            DMF_SynchronizationDelete(dmfObject);
+            DMF_ModuleTypeTagUnregister((DMFMODULE)memoryDmfObject);
+
+            // All subsequent allocations after memoryDmfObject are part of it or use memoryDmfObject
+            // as parent. So, this call deletes all the allocations made.
             //
             WdfObjectDelete(memoryDmfObject);
             memoryDmfObject = NULL;
@@ -1436,6 +1586,9 @@ Exit:
                                                      0,
                                                      NULL,
                                                      NULL);
+        // Allow Methods to read the Module type tag without calling WDF.
+        //
+        DMF_ModuleTypeTagRegister(dmfModule);
         DmfAssert(! dmfObject->DynamicModuleImmediate);
         // If this Module is a Dynamic Module or it is an immediate or non-immediate Child
         // of a Dynamic Module, open it now if it should be opened during Create.
@@ -1521,11 +1674,15 @@ Return Value:
     DMF_HandleValidate_Destroy(dmfObject);
     dmfObject->ModuleState = ModuleState_Destroying;
 
+    // The handle may be reused after the Module is destroyed.
+    //
+    DMF_ModuleTypeTagUnregister(DmfModule);
+
     DmfAssert(dmfObject->MemoryDmfObject != NULL);
 
-    DmfAssert(dmfObject->ClientModuleInstanceNameMemory != NULL);
-    WdfObjectDelete(dmfObject->ClientModuleInstanceNameMemory);
-    dmfObject->ClientModuleInstanceNameMemory = NULL;
+    // The Module's locks are not used after this.
+    //
+    DMF_SynchronizationDelete(dmfObject);
 
 #if !defined(DMF_USER_MODE)
     if (dmfObject->InFlightRecorder != NULL)
@@ -1535,20 +1692,14 @@ Return Value:
     }
 #endif
 
-    if (dmfObject->ModuleConfigMemory != NULL)
-    {
-        DmfAssert(dmfObject->ModuleConfig != NULL);
-        WdfObjectDelete(dmfObject->ModuleConfigMemory);
-        dmfObject->ModuleConfigMemory = NULL;
-        dmfObject->ModuleConfig = NULL;
-    }
-    else
-    {
-        // Module Config Memory is optional.
-        //
-        DmfAssert(NULL == dmfObject->ModuleConfig);
-        DmfAssert(NULL == dmfObject->ModuleConfigMemory);
-    }
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+    DMF_MethodInstrumentationUninitialize(dmfObject);
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+    // The Client Module Instance Name and Module Config are part of the DMF_OBJECT allocation.
+    // The Module Config is not used after this.
+    //
+    dmfObject->ModuleConfig = NULL;
 
     if (DeleteMemory)
     {
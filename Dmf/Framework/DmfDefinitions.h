@@ -359,6 +359,10 @@ typedef NTSTATUS DMF_ModuleTransportMethod(_In_ DMFMODULE DmfModule,
                                            _Out_writes_(OutputBufferSize) VOID* OutputBuffer,
                                            _In_ size_t OutputBufferSize);
 
+// Maximum number of Modules a Module can be opened after (see DMF_MODULE_ATTRIBUTES.OpenAfter).
+//
+#define DMF_MODULE_ATTRIBUTES_OPEN_AFTER_MAXIMUM    4
+
 typedef struct _DMF_MODULE_ATTRIBUTES
 {
     // Size of this Structure.
@@ -406,6 +410,28 @@ typedef struct _DMF_MODULE_ATTRIBUTES
     // Indicates that this Module is a Transport Module.
     //
     BOOLEAN IsTransportModule;
+    // TRUE if Client allows DMF to open this Module (and its Child Modules) at the same time as
+    // other Modules in the Module Collection that also set this flag. It applies to Modules
+    // the Client adds to the Module Collection directly. Modules that do not set it are opened
+    // after all the Modules added before them and before all the Modules added after them.
+    //
+    BOOLEAN OpenInParallel;
+    // Optional. When OpenInParallel is set, addresses of the handles of Modules that must be
+    // opened before this Module (usually the addresses passed as the ResultantDmfModule of those Modules).
+    // Those Modules must be added to the Module Collection before this Module.
+    //
+    DMFMODULE* OpenAfter[DMF_MODULE_ATTRIBUTES_OPEN_AFTER_MAXIMUM];
+    // TRUE if Client wants DMF to open this Module the first time it is used instead of when
+    // its Open Option says. The Module is opened the first time one of its Methods or
+    // DMF_ModuleReference() is called for it or the first time DMF routes a Request or File Create to it.
+    // Only the Module's own Open is deferred. Child Modules are opened as their attributes say.
+    // It applies to DMF_MODULE_OPEN_OPTION_OPEN_Create, DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware
+    // and DMF_MODULE_OPEN_OPTION_OPEN_D0Entry. It is ignored for other Open Options. It is also
+    // ignored for Modules that handle Requests unless DMF_DmfDeviceInitSetPassiveLevel() has been called.
+    // NOTE: The Module can only be opened at PASSIVE_LEVEL. Until then, DMF_ModuleReference()
+    //       fails at DISPATCH_LEVEL and calling the Module's Methods at DISPATCH_LEVEL is an error.
+    //
+    BOOLEAN OpenOnFirstUse;
 } DMF_MODULE_ATTRIBUTES;
 
 __forceinline
@@ -1349,6 +1375,12 @@ DMF_DmfFdoSetFilter(
     _In_ PDMFDEVICE_INIT DmfDeviceInit
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DmfDeviceInitSetPassiveLevel(
+    _In_ PDMFDEVICE_INIT DmfDeviceInit
+    );
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
 DMF_DmfModuleAdd(
@@ -91,6 +91,10 @@ typedef struct DMFDEVICE_INIT
     // Indicates that the Client Driver is a Filter driver.
     //
     BOOLEAN IsFilterDevice;
+
+    // Indicates that the Client Driver's device presents Requests at PASSIVE_LEVEL.
+    //
+    BOOLEAN IsPassiveLevel;
 } *PDMFDEVICE_INIT;
 
 // This is a sentinel for failed allocations. In this way, callers call to allocate always succeeds. It
@@ -255,6 +259,36 @@ Return Value:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+DMF_DmfDeviceInitIsPassiveLevel(
+    _In_ PDMFDEVICE_INIT DmfDeviceInit
+    )
+/*++
+
+Routine Description:
+
+    Let the caller know if the Client Driver's device presents Requests at PASSIVE_LEVEL.
+
+Parameters Description:
+
+    DmfDeviceInit - A pointer to a framework-allocated DMFDEVICE_INIT structure.
+
+Return Value:
+
+    TRUE if the Client Driver's device presents Requests at PASSIVE_LEVEL.
+    FALSE otherwise.
+
+--*/
+{
+    PAGED_CODE();
+
+    DmfAssert(DmfDeviceInit != NULL);
+    return DmfDeviceInit->IsPassiveLevel;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 WDFDEVICE
@@ -1137,6 +1171,39 @@ Return Value:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DmfDeviceInitSetPassiveLevel(
+    _In_ PDMFDEVICE_INIT DmfDeviceInit
+    )
+/*++
+
+Routine Description:
+
+    Tells DMF that the Client Driver's device presents Requests at PASSIVE_LEVEL (the Client
+    Driver creates the device or its queues with WdfExecutionLevelPassive). This allows Modules
+    that handle Requests to be opened on first use (DMF_MODULE_ATTRIBUTES.OpenOnFirstUse).
+
+Parameters Description:
+
+    DmfDeviceInit - A pointer to a framework-allocated DMFDEVICE_INIT structure.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    if (DmfDeviceInit != &g_DmfDefaultDeviceInit)
+    {
+        DmfDeviceInit->IsPassiveLevel = TRUE;
+    }
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
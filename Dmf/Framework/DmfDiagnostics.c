@@ -0,0 +1,1072 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfDiagnostics.c
+
+Abstract:
+
+    DMF Implementation:
+
+    This Module contains the support for diagnostic data that DMF collects about
+    each Module and the IOCTL that applications use to retrieve that data.
+    Diagnostic data is only collected when DMF is built with one of these options:
+
+    USE_DMF_METHOD_INSTRUMENTATION: Call count and latency histogram of Module Methods.
+    USE_DMF_LOCK_PROFILING: Acquisition count, contention and hold time histogram of Module locks.
+
+    NOTE: Make sure to set "compile as C++" option.
+    NOTE: Make sure to #define DMF_USER_MODE in UMDF Drivers.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#include "DmfModule.h"
+#include "DmfIncludeInternal.h"
+
+#include "DmfDiagnostics.tmh"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Diagnostics Support
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// NOTE: The time functions are always available because Module Collections use them to
+//       report how long Modules take to open.
+//
+
+LONGLONG
+DMF_DiagnosticsTimeGet(
+    _Out_opt_ LONGLONG* Frequency
+    )
+/*++
+
+Routine Description:
+
+    Returns the current value of the performance counter.
+
+Arguments:
+
+    Frequency - Optionally returns the number of performance counter ticks per second.
+
+Return Value:
+
+    The current value of the performance counter.
+
+--*/
+{
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    frequency.QuadPart = 0;
+
+#if !defined(DMF_USER_MODE)
+    counter = KeQueryPerformanceCounter(&frequency);
+#else
+    QueryPerformanceCounter(&counter);
+    if (Frequency != NULL)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+#endif // !defined(DMF_USER_MODE)
+
+    if (Frequency != NULL)
+    {
+        *Frequency = frequency.QuadPart;
+    }
+
+    return counter.QuadPart;
+}
+
+ULONGLONG
+DMF_DiagnosticsElapsedNanosecondsGet(
+    _In_ LONGLONG StartTime
+    )
+/*++
+
+Routine Description:
+
+    Returns the time elapsed since a time returned by DMF_DiagnosticsTimeGet().
+
+Arguments:
+
+    StartTime - Value of the performance counter at the start of the interval.
+
+Return Value:
+
+    Elapsed time in nanoseconds.
+
+--*/
+{
+    LONGLONG currentTime;
+    LONGLONG frequency;
+    ULONGLONG elapsedTicks;
+
+    currentTime = DMF_DiagnosticsTimeGet(&frequency);
+    if ((currentTime <= StartTime) ||
+        (frequency <= 0))
+    {
+        return 0;
+    }
+
+    // Split the conversion to avoid overflow for long intervals.
+    //
+    elapsedTicks = (ULONGLONG)(currentTime - StartTime);
+    return ((elapsedTicks / (ULONGLONG)frequency) * 1000000000ULL) +
+           (((elapsedTicks % (ULONGLONG)frequency) * 1000000000ULL) / (ULONGLONG)frequency);
+}
+
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+
+ULONG
+DMF_DiagnosticsHistogramBucketGet(
+    _In_ ULONGLONG Nanoseconds
+    )
+/*++
+
+Routine Description:
+
+    Returns the index of the histogram bucket that counts a given interval.
+
+Arguments:
+
+    Nanoseconds - The given interval.
+
+Return Value:
+
+    floor(log2(Nanoseconds)), limited to the number of buckets.
+
+--*/
+{
+    ULONG bucketIndex;
+
+    // _BitScanReverse64() is not available on all platforms.
+    //
+    if ((Nanoseconds >> 32) != 0)
+    {
+        _BitScanReverse((unsigned long*)&bucketIndex,
+                        (ULONG)(Nanoseconds >> 32));
+        bucketIndex += 32;
+    }
+    else if (! _BitScanReverse((unsigned long*)&bucketIndex,
+                               (ULONG)Nanoseconds))
+    {
+        bucketIndex = 0;
+    }
+
+    if (bucketIndex >= DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS)
+    {
+        bucketIndex = DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    return bucketIndex;
+}
+
+ULONG
+DMF_DiagnosticsProcessorIndexGet(
+    _In_ ULONG NumberOfProcessors
+    )
+/*++
+
+Routine Description:
+
+    Returns the index of the set of per processor counters the current thread should update.
+    The thread may be moved to another processor after this call so counters must still be
+    updated using interlocked operations. Doing so is inexpensive because the counters are
+    almost never shared between processors.
+
+Arguments:
+
+    NumberOfProcessors - Number of sets of counters.
+
+Return Value:
+
+    Index of the set of counters.
+
+--*/
+{
+    ULONG processorIndex;
+
+#if !defined(DMF_USER_MODE)
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+#else
+    processorIndex = GetCurrentProcessorNumber();
+#endif // !defined(DMF_USER_MODE)
+
+    return processorIndex % NumberOfProcessors;
+}
+
+static
+VOID
+DMF_DiagnosticsNameCopy(
+    _Out_writes_(DMF_DIAGNOSTICS_NAME_SIZE) CHAR* Destination,
+    _In_opt_z_ const CHAR* Source
+    )
+/*++
+
+Routine Description:
+
+    Copy a name into a diagnostics entry, truncating it if necessary.
+
+Arguments:
+
+    Destination - Name field of the entry.
+    Source - The name to copy.
+
+Return Value:
+
+    None
+
+--*/
+{
+    if (NULL == Source)
+    {
+        Destination[0] = '\0';
+        return;
+    }
+
+    strncpy_s(Destination,
+              DMF_DIAGNOSTICS_NAME_SIZE,
+              Source,
+              _TRUNCATE);
+}
+
+// Writes the diagnostics entries of a given DMF Object and its Child Modules.
+// OutputData->NumberOfEntriesAvailable counts all the entries, including those that
+// do not fit in OutputData.
+//
+typedef
+VOID
+DMF_DiagnosticsEntriesGet(
+    _In_ DMF_OBJECT* DmfObject,
+    _Inout_ DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* OutputData,
+    _In_ ULONG MaximumNumberOfEntries
+    );
+
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Method Instrumentation
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+ULONG
+DMF_DiagnosticsProcessorCountGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Returns the number of processors that diagnostic counters are kept for.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    Number of active processors.
+
+--*/
+{
+    ULONG numberOfProcessors;
+
+#if !defined(DMF_USER_MODE)
+    numberOfProcessors = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+#else
+    numberOfProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#endif // !defined(DMF_USER_MODE)
+
+    if (0 == numberOfProcessors)
+    {
+        numberOfProcessors = 1;
+    }
+
+    return numberOfProcessors;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_MethodInstrumentationInitialize(
+    _Inout_ DMF_OBJECT* DmfObject
+    )
+/*++
+
+Routine Description:
+
+    Allocate the Method instrumentation counters of a given DMF Object.
+    Instrumentation is not essential. If the counters cannot be allocated, the Module's
+    Methods are not recorded.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+
+Return Value:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    ULONG numberOfProcessors;
+    size_t headerSize;
+    size_t countersSize;
+    DMF_METHOD_INSTRUMENTATION* methodInstrumentation;
+
+    PAGED_CODE();
+
+    DmfAssert(NULL == DmfObject->MethodInstrumentation);
+    DmfAssert(NULL == DmfObject->MethodInstrumentationMemory);
+
+    // Each processor's counters are padded to a multiple of the cache line size so that
+    // processors do not share cache lines.
+    //
+    numberOfProcessors = DMF_DiagnosticsProcessorCountGet();
+    headerSize = DMF_DIAGNOSTICS_CACHE_LINE_ALIGN(sizeof(DMF_METHOD_INSTRUMENTATION));
+    countersSize = DMF_DIAGNOSTICS_CACHE_LINE_ALIGN(sizeof(DMF_METHOD_INSTRUMENTATION_COUNTERS) * DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = DmfObject->MemoryDmfObject;
+    ntStatus = WdfMemoryCreate(&attributes,
+                               NonPagedPoolNx,
+                               DMF_TAG,
+                               headerSize + (countersSize * numberOfProcessors),
+                               &DmfObject->MethodInstrumentationMemory,
+                               (VOID**)&methodInstrumentation);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        DmfObject->MethodInstrumentationMemory = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(methodInstrumentation,
+                  headerSize + (countersSize * numberOfProcessors));
+    methodInstrumentation->NumberOfProcessors = numberOfProcessors;
+    methodInstrumentation->CountersPerProcessor = (ULONG)(countersSize / sizeof(DMF_METHOD_INSTRUMENTATION_COUNTERS));
+    methodInstrumentation->Counters = (DMF_METHOD_INSTRUMENTATION_COUNTERS*)((UCHAR*)methodInstrumentation + headerSize);
+
+    DmfObject->MethodInstrumentation = methodInstrumentation;
+
+Exit:
+    ;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_MethodInstrumentationUninitialize(
+    _Inout_ DMF_OBJECT* DmfObject
+    )
+/*++
+
+Routine Description:
+
+    Free the Method instrumentation counters of a given DMF Object.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    if (DmfObject->MethodInstrumentationMemory != NULL)
+    {
+        DmfObject->MethodInstrumentation = NULL;
+        WdfObjectDelete(DmfObject->MethodInstrumentationMemory);
+        DmfObject->MethodInstrumentationMemory = NULL;
+    }
+}
+#pragma code_seg()
+
+static
+ULONG
+DMF_MethodInstrumentationIndexGet(
+    _Inout_ DMF_METHOD_INSTRUMENTATION* MethodInstrumentation,
+    _In_z_ const CHAR* MethodName
+    )
+/*++
+
+Routine Description:
+
+    Find the counters index of a given Method. The first time a Method is called it
+    is assigned the next free index.
+    NOTE: Methods are identified by the address of their name so the lookup does not
+          compare strings.
+
+Arguments:
+
+    MethodInstrumentation - Method instrumentation of the Module.
+    MethodName - Name of the Method.
+
+Return Value:
+
+    Index of the Method's counters or DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS if
+    the Module already records the maximum number of Methods.
+
+--*/
+{
+    ULONG methodIndex;
+    const CHAR* existingMethodName;
+
+    for (methodIndex = 0; methodIndex < DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS; methodIndex++)
+    {
+        existingMethodName = MethodInstrumentation->MethodNames[methodIndex];
+        if (NULL == existingMethodName)
+        {
+            // Claim this index unless another thread has just claimed it.
+            //
+            existingMethodName = (const CHAR*)InterlockedCompareExchangePointer((VOID* volatile*)&MethodInstrumentation->MethodNames[methodIndex],
+                                                                                (VOID*)MethodName,
+                                                                                NULL);
+            if (NULL == existingMethodName)
+            {
+                break;
+            }
+        }
+
+        if (existingMethodName == MethodName)
+        {
+            break;
+        }
+    }
+
+    return methodIndex;
+}
+
+LONGLONG
+DMF_MethodInstrumentationStart(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Called by DMF_METHOD_INSTRUMENTATION_BEGIN when a Module Method starts.
+
+Arguments:
+
+    None
+
+Return Value:
+
+    Time the Method started. It is passed to DMF_MethodInstrumentationStop().
+
+--*/
+{
+    return DMF_DiagnosticsTimeGet(NULL);
+}
+
+VOID
+DMF_MethodInstrumentationStop(
+    _In_ DMFMODULE DmfModule,
+    _In_z_ const CHAR* MethodName,
+    _In_ LONGLONG StartTime
+    )
+/*++
+
+Routine Description:
+
+    Called by DMF_METHOD_INSTRUMENTATION_END when a Module Method returns. Records the
+    call and its latency in the current processor's counters for the Method.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    MethodName - Name of the Method.
+    StartTime - Value returned by DMF_MethodInstrumentationStart().
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_METHOD_INSTRUMENTATION* methodInstrumentation;
+    DMF_METHOD_INSTRUMENTATION_COUNTERS* counters;
+    ULONGLONG elapsedNanoseconds;
+    ULONG methodIndex;
+    ULONG processorIndex;
+
+    elapsedNanoseconds = DMF_DiagnosticsElapsedNanosecondsGet(StartTime);
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    methodInstrumentation = dmfObject->MethodInstrumentation;
+    if (NULL == methodInstrumentation)
+    {
+        // Counters could not be allocated.
+        //
+        return;
+    }
+
+    methodIndex = DMF_MethodInstrumentationIndexGet(methodInstrumentation,
+                                                    MethodName);
+    if (methodIndex >= DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS)
+    {
+        return;
+    }
+
+    processorIndex = DMF_DiagnosticsProcessorIndexGet(methodInstrumentation->NumberOfProcessors);
+    counters = &methodInstrumentation->Counters[(processorIndex * methodInstrumentation->CountersPerProcessor) + methodIndex];
+
+    InterlockedIncrement64(&counters->CallCount);
+    InterlockedExchangeAdd64(&counters->TotalLatencyNs,
+                             (LONG64)elapsedNanoseconds);
+    InterlockedIncrement64(&counters->LatencyHistogram[DMF_DiagnosticsHistogramBucketGet(elapsedNanoseconds)]);
+}
+
+static
+VOID
+DMF_MethodInstrumentationEntriesGet(
+    _In_ DMF_OBJECT* DmfObject,
+    _Inout_ DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* OutputData,
+    _In_ ULONG MaximumNumberOfEntries
+    )
+/*++
+
+Routine Description:
+
+    Write an entry for each Method recorded by a given DMF Object and its Child Modules.
+    The counters of all processors are added together.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+    OutputData - Where the entries are written.
+    MaximumNumberOfEntries - Number of entries that fit in OutputData.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_METHOD_INSTRUMENTATION* methodInstrumentation;
+    DMF_OBJECT* childDmfObject;
+    CHILD_OBJECT_INTERATION_CONTEXT childObjectIterationContext;
+    ULONG methodIndex;
+    ULONG processorIndex;
+    ULONG bucketIndex;
+
+    methodInstrumentation = DmfObject->MethodInstrumentation;
+    if (methodInstrumentation != NULL)
+    {
+        for (methodIndex = 0; methodIndex < DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS; methodIndex++)
+        {
+            DMF_DIAGNOSTICS_METHOD_ENTRY* entry;
+            const CHAR* methodName;
+
+            methodName = methodInstrumentation->MethodNames[methodIndex];
+            if (NULL == methodName)
+            {
+                // Indexes are assigned in order.
+                //
+                break;
+            }
+
+            OutputData->NumberOfEntriesAvailable++;
+            if (OutputData->NumberOfEntries >= MaximumNumberOfEntries)
+            {
+                continue;
+            }
+
+            entry = &OutputData->Response.Methods[OutputData->NumberOfEntries];
+            RtlZeroMemory(entry,
+                          sizeof(DMF_DIAGNOSTICS_METHOD_ENTRY));
+            DMF_DiagnosticsNameCopy(entry->ModuleInstanceName,
+                                    DmfObject->ClientModuleInstanceName);
+            DMF_DiagnosticsNameCopy(entry->MethodName,
+                                    methodName);
+
+            for (processorIndex = 0; processorIndex < methodInstrumentation->NumberOfProcessors; processorIndex++)
+            {
+                DMF_METHOD_INSTRUMENTATION_COUNTERS* counters;
+
+                counters = &methodInstrumentation->Counters[(processorIndex * methodInstrumentation->CountersPerProcessor) + methodIndex];
+                entry->CallCount += (ULONGLONG)counters->CallCount;
+                entry->TotalLatencyNs += (ULONGLONG)counters->TotalLatencyNs;
+                for (bucketIndex = 0; bucketIndex < DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS; bucketIndex++)
+                {
+                    entry->LatencyHistogram[bucketIndex] += (ULONGLONG)counters->LatencyHistogram[bucketIndex];
+                }
+            }
+
+            OutputData->NumberOfEntries++;
+        }
+    }
+
+    childDmfObject = DmfChildObjectFirstGet(DmfObject,
+                                            &childObjectIterationContext);
+    while (childDmfObject != NULL)
+    {
+        DMF_MethodInstrumentationEntriesGet(childDmfObject,
+                                            OutputData,
+                                            MaximumNumberOfEntries);
+        childDmfObject = DmfChildObjectNextGet(&childObjectIterationContext);
+    }
+}
+
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+#if defined(USE_DMF_LOCK_PROFILING)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Lock Profiling
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// The linker places this symbol at the start of the driver image. Lock owners are
+// reported relative to it so that applications do not see kernel addresses.
+//
+EXTERN_C UCHAR __ImageBase;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+DMF_LockProfileContendedGet(
+    _In_ DMF_SYNCHRONIZATION* Synchronization
+    )
+/*++
+
+Routine Description:
+
+    Called before a Module lock is acquired to find out if the caller will have to wait.
+    NOTE: LockHeldByThread is set after the lock is acquired and cleared before it is
+          released so this is an approximation. It is good enough to find hot spots.
+
+Arguments:
+
+    Synchronization - The lock that is about to be acquired.
+
+Return Value:
+
+    TRUE if another thread holds the lock.
+
+--*/
+{
+    HANDLE lockHeldByThread;
+
+    lockHeldByThread = *((HANDLE volatile*)&Synchronization->LockHeldByThread);
+
+    return (lockHeldByThread != NULL);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LockProfileAcquired(
+    _Inout_ DMF_SYNCHRONIZATION* Synchronization,
+    _In_ BOOLEAN Contended,
+    _In_ VOID* Owner
+    )
+/*++
+
+Routine Description:
+
+    Called after a Module lock is acquired. Records the acquisition and when it started.
+
+Arguments:
+
+    Synchronization - The lock that was acquired.
+    Contended - Value returned by DMF_LockProfileContendedGet() before the lock was acquired.
+    Owner - Return address of the call that acquired the lock.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_LOCK_PROFILE* lockProfile;
+
+    lockProfile = &Synchronization->LockProfile;
+
+    lockProfile->AcquireCount++;
+    if (Contended)
+    {
+        lockProfile->ContendedCount++;
+    }
+    lockProfile->Owner = Owner;
+    lockProfile->AcquireTime = DMF_DiagnosticsTimeGet(NULL);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LockProfileReleased(
+    _Inout_ DMF_SYNCHRONIZATION* Synchronization
+    )
+/*++
+
+Routine Description:
+
+    Called before a Module lock is released. Records how long the lock was held.
+
+Arguments:
+
+    Synchronization - The lock that is about to be released.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_LOCK_PROFILE* lockProfile;
+    ULONGLONG holdNanoseconds;
+
+    lockProfile = &Synchronization->LockProfile;
+
+    holdNanoseconds = DMF_DiagnosticsElapsedNanosecondsGet(lockProfile->AcquireTime);
+
+    lockProfile->HoldHistogram[DMF_DiagnosticsHistogramBucketGet(holdNanoseconds)]++;
+    if ((LONG64)holdNanoseconds > lockProfile->MaximumHoldNs)
+    {
+        lockProfile->MaximumHoldNs = (LONG64)holdNanoseconds;
+        lockProfile->MaximumHoldOwner = lockProfile->Owner;
+    }
+    lockProfile->Owner = NULL;
+}
+
+static
+VOID
+DMF_LockProfileEntriesGet(
+    _In_ DMF_OBJECT* DmfObject,
+    _Inout_ DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* OutputData,
+    _In_ ULONG MaximumNumberOfEntries
+    )
+/*++
+
+Routine Description:
+
+    Write an entry for each lock of a given DMF Object and its Child Modules that has
+    been acquired at least once.
+    NOTE: The counters are read without acquiring the lock so an entry may mix values
+          from before and after a concurrent acquisition.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+    OutputData - Where the entries are written.
+    MaximumNumberOfEntries - Number of entries that fit in OutputData.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* childDmfObject;
+    CHILD_OBJECT_INTERATION_CONTEXT childObjectIterationContext;
+    ULONG lockIndex;
+    ULONG numberOfLocks;
+
+    numberOfLocks = DmfObject->ModuleDescriptor.NumberOfAuxiliaryLocks + DMF_NUMBER_OF_DEFAULT_LOCKS;
+    if (numberOfLocks > DMF_MAXIMUM_AUXILIARY_LOCKS + DMF_NUMBER_OF_DEFAULT_LOCKS)
+    {
+        DmfAssert(FALSE);
+        numberOfLocks = DMF_MAXIMUM_AUXILIARY_LOCKS + DMF_NUMBER_OF_DEFAULT_LOCKS;
+    }
+
+    for (lockIndex = 0; lockIndex < numberOfLocks; lockIndex++)
+    {
+        DMF_LOCK_PROFILE* lockProfile;
+        DMF_DIAGNOSTICS_LOCK_ENTRY* entry;
+
+        lockProfile = &DmfObject->Synchronizations[lockIndex].LockProfile;
+        if (0 == lockProfile->AcquireCount)
+        {
+            continue;
+        }
+
+        OutputData->NumberOfEntriesAvailable++;
+        if (OutputData->NumberOfEntries >= MaximumNumberOfEntries)
+        {
+            continue;
+        }
+
+        entry = &OutputData->Response.Locks[OutputData->NumberOfEntries];
+        RtlZeroMemory(entry,
+                      sizeof(DMF_DIAGNOSTICS_LOCK_ENTRY));
+        DMF_DiagnosticsNameCopy(entry->ModuleInstanceName,
+                                DmfObject->ClientModuleInstanceName);
+        entry->LockIndex = lockIndex;
+        entry->Passive = (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE) ? 1 : 0;
+        entry->AcquireCount = (ULONGLONG)lockProfile->AcquireCount;
+        entry->ContendedCount = (ULONGLONG)lockProfile->ContendedCount;
+        entry->MaximumHoldNs = (ULONGLONG)lockProfile->MaximumHoldNs;
+        if (lockProfile->MaximumHoldOwner != NULL)
+        {
+            entry->MaximumHoldOwnerOffset = (ULONGLONG)((ULONG_PTR)lockProfile->MaximumHoldOwner - (ULONG_PTR)&__ImageBase);
+        }
+        RtlCopyMemory(entry->HoldHistogram,
+                      lockProfile->HoldHistogram,
+                      sizeof(entry->HoldHistogram));
+
+        OutputData->NumberOfEntries++;
+    }
+
+    childDmfObject = DmfChildObjectFirstGet(DmfObject,
+                                            &childObjectIterationContext);
+    while (childDmfObject != NULL)
+    {
+        DMF_LockProfileEntriesGet(childDmfObject,
+                                  OutputData,
+                                  MaximumNumberOfEntries);
+        childDmfObject = DmfChildObjectNextGet(&childObjectIterationContext);
+    }
+}
+
+#endif // defined(USE_DMF_LOCK_PROFILING)
+
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Diagnostics Query
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DiagnosticsDeviceInterfaceCreate(
+    _In_ WDFDEVICE Device
+    )
+/*++
+
+Routine Description:
+
+    Register a device interface so applications can find the device and query diagnostics.
+    Diagnostics are not essential so failure is ignored.
+
+Arguments:
+
+    Device - The Client Driver's device.
+
+Return Value:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    ntStatus = WdfDeviceCreateDeviceInterface(Device,
+                                              (LPGUID)&GUID_DEVINTERFACE_DmfDiagnostics,
+                                              NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "WdfDeviceCreateDeviceInterface fails, ntStatus=%!STATUS!", ntStatus);
+    }
+}
+#pragma code_seg()
+
+static
+NTSTATUS
+DMF_DiagnosticsQuery(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ DWORD ResponseType,
+    _In_ size_t EntrySize,
+    _In_ DMF_DiagnosticsEntriesGet* EntriesGet,
+    _Out_writes_bytes_(OutputBufferSize) DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* OutputData,
+    _In_ size_t OutputBufferSize,
+    _Out_ size_t* BytesReturned
+    )
+/*++
+
+Routine Description:
+
+    Write the diagnostics entries of a given type for all the Modules in a Module Collection.
+
+Arguments:
+
+    ModuleCollectionHandle - The given Module Collection.
+    ResponseType - The type of the entries.
+    EntrySize - Size of each entry in bytes.
+    EntriesGet - Writes the entries of a Module and its Child Modules.
+    OutputData - Where the data is written.
+    OutputBufferSize - Size of OutputData in bytes.
+    BytesReturned - Number of bytes written to OutputData.
+
+Return Value:
+
+    STATUS_SUCCESS if all the entries were written.
+    STATUS_BUFFER_OVERFLOW if only some of the entries fit in the buffer.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    ULONG maximumNumberOfEntries;
+    LONG driverModuleIndex;
+
+    DmfAssert(OutputBufferSize >= FIELD_OFFSET(DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA, Response));
+    maximumNumberOfEntries = (ULONG)((OutputBufferSize - FIELD_OFFSET(DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA, Response)) / EntrySize);
+
+    OutputData->ResponseType = ResponseType;
+    OutputData->NumberOfEntries = 0;
+    OutputData->NumberOfEntriesAvailable = 0;
+
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DmfAssert(ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex] != NULL);
+        EntriesGet(ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex],
+                   OutputData,
+                   maximumNumberOfEntries);
+    }
+
+    *BytesReturned = FIELD_OFFSET(DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA, Response) +
+                     (OutputData->NumberOfEntries * EntrySize);
+
+    if (OutputData->NumberOfEntries < OutputData->NumberOfEntriesAvailable)
+    {
+        ntStatus = STATUS_BUFFER_OVERFLOW;
+    }
+    else
+    {
+        ntStatus = STATUS_SUCCESS;
+    }
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+DMF_DiagnosticsDeviceIoControl(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG IoControlCode
+    )
+/*++
+
+Routine Description:
+
+    Handle IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION sent to the Client Driver's device.
+
+Arguments:
+
+    ModuleCollectionHandle - Module Collection of the device that received the Request.
+    Request - The given Request.
+    IoControlCode - The IOCTL code of the Request.
+
+Return Value:
+
+    TRUE if the Request was handled (and completed).
+    FALSE if the Request is not a diagnostics Request.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_DIAGNOSTICS_REQUEST_INPUT_DATA* inputData;
+    DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* outputData;
+    size_t outputBufferSize;
+    size_t bytesReturned;
+
+    if (IoControlCode != IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION)
+    {
+        return FALSE;
+    }
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION received.");
+
+    bytesReturned = 0;
+
+    ntStatus = WdfRequestRetrieveInputBuffer(Request,
+                                             sizeof(DMF_DIAGNOSTICS_REQUEST_INPUT_DATA),
+                                             (VOID**)&inputData,
+                                             NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRequestRetrieveInputBuffer fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    ntStatus = WdfRequestRetrieveOutputBuffer(Request,
+                                              FIELD_OFFSET(DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA, Response),
+                                              (VOID**)&outputData,
+                                              &outputBufferSize);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRequestRetrieveOutputBuffer fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    switch (inputData->Type)
+    {
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+        case DMF_DIAGNOSTICS_REQUEST_TYPE_METHODS:
+        {
+            ntStatus = DMF_DiagnosticsQuery(ModuleCollectionHandle,
+                                            DMF_DIAGNOSTICS_REQUEST_TYPE_METHODS,
+                                            sizeof(DMF_DIAGNOSTICS_METHOD_ENTRY),
+                                            DMF_MethodInstrumentationEntriesGet,
+                                            outputData,
+                                            outputBufferSize,
+                                            &bytesReturned);
+            break;
+        }
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+#if defined(USE_DMF_LOCK_PROFILING)
+        case DMF_DIAGNOSTICS_REQUEST_TYPE_LOCKS:
+        {
+            ntStatus = DMF_DiagnosticsQuery(ModuleCollectionHandle,
+                                            DMF_DIAGNOSTICS_REQUEST_TYPE_LOCKS,
+                                            sizeof(DMF_DIAGNOSTICS_LOCK_ENTRY),
+                                            DMF_LockProfileEntriesGet,
+                                            outputData,
+                                            outputBufferSize,
+                                            &bytesReturned);
+            break;
+        }
+#endif // defined(USE_DMF_LOCK_PROFILING)
+        default:
+        {
+            // Either the type is invalid or this build does not collect it.
+            //
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unsupported Type=%d", inputData->Type);
+            ntStatus = STATUS_NOT_SUPPORTED;
+            break;
+        }
+    }
+
+Exit:
+
+    WdfRequestCompleteWithInformation(Request,
+                                      ntStatus,
+                                      bytesReturned);
+
+    return TRUE;
+}
+
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
+// eof: DmfDiagnostics.c
+//
@@ -0,0 +1,142 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfDiagnostics_Public.h
+
+Abstract:
+
+    Header file containing the public interface used by applications to query
+    diagnostic data that DMF collects for each Module.
+
+Environment:
+
+    Kernel-mode
+    User-mode
+
+--*/
+
+#pragma once
+
+// Define an Interface Guid so that app can find the device and talk to it.
+//
+// {65CD108D-56FE-4805-B095-E65547A3AD3E}
+DEFINE_GUID(GUID_DEVINTERFACE_DmfDiagnostics,
+            0x65cd108d, 0x56fe, 0x4805, 0xb0, 0x95, 0xe6, 0x55, 0x47, 0xa3, 0xad, 0x3e);
+
+// IOCTL to query collected information.
+//
+#define IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION    CTL_CODE(FILE_DEVICE_UNKNOWN, 0x40C, METHOD_BUFFERED, FILE_READ_ACCESS)
+
+// Maximum length of names returned, including the zero terminator.
+//
+#define DMF_DIAGNOSTICS_NAME_SIZE                   64
+
+// Number of buckets in time histograms.
+// Bucket N counts the intervals that lasted [2^N, 2^(N+1)) nanoseconds. Bucket 0 also counts
+// intervals shorter than 1 nanosecond and the last bucket counts all longer intervals.
+//
+#define DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS           32
+
+enum DMF_DIAGNOSTICS_REQUEST_TYPE
+{
+    DMF_DIAGNOSTICS_REQUEST_TYPE_INVALID = 0,
+    DMF_DIAGNOSTICS_REQUEST_TYPE_METHODS,
+    DMF_DIAGNOSTICS_REQUEST_TYPE_LOCKS
+};
+
+typedef struct _DMF_DIAGNOSTICS_REQUEST_INPUT_DATA
+{
+    // Request type.
+    //
+    DWORD Type;
+} DMF_DIAGNOSTICS_REQUEST_INPUT_DATA;
+
+typedef struct _DMF_DIAGNOSTICS_METHOD_ENTRY
+{
+    // Module instance name, a zero-terminated string.
+    //
+    CHAR ModuleInstanceName[DMF_DIAGNOSTICS_NAME_SIZE];
+
+    // Method name, a zero-terminated string.
+    //
+    CHAR MethodName[DMF_DIAGNOSTICS_NAME_SIZE];
+
+    // Number of times the Method was called.
+    //
+    ULONGLONG CallCount;
+
+    // Sum of the time spent in all the calls.
+    //
+    ULONGLONG TotalLatencyNs;
+
+    // Calls counted by latency.
+    //
+    ULONGLONG LatencyHistogram[DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS];
+} DMF_DIAGNOSTICS_METHOD_ENTRY;
+
+typedef struct _DMF_DIAGNOSTICS_LOCK_ENTRY
+{
+    // Module instance name, a zero-terminated string.
+    //
+    CHAR ModuleInstanceName[DMF_DIAGNOSTICS_NAME_SIZE];
+
+    // 0 is the Module's default lock. Auxiliary lock N is N + 1.
+    //
+    DWORD LockIndex;
+
+    // Non-zero if the lock is a PASSIVE_LEVEL lock.
+    //
+    DWORD Passive;
+
+    // Number of times the lock was acquired.
+    //
+    ULONGLONG AcquireCount;
+
+    // Number of times the lock was held by another thread when it was acquired.
+    //
+    ULONGLONG ContendedCount;
+
+    // Longest time the lock was held.
+    //
+    ULONGLONG MaximumHoldNs;
+
+    // Offset from the start of the driver image of the code that acquired the lock
+    // when it was held the longest. Use the driver's symbols to find the Method
+    // (for example, "ln Driver+Offset" in the debugger).
+    //
+    ULONGLONG MaximumHoldOwnerOffset;
+
+    // Acquisitions counted by hold time.
+    //
+    ULONGLONG HoldHistogram[DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS];
+} DMF_DIAGNOSTICS_LOCK_ENTRY;
+
+typedef struct _DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA
+{
+    // Response Type.
+    //
+    DWORD ResponseType;
+
+    // Number of entries written to Response.
+    //
+    DWORD NumberOfEntries;
+
+    // Number of entries available. If it is greater than NumberOfEntries the output
+    // buffer was too small to hold all the entries.
+    //
+    DWORD NumberOfEntriesAvailable;
+
+    union
+    {
+        DMF_DIAGNOSTICS_METHOD_ENTRY Methods[ANYSIZE_ARRAY];
+        DMF_DIAGNOSTICS_LOCK_ENTRY Locks[ANYSIZE_ARRAY];
+    } Response;
+
+} DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA;
+
+// eof: DmfDiagnostics_Public.h
+//
@@ -372,7 +372,16 @@ Return Value:
         }
     }
 
-    if (DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware == dmfObject->ModuleDescriptor.OpenOption)
+    if ((DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware == dmfObject->ModuleDescriptor.OpenOption) &&
+        (dmfObject->ModuleAttributes.OpenOnFirstUse))
+    {
+        // This Module is opened the first time it is used instead.
+        //
+        DMF_ModuleDeferredOpenArm(DmfModule,
+                                  ModuleOpenedDuringType_PrepareHardware);
+        ntStatus = STATUS_SUCCESS;
+    }
+    else if (DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware == dmfObject->ModuleDescriptor.OpenOption)
     {
         // This Module is automatically opened in PrepareHardware.
         //
@@ -487,6 +496,14 @@ Return Value:
         //       Therefore, it is possible this Module may have been clean up if only some
         //       of the modules in the collection hare closed. So, check for that condition here.
         //
+        if (dmfObject->ModuleAttributes.OpenOnFirstUse)
+        {
+            // Only close this Module if it has been used.
+            //
+            DMF_ModuleDeferredOpenCancel(DmfModule,
+                                         ModuleOpenedDuringType_PrepareHardware);
+        }
+
         if (dmfObject->ModuleOpenedDuring == ModuleOpenedDuringType_PrepareHardware)
         {
             DMF_Internal_Close(DmfModule);
@@ -608,6 +625,15 @@ Return Value:
             ntStatus = STATUS_SUCCESS;
         }
     }
+    else if ((DMF_MODULE_OPEN_OPTION_OPEN_D0Entry == dmfObject->ModuleDescriptor.OpenOption) &&
+             (dmfObject->ModuleAttributes.OpenOnFirstUse))
+    {
+        // This Module is opened the first time it is used instead.
+        //
+        DMF_ModuleDeferredOpenArm(DmfModule,
+                                  ModuleOpenedDuringType_D0Entry);
+        ntStatus = STATUS_SUCCESS;
+    }
     else if (DMF_MODULE_OPEN_OPTION_OPEN_D0Entry == dmfObject->ModuleDescriptor.OpenOption)
     {
         // This Module is automatically opened in D0Entry.
@@ -805,6 +831,18 @@ Return Value:
             DMF_Internal_Close(DmfModule);
         }
     }
+    else if ((DMF_MODULE_OPEN_OPTION_OPEN_D0Entry == dmfObject->ModuleDescriptor.OpenOption) &&
+             (dmfObject->ModuleAttributes.OpenOnFirstUse))
+    {
+        // This Module is only closed in D0Exit if it has been used since D0Entry.
+        //
+        DMF_ModuleDeferredOpenCancel(DmfModule,
+                                     ModuleOpenedDuringType_D0Entry);
+        if (dmfObject->ModuleOpenedDuring == ModuleOpenedDuringType_D0Entry)
+        {
+            DMF_Internal_Close(DmfModule);
+        }
+    }
     else if (DMF_MODULE_OPEN_OPTION_OPEN_D0Entry == dmfObject->ModuleDescriptor.OpenOption)
     {
         // This Module is automatically closed in D0Exit.
@@ -2536,5 +2574,384 @@ Return Value:
                                          DMF_DEFAULT_LOCK_INDEX);
 }
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterLock_Passive(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to acquire the PASSIVE_LEVEL reader/writer lock of a given DMF Module
+    for writing.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    PAGED_CODE();
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    AcquireSRWLockExclusive(&readerWriterLock->SrwLock);
+#else
+    KeEnterCriticalRegion();
+    ExAcquireResourceExclusiveLite(&readerWriterLock->Resource,
+                                   TRUE);
+#endif // defined(DMF_USER_MODE)
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterUnlock_Passive(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to release the PASSIVE_LEVEL reader/writer lock of a given DMF Module
+    after writing.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    PAGED_CODE();
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    ReleaseSRWLockExclusive(&readerWriterLock->SrwLock);
+#else
+    ExReleaseResourceLite(&readerWriterLock->Resource);
+    KeLeaveCriticalRegion();
+#endif // defined(DMF_USER_MODE)
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterLockShared_Passive(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to acquire the PASSIVE_LEVEL reader/writer lock of a given DMF Module
+    for reading.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    PAGED_CODE();
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    AcquireSRWLockShared(&readerWriterLock->SrwLock);
+#else
+    KeEnterCriticalRegion();
+    ExAcquireResourceSharedLite(&readerWriterLock->Resource,
+                                TRUE);
+#endif // defined(DMF_USER_MODE)
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterUnlockShared_Passive(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to release the PASSIVE_LEVEL reader/writer lock of a given DMF Module
+    after reading.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    PAGED_CODE();
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    ReleaseSRWLockShared(&readerWriterLock->SrwLock);
+#else
+    ExReleaseResourceLite(&readerWriterLock->Resource);
+    KeLeaveCriticalRegion();
+#endif // defined(DMF_USER_MODE)
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterLock_Dispatch(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to acquire the DISPATCH_LEVEL reader/writer lock of a given DMF Module
+    for writing.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    AcquireSRWLockExclusive(&readerWriterLock->SrwLock);
+#else
+    readerWriterLock->ExclusiveOldIrql = ExAcquireSpinLockExclusive(&readerWriterLock->SpinLock);
+#endif // defined(DMF_USER_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterUnlock_Dispatch(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to release the DISPATCH_LEVEL reader/writer lock of a given DMF Module
+    after writing.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    ReleaseSRWLockExclusive(&readerWriterLock->SrwLock);
+#else
+    ExReleaseSpinLockExclusive(&readerWriterLock->SpinLock,
+                               readerWriterLock->ExclusiveOldIrql);
+#endif // defined(DMF_USER_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterLockShared_Dispatch(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to acquire the DISPATCH_LEVEL reader/writer lock of a given DMF Module
+    for reading.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+#if !defined(DMF_USER_MODE)
+    KIRQL oldIrql;
+    ULONG processorIndex;
+#endif // !defined(DMF_USER_MODE)
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    AcquireSRWLockShared(&readerWriterLock->SrwLock);
+#else
+    oldIrql = ExAcquireSpinLockShared(&readerWriterLock->SpinLock);
+
+    // The thread cannot change processors until the lock is released.
+    //
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+    DmfAssert(processorIndex < readerWriterLock->NumberOfProcessors);
+    readerWriterLock->SharedOldIrql[processorIndex % readerWriterLock->NumberOfProcessors] = oldIrql;
+#endif // defined(DMF_USER_MODE)
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterUnlockShared_Dispatch(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Generic callback to release the DISPATCH_LEVEL reader/writer lock of a given DMF Module
+    after reading.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+#if !defined(DMF_USER_MODE)
+    ULONG processorIndex;
+#endif // !defined(DMF_USER_MODE)
+
+    // NOTE: No FuncEntry/Exit logging. It is too much and it is not necessary for this
+    // simple function.
+    //
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DMF_HandleValidate_IsAvailable(dmfObject);
+
+    readerWriterLock = dmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    ReleaseSRWLockShared(&readerWriterLock->SrwLock);
+#else
+    processorIndex = KeGetCurrentProcessorNumberEx(NULL);
+    DmfAssert(processorIndex < readerWriterLock->NumberOfProcessors);
+    ExReleaseSpinLockShared(&readerWriterLock->SpinLock,
+                            readerWriterLock->SharedOldIrql[processorIndex % readerWriterLock->NumberOfProcessors]);
+#endif // defined(DMF_USER_MODE)
+}
+
 // eof: DmfGeneric.c
 //
@@ -321,13 +321,11 @@ Return Value:
 
     DmfAssert(dmfObject != NULL);
 
-    if (dmfObject->ModuleConfigMemory != NULL)
+    if (dmfObject->ModuleConfig != NULL)
     {
-        moduleConfig = WdfMemoryGetBuffer(dmfObject->ModuleConfigMemory,
-                                          &configSize);
+        moduleConfig = dmfObject->ModuleConfig;
+        configSize = dmfObject->ModuleDescriptor.ModuleConfigSize;
 
-        DmfAssert(dmfObject->ModuleConfig == moduleConfig);
-    
         if (configSize != ModuleConfigSize)
         {
             ntStatus = STATUS_INVALID_BUFFER_SIZE;
@@ -384,6 +382,50 @@ Return Value:
     return deviceContext->IsFilterDevice;
 }
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleIoctlInterestAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG IoControlCode
+    )
+/*++
+
+Routine Description:
+
+    Declares that the given Module handles the given IOCTL in its DeviceIoControl or
+    InternalDeviceIoControl callback. Once every Module that has these callbacks has declared
+    its IOCTLs, DMF no longer dispatches other IOCTLs to the Modules. In a filter driver,
+    those IOCTLs are sent down the stack directly.
+    Modules call this function from their Create function after DMF_ModuleCreate().
+    A Module that never calls it is assumed to handle all IOCTLs.
+
+Arguments:
+
+    DmfModule - The given Module.
+    IoControlCode - The IOCTL the Module handles.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+
+    PAGED_CODE();
+
+    DMF_ObjectValidate(DmfModule);
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    DmfAssert(dmfObject->ModuleState == ModuleState_Created);
+
+    dmfObject->IoctlInterestDeclared = TRUE;
+    DMF_IoctlInterestSet(&dmfObject->IoctlInterest,
+                         IoControlCode);
+}
+#pragma code_seg()
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // These are used by only by DMF.
@@ -391,6 +433,126 @@ Return Value:
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_ReaderWriterLockInitialize(
+    _In_ DMF_OBJECT* DmfObject
+    )
+/*++
+
+Routine Description:
+
+    Initialize the reader/writer lock that is the default lock of a given DMF Module
+    that sets DMF_MODULE_OPTIONS_READER_WRITER_LOCK. DMF_ModuleCreate() allocates it
+    (zeroed) with the DMF Module's DMF_OBJECT.
+
+Arguments:
+
+    DmfObject - The given DMF Module.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    PAGED_CODE();
+
+    readerWriterLock = DmfObject->ReaderWriterLock;
+    DmfAssert(readerWriterLock != NULL);
+
+#if defined(DMF_USER_MODE)
+    InitializeSRWLock(&readerWriterLock->SrwLock);
+    ntStatus = STATUS_SUCCESS;
+#else
+    if (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH)
+    {
+        // Zeroed memory is an initialized EX_SPIN_LOCK.
+        // Shared owners save their IRQL in an entry for their processor. The entries
+        // follow this structure.
+        //
+        readerWriterLock->NumberOfProcessors = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+        readerWriterLock->SharedOldIrql = (KIRQL*)(readerWriterLock + 1);
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = ExInitializeResourceLite(&readerWriterLock->Resource);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ExInitializeResourceLite fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        readerWriterLock->ResourceInitialized = TRUE;
+    }
+
+Exit:
+#endif // defined(DMF_USER_MODE)
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+size_t
+DMF_ReaderWriterLockSizeGet(
+    _In_ ULONG ModuleOptions,
+    _In_ BOOLEAN PassiveLevel
+    )
+/*++
+
+Routine Description:
+
+    Returns the number of bytes DMF_ModuleCreate() allocates for the reader/writer lock
+    of a DMF Module.
+
+Arguments:
+
+    ModuleOptions - The Module Options set by the Module's descriptor.
+    PassiveLevel - TRUE if Client wants the Module options to be set to MODULE_OPTIONS_PASSIVE.
+
+Return Value:
+
+    Zero if the Module does not set DMF_MODULE_OPTIONS_READER_WRITER_LOCK.
+    Otherwise, the size of the lock in bytes.
+
+--*/
+{
+    size_t sizeOfLock;
+
+    PAGED_CODE();
+
+    if (! (ModuleOptions & DMF_MODULE_OPTIONS_READER_WRITER_LOCK))
+    {
+        sizeOfLock = 0;
+        goto Exit;
+    }
+
+    sizeOfLock = sizeof(DMF_READER_WRITER_LOCK);
+#if !defined(DMF_USER_MODE)
+    // See DMF_SynchronizationCreate() for how the Module Options are updated.
+    //
+    if ((ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH) ||
+        ((ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM) && (! PassiveLevel)))
+    {
+        sizeOfLock += KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS) * sizeof(KIRQL);
+    }
+#else
+    UNREFERENCED_PARAMETER(PassiveLevel);
+#endif // !defined(DMF_USER_MODE)
+
+Exit:
+
+    return sizeOfLock;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -420,6 +582,7 @@ Return Value:
     NTSTATUS ntStatus;
     WDF_OBJECT_ATTRIBUTES attributes;
     ULONG lockIndex;
+    ULONG firstLockIndex;
     DMF_MODULE_DESCRIPTOR* moduleDescriptor;
 
     PAGED_CODE();
@@ -452,6 +615,19 @@ Return Value:
         }
     }
 
+    // A reader/writer lock replaces the WDF default lock.
+    //
+    firstLockIndex = 0;
+    if (moduleDescriptor->ModuleOptions & DMF_MODULE_OPTIONS_READER_WRITER_LOCK)
+    {
+        ntStatus = DMF_ReaderWriterLockInitialize(DmfObject);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+        firstLockIndex = DMF_NUMBER_OF_DEFAULT_LOCKS;
+    }
+
     // Create the locking mechanism based on Module Options.
     //
     if (moduleDescriptor->ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE)
@@ -462,7 +638,7 @@ Return Value:
 
         // Create the Generic PASSIVE_LEVEL Lock for the Auxiliary Synchronization and one device lock.
         //
-        for (lockIndex = 0; lockIndex < moduleDescriptor->NumberOfAuxiliaryLocks + DMF_NUMBER_OF_DEFAULT_LOCKS; lockIndex++)
+        for (lockIndex = firstLockIndex; lockIndex < moduleDescriptor->NumberOfAuxiliaryLocks + DMF_NUMBER_OF_DEFAULT_LOCKS; lockIndex++)
         {
             WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
             attributes.ParentObject = DmfObject->ParentDevice;
@@ -481,7 +657,7 @@ Return Value:
 
         // Create the Generic DISPATCH_LEVEL Lock for the Auxiliary Synchronization and one device lock.
         //
-        for (lockIndex = 0; lockIndex < moduleDescriptor->NumberOfAuxiliaryLocks + DMF_NUMBER_OF_DEFAULT_LOCKS; lockIndex++)
+        for (lockIndex = firstLockIndex; lockIndex < moduleDescriptor->NumberOfAuxiliaryLocks + DMF_NUMBER_OF_DEFAULT_LOCKS; lockIndex++)
         {
             WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
             attributes.ParentObject = DmfObject->ParentDevice;
@@ -505,6 +681,45 @@ Exit:
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_SynchronizationDelete(
+    _In_ DMF_OBJECT* DmfObject
+    )
+/*++
+
+Routine Description:
+
+    Release the resources of the locks of a given DMF Module that are not WDF objects.
+    It may be called more than once.
+
+Arguments:
+
+    DmfObject - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+#if defined(DMF_USER_MODE)
+    // SRWLOCK has no resources to release.
+    //
+    UNREFERENCED_PARAMETER(DmfObject);
+#else
+    DMF_READER_WRITER_LOCK* readerWriterLock;
+
+    readerWriterLock = DmfObject->ReaderWriterLock;
+    if ((readerWriterLock != NULL) &&
+        (readerWriterLock->ResourceInitialized))
+    {
+        ExDeleteResourceLite(&readerWriterLock->Resource);
+        readerWriterLock->ResourceInitialized = FALSE;
+    }
+#endif // defined(DMF_USER_MODE)
+}
+
 // TODO: This function should not reference DMF_OBJECT nor DMF_MODULE_COLLECTION.
 //       Currently it is an exception because it is an "internal" Module. But, this
 //       needs to be fixed.
@@ -677,7 +892,13 @@ Return Value:
 
     ioTarget = WdfDeviceGetIoTarget(Device);
 
+    // The request is sent and forgotten: no completion routine is set and it is never seen again.
+    // KMDF just skips the current stack location in that case so the request does not need
+    // to be formatted. UMDF requires it.
+    //
+#if defined(DMF_USER_MODE)
     WdfRequestFormatRequestUsingCurrentType(Request);
+#endif // defined(DMF_USER_MODE)
     WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions,
                                   WDF_REQUEST_SEND_OPTION_SEND_AND_FORGET);
     if (! WdfRequestSend(Request,
@@ -26,6 +26,14 @@ Environment:
 #include "DmfModules.Core.h"
 #include "DmfModules.Core.Trace.h"
 #include "Dmf_Bridge.h"
+#include "DmfDiagnostics_Public.h"
+
+// Diagnostic data is collected when DMF is built with any of these options.
+// (See DmfDiagnostics.c.)
+//
+#if defined(USE_DMF_METHOD_INSTRUMENTATION) || defined(USE_DMF_LOCK_PROFILING)
+#define DMF_DIAGNOSTICS_ENABLED
+#endif
 
 // It means the Generic function is not overridden.
 //
@@ -86,6 +94,37 @@ typedef enum
     ModuleOpenedDuringType_Maximum
 } ModuleOpenedDuringType;
 
+#if defined(USE_DMF_LOCK_PROFILING)
+
+// Profile of a single Module lock.
+// The fields are only written by the thread that holds the lock so no interlocked
+// operations are needed.
+//
+typedef struct
+{
+    // Number of times the lock was acquired.
+    //
+    LONG64 AcquireCount;
+    // Number of times the lock was already held by another thread when acquire was called.
+    //
+    LONG64 ContendedCount;
+    // Time the current owner acquired the lock.
+    //
+    LONGLONG AcquireTime;
+    // Return address of the call that acquired the lock (the owning Method).
+    //
+    VOID* Owner;
+    // Longest time the lock was held and the Method that held it.
+    //
+    LONG64 MaximumHoldNs;
+    VOID* MaximumHoldOwner;
+    // Number of acquisitions by hold time.
+    //
+    LONG64 HoldHistogram[DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS];
+} DMF_LOCK_PROFILE;
+
+#endif // defined(USE_DMF_LOCK_PROFILING)
+
 typedef struct
 {
     // DISPATCH_LEVEL Synchronization Generic Device Lock.
@@ -97,8 +136,49 @@ typedef struct
     // For debug purposes only.
     //
     HANDLE LockHeldByThread;
+#if defined(DEBUG)
+    // Number of threads that hold the lock shared.
+    // For debug purposes only.
+    //
+    volatile LONG LockHeldSharedCount;
+#endif // defined(DEBUG)
+#if defined(USE_DMF_LOCK_PROFILING)
+    // Hold time and contention of this lock.
+    //
+    DMF_LOCK_PROFILE LockProfile;
+#endif // defined(USE_DMF_LOCK_PROFILING)
 } DMF_SYNCHRONIZATION;
 
+// Default lock of Modules that set DMF_MODULE_OPTIONS_READER_WRITER_LOCK.
+// It replaces the WDF lock at DMF_DEFAULT_LOCK_INDEX. It is allocated with the
+// Module's DMF_OBJECT (see DMF_ModuleCreate()).
+//
+typedef struct
+{
+#if defined(DMF_USER_MODE)
+    // Used by both PASSIVE_LEVEL and DISPATCH_LEVEL Modules.
+    //
+    SRWLOCK SrwLock;
+#else
+    // PASSIVE_LEVEL Modules.
+    //
+    ERESOURCE Resource;
+    BOOLEAN ResourceInitialized;
+    // DISPATCH_LEVEL Modules.
+    //
+    EX_SPIN_LOCK SpinLock;
+    // IRQL to restore when the exclusive owner releases SpinLock.
+    //
+    KIRQL ExclusiveOldIrql;
+    // IRQL to restore when a shared owner releases SpinLock, indexed by processor.
+    // Shared owners stay at DISPATCH_LEVEL until they release SpinLock so only one
+    // owner at a time uses each processor's entry.
+    //
+    ULONG NumberOfProcessors;
+    KIRQL* SharedOldIrql;
+#endif // defined(DMF_USER_MODE)
+} DMF_READER_WRITER_LOCK;
+
 // Maximum number of Auxiliary locks per DMF Module.
 //
 #define DMF_MAXIMUM_AUXILIARY_LOCKS         4
@@ -128,8 +208,109 @@ typedef struct
     // Unlock Module using auxiliary lock.
     //
     DMF_AuxiliaryLock* AuxiliaryUnlock;
+    // Lock Module using default lock for reading.
+    //
+    DMF_Lock* DefaultLockShared;
+    // Unlock Module using default lock for reading.
+    //
+    DMF_Unlock* DefaultUnlockShared;
 } DMF_CALLBACKS_INTERNAL;
 
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+
+// Per processor diagnostic counters are padded to this size.
+//
+#define DMF_DIAGNOSTICS_CACHE_LINE_SIZE     64
+#define DMF_DIAGNOSTICS_CACHE_LINE_ALIGN(Size)  (((Size) + DMF_DIAGNOSTICS_CACHE_LINE_SIZE - 1) & ~((size_t)DMF_DIAGNOSTICS_CACHE_LINE_SIZE - 1))
+
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+// Maximum number of Methods recorded per Module. Calls to other Methods are not recorded.
+//
+#define DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS      16
+
+// Counters of a single Method on a single processor.
+//
+typedef struct
+{
+    volatile LONG64 CallCount;
+    volatile LONG64 TotalLatencyNs;
+    volatile LONG64 LatencyHistogram[DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS];
+} DMF_METHOD_INSTRUMENTATION_COUNTERS;
+
+// Method instrumentation data of a Module.
+//
+typedef struct
+{
+    // Name of the Method that uses each set of counters. It is set the first time
+    // the Method is called and never changes after that.
+    //
+    const CHAR* volatile MethodNames[DMF_METHOD_INSTRUMENTATION_MAXIMUM_METHODS];
+    // Number of processors that have their own counters.
+    //
+    ULONG NumberOfProcessors;
+    // Number of counters for each processor (including padding).
+    //
+    ULONG CountersPerProcessor;
+    // NumberOfProcessors * CountersPerProcessor counters, indexed by processor and then by Method.
+    //
+    DMF_METHOD_INSTRUMENTATION_COUNTERS* Counters;
+} DMF_METHOD_INSTRUMENTATION;
+
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+// Number of bits in the set of IOCTLs that Modules declare they handle.
+// Several IOCTLs can share a bit, so a set bit only means that a Module may handle the IOCTL.
+//
+#define DMF_IOCTL_INTEREST_BITS     256
+
+// Set of IOCTLs that one or more Modules handle. Each IOCTL is hashed to one bit.
+//
+typedef struct
+{
+    ULONG Bits[DMF_IOCTL_INTEREST_BITS / 32];
+} DMF_IOCTL_INTEREST;
+
+__forceinline
+ULONG
+DMF_IoctlInterestBitGet(
+    _In_ ULONG IoControlCode
+    )
+{
+    // Mix the Function and the Device Type so that the IOCTLs of a single device
+    // do not all share a few bits.
+    //
+    return ((IoControlCode >> 2) ^ (IoControlCode >> 16)) % DMF_IOCTL_INTEREST_BITS;
+}
+
+__forceinline
+VOID
+DMF_IoctlInterestSet(
+    _Inout_ DMF_IOCTL_INTEREST* IoctlInterest,
+    _In_ ULONG IoControlCode
+    )
+{
+    ULONG bit;
+
+    bit = DMF_IoctlInterestBitGet(IoControlCode);
+    IoctlInterest->Bits[bit / 32] |= (1UL << (bit % 32));
+}
+
+__forceinline
+BOOLEAN
+DMF_IoctlInterestIsSet(
+    _In_ DMF_IOCTL_INTEREST* IoctlInterest,
+    _In_ ULONG IoControlCode
+    )
+{
+    ULONG bit;
+
+    bit = DMF_IoctlInterestBitGet(IoControlCode);
+    return ((IoctlInterest->Bits[bit / 32] & (1UL << (bit % 32))) != 0);
+}
+
 // Forward declaration for DMF Object.
 //
 typedef struct _DMF_OBJECT_ DMF_OBJECT;
@@ -140,14 +321,21 @@ typedef struct _DMF_MODULE_COLLECTION_ DMF_MODULE_COLLECTION;
 
 struct _DMF_OBJECT_
 {
+    // Identifies the Module type (see DMF_MODULE_TYPE_TAG).
+    // DMF_ModuleTypeTagGet() returns it so that Module Methods can validate their handle cheaply.
+    // While the Module's open is deferred until first use, it is DMF_MODULE_TYPE_TAG_OPEN_DEFERRED()
+    // of the Module type's tag.
+    //
+    VOID* ModuleTypeTag;
     // This element is used to insert an instance of this structure into a list
     // when this instance is a Child Module.
     //
     LIST_ENTRY ChildListEntry;
     // Context using during Open.
     //
+    // It is allocated with this structure. Its size is ModuleDescriptor.ModuleConfigSize.
+    //
     VOID* ModuleConfig;
-    WDFMEMORY ModuleConfigMemory;
     // For debug purposes only.
     // If Client wants allocates its own context, then
     // ModuleContext will not be the primary context of DMFMODULE.
@@ -172,6 +360,23 @@ struct _DMF_OBJECT_
     //
     ModuleOpenedDuringType ModuleOpenedDuring;
     ModuleOpenedDuringType ModuleNotificationRegisteredDuring;
+    // When DMF_MODULE_ATTRIBUTES.OpenOnFirstUse is set and the automatic open has been deferred,
+    // the callback during which the Module would have been opened. Otherwise, ModuleOpenedDuringType_Invalid.
+    //
+    ModuleOpenedDuringType OpenDeferredDuring;
+    // Serializes the deferred open with the automatic close.
+    // It is only created when DMF_MODULE_ATTRIBUTES.OpenOnFirstUse is set.
+    //
+    WDFWAITLOCK OpenDeferredLock;
+    // Thread that is opening the Module on first use (so that Methods the Module's Open
+    // calls do not try to open the Module again).
+    //
+    HANDLE OpenDeferredThreadId;
+    // TRUE if the Module has declared all the IOCTLs it handles using DMF_ModuleIoctlInterestAdd().
+    // Otherwise, the Module is assumed to handle all IOCTLs.
+    //
+    BOOLEAN IoctlInterestDeclared;
+    DMF_IOCTL_INTEREST IoctlInterest;
     // For debug purposes only.
     // This allows the Client Driver to easily identify which type 
     // of DMF Module this handle is associated with.
@@ -180,8 +385,8 @@ struct _DMF_OBJECT_
     // For debug purposes only.
     // This allows the Client Driver to easily identify which instance
     // of a DMF Module this handle is associated with.
+    // It is allocated with this structure.
     //
-    WDFMEMORY ClientModuleInstanceNameMemory;
     CHAR* ClientModuleInstanceName;
     // For debug purposes only.
     //
@@ -223,11 +428,11 @@ struct _DMF_OBJECT_
     //
     ULONG NumberOfChildModules;
     // Collection of Interface Bindings where this Module is either the Transport or the Protocol.
-    //
-    // TODO: Check if a lock is needed to protect this?
+    // It is created when the Module is first bound. Until then it is NULL.
     //
     WDFCOLLECTION InterfaceBindings;
     // Spin Lock to protect access to InterfaceBindings.
+    // It is created before InterfaceBindings is set.
     //
     WDFSPINLOCK InterfaceBindingsLock;
     // Transport Modules.
@@ -244,6 +449,9 @@ struct _DMF_OBJECT_
     // This includes one default lock and a number of auxiliary locks as specified by Client.
     //
     DMF_SYNCHRONIZATION Synchronizations[DMF_MAXIMUM_AUXILIARY_LOCKS + DMF_NUMBER_OF_DEFAULT_LOCKS];
+    // Default lock of Modules that set DMF_MODULE_OPTIONS_READER_WRITER_LOCK.
+    //
+    DMF_READER_WRITER_LOCK* ReaderWriterLock;
     // Stores the Module's In Flight Recorder handle.
     //
     RECORDER_LOG InFlightRecorder;
@@ -256,6 +464,18 @@ struct _DMF_OBJECT_
     // Transport Interface GUID for validation.
     //
     GUID DesiredTransportInterfaceGuid;
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    // For debug purposes only.
+    // Time the Module's Open callback took the last time it was called.
+    //
+    ULONGLONG OpenDurationNs;
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+    // Method call counts and latency (NULL if it could not be allocated).
+    //
+    DMF_METHOD_INSTRUMENTATION* MethodInstrumentation;
+    WDFMEMORY MethodInstrumentationMemory;
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
 };
 
 // DMF Object Signature.
@@ -281,6 +501,110 @@ typedef struct
     LIST_ENTRY* PreviousChildObjectListEntry;
 } CHILD_OBJECT_INTERATION_CONTEXT;
 
+// WDF callbacks that are dispatched through a routing table.
+//
+typedef enum
+{
+    ModuleCollectionRoute_QueueIoRead = 0,
+    ModuleCollectionRoute_QueueIoWrite,
+    ModuleCollectionRoute_DeviceIoControl,
+    ModuleCollectionRoute_InternalDeviceIoControl,
+    ModuleCollectionRoute_NumberOfRoutes
+} ModuleCollectionRouteType;
+
+// List of Modules (including Child Modules) that implement a given WDF callback.
+// The Modules are listed in the same order that the callback was dispatched to them
+// by walking the Module tree: each Module before its Children.
+//
+typedef struct
+{
+    DMF_OBJECT** DmfObjects;
+    LONG NumberOfDmfObjects;
+    // IOCTL routes only: TRUE if every Module in the table has declared the IOCTLs it handles.
+    // In that case, IOCTLs that are not in IoctlInterest are not dispatched to the Modules.
+    //
+    BOOLEAN IoctlInterestDeclared;
+    DMF_IOCTL_INTEREST IoctlInterest;
+} DMF_MODULE_COLLECTION_ROUTE;
+
+// Opens (or otherwise starts) the tree of a Module in the Module Collection.
+// Context contains the arguments of the WDF callback.
+//
+typedef NTSTATUS (*ModuleCollectionOpenFunctionType)(_In_ DMFMODULE DmfModule,
+                                                     _In_opt_ VOID* Context);
+
+// Maximum number of work items that open Modules in parallel.
+//
+#define DMF_MODULE_COLLECTION_OPEN_WORKERS_MAXIMUM      4
+
+typedef enum
+{
+    ModuleCollectionOpenState_NotStarted = 0,
+    ModuleCollectionOpenState_Running,
+    ModuleCollectionOpenState_Completed
+} ModuleCollectionOpenStateType;
+
+// Describes when one of the Modules in the Module Collection can be opened
+// when Modules are opened in parallel.
+//
+typedef struct
+{
+    // TRUE if the Module set DMF_MODULE_ATTRIBUTES.OpenInParallel.
+    //
+    BOOLEAN OpenInParallel;
+    // Index of the last Module before this Module that does not set OpenInParallel.
+    // -1 if there is none.
+    //
+    LONG SequentialIndex;
+    // Indexes of the Modules in DMF_MODULE_ATTRIBUTES.OpenAfter.
+    //
+    LONG OpenAfterIndex[DMF_MODULE_ATTRIBUTES_OPEN_AFTER_MAXIMUM];
+    ULONG NumberOfOpenAfter;
+    // State of the current dispatch.
+    //
+    ModuleCollectionOpenStateType OpenState;
+    // Times of the current dispatch. StartNs is relative to the start of the dispatch.
+    //
+    ULONGLONG StartNs;
+    ULONGLONG DurationNs;
+} DMF_MODULE_COLLECTION_OPEN_NODE;
+
+// Used to open the Modules of a Module Collection in parallel. It only exists when
+// at least one Module sets DMF_MODULE_ATTRIBUTES.OpenInParallel.
+//
+typedef struct
+{
+    // Module Collection that contains the Modules.
+    //
+    DMF_MODULE_COLLECTION* ModuleCollectionHandle;
+    // One entry for each Module in ClientDriverDmfModules.
+    //
+    DMF_MODULE_COLLECTION_OPEN_NODE* Nodes;
+    // Work items that open the Modules.
+    //
+    WDFWORKITEM WorkItems[DMF_MODULE_COLLECTION_OPEN_WORKERS_MAXIMUM];
+    ULONG NumberOfWorkItems;
+    // Protects the rest of this structure and the state of Nodes.
+    //
+    WDFWAITLOCK Lock;
+    // Indicates if each work item is enqueued or running. A work item is only enqueued
+    // while holding Lock and after it is marked active.
+    //
+    BOOLEAN WorkItemActive[DMF_MODULE_COLLECTION_OPEN_WORKERS_MAXIMUM];
+    LONG NumberOfWorkItemsActive;
+    // Set when NumberOfWorkItemsActive becomes zero.
+    //
+    DMF_PORTABLE_EVENT WorkItemsDoneEvent;
+    // Function and arguments of the current dispatch.
+    //
+    ModuleCollectionOpenFunctionType OpenFunction;
+    VOID* OpenFunctionContext;
+    LONGLONG StartTime;
+    // Status of the first Module that fails.
+    //
+    NTSTATUS NtStatus;
+} DMF_MODULE_COLLECTION_PARALLEL_OPEN;
+
 // The DMF Module Collection contains information about all the instantiated
 // DMF Modules. It is used for automatically dispatching various calls to
 // each instance of a DMF Module.
@@ -315,6 +639,18 @@ struct _DMF_MODULE_COLLECTION_
     //
     DMF_CALLBACKS_WDF_CHECK DmfCallbacksWdfCheck;
 
+    // Routing tables for the Request dispatch callbacks. They are built once after
+    // all the Modules are created so that dispatch does not need to walk the Module tree.
+    // All the tables share a single allocation.
+    //
+    DMF_MODULE_COLLECTION_ROUTE Routes[ModuleCollectionRoute_NumberOfRoutes];
+    WDFMEMORY RoutesMemory;
+
+    // Used to open Modules in parallel. NULL when Modules are opened one after the other.
+    //
+    DMF_MODULE_COLLECTION_PARALLEL_OPEN* ParallelOpen;
+    WDFMEMORY ParallelOpenMemory;
+
     // Indicates that Client invoked Create callbacks manually.
     // It is necessary for the case where Module Collection Cleanup callback
     // is called, but the Client has not had a chance to call the corresponding
@@ -345,10 +681,13 @@ typedef struct _DMF_INTERFACE_OBJECT
     // State of this Interface.
     //
     InterfaceStateType InterfaceState;
-    // Reference counter for this Interface.
+    // Reference counter for this Interface (in units of INTERFACE_REFERENCE_INCREMENT).
+    // INTERFACE_REFERENCE_ACTIVE is set while references can be acquired. It is cleared
+    // when the Interface starts to close. Accessed only using Interlocked functions so that
+    // Protocol/Transport calls do not acquire InterfaceLock.
     //
-    LONG ReferenceCount;
-    // Lock to protect accesses to this structure.
+    volatile LONG ReferenceCount;
+    // Lock to protect accesses to this structure (other than ReferenceCount).
     //
     WDFSPINLOCK InterfaceLock;
     // WDF Object corresponding to DMF_INTERFACE_OBJECT.
@@ -356,6 +695,11 @@ typedef struct _DMF_INTERFACE_OBJECT
     DMFINTERFACE DmfInterface;
 } DMF_INTERFACE_OBJECT;
 
+// Bits of DMF_INTERFACE_OBJECT.ReferenceCount.
+//
+#define INTERFACE_REFERENCE_ACTIVE          (0x00000001)
+#define INTERFACE_REFERENCE_INCREMENT       (0x00000002)
+
 typedef struct _DMF_DEVICE_CONTEXT
 {
     // Corresponding WDF Device.
@@ -385,6 +729,10 @@ typedef struct _DMF_DEVICE_CONTEXT
     //
     BOOLEAN IsFilterDevice;
 
+    // Indicates that the Client Driver's device presents Requests at PASSIVE_LEVEL.
+    //
+    BOOLEAN IsPassiveLevel;
+
     // Callback that allows Client to emit logging/telemetry data.
     //
     EVT_DMF_DEVICE_LOG* EvtDmfDeviceLog;
@@ -475,6 +823,10 @@ DmfChildObjectNextGet(
     _Inout_ CHILD_OBJECT_INTERATION_CONTEXT* ChildObjectInterationContext
     );
 
+HANDLE 
+DmfGetCurrentThreadId(
+    );
+
 // DmfBranchTrack.h
 //
 
@@ -544,6 +896,13 @@ DMF_ModuleLiveKernelDump_ModuleCollectionInitialize(
 // DmfHelpers.h
 //
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+size_t
+DMF_ReaderWriterLockSizeGet(
+    _In_ ULONG ModuleOptions,
+    _In_ BOOLEAN PassiveLevel
+    );
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
 DMF_SynchronizationCreate(
@@ -551,6 +910,12 @@ DMF_SynchronizationCreate(
     _In_ BOOLEAN PassiveLevel
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_SynchronizationDelete(
+    _In_ DMF_OBJECT* DmfObject
+    );
+
 // DmfValidate.c
 //
 
@@ -594,6 +959,22 @@ DMF_HandleValidate_Destroy(
     _In_ DMF_OBJECT* DmfObject
     );
 
+VOID
+DMF_ModuleTypeTagRegister(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleTypeTagUnregister(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleTypeTagOpenDeferredSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN OpenDeferred
+    );
+
 VOID
 DMF_HandleValidate_IsOpen(
     _In_ DMF_OBJECT* DmfObject
@@ -1356,6 +1737,58 @@ DMF_Generic_Unlock_Dispatch(
     _In_ DMFMODULE DmfModule
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterLock_Passive(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterUnlock_Passive(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterLockShared_Passive(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Generic_ReaderWriterUnlockShared_Passive(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterLock_Dispatch(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterUnlock_Dispatch(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterLockShared_Dispatch(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+#pragma warning(suppress: 28167)
+DMF_Generic_ReaderWriterUnlockShared_Dispatch(
+    _In_ DMFMODULE DmfModule
+    );
+
 __forceinline
 DMF_OBJECT*
 DMF_ModuleToObject(
@@ -1534,6 +1967,108 @@ DMF_ModuleWaitForReferenceCountToClear(
     _In_ DMFMODULE DmfModule
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleDeferredOpenArm(
+    _In_ DMFMODULE DmfModule,
+    _In_ ModuleOpenedDuringType OpenDeferredDuring
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleDeferredOpenCancel(
+    _In_ DMFMODULE DmfModule,
+    _In_ ModuleOpenedDuringType OpenDeferredDuring
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_ModuleDeferredOpen(
+    _In_ DMFMODULE DmfModule
+    );
+
+// DmfDiagnostics.c
+//
+
+LONGLONG
+DMF_DiagnosticsTimeGet(
+    _Out_opt_ LONGLONG* Frequency
+    );
+
+ULONGLONG
+DMF_DiagnosticsElapsedNanosecondsGet(
+    _In_ LONGLONG StartTime
+    );
+
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+
+ULONG
+DMF_DiagnosticsHistogramBucketGet(
+    _In_ ULONGLONG Nanoseconds
+    );
+
+ULONG
+DMF_DiagnosticsProcessorIndexGet(
+    _In_ ULONG NumberOfProcessors
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_DiagnosticsDeviceInterfaceCreate(
+    _In_ WDFDEVICE Device
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+DMF_DiagnosticsDeviceIoControl(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG IoControlCode
+    );
+
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
+#if defined(USE_DMF_LOCK_PROFILING)
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+BOOLEAN
+DMF_LockProfileContendedGet(
+    _In_ DMF_SYNCHRONIZATION* Synchronization
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LockProfileAcquired(
+    _Inout_ DMF_SYNCHRONIZATION* Synchronization,
+    _In_ BOOLEAN Contended,
+    _In_ VOID* Owner
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_LockProfileReleased(
+    _Inout_ DMF_SYNCHRONIZATION* Synchronization
+    );
+
+#endif // defined(USE_DMF_LOCK_PROFILING)
+
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_MethodInstrumentationInitialize(
+    _Inout_ DMF_OBJECT* DmfObject
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_MethodInstrumentationUninitialize(
+    _Inout_ DMF_OBJECT* DmfObject
+    );
+
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
 // DmfContainer.c
 //
 
@@ -1612,6 +2147,12 @@ DMF_DmfDeviceInitIsFilterDriver(
     _In_ PDMFDEVICE_INIT DmfDeviceInit
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+DMF_DmfDeviceInitIsPassiveLevel(
+    _In_ PDMFDEVICE_INIT DmfDeviceInit
+    );
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 DMF_CONFIG_LiveKernelDump*
 DMF_DmfDeviceInitLiveKernelDumpModuleConfigGet(
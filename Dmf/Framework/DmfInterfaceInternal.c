@@ -371,6 +371,13 @@ Return Value:
         *DmfInterfaceObject = NULL;
     }
 
+    if (NULL == dmfObject->InterfaceBindings)
+    {
+        // The Module has never been bound.
+        //
+        goto Exit;
+    }
+
     WdfSpinLockAcquire(dmfObject->InterfaceBindingsLock);
 
     for (interfaceIndex = 0; interfaceIndex < WdfCollectionGetCount(dmfObject->InterfaceBindings); interfaceIndex++)
@@ -405,6 +412,8 @@ Return Value:
 
     WdfSpinLockRelease(dmfObject->InterfaceBindingsLock);
 
+Exit:
+
     return interfaceFound;
 }
 
@@ -456,6 +465,13 @@ Return Value:
         *DmfInterfaceObject = NULL;
     }
 
+    if (NULL == dmfObject->InterfaceBindings)
+    {
+        // The Module has never been bound.
+        //
+        goto Exit;
+    }
+
     WdfSpinLockAcquire(dmfObject->InterfaceBindingsLock);
 
     for (interfaceIndex = 0; interfaceIndex < WdfCollectionGetCount(dmfObject->InterfaceBindings); interfaceIndex++)
@@ -495,6 +511,8 @@ Return Value:
 
     WdfSpinLockRelease(dmfObject->InterfaceBindingsLock);
 
+Exit:
+
     return interfaceFound;
 }
 
@@ -507,6 +525,7 @@ DMF_InterfaceReference(
 Routine Description:
 
     Increments the reference count corresponding to the given DMF Interface if the Interface is in Open state.
+    This function does not acquire a lock.
 
 Arguments:
 
@@ -521,27 +540,33 @@ Return Value:
 {
     DMF_INTERFACE_OBJECT* dmfInterfaceObject;
     NTSTATUS ntStatus;
-
-    ntStatus = STATUS_SUCCESS;
+    LONG referenceCount;
 
     dmfInterfaceObject = DMF_InterfaceToObject(DmfInterface);
 
-    // Modify the ReferenceCount of the DmfInterfaceObject.
+    // Increment the ReferenceCount of the DmfInterfaceObject only if it is still active.
+    // The reference count and the active bit are in the same word so that
+    // DMF_ModuleInterfaceWaitToClose() cannot miss a reference that is being added.
     //
-    WdfSpinLockAcquire(dmfInterfaceObject->InterfaceLock);
-
-    if (dmfInterfaceObject->InterfaceState == InterfaceState_Opened)
-    {
-        dmfInterfaceObject->ReferenceCount++;
-        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Interface reference added. ReferenceCount after adding: %d", dmfInterfaceObject->ReferenceCount);
-    }
-    else
+    for (;;)
     {
-        ntStatus = STATUS_UNSUCCESSFUL;
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Interface reference add failed. DmfInterfaceObject: 0x%p, InterfaceState: %d", dmfInterfaceObject, dmfInterfaceObject->InterfaceState);
-    }
+        referenceCount = dmfInterfaceObject->ReferenceCount;
+        if (! (referenceCount & INTERFACE_REFERENCE_ACTIVE))
+        {
+            ntStatus = STATUS_UNSUCCESSFUL;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Interface reference add failed. DmfInterfaceObject: 0x%p, InterfaceState: %d", dmfInterfaceObject, dmfInterfaceObject->InterfaceState);
+            break;
+        }
 
-    WdfSpinLockRelease(dmfInterfaceObject->InterfaceLock);
+        if (InterlockedCompareExchange(&dmfInterfaceObject->ReferenceCount,
+                                       referenceCount + INTERFACE_REFERENCE_INCREMENT,
+                                       referenceCount) == referenceCount)
+        {
+            ntStatus = STATUS_SUCCESS;
+            TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Interface reference added. ReferenceCount after adding: %d", (referenceCount / INTERFACE_REFERENCE_INCREMENT) + 1);
+            break;
+        }
+    }
 
     return ntStatus;
 }
@@ -555,6 +580,7 @@ DMF_InterfaceDereference(
 Routine Description:
 
     Decrements the reference count corresponding to the given DMF Interface.
+    This function does not acquire a lock.
 
 Arguments:
 
@@ -567,23 +593,21 @@ Return Value:
 --*/
 {
     DMF_INTERFACE_OBJECT* dmfInterfaceObject;
+    LONG referenceCount;
 
     dmfInterfaceObject = DMF_InterfaceToObject(DmfInterface);
 
-    // Modify the ReferenceCount of the DmfInterfaceObject.
-    //
-    WdfSpinLockAcquire(dmfInterfaceObject->InterfaceLock);
-
     DmfAssert((dmfInterfaceObject->InterfaceState == InterfaceState_Opened)||
               (dmfInterfaceObject->InterfaceState == InterfaceState_Closing));
 
-    dmfInterfaceObject->ReferenceCount--;
-
-    DmfAssert(dmfInterfaceObject->ReferenceCount >= 0);
+    // Decrement the ReferenceCount of the DmfInterfaceObject.
+    //
+    referenceCount = InterlockedExchangeAdd(&dmfInterfaceObject->ReferenceCount,
+                                            -INTERFACE_REFERENCE_INCREMENT);
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Interface reference count after de-reference: %d", dmfInterfaceObject->ReferenceCount);
+    DmfAssert(referenceCount >= INTERFACE_REFERENCE_INCREMENT);
 
-    WdfSpinLockRelease(dmfInterfaceObject->InterfaceLock);
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Interface reference count after de-reference: %d", (referenceCount / INTERFACE_REFERENCE_INCREMENT) - 1);
 
     return;
 }
@@ -622,18 +646,17 @@ Return Value:
     // since DMF_InterfaceReference() will fail.
     //
     DmfInterfaceObject->InterfaceState = InterfaceState_Closing;
-    referenceCount = DmfInterfaceObject->ReferenceCount;
+    referenceCount = InterlockedAnd(&DmfInterfaceObject->ReferenceCount,
+                                    ~INTERFACE_REFERENCE_ACTIVE);
+    referenceCount &= ~INTERFACE_REFERENCE_ACTIVE;
 
     WdfSpinLockRelease(DmfInterfaceObject->InterfaceLock);
 
     while (referenceCount > 0)
     {
-        WdfSpinLockAcquire(DmfInterfaceObject->InterfaceLock);
-
-        referenceCount = DmfInterfaceObject->ReferenceCount;
-
-        WdfSpinLockRelease(DmfInterfaceObject->InterfaceLock);
-
+        referenceCount = InterlockedCompareExchange(&DmfInterfaceObject->ReferenceCount,
+                                                    0,
+                                                    0);
         if (referenceCount == 0)
         {
             break;
@@ -710,6 +733,91 @@ Exit:
     return ntStatus;
 }
 
+static
+NTSTATUS
+DMF_ModuleInterfaceBindingsCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Creates the Interface Bindings collection of a given Module and the lock that protects
+    it, if they have not already been created. Most Modules are never bound so they are
+    not created with the Module.
+
+Arguments:
+
+    DmfModule - The given Module.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_OBJECT* dmfObject;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDFSPINLOCK interfaceBindingsLock;
+    WDFCOLLECTION interfaceBindings;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    if (dmfObject->InterfaceBindings != NULL)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = dmfObject->MemoryDmfObject;
+
+    // The lock is set before the collection so that any code that finds the collection
+    // can use the lock.
+    //
+    if (NULL == dmfObject->InterfaceBindingsLock)
+    {
+        ntStatus = WdfSpinLockCreate(&attributes,
+                                     &interfaceBindingsLock);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "InterfaceBindingsLock create fails.");
+            goto Exit;
+        }
+
+        if (InterlockedCompareExchangePointer((VOID* volatile*)&dmfObject->InterfaceBindingsLock,
+                                              interfaceBindingsLock,
+                                              NULL) != NULL)
+        {
+            // Another thread set it first.
+            //
+            WdfObjectDelete(interfaceBindingsLock);
+        }
+    }
+
+    ntStatus = WdfCollectionCreate(&attributes,
+                                   &interfaceBindings);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Unable to allocate Collection for InterfaceBindings.");
+        goto Exit;
+    }
+
+    if (InterlockedCompareExchangePointer((VOID* volatile*)&dmfObject->InterfaceBindings,
+                                          interfaceBindings,
+                                          NULL) != NULL)
+    {
+        // Another thread set it first.
+        //
+        WdfObjectDelete(interfaceBindings);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
 NTSTATUS
 DMF_ModuleInterfaceBind(
     _In_ DMFMODULE ProtocolModule,
@@ -824,6 +932,18 @@ Return Value:
 
     // Add this Interface to Protocol Module's and Transport Module's Interface Binding collections.
     //
+    ntStatus = DMF_ModuleInterfaceBindingsCreate(ProtocolModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    ntStatus = DMF_ModuleInterfaceBindingsCreate(TransportModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
     dmfObject = DMF_ModuleToObject(ProtocolModule);
 
     WdfSpinLockAcquire(dmfObject->InterfaceBindingsLock);
@@ -893,6 +1013,10 @@ Return Value:
     //
     WdfSpinLockAcquire(dmfInterfaceObject->InterfaceLock);
     dmfInterfaceObject->InterfaceState = InterfaceState_Opened;
+    // Allow references to be acquired.
+    //
+    InterlockedOr(&dmfInterfaceObject->ReferenceCount,
+                  INTERFACE_REFERENCE_ACTIVE);
     WdfSpinLockRelease(dmfInterfaceObject->InterfaceLock);
 
     // Interface state is set to Opened when PostBind callbacks are called.
@@ -1040,6 +1164,13 @@ Return Value:
 
     dmfObject = DMF_ModuleToObject(DmfModule);
 
+    if (NULL == dmfObject->InterfaceBindings)
+    {
+        // The Module has never been bound.
+        //
+        return;
+    }
+
     // Unbind all interface bindings of this Module.
     // NOTE: Generally speaking this loop should not execute.
     // This will happen in the case of non-PnP Client drivers.
@@ -1522,6 +1522,9 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_OBJECT* dmfObject;
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    LONGLONG startTime;
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
 
     dmfObject = DMF_ModuleToObject(DmfModule);
 
@@ -1533,7 +1536,14 @@ Return Value:
     // Open the Module.
     //
     DmfAssert(dmfObject->ModuleDescriptor.CallbacksDmf->DeviceOpen != NULL);
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    startTime = DMF_DiagnosticsTimeGet(NULL);
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
     ntStatus = (dmfObject->ModuleDescriptor.CallbacksDmf->DeviceOpen)(DmfModule);
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    dmfObject->OpenDurationNs = DMF_DiagnosticsElapsedNanosecondsGet(startTime);
+    TraceInformation(DMF_TRACE, "DmfModule=0x%p [%s] OpenDurationUs=%I64d", DmfModule, dmfObject->ClientModuleInstanceName, dmfObject->OpenDurationNs / 1000);
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
     if (NT_SUCCESS(ntStatus))
     {
         // The Module is open.
@@ -105,31 +105,48 @@ Return Value:
     dmfModule = DMF_ObjectToModule(DmfObject);
 
     // Store pointers to Module specific structures (DMF_OBJECT, DMF_CONFIG) to the Framework Ring Buffer.
+    // NOTE: When DMF is built with USE_DMF_LOCK_PROFILING, the lock profiles are part of
+    //       DMF_OBJECT (see DMF_SYNCHRONIZATION).
     //
     DMF_MODULE_LIVEKERNELDUMP_POINTER_STORE(dmfModule,
                                             DmfObject,
                                             sizeof(DMF_OBJECT));
 
-    if (DmfObject->ModuleConfigMemory != NULL)
+    if (DmfObject->ModuleConfig != NULL)
     {
-        dmfConfig = WdfMemoryGetBuffer(DmfObject->ModuleConfigMemory,
-                                       &dmfConfigSize);
+        dmfConfig = DmfObject->ModuleConfig;
+        dmfConfigSize = DmfObject->ModuleDescriptor.ModuleConfigSize;
 
         DMF_MODULE_LIVEKERNELDUMP_POINTER_STORE(dmfModule,
                                                 dmfConfig,
                                                 dmfConfigSize);
     }
 
-    if (DmfObject->ClientModuleInstanceNameMemory != NULL)
+    if (DmfObject->ClientModuleInstanceName != NULL)
     {
-        clientModuleInstanceName = WdfMemoryGetBuffer(DmfObject->ClientModuleInstanceNameMemory,
-                                                      &clientModuleInstanceNameSize);
+        clientModuleInstanceName = DmfObject->ClientModuleInstanceName;
+        clientModuleInstanceNameSize = strlen(DmfObject->ClientModuleInstanceName) + sizeof(CHAR);
 
         DMF_MODULE_LIVEKERNELDUMP_POINTER_STORE(dmfModule,
                                                 clientModuleInstanceName,
                                                 clientModuleInstanceNameSize);
     }
 
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+    if (DmfObject->MethodInstrumentationMemory != NULL)
+    {
+        VOID* methodInstrumentation;
+        size_t methodInstrumentationSize;
+
+        methodInstrumentation = WdfMemoryGetBuffer(DmfObject->MethodInstrumentationMemory,
+                                                   &methodInstrumentationSize);
+
+        DMF_MODULE_LIVEKERNELDUMP_POINTER_STORE(dmfModule,
+                                                methodInstrumentation,
+                                                methodInstrumentationSize);
+    }
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
     // Call the Module specific Initialize function where the Module can store 
     // private structures to the ring buffer.
     //
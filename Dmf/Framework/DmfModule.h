@@ -553,6 +553,11 @@ DMF_CALLBACKS_WDF_INIT(
 // It means the Module requires the Client to set a Transport.
 //
 #define DMF_MODULE_OPTIONS_TRANSPORT_REQUIRED   0x00000008
+// It means the Module's default lock is a reader/writer lock. Methods that do not
+// modify the Module's data use DMF_ModuleLockShared() so they do not serialize
+// against each other. (Auxiliary locks are not affected.)
+//
+#define DMF_MODULE_OPTIONS_READER_WRITER_LOCK   0x00000010
 
 #define DMF_MODULE_RUNS_PASSIVE(DmfObject) (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_PASSIVE)
 #define DMF_MODULE_RUNS_DISPATCH(DmfObject) (DmfObject->ModuleDescriptor.ModuleOptions & DMF_MODULE_OPTIONS_DISPATCH)
@@ -646,8 +651,20 @@ typedef struct
     // this method.
     //
     DMF_WdfAddCustomType* WdfAddCustomType;
+    // Identifies the Module type. It is stored in the Module's DMF_OBJECT so that
+    // Module Methods can validate the handle they receive by comparing a single pointer.
+    //
+    VOID* ModuleTypeTag;
 } DMF_MODULE_DESCRIPTOR;
 
+// The Module type tag is the address of the (unique) WDF type information of the
+// Module's custom type. It is the same for all instances of a Module type.
+//
+#define DMF_MODULE_TYPE_TAG_FROM_CONTEXT(ContextType)                                       \
+    ((VOID*)(WDF_GET_CONTEXT_TYPE_INFO(ContextType)->UniqueType))
+#define DMF_MODULE_TYPE_TAG(ModuleType)                                                     \
+    DMF_MODULE_TYPE_TAG_FROM_CONTEXT(WDF_CUSTOM_TYPE_CONTEXT_NAME(ModuleType))
+
 #define DMF_MODULE_DESCRIPTOR_INIT(Descriptor, Name, Module_Options, Open_Option)           \
                                                                                             \
 RtlZeroMemory(&Descriptor,                                                                  \
@@ -665,6 +682,7 @@ Descriptor.CallbacksWdf                    = NULL;
 Descriptor.ModuleLiveKernelDumpInitialize  = DMF_##Name##_LiveKernelDumpInitialize;         \
 Descriptor.ModuleContextAttributes         = WDF_NO_OBJECT_ATTRIBUTES;                      \
 Descriptor.WdfAddCustomType                = WDF_ADD_CUSTOM_TYPE_FUNCTION_NAME(Name);       \
+Descriptor.ModuleTypeTag                   = DMF_MODULE_TYPE_TAG(Name);                     \
                                                                                             \
 
 #define DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(Descriptor, Name, ModuleContext, Module_Options, Open_Option)         \
@@ -727,6 +745,13 @@ DMF_ModuleIsInFilterDriver(
     _In_ DMFMODULE DmfModule
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleIoctlInterestAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG IoControlCode
+    );
+
 VOID
 DMF_ModuleLock(
     _In_ DMFMODULE DmfModule
@@ -737,12 +762,27 @@ DMF_ModuleUnlock(
     _In_ DMFMODULE DmfModule
     );
 
+VOID
+DMF_ModuleLockShared(
+    _In_ DMFMODULE DmfModule
+    );
+
+VOID
+DMF_ModuleUnlockShared(
+    _In_ DMFMODULE DmfModule
+    );
+
 #if defined(DEBUG)
 BOOLEAN
 DMF_ModuleIsLocked(
     _In_ DMFMODULE DmfModule
     );
 
+BOOLEAN
+DMF_ModuleIsLockedExclusive(
+    _In_ DMFMODULE DmfModule
+    );
+
 BOOLEAN
 DMF_ModuleLockIsPassive(
     _In_ DMFMODULE DmfModule
@@ -827,6 +867,47 @@ DMF_InFlightRecorderGet(
 );
 #endif
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Method Instrumentation
+////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// When DMF and the Client are built with USE_DMF_METHOD_INSTRUMENTATION, Methods that use
+// these macros record their call count and a latency histogram per processor. Applications
+// retrieve the data using IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION (DmfDiagnostics_Public.h).
+// Place DMF_METHOD_INSTRUMENTATION_BEGIN after the Module handle is validated and
+// DMF_METHOD_INSTRUMENTATION_END before the Method returns.
+// Otherwise, the macros do nothing.
+//
+#if defined(USE_DMF_METHOD_INSTRUMENTATION)
+
+LONGLONG
+DMF_MethodInstrumentationStart(
+    VOID
+    );
+
+VOID
+DMF_MethodInstrumentationStop(
+    _In_ DMFMODULE DmfModule,
+    _In_z_ const CHAR* MethodName,
+    _In_ LONGLONG StartTime
+    );
+
+#define DMF_METHOD_INSTRUMENTATION_BEGIN(ModuleHandle)                                          \
+    LONGLONG dmfMethodInstrumentationStartTime = DMF_MethodInstrumentationStart()
+
+#define DMF_METHOD_INSTRUMENTATION_END(ModuleHandle)                                            \
+    DMF_MethodInstrumentationStop(ModuleHandle,                                                 \
+                                  __FUNCTION__,                                                 \
+                                  dmfMethodInstrumentationStartTime)
+
+#else
+
+#define DMF_METHOD_INSTRUMENTATION_BEGIN(ModuleHandle)
+#define DMF_METHOD_INSTRUMENTATION_END(ModuleHandle)
+
+#endif // defined(USE_DMF_METHOD_INSTRUMENTATION)
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Features
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -853,12 +934,118 @@ DMF_HandleValidate_ModuleMethod(
     _In_ DMFMODULE DmfModule
     );
 
+// Returns the Module type tag (see DMF_MODULE_TYPE_TAG) stored in the given Module's DMF_OBJECT.
+//
+VOID*
+DMF_ModuleTypeTagObjectGet(
+    _In_ DMFMODULE DmfModule
+    );
+
+// Table of Module type tags indexed by a hash of the Module handle. It allows Module Methods to
+// read the tag of the handle they receive without calling WDF. A Module claims the entry its handle
+// hashes to when it is created if the entry is not used, and releases it when it is destroyed.
+// Modules that cannot claim their entry read the tag from their DMF_OBJECT instead.
+// An entry is only claimed or released while no Method of the Module that owns it can be called.
+//
+#define DMF_MODULE_TYPE_TAG_TABLE_SIZE      1024
+
+typedef struct
+{
+    DMFMODULE DmfModule;
+    VOID* ModuleTypeTag;
+} DMF_MODULE_TYPE_TAG_ENTRY;
+
+extern DMF_MODULE_TYPE_TAG_ENTRY DmfModuleTypeTagTable[DMF_MODULE_TYPE_TAG_TABLE_SIZE];
+
+__forceinline
+ULONG
+DMF_ModuleTypeTagIndexGet(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    ULONG_PTR handleValue;
+
+    // The lowest bits of handles vary little, so mix in higher bits.
+    //
+    handleValue = (ULONG_PTR)DmfModule;
+    return (ULONG)(((handleValue >> 3) ^ (handleValue >> 13)) & (DMF_MODULE_TYPE_TAG_TABLE_SIZE - 1));
+}
+
+// While the open of a Module is deferred until first use (DMF_MODULE_ATTRIBUTES.OpenOnFirstUse),
+// its tag is changed to this value so that it does not match the tag Module Methods expect.
+// The Methods then take the slow path which opens the Module before they proceed.
+// Module type tags are addresses of WDF type information so their lowest bit is clear.
+//
+#define DMF_MODULE_TYPE_TAG_OPEN_DEFERRED(ModuleTypeTag)                                    \
+    ((VOID*)((ULONG_PTR)(ModuleTypeTag) | 1))
+
+// Returns the Module type tag (see DMF_MODULE_TYPE_TAG) of the given Module.
+//
+__forceinline
+VOID*
+DMF_ModuleTypeTagGet(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_MODULE_TYPE_TAG_ENTRY* entry;
+
+    entry = &DmfModuleTypeTagTable[DMF_ModuleTypeTagIndexGet(DmfModule)];
+    if (entry->DmfModule == DmfModule)
+    {
+        return entry->ModuleTypeTag;
+    }
+
+    return DMF_ModuleTypeTagObjectGet(DmfModule);
+}
+
+// Called by the validation macros below when the type tag of the handle a Module Method receives
+// is not the tag of the Module type the Method expects. This happens when the handle is of the wrong
+// Module type, or when the Module's open is deferred until first use.
+//
+VOID
+DMF_HandleValidate_ModuleTypeMismatch(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ModuleTypeTag
+    );
+
+// Debug builds validate the Module handle passed to Module Methods using the WDF custom type
+// of the handle along with the state of the Module.
+// Other builds only validate the Module type by comparing the type tag stored in the
+// DMF_OBJECT with the tag of the expected Module type. Define USE_DMF_STRICT_MODULE_VALIDATION
+// to use the WDF custom type check in those builds as well.
+// In all builds, a Method called for a Module whose open is deferred until first use opens the Module.
+//
+#if defined(DEBUG)
+#define DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)                                      \
+    WdfObjectIsCustomType(ModuleHandle, ModuleType)
+#elif defined(USE_DMF_STRICT_MODULE_VALIDATION)
+#define DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)                                      \
+    (WdfObjectIsCustomType(ModuleHandle, ModuleType) &&                                         \
+     (DMF_ModuleTypeTagGet(ModuleHandle) == DMF_MODULE_TYPE_TAG(ModuleType)))
+#else
+#define DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)                                      \
+    (DMF_ModuleTypeTagGet(ModuleHandle) == DMF_MODULE_TYPE_TAG(ModuleType))
+#endif // defined(DEBUG)
+
+#if defined(DEBUG)
+
 #define DMFMODULE_VALIDATE_IN_METHOD(ModuleHandle, ModuleType)                                  \
                                                                                                 \
-     (! WdfObjectIsCustomType(ModuleHandle, ModuleType)) ?                                      \
+     (! DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)) ?                                   \
               (DmfAssert(FALSE)) :                                                              \
               (DMF_HandleValidate_ModuleMethod(ModuleHandle))                                   \
 
+#else
+
+#define DMFMODULE_VALIDATE_IN_METHOD(ModuleHandle, ModuleType)                                  \
+                                                                                                \
+     (! DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)) ?                                   \
+              (DMF_HandleValidate_ModuleTypeMismatch(ModuleHandle,                              \
+                                                     DMF_MODULE_TYPE_TAG(ModuleType))) :        \
+              ((VOID)0)                                                                         \
+
+#endif // defined(DEBUG)
+
 // These two validation functions are deprecated
 // Do not use it.
 //
@@ -867,23 +1054,35 @@ DMF_HandleValidate_OpeningOk(
     _In_ DMFMODULE DmfModule
     );
 
+VOID
+DMF_HandleValidate_ClosingOk(
+    _In_ DMFMODULE DmfModule
+    );
+
+#if defined(DEBUG)
+
 #define DMFMODULE_VALIDATE_IN_METHOD_OPENING_OK(ModuleHandle, ModuleType)                       \
                                                                                                 \
-    (! WdfObjectIsCustomType(ModuleHandle, ModuleType)) ?                                       \
+    (! DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)) ?                                    \
               (DmfAssert(FALSE)) :                                                              \
               (DMF_HandleValidate_OpeningOk(ModuleHandle))                                      \
 
-VOID
-DMF_HandleValidate_ClosingOk(
-    _In_ DMFMODULE DmfModule
-    );
-	
 #define DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(ModuleHandle, ModuleType)                       \
                                                                                                 \
-    (! WdfObjectIsCustomType(ModuleHandle, ModuleType)) ?                                       \
+    (! DMFMODULE_IS_MODULE_TYPE(ModuleHandle, ModuleType)) ?                                    \
               (DmfAssert(FALSE)) :                                                              \
               (DMF_HandleValidate_ClosingOk(ModuleHandle))                                      \
 
+#else
+
+#define DMFMODULE_VALIDATE_IN_METHOD_OPENING_OK(ModuleHandle, ModuleType)                       \
+    DMFMODULE_VALIDATE_IN_METHOD(ModuleHandle, ModuleType)
+
+#define DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(ModuleHandle, ModuleType)                       \
+    DMFMODULE_VALIDATE_IN_METHOD(ModuleHandle, ModuleType)
+
+#endif // defined(DEBUG)
+
 __forceinline
 DMFMODULE
 DMFMODULEVOID_TO_MODULE(
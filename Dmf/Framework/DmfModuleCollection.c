@@ -428,80 +428,924 @@ Return Value:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+BOOLEAN
+DMF_ModuleCollectionRouteImplemented(
+    _In_ DMF_OBJECT* DmfObject,
+    _In_ ModuleCollectionRouteType RouteType
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the given DMF Object implements the WDF callback that corresponds to the given route.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+    RouteType - Indicates the WDF callback.
+
+Return Value:
+
+    TRUE if the DMF Object implements the WDF callback.
+    FALSE if the DMF Object uses the Generic handler.
+
+--*/
+{
+    BOOLEAN returnValue;
+    DMF_CALLBACKS_WDF* wdfCallbacks;
+
+    PAGED_CODE();
+
+    wdfCallbacks = DmfObject->ModuleDescriptor.CallbacksWdf;
+    DmfAssert(wdfCallbacks != NULL);
+
+    switch (RouteType)
+    {
+        case ModuleCollectionRoute_QueueIoRead:
+        {
+            returnValue = (wdfCallbacks->ModuleQueueIoRead != DMF_Generic_ModuleQueueIoRead);
+            break;
+        }
+        case ModuleCollectionRoute_QueueIoWrite:
+        {
+            returnValue = (wdfCallbacks->ModuleQueueIoWrite != DMF_Generic_ModuleQueueIoWrite);
+            break;
+        }
+        case ModuleCollectionRoute_DeviceIoControl:
+        {
+            returnValue = (wdfCallbacks->ModuleDeviceIoControl != DMF_Generic_ModuleDeviceIoControl);
+            break;
+        }
+        case ModuleCollectionRoute_InternalDeviceIoControl:
+        {
+            returnValue = (wdfCallbacks->ModuleInternalDeviceIoControl != DMF_Generic_ModuleInternalDeviceIoControl);
+            break;
+        }
+        default:
+        {
+            DmfAssert(FALSE);
+            returnValue = FALSE;
+            break;
+        }
+    }
+
+    return returnValue;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+DMF_ModuleCollectionRouteAdd(
+    _In_ DMF_OBJECT* DmfObject,
+    _In_ ModuleCollectionRouteType RouteType,
+    _Inout_ DMF_MODULE_COLLECTION_ROUTE* Route
+    )
+/*++
+
+Routine Description:
+
+    Add the given DMF Object and its Child Modules to the given route if they implement
+    the route's WDF callback. The Module tree is walked in the same order as DMF_Module_QueueIoRead()
+    and similar functions dispatch: the Parent Module first, then each Child Module and its Children.
+    If the route's table has not been allocated yet, the entries are only counted.
+
+Arguments:
+
+    DmfObject - The given DMF Object.
+    RouteType - Indicates the WDF callback.
+    Route - The route to add to.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* childDmfObject;
+    CHILD_OBJECT_INTERATION_CONTEXT childObjectIterationContext;
+
+    PAGED_CODE();
+
+    if (DMF_ModuleCollectionRouteImplemented(DmfObject,
+                                             RouteType))
+    {
+        if (Route->DmfObjects != NULL)
+        {
+            Route->DmfObjects[Route->NumberOfDmfObjects] = DmfObject;
+        }
+        Route->NumberOfDmfObjects++;
+    }
+
+    childDmfObject = DmfChildObjectFirstGet(DmfObject,
+                                            &childObjectIterationContext);
+    while (childDmfObject != NULL)
+    {
+        DMF_ModuleCollectionRouteAdd(childDmfObject,
+                                     RouteType,
+                                     Route);
+        childDmfObject = DmfChildObjectNextGet(&childObjectIterationContext);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_ModuleCollectionRoutesBuild(
+    _Inout_ DMF_MODULE_COLLECTION* ModuleCollectionHandle
+    )
+/*++
+
+Routine Description:
+
+    Build the routing tables used to dispatch Requests to the Modules in the tree of instantiated Modules.
+    Each table only contains the Modules that implement the corresponding WDF callback so that
+    Modules that would only return FALSE are never called.
+
+Arguments:
+
+    ModuleCollectionHandle - Module Collection that contains the Modules.
+
+Return Value:
+
+    STATUS_SUCCESS or the error from WdfMemoryCreate().
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    DMF_OBJECT** dmfObjects;
+    LONG numberOfDmfObjects;
+    LONG routeIndex;
+    LONG driverModuleIndex;
+    LONG dmfObjectIndex;
+    DMF_MODULE_COLLECTION_ROUTE* route;
+    ULONG bitsIndex;
+
+    PAGED_CODE();
+
+    DmfAssert(NULL == ModuleCollectionHandle->RoutesMemory);
+
+    // Count the number of entries in each table.
+    //
+    numberOfDmfObjects = 0;
+    for (routeIndex = 0; routeIndex < ModuleCollectionRoute_NumberOfRoutes; routeIndex++)
+    {
+        route = &ModuleCollectionHandle->Routes[routeIndex];
+        route->DmfObjects = NULL;
+        route->NumberOfDmfObjects = 0;
+        route->IoctlInterestDeclared = FALSE;
+        RtlZeroMemory(&route->IoctlInterest,
+                      sizeof(route->IoctlInterest));
+        for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+        {
+            DmfAssert(ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex] != NULL);
+            DMF_ModuleCollectionRouteAdd(ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex],
+                                         (ModuleCollectionRouteType)routeIndex,
+                                         route);
+        }
+        numberOfDmfObjects += route->NumberOfDmfObjects;
+    }
+
+    if (0 == numberOfDmfObjects)
+    {
+        // No Module handles Requests.
+        //
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // Allocate all the tables at once.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = (DMFCOLLECTION)(ModuleCollectionHandle->ModuleCollectionHandleMemory);
+    ntStatus = WdfMemoryCreate(&attributes,
+                               NonPagedPoolNx,
+                               DMF_TAG,
+                               sizeof(DMF_OBJECT*) * numberOfDmfObjects,
+                               &ModuleCollectionHandle->RoutesMemory,
+                               (VOID**)&dmfObjects);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        ModuleCollectionHandle->RoutesMemory = NULL;
+        RtlZeroMemory(ModuleCollectionHandle->Routes,
+                      sizeof(ModuleCollectionHandle->Routes));
+        goto Exit;
+    }
+
+    // Populate each table.
+    //
+    for (routeIndex = 0; routeIndex < ModuleCollectionRoute_NumberOfRoutes; routeIndex++)
+    {
+        route = &ModuleCollectionHandle->Routes[routeIndex];
+        if (0 == route->NumberOfDmfObjects)
+        {
+            continue;
+        }
+
+        route->DmfObjects = dmfObjects;
+        route->NumberOfDmfObjects = 0;
+        for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+        {
+            DMF_ModuleCollectionRouteAdd(ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex],
+                                         (ModuleCollectionRouteType)routeIndex,
+                                         route);
+        }
+        dmfObjects += route->NumberOfDmfObjects;
+
+        if ((ModuleCollectionRoute_DeviceIoControl == routeIndex) ||
+            (ModuleCollectionRoute_InternalDeviceIoControl == routeIndex))
+        {
+            // IOCTLs can only be filtered when every Module in the table has declared
+            // the IOCTLs it handles.
+            //
+            route->IoctlInterestDeclared = TRUE;
+            for (dmfObjectIndex = 0; dmfObjectIndex < route->NumberOfDmfObjects; dmfObjectIndex++)
+            {
+                if (! route->DmfObjects[dmfObjectIndex]->IoctlInterestDeclared)
+                {
+                    route->IoctlInterestDeclared = FALSE;
+                    break;
+                }
+                for (bitsIndex = 0; bitsIndex < ARRAYSIZE(route->IoctlInterest.Bits); bitsIndex++)
+                {
+                    route->IoctlInterest.Bits[bitsIndex] |= route->DmfObjects[dmfObjectIndex]->IoctlInterest.Bits[bitsIndex];
+                }
+            }
+        }
+
+        TraceInformation(DMF_TRACE, "ModuleCollectionHandle=0x%p route=%d NumberOfDmfObjects=%d IoctlInterestDeclared=%d", ModuleCollectionHandle, routeIndex, route->NumberOfDmfObjects, route->IoctlInterestDeclared);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
 static
+LONG
+DMF_ModuleCollectionModuleIndexGet(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Find the Module in the Module Collection that contains the given Module. It is
+    either the given Module or the top level Parent Module of the given Module.
+
+Arguments:
+
+    ModuleCollectionHandle - Module Collection that contains the Modules.
+    DmfModule - The given Module.
+
+Return Value:
+
+    Index of the Module in ClientDriverDmfModules or -1 if it is not in the Module Collection.
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    LONG driverModuleIndex;
+
+    PAGED_CODE();
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    while (dmfObject->DmfObjectParent != NULL)
+    {
+        dmfObject = dmfObject->DmfObjectParent;
+    }
+
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        if (ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex] == dmfObject)
+        {
+            return driverModuleIndex;
+        }
+    }
+
+    return -1;
+}
+#pragma code_seg()
+
+EVT_WDF_WORKITEM DMF_ModuleCollectionParallelOpenWork;
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_ModuleCollectionParallelOpenCreate(
+    _Inout_ DMF_MODULE_COLLECTION* ModuleCollectionHandle
+    )
+/*++
+
+Routine Description:
+
+    If any Module in the Module Collection sets DMF_MODULE_ATTRIBUTES.OpenInParallel, determine
+    which Modules each Module must be opened after and create the work items that open
+    the Modules in parallel. Otherwise, do nothing so that Modules are opened one after the other.
+
+Arguments:
+
+    ModuleCollectionHandle - Module Collection that contains the Modules.
+
+Return Value:
+
+    STATUS_SUCCESS, STATUS_INVALID_PARAMETER if a Module's OpenAfter is not valid or
+    the error from creating the WDF objects.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDF_WORKITEM_CONFIG workItemConfig;
+    WDFMEMORY parallelOpenMemory;
+    DMF_MODULE_COLLECTION_PARALLEL_OPEN* parallelOpen;
+    LONG numberOfParallelModules;
+    LONG driverModuleIndex;
+    LONG sequentialIndex;
+    ULONG openAfterIndex;
+    ULONG workItemIndex;
+
+    PAGED_CODE();
+
+    DmfAssert(NULL == ModuleCollectionHandle->ParallelOpen);
+
+    ntStatus = STATUS_SUCCESS;
+    parallelOpenMemory = NULL;
+
+    numberOfParallelModules = 0;
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        if (ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex]->ModuleAttributes.OpenInParallel)
+        {
+            numberOfParallelModules++;
+        }
+    }
+
+    if (0 == numberOfParallelModules)
+    {
+        // Modules are opened one after the other.
+        //
+        goto Exit;
+    }
+
+    // Allocate the structure and one node per Module at once.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = (DMFCOLLECTION)(ModuleCollectionHandle->ModuleCollectionHandleMemory);
+    ntStatus = WdfMemoryCreate(&attributes,
+                               NonPagedPoolNx,
+                               DMF_TAG,
+                               sizeof(DMF_MODULE_COLLECTION_PARALLEL_OPEN) + 
+                               (sizeof(DMF_MODULE_COLLECTION_OPEN_NODE) * ModuleCollectionHandle->NumberOfClientDriverDmfModules),
+                               &parallelOpenMemory,
+                               (VOID**)&parallelOpen);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        parallelOpenMemory = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(parallelOpen,
+                  sizeof(DMF_MODULE_COLLECTION_PARALLEL_OPEN) + 
+                  (sizeof(DMF_MODULE_COLLECTION_OPEN_NODE) * ModuleCollectionHandle->NumberOfClientDriverDmfModules));
+    parallelOpen->ModuleCollectionHandle = ModuleCollectionHandle;
+    parallelOpen->Nodes = (DMF_MODULE_COLLECTION_OPEN_NODE*)(parallelOpen + 1);
+
+    // Modules that do not set OpenInParallel keep their place in the order of the Module Collection.
+    // Modules that set it wait for the last such Module before them and for their OpenAfter Modules.
+    // Since all those Modules are before the Module, there can be no cycles.
+    //
+    sequentialIndex = -1;
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DMF_OBJECT* dmfObject;
+        DMF_MODULE_COLLECTION_OPEN_NODE* node;
+
+        dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        node = &parallelOpen->Nodes[driverModuleIndex];
+
+        node->OpenInParallel = dmfObject->ModuleAttributes.OpenInParallel;
+        node->SequentialIndex = sequentialIndex;
+        if (! node->OpenInParallel)
+        {
+            sequentialIndex = driverModuleIndex;
+            continue;
+        }
+
+        for (openAfterIndex = 0; openAfterIndex < DMF_MODULE_ATTRIBUTES_OPEN_AFTER_MAXIMUM; openAfterIndex++)
+        {
+            DMFMODULE* openAfterDmfModule;
+            LONG openAfterDriverModuleIndex;
+
+            openAfterDmfModule = dmfObject->ModuleAttributes.OpenAfter[openAfterIndex];
+            if (NULL == openAfterDmfModule)
+            {
+                continue;
+            }
+
+            if (NULL == *openAfterDmfModule)
+            {
+                openAfterDriverModuleIndex = -1;
+            }
+            else
+            {
+                openAfterDriverModuleIndex = DMF_ModuleCollectionModuleIndexGet(ModuleCollectionHandle,
+                                                                                *openAfterDmfModule);
+            }
+            if ((openAfterDriverModuleIndex < 0) ||
+                (openAfterDriverModuleIndex >= driverModuleIndex))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid OpenAfter dmfObject=0x%p [%s] openAfterIndex=%d", dmfObject, dmfObject->ClientModuleInstanceName, openAfterIndex);
+                DmfAssert(FALSE);
+                ntStatus = STATUS_INVALID_PARAMETER;
+                goto Exit;
+            }
+
+            node->OpenAfterIndex[node->NumberOfOpenAfter] = openAfterDriverModuleIndex;
+            node->NumberOfOpenAfter++;
+        }
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = parallelOpenMemory;
+    ntStatus = WdfWaitLockCreate(&attributes,
+                                 &parallelOpen->Lock);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfWaitLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // There is no need for more work items than Modules that can be opened at the same time.
+    //
+    parallelOpen->NumberOfWorkItems = min((ULONG)numberOfParallelModules,
+                                          DMF_MODULE_COLLECTION_OPEN_WORKERS_MAXIMUM);
+    for (workItemIndex = 0; workItemIndex < parallelOpen->NumberOfWorkItems; workItemIndex++)
+    {
+        WDF_WORKITEM_CONFIG_INIT(&workItemConfig,
+                                 DMF_ModuleCollectionParallelOpenWork);
+        workItemConfig.AutomaticSerialization = WdfFalse;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = parallelOpenMemory;
+        ntStatus = WdfWorkItemCreate(&workItemConfig,
+                                     &attributes,
+                                     &parallelOpen->WorkItems[workItemIndex]);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfWorkItemCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    DMF_Portable_EventCreate(&parallelOpen->WorkItemsDoneEvent,
+                             SynchronizationEvent,
+                             FALSE);
+
+    ModuleCollectionHandle->ParallelOpen = parallelOpen;
+    ModuleCollectionHandle->ParallelOpenMemory = parallelOpenMemory;
+    parallelOpenMemory = NULL;
+
+    TraceInformation(DMF_TRACE, "ModuleCollectionHandle=0x%p numberOfParallelModules=%d NumberOfWorkItems=%d", ModuleCollectionHandle, numberOfParallelModules, parallelOpen->NumberOfWorkItems);
+
+Exit:
+
+    if (parallelOpenMemory != NULL)
+    {
+        // This also deletes the lock and work items.
+        //
+        WdfObjectDelete(parallelOpenMemory);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+static
+VOID
+DMF_ModuleCollectionCleanup(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ ModuleOpenedDuringType ModuleOpenedDuring
+    )
+/*++
+
+Routine Description:
+
+    Close all Modules in a Module Collection that have been opened during a given
+    callback. This function is called during failure to cleanup prior to exit.
+
+Arguments:
+
+    ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
+    ModuleOpenedDuring - The current callback for which modules should be closed.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LONG driverModuleIndex;
+
+    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p ModuleOpenedDuring=%d", ModuleCollectionHandle, ModuleOpenedDuring);
+
+    // NumberOfClientDriverDmfModules may be zero in cases where all elements of structure
+    // have not been allocated (usually due to fault injection).
+    //
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DMF_OBJECT* dmfObject;
+
+        dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        DmfAssert(dmfObject != NULL);
+        DMFMODULE dmfModule = DMF_ObjectToModule(dmfObject);
+        if (dmfObject->ModuleAttributes.OpenOnFirstUse)
+        {
+            // If the Module has not been used it was not opened so it is not closed.
+            //
+            DMF_ModuleDeferredOpenCancel(dmfModule,
+                                         ModuleOpenedDuring);
+        }
+
+        if (dmfObject->ModuleOpenedDuring == ModuleOpenedDuring)
+        {
+            // The Module needs to be cleaned up (closed).
+            //
+            TraceInformation(DMF_TRACE, "Cleanup (close) ModuleCollectionHandle=0x%p dmfObject=0x%p", ModuleCollectionHandle, dmfObject);
+            DMF_ModuleClose(dmfModule);
+        }
+        else if (dmfObject->ModuleNotificationRegisteredDuring == ModuleOpenedDuring)
+        {
+            // The Module needs to be cleaned up (notification unregistered).
+            //
+            TraceInformation(DMF_TRACE, "Cleanup (notification) ModuleCollectionHandle=0x%p dmfObject=0x%p", ModuleCollectionHandle, dmfObject);
+            DMF_Module_NotificationUnregister(dmfModule);
+        }
+    }
+
+    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+}
+
+_Function_class_(EVT_WDF_OBJECT_CONTEXT_CLEANUP)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_ModuleCollectionDestroy(
+    _In_ WDFOBJECT Object
+    )
+/*++
+
+Routine Description:
+
+    Given a WDFOBJECT which is a DMFCOLLECTION, this function destroys all the
+    Modules that are associated with the DMFCOLLECTION. This function is designed
+    to be called directly by WDF (it is a WDF clean up callback).
+
+Arguments:
+
+    Object - The given WDFOBJECT.
+
+Return Value:
+
+    None
+
+--*/
+{
+    LONG driverModuleIndex;
+    DMF_OBJECT* dmfObject;
+    DMFCOLLECTION dmfCollection;
+
+    dmfCollection = (DMFCOLLECTION)Object;
+
+    FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p", dmfCollection);
+
+    if (NULL == dmfCollection)
+    {
+        // This is a normal code path in case driver initialization completely fails.
+        // ReleaseHardware is always called.
+        //
+        goto Exit;
+    }
+
+    DMF_MODULE_COLLECTION* moduleCollectionHandle = DMF_CollectionToHandle(dmfCollection);
+
+    // In the case of non-PnP drivers where DMF_Invoke_DeviceCallbacksCreate() has been called in DriverEntry()
+    // the Client Driver has no chance to call the corresponding DMF_Invoke_DeviceCallbacksDestroy() since this
+    // callback happens before the Client Driver's Cleanup callback. Because Modules must be Closed before they
+    // are destroyed this condition is detected and the corresponding function is called here.
+    //
+    if (moduleCollectionHandle->ManualDestroyCallbackIsPending)
+    {
+        moduleCollectionHandle->ManualDestroyCallbackIsPending = FALSE;
+        // '_Param_(2)' could be '0':  this does not adhere to the specification for the function 'DMF_Invoke_DeviceCallbacksDestroy'
+        //
+        #pragma warning(suppress:6387)
+        DMF_Invoke_DeviceCallbacksDestroy(moduleCollectionHandle->ClientDevice,
+                                          NULL,
+                                          WdfPowerDeviceD0);
+    }
+
+    // Close any modules that were automatically opened after creation.
+    //
+    for (driverModuleIndex = (moduleCollectionHandle->NumberOfClientDriverDmfModules - 1);
+         driverModuleIndex >= 0;
+         driverModuleIndex--)
+    {
+        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        DmfAssert(dmfObject != NULL);
+        DMFMODULE dmfModule = DMF_ObjectToModule(dmfObject);
+
+        DMF_Module_CloseOrUnregisterNotificationOnDestroy(dmfModule);
+    }
+
+    // The routing tables refer to the Modules that are about to be destroyed.
+    //
+    if (moduleCollectionHandle->RoutesMemory != NULL)
+    {
+        WdfObjectDelete(moduleCollectionHandle->RoutesMemory);
+        moduleCollectionHandle->RoutesMemory = NULL;
+    }
+    RtlZeroMemory(moduleCollectionHandle->Routes,
+                  sizeof(moduleCollectionHandle->Routes));
+
+    // No Modules are opened in parallel after this. (The lock and work items are deleted with the memory.)
+    //
+    if (moduleCollectionHandle->ParallelOpen != NULL)
+    {
+        DMF_Portable_EventClose(&moduleCollectionHandle->ParallelOpen->WorkItemsDoneEvent);
+        WdfObjectDelete(moduleCollectionHandle->ParallelOpenMemory);
+        moduleCollectionHandle->ParallelOpen = NULL;
+        moduleCollectionHandle->ParallelOpenMemory = NULL;
+    }
+
+    // Destroy every Module in the collection.
+    //
+    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DMFMODULE dmfModule;
+
+        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        DmfAssert(dmfObject != NULL);
+        dmfModule = DMF_ObjectToModule(dmfObject);
+        DMF_ModuleTreeDestroy(dmfModule);
+        moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex] = NULL;
+    }
+
+    if (moduleCollectionHandle->ClientDriverDmfModules != NULL)
+    {
+        DmfAssert(moduleCollectionHandle->ClientDriverDmfModulesMemory != NULL);
+        WdfObjectDelete(moduleCollectionHandle->ClientDriverDmfModulesMemory);
+        moduleCollectionHandle->ClientDriverDmfModules = NULL;
+        moduleCollectionHandle->NumberOfClientDriverDmfModules = 0;
+        moduleCollectionHandle->ClientDriverDmfModulesMemory = NULL;
+    }
+
+    // (This function is called from the object's delete callback. It means that ModuleCollectionHandleMemory
+    // has already been deleted and must not be deleted again. It is not possible to call this function
+    // directly. It must always be called from the object's delete callback.)
+    //
+    moduleCollectionHandle = NULL;
+
+Exit:
+    ;
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Module Collection Dispatch Function Helpers
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Types for Module Collection functions that have common signatures so that the common coding pattern
+// does not need to be duplicated.
+//
+typedef NTSTATUS (*ModuleCollectionHandleDispatchFunctionNtStatusType)(_In_ DMFMODULE DmfModule);
+typedef VOID (*ModuleCollectionHandleDispatchFunctionVoidType)(_In_ DMFMODULE DmfModule);
+
+// Arguments of WDF callbacks passed to ModuleCollectionOpenFunctionType functions.
+//
+typedef struct
+{
+    WDFCMRESLIST ResourcesRaw;
+    WDFCMRESLIST ResourcesTranslated;
+} MODULE_COLLECTION_PREPARE_HARDWARE_CONTEXT;
+
+typedef struct
+{
+    WDF_POWER_DEVICE_STATE PreviousState;
+} MODULE_COLLECTION_D0ENTRY_CONTEXT;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_ModuleCollectionDispatchNtStatus(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ ModuleCollectionHandleDispatchFunctionNtStatusType ModuleCollectionDispatchFunction
+    )
+/*++
+
+Routine Description:
+
+    Given a DMF_MODULE_COLLECTION and a callback function that takes a DMFMODULE and returns NTSTATUS,
+    call the callback function for every Module associated with the given DMF_MODULE_COLLECTION.
+
+Arguments:
+
+    ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
+    ModuleCollectionDispatchFunction - The given callback function to call.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    LONG driverModuleIndex;
+    NTSTATUS ntStatus;
+
+    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+
+    ntStatus = STATUS_SUCCESS;
+
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DMF_OBJECT* dmfObject;
+        DMFMODULE dmfModule;
+
+        dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        DmfAssert(dmfObject != NULL);
+        dmfModule = DMF_ObjectToModule(dmfObject);
+        // NOTE: By design, this function will exit as soon as a Module returns an error.
+        //
+        ntStatus = ModuleCollectionDispatchFunction(dmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p ntStatus=%!STATUS!", ModuleCollectionHandle, ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
 VOID
-DMF_ModuleCollectionCleanup(
+DMF_ModuleCollectionDispatchVoid(
     _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
-    _In_ ModuleOpenedDuringType ModuleOpenedDuring
+    _In_ ModuleCollectionHandleDispatchFunctionVoidType ModuleCollectionDispatchFunction
     )
 /*++
 
 Routine Description:
 
-    Close all Modules in a Module Collection that have been opened during a given
-    callback. This function is called during failure to cleanup prior to exit.
+    Given a DMF_MODULE_COLLECTION and a callback function that takes a DMFMODULE and returns nothing,
+    call the callback function for every Module associated with the given DMF_MODULE_COLLECTION.
 
 Arguments:
 
     ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
-    ModuleOpenedDuring - The current callback for which modules should be closed.
+    ModuleCollectionDispatchFunction - The given callback function to call.
 
 Return Value:
 
-    None
+    NTSTATUS
 
 --*/
 {
     LONG driverModuleIndex;
 
-    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p ModuleOpenedDuring=%d", ModuleCollectionHandle, ModuleOpenedDuring);
+    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
 
-    // NumberOfClientDriverDmfModules may be zero in cases where all elements of structure
-    // have not been allocated (usually due to fault injection).
-    //
     for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
     {
         DMF_OBJECT* dmfObject;
+        DMFMODULE dmfModule;
 
         dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
         DmfAssert(dmfObject != NULL);
-        DMFMODULE dmfModule = DMF_ObjectToModule(dmfObject);
-        if (dmfObject->ModuleOpenedDuring == ModuleOpenedDuring)
+        dmfModule = DMF_ObjectToModule(dmfObject);
+        ModuleCollectionDispatchFunction(dmfModule);
+    }
+
+    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+LONG
+DMF_ModuleCollectionParallelOpenNextGet(
+    _In_ DMF_MODULE_COLLECTION_PARALLEL_OPEN* ParallelOpen
+    )
+/*++
+
+Routine Description:
+
+    Find a Module that has not been opened yet and that can be opened now because all
+    the Modules it must be opened after are open.
+
+    NOTE: Caller must hold ParallelOpen->Lock.
+
+Arguments:
+
+    ParallelOpen - Parallel open state of the Module Collection.
+
+Return Value:
+
+    Index of the Module or -1 if no Module can be opened now.
+
+--*/
+{
+    DMF_MODULE_COLLECTION_OPEN_NODE* nodes;
+    LONG driverModuleIndex;
+    BOOLEAN previousModulesCompleted;
+
+    // Do not open more Modules after a Module fails.
+    //
+    if (! NT_SUCCESS(ParallelOpen->NtStatus))
+    {
+        return -1;
+    }
+
+    nodes = ParallelOpen->Nodes;
+    previousModulesCompleted = TRUE;
+    for (driverModuleIndex = 0; driverModuleIndex < ParallelOpen->ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        DMF_MODULE_COLLECTION_OPEN_NODE* node;
+        BOOLEAN ready;
+        ULONG openAfterIndex;
+
+        node = &nodes[driverModuleIndex];
+        if (node->OpenState != ModuleCollectionOpenState_NotStarted)
         {
-            // The Module needs to be cleaned up (closed).
-            //
-            TraceInformation(DMF_TRACE, "Cleanup (close) ModuleCollectionHandle=0x%p dmfObject=0x%p", ModuleCollectionHandle, dmfObject);
-            DMF_ModuleClose(dmfModule);
+            previousModulesCompleted = previousModulesCompleted && 
+                                       (ModuleCollectionOpenState_Completed == node->OpenState);
+            continue;
         }
-        else if (dmfObject->ModuleNotificationRegisteredDuring == ModuleOpenedDuring)
+
+        if (! node->OpenInParallel)
         {
-            // The Module needs to be cleaned up (notification unregistered).
+            if (previousModulesCompleted)
+            {
+                return driverModuleIndex;
+            }
+            // No Module after this Module can be opened before it.
             //
-            TraceInformation(DMF_TRACE, "Cleanup (notification) ModuleCollectionHandle=0x%p dmfObject=0x%p", ModuleCollectionHandle, dmfObject);
-            DMF_Module_NotificationUnregister(dmfModule);
+            break;
+        }
+
+        ready = ((node->SequentialIndex < 0) ||
+                 (ModuleCollectionOpenState_Completed == nodes[node->SequentialIndex].OpenState));
+        for (openAfterIndex = 0; ready && (openAfterIndex < node->NumberOfOpenAfter); openAfterIndex++)
+        {
+            ready = (ModuleCollectionOpenState_Completed == nodes[node->OpenAfterIndex[openAfterIndex]].OpenState);
+        }
+        if (ready)
+        {
+            return driverModuleIndex;
         }
+
+        previousModulesCompleted = FALSE;
     }
 
-    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+    return -1;
 }
 
-_Function_class_(EVT_WDF_OBJECT_CONTEXT_CLEANUP)
+#pragma code_seg("PAGE")
+_Function_class_(EVT_WDF_WORKITEM)
+_IRQL_requires_same_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
-DMF_ModuleCollectionDestroy(
-    _In_ WDFOBJECT Object
+DMF_ModuleCollectionParallelOpenWork(
+    _In_ WDFWORKITEM WorkItem
     )
 /*++
 
 Routine Description:
 
-    Given a WDFOBJECT which is a DMFCOLLECTION, this function destroys all the
-    Modules that are associated with the DMFCOLLECTION. This function is designed
-    to be called directly by WDF (it is a WDF clean up callback).
+    Open Modules of the Module Collection until no more Modules can be opened now.
+    Each time a Module is opened and other Modules can be opened because of it, the other
+    work items that are not active are enqueued so that they open those Modules.
 
 Arguments:
 
-    Object - The given WDFOBJECT.
+    WorkItem - One of the work items of the Module Collection's parallel open state.
 
 Return Value:
 
@@ -509,203 +1353,345 @@ Return Value:
 
 --*/
 {
+    WDFMEMORY parallelOpenMemory;
+    DMF_MODULE_COLLECTION_PARALLEL_OPEN* parallelOpen;
+    DMF_MODULE_COLLECTION* moduleCollectionHandle;
     LONG driverModuleIndex;
-    DMF_OBJECT* dmfObject;
-    DMFCOLLECTION dmfCollection;
+    ULONG workItemIndex;
+    ULONG thisWorkItemIndex;
 
-    dmfCollection = (DMFCOLLECTION)Object;
+    PAGED_CODE();
 
-    FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p", dmfCollection);
+    parallelOpenMemory = (WDFMEMORY)WdfWorkItemGetParentObject(WorkItem);
+    parallelOpen = (DMF_MODULE_COLLECTION_PARALLEL_OPEN*)WdfMemoryGetBuffer(parallelOpenMemory,
+                                                                            NULL);
+    moduleCollectionHandle = parallelOpen->ModuleCollectionHandle;
 
-    if (NULL == dmfCollection)
+    thisWorkItemIndex = 0;
+    for (workItemIndex = 0; workItemIndex < parallelOpen->NumberOfWorkItems; workItemIndex++)
     {
-        // This is a normal code path in case driver initialization completely fails.
-        // ReleaseHardware is always called.
-        //
-        goto Exit;
+        if (parallelOpen->WorkItems[workItemIndex] == WorkItem)
+        {
+            thisWorkItemIndex = workItemIndex;
+            break;
+        }
     }
 
-    DMF_MODULE_COLLECTION* moduleCollectionHandle = DMF_CollectionToHandle(dmfCollection);
+    WdfWaitLockAcquire(parallelOpen->Lock,
+                       NULL);
 
-    // In the case of non-PnP drivers where DMF_Invoke_DeviceCallbacksCreate() has been called in DriverEntry()
-    // the Client Driver has no chance to call the corresponding DMF_Invoke_DeviceCallbacksDestroy() since this
-    // callback happens before the Client Driver's Cleanup callback. Because Modules must be Closed before they
-    // are destroyed this condition is detected and the corresponding function is called here.
-    //
-    if (moduleCollectionHandle->ManualDestroyCallbackIsPending)
+    DmfAssert(parallelOpen->WorkItemActive[thisWorkItemIndex]);
+
+    for (;;)
     {
-        moduleCollectionHandle->ManualDestroyCallbackIsPending = FALSE;
-        // '_Param_(2)' could be '0':  this does not adhere to the specification for the function 'DMF_Invoke_DeviceCallbacksDestroy'
+        DMF_MODULE_COLLECTION_OPEN_NODE* node;
+        DMFMODULE dmfModule;
+        LONGLONG startTime;
+        ULONGLONG durationNs;
+        NTSTATUS ntStatus;
+
+        driverModuleIndex = DMF_ModuleCollectionParallelOpenNextGet(parallelOpen);
+        if (driverModuleIndex < 0)
+        {
+            break;
+        }
+
+        node = &parallelOpen->Nodes[driverModuleIndex];
+        node->OpenState = ModuleCollectionOpenState_Running;
+        node->StartNs = DMF_DiagnosticsElapsedNanosecondsGet(parallelOpen->StartTime);
+
+        WdfWaitLockRelease(parallelOpen->Lock);
+
+        dmfModule = DMF_ObjectToModule(moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex]);
+        startTime = DMF_DiagnosticsTimeGet(NULL);
+        ntStatus = parallelOpen->OpenFunction(dmfModule,
+                                              parallelOpen->OpenFunctionContext);
+        durationNs = DMF_DiagnosticsElapsedNanosecondsGet(startTime);
+
+        WdfWaitLockAcquire(parallelOpen->Lock,
+                           NULL);
+
+        node->DurationNs = durationNs;
+        node->OpenState = ModuleCollectionOpenState_Completed;
+        if ((! NT_SUCCESS(ntStatus)) &&
+            NT_SUCCESS(parallelOpen->NtStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "dmfModule=0x%p ntStatus=%!STATUS!", dmfModule, ntStatus);
+            parallelOpen->NtStatus = ntStatus;
+        }
+
+        // Let the other work items open the Modules that were waiting for this Module.
+        // Only work items that are not active are enqueued so that every enqueue is
+        // counted in NumberOfWorkItemsActive.
         //
-        #pragma warning(suppress:6387)
-        DMF_Invoke_DeviceCallbacksDestroy(moduleCollectionHandle->ClientDevice,
-                                          NULL,
-                                          WdfPowerDeviceD0);
+        if (DMF_ModuleCollectionParallelOpenNextGet(parallelOpen) >= 0)
+        {
+            for (workItemIndex = 0; workItemIndex < parallelOpen->NumberOfWorkItems; workItemIndex++)
+            {
+                if (! parallelOpen->WorkItemActive[workItemIndex])
+                {
+                    parallelOpen->WorkItemActive[workItemIndex] = TRUE;
+                    parallelOpen->NumberOfWorkItemsActive++;
+                    WdfWorkItemEnqueue(parallelOpen->WorkItems[workItemIndex]);
+                }
+            }
+        }
     }
 
-    // Close any modules that were automatically opened after creation.
+    // No Module can be opened now. Modules that are still running enqueue this work
+    // item again if needed.
     //
-    for (driverModuleIndex = (moduleCollectionHandle->NumberOfClientDriverDmfModules - 1);
-         driverModuleIndex >= 0;
-         driverModuleIndex--)
+    parallelOpen->WorkItemActive[thisWorkItemIndex] = FALSE;
+    parallelOpen->NumberOfWorkItemsActive--;
+    if (0 == parallelOpen->NumberOfWorkItemsActive)
     {
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        DMFMODULE dmfModule = DMF_ObjectToModule(dmfObject);
-
-        DMF_Module_CloseOrUnregisterNotificationOnDestroy(dmfModule);
+        DMF_Portable_EventSet(&parallelOpen->WorkItemsDoneEvent);
     }
 
-    // Destroy every Module in the collection.
-    //
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
-    {
-        DMFMODULE dmfModule;
+    WdfWaitLockRelease(parallelOpen->Lock);
+}
+#pragma code_seg()
 
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        DMF_ModuleTreeDestroy(dmfModule);
-        moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex] = NULL;
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_ModuleCollectionParallelOpen(
+    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
+    _In_ ModuleCollectionOpenFunctionType ModuleCollectionOpenFunction,
+    _In_opt_ VOID* Context
+    )
+/*++
+
+Routine Description:
+
+    Call the given function for every Module in the Module Collection using the Module
+    Collection's work items. Modules are called as soon as the Modules they must be opened
+    after are done. This function returns after all the calls are done.
+
+Arguments:
+
+    ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
+    ModuleCollectionOpenFunction - The given function to call.
+    Context - Arguments of the WDF callback passed to ModuleCollectionOpenFunction.
+
+Return Value:
+
+    STATUS_SUCCESS if every call succeeds. Otherwise, the NTSTATUS of the first call that fails.
+    In that case Modules that were not called yet are not called.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_COLLECTION_PARALLEL_OPEN* parallelOpen;
+    LONG driverModuleIndex;
+    ULONG workItemIndex;
+    BOOLEAN done;
+
+    PAGED_CODE();
+
+    parallelOpen = ModuleCollectionHandle->ParallelOpen;
+    DmfAssert(parallelOpen != NULL);
+
+    WdfWaitLockAcquire(parallelOpen->Lock,
+                       NULL);
+
+    parallelOpen->OpenFunction = ModuleCollectionOpenFunction;
+    parallelOpen->OpenFunctionContext = Context;
+    parallelOpen->StartTime = DMF_DiagnosticsTimeGet(NULL);
+    parallelOpen->NtStatus = STATUS_SUCCESS;
+    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    {
+        parallelOpen->Nodes[driverModuleIndex].OpenState = ModuleCollectionOpenState_NotStarted;
+        parallelOpen->Nodes[driverModuleIndex].StartNs = 0;
+        parallelOpen->Nodes[driverModuleIndex].DurationNs = 0;
     }
 
-    if (moduleCollectionHandle->ClientDriverDmfModules != NULL)
+    DmfAssert(0 == parallelOpen->NumberOfWorkItemsActive);
+    for (workItemIndex = 0; workItemIndex < parallelOpen->NumberOfWorkItems; workItemIndex++)
     {
-        DmfAssert(moduleCollectionHandle->ClientDriverDmfModulesMemory != NULL);
-        WdfObjectDelete(moduleCollectionHandle->ClientDriverDmfModulesMemory);
-        moduleCollectionHandle->ClientDriverDmfModules = NULL;
-        moduleCollectionHandle->NumberOfClientDriverDmfModules = 0;
-        moduleCollectionHandle->ClientDriverDmfModulesMemory = NULL;
+        parallelOpen->WorkItemActive[workItemIndex] = TRUE;
+        parallelOpen->NumberOfWorkItemsActive++;
+        WdfWorkItemEnqueue(parallelOpen->WorkItems[workItemIndex]);
     }
 
-    // (This function is called from the object's delete callback. It means that ModuleCollectionHandleMemory
-    // has already been deleted and must not be deleted again. It is not possible to call this function
-    // directly. It must always be called from the object's delete callback.)
+    WdfWaitLockRelease(parallelOpen->Lock);
+
+    // Work items stop when no Module can be opened. The last one to stop finds that
+    // all Modules are done or, after a Module fails, that no Module is running.
     //
-    moduleCollectionHandle = NULL;
+    for (;;)
+    {
+        WdfWaitLockAcquire(parallelOpen->Lock,
+                           NULL);
+        done = (0 == parallelOpen->NumberOfWorkItemsActive);
+        WdfWaitLockRelease(parallelOpen->Lock);
+        if (done)
+        {
+            break;
+        }
 
-Exit:
-    ;
+        DMF_Portable_EventWaitForSingleObject(&parallelOpen->WorkItemsDoneEvent,
+                                              NULL,
+                                              FALSE);
+    }
 
-    FuncExitVoid(DMF_TRACE);
-}
+    // No work item can be enqueued again now. Make sure the last ones have returned
+    // before the next dispatch or before cleanup deletes this state.
+    //
+    for (workItemIndex = 0; workItemIndex < parallelOpen->NumberOfWorkItems; workItemIndex++)
+    {
+        WdfWorkItemFlush(parallelOpen->WorkItems[workItemIndex]);
+    }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-// Module Collection Dispatch Function Helpers
-//
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+    ntStatus = parallelOpen->NtStatus;
 
-// Types for Module Collection functions that have common signatures so that the common coding pattern
-// does not need to be duplicated.
-//
-typedef NTSTATUS (*ModuleCollectionHandleDispatchFunctionNtStatusType)(_In_ DMFMODULE DmfModule);
-typedef VOID (*ModuleCollectionHandleDispatchFunctionVoidType)(_In_ DMFMODULE DmfModule);
+    return ntStatus;
+}
+#pragma code_seg()
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
 NTSTATUS
-DMF_ModuleCollectionDispatchNtStatus(
+DMF_ModuleCollectionDispatchOpen(
     _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
-    _In_ ModuleCollectionHandleDispatchFunctionNtStatusType ModuleCollectionDispatchFunction
+    _In_ ModuleCollectionOpenFunctionType ModuleCollectionOpenFunction,
+    _In_opt_ VOID* Context,
+    _In_ BOOLEAN AllowParallelOpen,
+    _In_z_ const CHAR* CallbackName
     )
 /*++
 
 Routine Description:
 
-    Given a DMF_MODULE_COLLECTION and a callback function that takes a DMFMODULE and returns NTSTATUS,
-    call the callback function for every Module associated with the given DMF_MODULE_COLLECTION.
+    Given a DMF_MODULE_COLLECTION and a function that opens (or otherwise starts) a Module and
+    its Child Modules, call the function for every Module associated with the given DMF_MODULE_COLLECTION.
+    Modules are called one after the other unless parallel open is allowed and at least one
+    Module sets DMF_MODULE_ATTRIBUTES.OpenInParallel.
+    The time each Module takes is traced so that the time the device takes to start can be broken
+    down by Module.
 
 Arguments:
 
     ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
-    ModuleCollectionDispatchFunction - The given callback function to call.
+    ModuleCollectionOpenFunction - The given function to call.
+    Context - Arguments of the WDF callback passed to ModuleCollectionOpenFunction.
+    AllowParallelOpen - Indicates if Modules may be opened in parallel during this WDF callback.
+    CallbackName - Name of the WDF callback (for tracing).
 
 Return Value:
 
-    NTSTATUS
+    STATUS_SUCCESS if every call succeeds. Otherwise, the NTSTATUS of the first call that fails.
 
 --*/
 {
-    LONG driverModuleIndex;
     NTSTATUS ntStatus;
+    LONG driverModuleIndex;
+    LONGLONG startTime;
+    BOOLEAN parallelOpen;
 
-    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p %s", ModuleCollectionHandle, CallbackName);
 
     ntStatus = STATUS_SUCCESS;
+    startTime = DMF_DiagnosticsTimeGet(NULL);
+    parallelOpen = AllowParallelOpen && (ModuleCollectionHandle->ParallelOpen != NULL);
 
-    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    if (parallelOpen)
     {
-        DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
+        ntStatus = DMF_ModuleCollectionParallelOpen(ModuleCollectionHandle,
+                                                    ModuleCollectionOpenFunction,
+                                                    Context);
 
-        dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        // NOTE: By design, this function will exit as soon as a Module returns an error.
-        //
-        ntStatus = ModuleCollectionDispatchFunction(dmfModule);
-        if (! NT_SUCCESS(ntStatus))
+        for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
         {
-            goto Exit;
+            DMF_OBJECT* dmfObject;
+            DMF_MODULE_COLLECTION_OPEN_NODE* node;
+
+            dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+            node = &ModuleCollectionHandle->ParallelOpen->Nodes[driverModuleIndex];
+            if (node->OpenState != ModuleCollectionOpenState_Completed)
+            {
+                continue;
+            }
+            TraceInformation(DMF_TRACE, "%s [%s] StartUs=%I64d DurationUs=%I64d OpenInParallel=%d", CallbackName, dmfObject->ClientModuleInstanceName, node->StartNs / 1000, node->DurationNs / 1000, node->OpenInParallel);
+        }
+    }
+    else
+    {
+        for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+        {
+            DMF_OBJECT* dmfObject;
+            DMFMODULE dmfModule;
+            ULONGLONG moduleStartNs;
+
+            dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+            DmfAssert(dmfObject != NULL);
+            dmfModule = DMF_ObjectToModule(dmfObject);
+            moduleStartNs = DMF_DiagnosticsElapsedNanosecondsGet(startTime);
+            // NOTE: By design, this function will exit as soon as a Module returns an error.
+            //
+            ntStatus = ModuleCollectionOpenFunction(dmfModule,
+                                                    Context);
+            TraceInformation(DMF_TRACE, "%s [%s] StartUs=%I64d DurationUs=%I64d", CallbackName, dmfObject->ClientModuleInstanceName, moduleStartNs / 1000, (DMF_DiagnosticsElapsedNanosecondsGet(startTime) - moduleStartNs) / 1000);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "%s dmfObject=0x%p ntStatus=%!STATUS!", CallbackName, dmfObject, ntStatus);
+                goto Exit;
+            }
         }
     }
 
 Exit:
 
-    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p ntStatus=%!STATUS!", ModuleCollectionHandle, ntStatus);
+    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p %s ElapsedUs=%I64d parallelOpen=%d ntStatus=%!STATUS!", ModuleCollectionHandle, CallbackName, DMF_DiagnosticsElapsedNanosecondsGet(startTime) / 1000, parallelOpen, ntStatus);
 
     return ntStatus;
 }
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
-VOID
-DMF_ModuleCollectionDispatchVoid(
-    _In_ DMF_MODULE_COLLECTION* ModuleCollectionHandle,
-    _In_ ModuleCollectionHandleDispatchFunctionVoidType ModuleCollectionDispatchFunction
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Module Collection Dispatch Functions
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_ModuleCollectionPrepareHardwareOpen(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_ VOID* Context
     )
 /*++
 
 Routine Description:
 
-    Given a DMF_MODULE_COLLECTION and a callback function that takes a DMFMODULE and returns nothing,
-    call the callback function for every Module associated with the given DMF_MODULE_COLLECTION.
+    Dispatch EvtDevicePrepareHardware to a Module and its Child Modules.
 
 Arguments:
 
-    ModuleCollectionHandle - The list of the Client Driver's instantiated Modules.
-    ModuleCollectionDispatchFunction - The given callback function to call.
+    DmfModule - The given Module.
+    Context - MODULE_COLLECTION_PREPARE_HARDWARE_CONTEXT.
 
 Return Value:
 
-    NTSTATUS
+    NTSTATUS of DMF_Module_PrepareHardware().
 
 --*/
 {
-    LONG driverModuleIndex;
-
-    FuncEntryArguments(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+    MODULE_COLLECTION_PREPARE_HARDWARE_CONTEXT* prepareHardwareContext;
 
-    for (driverModuleIndex = 0; driverModuleIndex < ModuleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
-    {
-        DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
+    PAGED_CODE();
 
-        dmfObject = ModuleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        ModuleCollectionDispatchFunction(dmfModule);
-    }
+    prepareHardwareContext = (MODULE_COLLECTION_PREPARE_HARDWARE_CONTEXT*)Context;
+    DmfAssert(prepareHardwareContext != NULL);
 
-    FuncExit(DMF_TRACE, "ModuleCollectionHandle=0x%p", ModuleCollectionHandle);
+    return DMF_Module_PrepareHardware(DmfModule,
+                                      prepareHardwareContext->ResourcesRaw,
+                                      prepareHardwareContext->ResourcesTranslated);
 }
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-// Module Collection Dispatch Functions
-//
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//
+#pragma code_seg()
 
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -737,7 +1723,7 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
-    LONG driverModuleIndex;
+    MODULE_COLLECTION_PREPARE_HARDWARE_CONTEXT prepareHardwareContext;
 
     PAGED_CODE();
 
@@ -760,23 +1746,15 @@ Return Value:
         goto Exit;
     }
 
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
-    {
-        DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
-
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        ntStatus = DMF_Module_PrepareHardware(dmfModule,
-                                              ResourcesRaw,
-                                              ResourcesTranslated);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ModulePrepareHardware dmfObject=0x%p ntStatus=%!STATUS!", dmfObject, ntStatus);
-            goto Exit;
-        }
-    }
+    // Modules that set OpenInParallel may be opened at the same time as other Modules.
+    //
+    prepareHardwareContext.ResourcesRaw = ResourcesRaw;
+    prepareHardwareContext.ResourcesTranslated = ResourcesTranslated;
+    ntStatus = DMF_ModuleCollectionDispatchOpen(moduleCollectionHandle,
+                                                DMF_ModuleCollectionPrepareHardwareOpen,
+                                                &prepareHardwareContext,
+                                                TRUE,
+                                                "ModulePrepareHardware");
 
 Exit:
 
@@ -891,6 +1869,39 @@ Exit:
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_ModuleCollectionD0EntryOpen(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_ VOID* Context
+    )
+/*++
+
+Routine Description:
+
+    Dispatch EvtDeviceD0Entry to a Module and its Child Modules.
+
+Arguments:
+
+    DmfModule - The given Module.
+    Context - MODULE_COLLECTION_D0ENTRY_CONTEXT.
+
+Return Value:
+
+    NTSTATUS of DMF_Module_D0Entry().
+
+--*/
+{
+    MODULE_COLLECTION_D0ENTRY_CONTEXT* d0EntryContext;
+
+    d0EntryContext = (MODULE_COLLECTION_D0ENTRY_CONTEXT*)Context;
+    DmfAssert(d0EntryContext != NULL);
+
+    return DMF_Module_D0Entry(DmfModule,
+                              d0EntryContext->PreviousState);
+}
+
 // D0Entry/D0Exit code must not be pageable even though it runs at PASSIVE_LEVEL.
 //
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -920,7 +1931,7 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
-    LONG driverModuleIndex;
+    MODULE_COLLECTION_D0ENTRY_CONTEXT d0EntryContext;
 
     FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p PreviousState=%d", DmfCollection, PreviousState);
 
@@ -941,23 +1952,16 @@ Return Value:
         goto Exit;
     }
 
+    // Modules are always opened one after the other in D0Entry because this code runs
+    // in the power up path. It must not depend on system work items.
+    //
     DmfAssert(moduleCollectionHandle->NumberOfClientDriverDmfModules > 0);
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
-    {
-        DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
-
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
-        DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        ntStatus = DMF_Module_D0Entry(dmfModule,
-                                      PreviousState);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ModuleD0Entry dmfObject=0x%p ntStatus=%!STATUS!", dmfObject, ntStatus);
-            goto Exit;
-        }
-    }
+    d0EntryContext.PreviousState = PreviousState;
+    ntStatus = DMF_ModuleCollectionDispatchOpen(moduleCollectionHandle,
+                                                DMF_ModuleCollectionD0EntryOpen,
+                                                &d0EntryContext,
+                                                FALSE,
+                                                "ModuleD0Entry");
 
 Exit:
 
@@ -1254,8 +2258,9 @@ Return Value:
 
 --*/
 {
-    LONG driverModuleIndex;
+    LONG routeIndex;
     BOOLEAN handled;
+    DMF_MODULE_COLLECTION_ROUTE* route;
 
     FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p Request=0x%p", DmfCollection, Request);
 
@@ -1263,32 +2268,38 @@ Return Value:
 
     handled = FALSE;
 
-    // If no Module in the Collection supports this entry point,
-    // then do not iterate through Collection and Child Modules since they will do nothing.
-    // If at least one Module in the Collection supports this entry point,
-    // then it is necessary to iterate though the Collection and Child Modules.
-    // In that case, the Generic handlers will be called for Module that do not specifically support this entry point
-    // (so that validation can happen).
+    // The route only lists the Modules (including Child Modules) that implement this entry point,
+    // in the order the Module tree is walked. Modules that use the Generic handler would
+    // only return FALSE so they are not called.
     //
-    if (! moduleCollectionHandle->DmfCallbacksWdfCheck.ModuleQueueIoReadImplemented)
+    route = &moduleCollectionHandle->Routes[ModuleCollectionRoute_QueueIoRead];
+    if (0 == route->NumberOfDmfObjects)
     {
         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection implement ModuleQueueIoRead handled=%d", handled);
         goto Exit;
     }
 
-    DmfAssert(moduleCollectionHandle->NumberOfClientDriverDmfModules > 0);
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    for (routeIndex = 0; routeIndex < route->NumberOfDmfObjects; routeIndex++)
     {
         DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
 
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        dmfObject = route->DmfObjects[routeIndex];
         DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        handled = DMF_Module_QueueIoRead(dmfModule,
-                                         Queue,
-                                         Request,
-                                         Length);
+
+        if ((dmfObject->OpenDeferredDuring != ModuleOpenedDuringType_Invalid) &&
+            (! NT_SUCCESS(DMF_ModuleDeferredOpen(DMF_ObjectToModule(dmfObject)))))
+        {
+            // This Module's open was deferred until first use and it cannot be opened now.
+            // Since such Modules only exist when Requests are presented at PASSIVE_LEVEL, this only
+            // happens when the Module's Open fails or the Module is being closed.
+            //
+            continue;
+        }
+
+        handled = (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleQueueIoRead)(DMF_ObjectToModule(dmfObject),
+                                                                                Queue,
+                                                                                Request,
+                                                                                Length);
         if (handled)
         {
             // The Module handled the call...no need to continue dispatching.
@@ -1334,8 +2345,9 @@ Return Value:
 
 --*/
 {
-    LONG driverModuleIndex;
+    LONG routeIndex;
     BOOLEAN handled;
+    DMF_MODULE_COLLECTION_ROUTE* route;
 
     FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p Request=0x%p", DmfCollection, Request);
 
@@ -1343,32 +2355,38 @@ Return Value:
 
     handled = FALSE;
 
-    // If no Module in the Collection supports this entry point,
-    // then do not iterate through Collection and Child Modules since they will do nothing.
-    // If at least one Module in the Collection supports this entry point,
-    // then it is necessary to iterate though the Collection and Child Modules.
-    // In that case, the Generic handlers will be called for Module that do not specifically support this entry point
-    // (so that validation can happen).
+    // The route only lists the Modules (including Child Modules) that implement this entry point,
+    // in the order the Module tree is walked. Modules that use the Generic handler would
+    // only return FALSE so they are not called.
     //
-    if (! moduleCollectionHandle->DmfCallbacksWdfCheck.ModuleQueueIoWriteImplemented)
+    route = &moduleCollectionHandle->Routes[ModuleCollectionRoute_QueueIoWrite];
+    if (0 == route->NumberOfDmfObjects)
     {
         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection implement ModuleQueueIoWrite handled=%d", handled);
         goto Exit;
     }
 
-    DmfAssert(moduleCollectionHandle->NumberOfClientDriverDmfModules > 0);
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    for (routeIndex = 0; routeIndex < route->NumberOfDmfObjects; routeIndex++)
     {
         DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
 
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        dmfObject = route->DmfObjects[routeIndex];
         DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        handled = DMF_Module_QueueIoWrite(dmfModule,
-                                          Queue,
-                                          Request,
-                                          Length);
+
+        if ((dmfObject->OpenDeferredDuring != ModuleOpenedDuringType_Invalid) &&
+            (! NT_SUCCESS(DMF_ModuleDeferredOpen(DMF_ObjectToModule(dmfObject)))))
+        {
+            // This Module's open was deferred until first use and it cannot be opened now.
+            // Since such Modules only exist when Requests are presented at PASSIVE_LEVEL, this only
+            // happens when the Module's Open fails or the Module is being closed.
+            //
+            continue;
+        }
+
+        handled = (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleQueueIoWrite)(DMF_ObjectToModule(dmfObject),
+                                                                                 Queue,
+                                                                                 Request,
+                                                                                 Length);
         if (handled)
         {
             // The Module handled the call...no need to continue dispatching.
@@ -1418,8 +2436,9 @@ Return Value:
 
 --*/
 {
-    LONG driverModuleIndex;
+    LONG routeIndex;
     BOOLEAN handled;
+    DMF_MODULE_COLLECTION_ROUTE* route;
 
     FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p Request=0x%p", DmfCollection, Request);
 
@@ -1427,34 +2446,63 @@ Return Value:
 
     handled = FALSE;
 
-    // If no Module in the Collection supports this entry point,
-    // then do not iterate through Collection and Child Modules since they will do nothing.
-    // If at least one Module in the Collection supports this entry point,
-    // then it is necessary to iterate though the Collection and Child Modules.
-    // In that case, the Generic handlers will be called for Module that do not specifically support this entry point
-    // (so that validation can happen).
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    // Diagnostics are queried using an IOCTL sent to the Client Driver's device.
+    //
+    handled = DMF_DiagnosticsDeviceIoControl(moduleCollectionHandle,
+                                             Request,
+                                             IoControlCode);
+    if (handled)
+    {
+        goto Exit;
+    }
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
+    // The route only lists the Modules (including Child Modules) that implement this entry point,
+    // in the order the Module tree is walked. Modules that use the Generic handler would
+    // only return FALSE so they are not called.
     //
-    if (! moduleCollectionHandle->DmfCallbacksWdfCheck.ModuleDeviceIoControlImplemented)
+    route = &moduleCollectionHandle->Routes[ModuleCollectionRoute_DeviceIoControl];
+    if (0 == route->NumberOfDmfObjects)
     {
         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection implement ModuleDeviceIoControl handled=%d", handled);
         goto Exit;
     }
 
-    DmfAssert(moduleCollectionHandle->NumberOfClientDriverDmfModules > 0);
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    if ((route->IoctlInterestDeclared) &&
+        (! DMF_IoctlInterestIsSet(&route->IoctlInterest,
+                                  IoControlCode)))
+    {
+        // None of the Modules handles this IOCTL. Return without dispatching it so that
+        // a filter driver sends it down the stack right away.
+        //
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection handle IoControlCode=0x%X handled=%d", IoControlCode, handled);
+        goto Exit;
+    }
+
+    for (routeIndex = 0; routeIndex < route->NumberOfDmfObjects; routeIndex++)
     {
         DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
 
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        dmfObject = route->DmfObjects[routeIndex];
         DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        handled = DMF_Module_DeviceIoControl(dmfModule,
-                                             Queue,
-                                             Request,
-                                             OutputBufferLength,
-                                             InputBufferLength,
-                                             IoControlCode);
+
+        if ((dmfObject->OpenDeferredDuring != ModuleOpenedDuringType_Invalid) &&
+            (! NT_SUCCESS(DMF_ModuleDeferredOpen(DMF_ObjectToModule(dmfObject)))))
+        {
+            // This Module's open was deferred until first use and it cannot be opened now.
+            // Since such Modules only exist when Requests are presented at PASSIVE_LEVEL, this only
+            // happens when the Module's Open fails or the Module is being closed.
+            //
+            continue;
+        }
+
+        handled = (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleDeviceIoControl)(DMF_ObjectToModule(dmfObject),
+                                                                                    Queue,
+                                                                                    Request,
+                                                                                    OutputBufferLength,
+                                                                                    InputBufferLength,
+                                                                                    IoControlCode);
         if (handled)
         {
             // The Module handled the call...no need to continue dispatching.
@@ -1504,8 +2552,9 @@ Return Value:
 
 --*/
 {
-    LONG driverModuleIndex;
+    LONG routeIndex;
     BOOLEAN handled;
+    DMF_MODULE_COLLECTION_ROUTE* route;
 
     FuncEntryArguments(DMF_TRACE, "DmfCollection=0x%p Request=0x%p", DmfCollection, Request);
 
@@ -1513,34 +2562,51 @@ Return Value:
 
     handled = FALSE;
 
-    // If no Module in the Collection supports this entry point,
-    // then do not iterate through Collection and Child Modules since they will do nothing.
-    // If at least one Module in the Collection supports this entry point,
-    // then it is necessary to iterate though the Collection and Child Modules.
-    // In that case, the Generic handlers will be called for Module that do not specifically support this entry point
-    // (so that validation can happen).
+    // The route only lists the Modules (including Child Modules) that implement this entry point,
+    // in the order the Module tree is walked. Modules that use the Generic handler would
+    // only return FALSE so they are not called.
     //
-    if (! moduleCollectionHandle->DmfCallbacksWdfCheck.ModuleInternalDeviceIoControlImplemented)
+    route = &moduleCollectionHandle->Routes[ModuleCollectionRoute_InternalDeviceIoControl];
+    if (0 == route->NumberOfDmfObjects)
     {
         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection implement ModuleInternalDeviceIoControl handled=%d", handled);
         goto Exit;
     }
 
-    DmfAssert(moduleCollectionHandle->NumberOfClientDriverDmfModules > 0);
-    for (driverModuleIndex = 0; driverModuleIndex < moduleCollectionHandle->NumberOfClientDriverDmfModules; driverModuleIndex++)
+    if ((route->IoctlInterestDeclared) &&
+        (! DMF_IoctlInterestIsSet(&route->IoctlInterest,
+                                  IoControlCode)))
+    {
+        // None of the Modules handles this IOCTL. Return without dispatching it so that
+        // a filter driver sends it down the stack right away.
+        //
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No Modules in Collection handle IoControlCode=0x%X handled=%d", IoControlCode, handled);
+        goto Exit;
+    }
+
+    for (routeIndex = 0; routeIndex < route->NumberOfDmfObjects; routeIndex++)
     {
         DMF_OBJECT* dmfObject;
-        DMFMODULE dmfModule;
 
-        dmfObject = moduleCollectionHandle->ClientDriverDmfModules[driverModuleIndex];
+        dmfObject = route->DmfObjects[routeIndex];
         DmfAssert(dmfObject != NULL);
-        dmfModule = DMF_ObjectToModule(dmfObject);
-        handled = DMF_Module_InternalDeviceIoControl(dmfModule,
-                                                     Queue,
-                                                     Request,
-                                                     OutputBufferLength,
-                                                     InputBufferLength,
-                                                     IoControlCode);
+
+        if ((dmfObject->OpenDeferredDuring != ModuleOpenedDuringType_Invalid) &&
+            (! NT_SUCCESS(DMF_ModuleDeferredOpen(DMF_ObjectToModule(dmfObject)))))
+        {
+            // This Module's open was deferred until first use and it cannot be opened now.
+            // Since such Modules only exist when Requests are presented at PASSIVE_LEVEL, this only
+            // happens when the Module's Open fails or the Module is being closed.
+            //
+            continue;
+        }
+
+        handled = (dmfObject->ModuleDescriptor.CallbacksWdf->ModuleInternalDeviceIoControl)(DMF_ObjectToModule(dmfObject),
+                                                                                            Queue,
+                                                                                            Request,
+                                                                                            OutputBufferLength,
+                                                                                            InputBufferLength,
+                                                                                            IoControlCode);
         if (handled)
         {
             // The Module handled the call...no need to continue dispatching.
@@ -1658,6 +2724,35 @@ Exit:
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_ModuleCollectionSelfManagedIoInitOpen(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_ VOID* Context
+    )
+/*++
+
+Routine Description:
+
+    Dispatch EvtDeviceSelfManagedIoInit to a Module and its Child Modules.
+
+Arguments:
+
+    DmfModule - The given Module.
+    Context - Not used.
+
+Return Value:
+
+    NTSTATUS of DMF_Module_SelfManagedIoInit().
+
+--*/
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    return DMF_Module_SelfManagedIoInit(DmfModule);
+}
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -1704,8 +2799,13 @@ Return Value:
         goto Exit;
     }
 
-    ntStatus = DMF_ModuleCollectionDispatchNtStatus(moduleCollectionHandle,
-                                                    DMF_Module_SelfManagedIoInit);
+    // Modules that set OpenInParallel may be started at the same time as other Modules.
+    //
+    ntStatus = DMF_ModuleCollectionDispatchOpen(moduleCollectionHandle,
+                                                DMF_ModuleCollectionSelfManagedIoInitOpen,
+                                                NULL,
+                                                TRUE,
+                                                "ModuleSelfManagedIoInit");
 
 Exit:
 
@@ -3550,6 +4650,22 @@ Return Value:
         //
         DMF_ModuleCollectionHandlePropagate(moduleCollectionHandle,
                                             moduleCollectionHandle->NumberOfClientDriverDmfModules);
+
+        // Now that the tree of Modules is complete, build the tables used to dispatch Requests.
+        //
+        ntStatus = DMF_ModuleCollectionRoutesBuild(moduleCollectionHandle);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+
+        // Determine the order Modules are opened in.
+        //
+        ntStatus = DMF_ModuleCollectionParallelOpenCreate(moduleCollectionHandle);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
     }
 
     if (ModuleCollectionConfig->DmfPrivate.BranchTrackEnabled)
@@ -3788,6 +4904,7 @@ Return Value:
     PDMFDEVICE_INIT dmfDeviceInit;
     BOOLEAN isControlDevice;
     BOOLEAN isFilterDriver;
+    BOOLEAN isPassiveLevel;
 
     PAGED_CODE();
 
@@ -3816,6 +4933,7 @@ Return Value:
     dmfEventCallbacks = DMF_DmfDeviceInitDmfEventCallbacksGet(dmfDeviceInit);
     isControlDevice = DMF_DmfDeviceInitIsControlDevice(dmfDeviceInit);
     isFilterDriver = DMF_DmfDeviceInitIsFilterDriver(dmfDeviceInit);
+    isPassiveLevel = DMF_DmfDeviceInitIsPassiveLevel(dmfDeviceInit);
 
     // If Default queue is not created by the client, then create one here.
     // Module which implement IoQueue callbacks will need a default queue.
@@ -3869,6 +4987,7 @@ Return Value:
     }
 
     dmfDeviceContext->IsFilterDevice = isFilterDriver;
+    dmfDeviceContext->IsPassiveLevel = isPassiveLevel;
 
     // Prepare to create a Module Collection.
     //
@@ -3926,6 +5045,16 @@ Return Value:
     moduleCollectionHandle->ClientDevice = Device;
     moduleCollectionHandle->ManualDestroyCallbackIsPending = FALSE;
 
+#if defined(DMF_DIAGNOSTICS_ENABLED)
+    // Allow applications to find this device to query diagnostics.
+    // (Control devices can only be opened using a symbolic link.)
+    //
+    if (! isControlDevice)
+    {
+        DMF_DiagnosticsDeviceInterfaceCreate(Device);
+    }
+#endif // defined(DMF_DIAGNOSTICS_ENABLED)
+
 Exit:
 
     dmfDeviceInit = NULL;
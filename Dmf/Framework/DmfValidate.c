@@ -531,6 +531,48 @@ Return Value:
               (ModuleState_Closed == DmfObject->ModuleState));
 }
 
+static
+VOID
+DMF_HandleValidate_ModuleDeferredOpen(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Called when a Module Method is called for a Module whose open has been deferred until first
+    use (DMF_MODULE_ATTRIBUTES.OpenOnFirstUse). Methods require the Module to be open, so the Module
+    is opened now. If it cannot be opened (for example, because the Method is called at DISPATCH_LEVEL
+    or the Module's Open failed), calling the Method is a fatal error.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+
+Return Value:
+
+    None. Failure causes an assert to trigger.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_OBJECT* dmfObject;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+
+    // The Module's Open may call its own Methods while the Module is opened on first use.
+    //
+    if (dmfObject->OpenDeferredThreadId != DmfGetCurrentThreadId())
+    {
+        ntStatus = DMF_ModuleDeferredOpen(DmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Module Method called for Module that cannot be opened on first use: DmfModule=0x%p [%s] ntStatus=%!STATUS!", DmfModule, dmfObject->ClientModuleInstanceName, ntStatus);
+            DmfVerifierAssert("Module Method called for Module that cannot be opened on first use", FALSE);
+        }
+    }
+}
+
 VOID
 DMF_HandleValidate_ModuleMethod(
     _In_ DMFMODULE DmfModule
@@ -560,6 +602,10 @@ Return Value:
 #if defined(DEBUG)
     DMF_OBJECT* dmfObject;
     dmfObject = DMF_ModuleToObject(DmfModule);
+    if (dmfObject->OpenDeferredDuring != ModuleOpenedDuringType_Invalid)
+    {
+        DMF_HandleValidate_ModuleDeferredOpen(DmfModule);
+    }
     if (DMF_IsObjectTypeOpenNotify(dmfObject))
     {
         DMF_HandleValidate_IsAvailable(dmfObject);
@@ -571,6 +617,197 @@ Return Value:
 #endif // defined(DEBUG)
 }
 
+// Module type tags of Modules whose entry is not used by another Module (see DmfModule.h).
+//
+DMF_MODULE_TYPE_TAG_ENTRY DmfModuleTypeTagTable[DMF_MODULE_TYPE_TAG_TABLE_SIZE];
+
+VOID*
+DMF_ModuleTypeTagObjectGet(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Returns the Module type tag stored in the given Module's DMF_OBJECT. DMF_ModuleTypeTagGet()
+    calls this function for Modules that do not have an entry in DmfModuleTypeTagTable.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+
+Return Value:
+
+    The Module type tag (see DMF_MODULE_TYPE_TAG).
+
+--*/
+{
+    return DMF_ModuleToObject(DmfModule)->ModuleTypeTag;
+}
+
+VOID
+DMF_ModuleTypeTagRegister(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Claim the entry of DmfModuleTypeTagTable the given Module's handle hashes to so that
+    DMF_ModuleTypeTagGet() does not need to call WDF. If another Module uses the entry, the
+    given Module's tag is read from its DMF_OBJECT instead.
+    NOTE: This is called before the handle is returned to the Client, so the entry is set
+          before any Method of the Module can be called.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_MODULE_TYPE_TAG_ENTRY* entry;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    entry = &DmfModuleTypeTagTable[DMF_ModuleTypeTagIndexGet(DmfModule)];
+
+    if (NULL == InterlockedCompareExchangePointer((VOID* volatile*)&entry->DmfModule,
+                                                  DmfModule,
+                                                  NULL))
+    {
+        entry->ModuleTypeTag = dmfObject->ModuleTypeTag;
+    }
+}
+
+VOID
+DMF_ModuleTypeTagOpenDeferredSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ BOOLEAN OpenDeferred
+    )
+/*++
+
+Routine Description:
+
+    Set the type tag of the given Module depending on whether its open is deferred until first use.
+    While it is, the tag does not match the tag Module Methods expect so that DMFMODULE_VALIDATE_IN_METHOD
+    calls DMF_HandleValidate_ModuleTypeMismatch() which opens the Module.
+    NOTE: Caller must hold the Module's OpenDeferredLock.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+    OpenDeferred - TRUE if the Module's open is deferred until first use.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_OBJECT* dmfObject;
+    DMF_MODULE_TYPE_TAG_ENTRY* entry;
+    VOID* moduleTypeTag;
+
+    dmfObject = DMF_ModuleToObject(DmfModule);
+    entry = &DmfModuleTypeTagTable[DMF_ModuleTypeTagIndexGet(DmfModule)];
+
+    moduleTypeTag = dmfObject->ModuleDescriptor.ModuleTypeTag;
+    if (OpenDeferred)
+    {
+        moduleTypeTag = DMF_MODULE_TYPE_TAG_OPEN_DEFERRED(moduleTypeTag);
+    }
+
+    dmfObject->ModuleTypeTag = moduleTypeTag;
+    if (entry->DmfModule == DmfModule)
+    {
+        entry->ModuleTypeTag = moduleTypeTag;
+    }
+}
+
+VOID
+DMF_ModuleTypeTagUnregister(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Release the entry of DmfModuleTypeTagTable the given Module claimed, if any.
+    NOTE: This is called when the Module is destroyed, before its handle can be reused.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_TYPE_TAG_ENTRY* entry;
+
+    entry = &DmfModuleTypeTagTable[DMF_ModuleTypeTagIndexGet(DmfModule)];
+
+    if (entry->DmfModule == DmfModule)
+    {
+        entry->ModuleTypeTag = NULL;
+        InterlockedExchangePointer((VOID* volatile*)&entry->DmfModule,
+                                   NULL);
+    }
+}
+
+VOID
+DMF_HandleValidate_ModuleTypeMismatch(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ModuleTypeTag
+    )
+/*++
+
+Routine Description:
+
+    Called by DMFMODULE_VALIDATE_IN_METHOD when the type tag of the given Module is not the tag
+    of the Module type the Method expects.
+    If the Module's open is deferred until first use, the Module is opened now.
+    Otherwise, the Method is called using another Module's (different type of Module) handle.
+    Doing so is always a fatal error.
+    This function is only in the path of correctly made Method calls the first time a Module
+    whose open is deferred until first use is used.
+
+Arguments:
+
+    DmfModule - The given Module handle.
+    ModuleTypeTag - The tag of the Module type the Method expects.
+
+Return Value:
+
+    None. Failure causes an assert to trigger.
+
+--*/
+{
+    VOID* moduleTypeTag;
+
+    moduleTypeTag = DMF_ModuleTypeTagObjectGet(DmfModule);
+    if (moduleTypeTag == DMF_MODULE_TYPE_TAG_OPEN_DEFERRED(ModuleTypeTag))
+    {
+        DMF_HandleValidate_ModuleDeferredOpen(DmfModule);
+    }
+    else if (moduleTypeTag != ModuleTypeTag)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Module Method called with handle of another Module type: DmfModule=0x%p", DmfModule);
+        DmfVerifierAssert("Module Method called with handle of another Module type", FALSE);
+    }
+    else
+    {
+        // The Module has been opened on first use since the caller read its tag.
+        //
+    }
+}
+
 VOID
 DMF_ObjectValidate(
     _In_ DMFMODULE DmfModule
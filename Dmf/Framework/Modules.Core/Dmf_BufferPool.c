@@ -1866,6 +1866,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferPool);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     clientBuffer = BufferPool_BufferGet(DmfModule);
     if (NULL == clientBuffer)
     {
@@ -1897,6 +1899,8 @@ Return Value:
 
 Exit:
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -1941,6 +1945,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferPool);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     clientBuffer = BufferPool_BufferGet(DmfModule);
     if (NULL == clientBuffer)
     {
@@ -1964,6 +1970,8 @@ Return Value:
 
 Exit:
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -2146,6 +2154,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
                                             BufferPool);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     // Given the Client Buffer, get the associated meta data.
@@ -2187,6 +2197,8 @@ Return Value:
 
     DMF_ModuleUnlock(DmfModule);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -293,12 +293,16 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolConsumer,
                                   ClientBuffer,
                                   ClientBufferContext);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -385,11 +389,15 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolConsumer,
                        ClientBuffer);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -476,12 +484,16 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolProducer,
                                   ClientBuffer,
                                   ClientBufferContext);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -567,11 +579,15 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  BufferQueue);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolProducer,
                        ClientBuffer);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     FuncExitVoid(DMF_TRACE);
 }
 
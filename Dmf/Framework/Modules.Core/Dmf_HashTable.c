@@ -469,7 +469,7 @@ Return Value:
 
     UNREFERENCED_PARAMETER(DmfModule);
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(DMF_ModuleIsLockedExclusive(DmfModule));
 
     DmfAssert(NewEntryIndex != NULL);
 
@@ -542,7 +542,7 @@ Return Value:
 
     DmfAssert(DataEntry != NULL);
 
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+    DmfAssert(DMF_ModuleIsLockedExclusive(DmfModule));
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
@@ -862,7 +862,7 @@ Return Value:
     DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_HashTable,
                                             HashTable,
                                             DMF_CONTEXT_HashTable,
-                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPTIONS_DISPATCH | DMF_MODULE_OPTIONS_READER_WRITER_LOCK,
                                             DMF_MODULE_OPEN_OPTION_OPEN_Create);
 
     dmfModuleDescriptor_HashTable.CallbacksDmf = &dmfCallbacksDmf_HashTable;
@@ -921,9 +921,10 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    // Synchronize with calls to add items to table.
+    // Synchronize with calls to add items to table. Enumerations only read the table
+    // so they may run at the same time.
     //
-    DMF_ModuleLock(DmfModule);
+    DMF_ModuleLockShared(DmfModule);
 
     for (entryIndex = 0; entryIndex < moduleContext->DataEntriesAllocated; ++entryIndex)
     {
@@ -940,7 +941,7 @@ Return Value:
         }
     }
 
-    DMF_ModuleUnlock(DmfModule);
+    DMF_ModuleUnlockShared(DmfModule);
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -1128,7 +1129,9 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  HashTable);
 
-    DMF_ModuleLock(DmfModule);
+    // Reads do not modify the table so they may run at the same time.
+    //
+    DMF_ModuleLockShared(DmfModule);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
@@ -1160,7 +1163,7 @@ Return Value:
 
 Exit:
 
-    DMF_ModuleUnlock(DmfModule);
+    DMF_ModuleUnlockShared(DmfModule);
 
     return ntStatus;
 }
@@ -1050,8 +1050,24 @@ Return Value:
     if (! NT_SUCCESS(ntStatus))
     {
         TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
     }
 
+    // Tell DMF which IOCTLs this Module handles so that other IOCTLs are not dispatched to it.
+    // When KernelModeRequestsOnly is set, this Module rejects every User-mode IOCTL so it
+    // must see all of them.
+    //
+    if (! moduleConfig->KernelModeRequestsOnly)
+    {
+        for (ULONG tableIndex = 0; tableIndex < moduleConfig->IoctlRecordCount; tableIndex++)
+        {
+            DMF_ModuleIoctlInterestAdd(*DmfModule,
+                                       (ULONG)(moduleConfig->IoctlRecords[tableIndex].IoctlCode));
+        }
+    }
+
+Exit:
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return(ntStatus);
@@ -1024,6 +1024,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DMF_ModuleLock(DmfModule);
@@ -1036,6 +1038,8 @@ Return Value:
 
     DMF_ModuleUnlock(DmfModule);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     return ntStatus;
 }
 
@@ -1428,6 +1432,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  RingBuffer);
 
+    DMF_METHOD_INSTRUMENTATION_BEGIN(DmfModule);
+
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DMF_ModuleLock(DmfModule);
@@ -1440,6 +1446,8 @@ Return Value:
 
     DMF_ModuleUnlock(DmfModule);
 
+    DMF_METHOD_INSTRUMENTATION_END(DmfModule);
+
     return ntStatus;
 }
 
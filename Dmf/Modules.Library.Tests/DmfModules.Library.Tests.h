@@ -54,6 +54,13 @@ extern "C"
 #include "Dmf_Tests_Pdo.h"
 #include "Dmf_Tests_String.h"
 #include "Dmf_Tests_AlertableSleep.h"
+#include "Dmf_Tests_Rundown.h"
+#include "Dmf_Tests_FrameParser.h"
+#include "Dmf_Tests_ModuleValidation.h"
+#include "Dmf_Tests_ModuleCreate.h"
+#include "Dmf_Tests_Interface.h"
+#include "Dmf_Tests_ParallelOpen.h"
+#include "Dmf_Tests_SpbTarget.h"
 
 // NOTE: The definitions in this file must be surrounded by this annotation to ensure
 //       that both C and C++ Clients can easily compile and link with Modules in this Library.
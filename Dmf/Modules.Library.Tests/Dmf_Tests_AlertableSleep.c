@@ -30,6 +30,14 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Number of threads that sleep using events allocated on demand. It is more than
+// ALERTABLE_SLEEP_MAXIMUM_TIMERS on purpose.
+//
+#define SLEEPER_THREAD_COUNT                48
+// Index of the Internal event used by the thread that interrupts all the sleepers.
+//
+#define INTERNAL_EVENT_INDEX_ABORT_ALL      1
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,6 +57,21 @@ typedef struct
     // Thread that interrupts.
     //
     DMFMODULE DmfModuleThreadInterrupt;
+    // AlertableSleep Module with events allocated on demand. (Test Module)
+    //
+    DMFMODULE DmfModuleAlertableSleepOnDemand;
+    // Threads that sleep using events allocated on demand.
+    //
+    DMFMODULE DmfModuleThreadSleeper[SLEEPER_THREAD_COUNT];
+    // Thread that interrupts all the sleepers and measures how long it takes them to wake.
+    //
+    DMFMODULE DmfModuleThreadAbortAll;
+    // Number of sleepers that woke because they were interrupted.
+    //
+    volatile LONG WokenSleeperCount;
+    // Time the last interrupted sleeper woke.
+    //
+    volatile LONG64 LastWakeTimeMs;
     // Indicates Module has started closing so that new waits are not started.
     //
     BOOLEAN Closing;
@@ -155,6 +178,132 @@ Tests_AlertableSleep_WorkThreadInterrupt(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_AlertableSleep_WorkThreadSleeper(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_AlertableSleep* moduleContext;
+    ULONG eventIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Each sleeper uses the event with the same index as its thread.
+    //
+    for (eventIndex = 0; eventIndex < SLEEPER_THREAD_COUNT; eventIndex++)
+    {
+        if (moduleContext->DmfModuleThreadSleeper[eventIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(eventIndex < SLEEPER_THREAD_COUNT);
+
+    DMF_AlertableSleep_ResetForReuse(moduleContext->DmfModuleAlertableSleepOnDemand,
+                                     eventIndex);
+
+    ntStatus = DMF_AlertableSleep_Sleep(moduleContext->DmfModuleAlertableSleepOnDemand,
+                                        eventIndex,
+                                        TIMEOUT_MS_MAXIMUM);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // Interrupted by AbortAll.
+        //
+        InterlockedExchange64(&moduleContext->LastWakeTimeMs,
+                              (LONG64)TestsUtility_TimeMsGet());
+        InterlockedIncrement(&moduleContext->WokenSleeperCount);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_AlertableSleep_WorkThreadAbortAll(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_AlertableSleep* moduleContext;
+    ULONG timeout;
+    NTSTATUS ntStatus;
+    ULONGLONG abortTimeMs;
+    LONG wokenSleeperCount;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Let the sleepers start sleeping.
+    //
+    timeout = TestsUtility_GenerateRandomNumber(1000, 
+                                                TIMEOUT_MS_MAXIMUM);
+    ntStatus = DMF_AlertableSleep_Sleep(moduleContext->DmfModuleAlertableSleepInternal,
+                                        INTERNAL_EVENT_INDEX_ABORT_ALL,
+                                        timeout);
+    if (NT_SUCCESS(ntStatus))
+    {
+        // Benchmark: Measure how long it takes all the sleepers to wake after AbortAll.
+        //
+        InterlockedExchange(&moduleContext->WokenSleeperCount,
+                            0);
+        abortTimeMs = TestsUtility_TimeMsGet();
+        InterlockedExchange64(&moduleContext->LastWakeTimeMs,
+                              (LONG64)abortTimeMs);
+
+        DMF_AlertableSleep_AbortAll(moduleContext->DmfModuleAlertableSleepOnDemand);
+
+        // Give the sleepers time to wake.
+        //
+        ntStatus = DMF_AlertableSleep_Sleep(moduleContext->DmfModuleAlertableSleepInternal,
+                                            INTERNAL_EVENT_INDEX_ABORT_ALL,
+                                            1000);
+        if (NT_SUCCESS(ntStatus))
+        {
+            wokenSleeperCount = InterlockedCompareExchange(&moduleContext->WokenSleeperCount,
+                                                           0,
+                                                           0);
+            TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "AbortAll benchmark: Sleepers=%d Woken=%d LastWakeMs=%I64d",
+                        SLEEPER_THREAD_COUNT,
+                        wokenSleeperCount,
+                        moduleContext->LastWakeTimeMs - (LONG64)abortTimeMs);
+        }
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -192,6 +341,7 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_Tests_AlertableSleep* moduleContext;
+    ULONG threadIndex;
 
     PAGED_CODE();
 
@@ -203,11 +353,21 @@ Return Value:
     //
     ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadSleep);
     ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadInterrupt);
+    for (threadIndex = 0; threadIndex < SLEEPER_THREAD_COUNT; threadIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadSleeper[threadIndex]);
+    }
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadAbortAll);
 
     // Tell the threads they have work to do.
     //
     DMF_Thread_WorkReady(moduleContext->DmfModuleThreadSleep);
     DMF_Thread_WorkReady(moduleContext->DmfModuleThreadInterrupt);
+    for (threadIndex = 0; threadIndex < SLEEPER_THREAD_COUNT; threadIndex++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadSleeper[threadIndex]);
+    }
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadAbortAll);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -240,6 +400,7 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_Tests_AlertableSleep* moduleContext;
+    ULONG threadIndex;
 
     PAGED_CODE();
 
@@ -249,13 +410,18 @@ Return Value:
 
     moduleContext->Closing = TRUE;
 
-    DMF_AlertableSleep_Abort(moduleContext->DmfModuleAlertableSleepInternal,
-                             0);
+    DMF_AlertableSleep_AbortAll(moduleContext->DmfModuleAlertableSleepInternal);
     DMF_AlertableSleep_Abort(moduleContext->DmfModuleAlertableSleepTest,
                              0);
+    DMF_AlertableSleep_AbortAll(moduleContext->DmfModuleAlertableSleepOnDemand);
 
     DMF_Thread_Stop(moduleContext->DmfModuleThreadSleep);
     DMF_Thread_Stop(moduleContext->DmfModuleThreadInterrupt);
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadAbortAll);
+    for (threadIndex = 0; threadIndex < SLEEPER_THREAD_COUNT; threadIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadSleeper[threadIndex]);
+    }
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -292,6 +458,7 @@ Return Value:
     DMF_CONTEXT_Tests_AlertableSleep* moduleContext;
     DMF_CONFIG_Thread moduleConfigThread;
     DMF_CONFIG_AlertableSleep moduleConfigAlertableSleep;
+    ULONG threadIndex;
 
     UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
 
@@ -317,7 +484,7 @@ Return Value:
     //
     DMF_CONFIG_AlertableSleep_AND_ATTRIBUTES_INIT(&moduleConfigAlertableSleep,
                                                   &moduleAttributes);
-    moduleConfigAlertableSleep.EventCount = 1;
+    moduleConfigAlertableSleep.EventCount = INTERNAL_EVENT_INDEX_ABORT_ALL + 1;
     DMF_DmfModuleAdd(DmfModuleInit,
                      &moduleAttributes,
                      WDF_NO_OBJECT_ATTRIBUTES,
@@ -347,6 +514,45 @@ Return Value:
                         WDF_NO_OBJECT_ATTRIBUTES,
                         &moduleContext->DmfModuleThreadInterrupt);
 
+    // AlertableSleep (On Demand Test)
+    // -------------------------------
+    //
+    DMF_CONFIG_AlertableSleep_AND_ATTRIBUTES_INIT(&moduleConfigAlertableSleep,
+                                                  &moduleAttributes);
+    moduleConfigAlertableSleep.EventCount = SLEEPER_THREAD_COUNT;
+    moduleConfigAlertableSleep.AllocateEventsOnDemand = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleAlertableSleepOnDemand);
+
+    // Thread (Sleepers)
+    // -----------------
+    //
+    for (threadIndex = 0; threadIndex < SLEEPER_THREAD_COUNT; threadIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_AlertableSleep_WorkThreadSleeper;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadSleeper[threadIndex]);
+    }
+
+    // Thread (Interrupts All)
+    // -----------------------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_AlertableSleep_WorkThreadAbortAll;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadAbortAll);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
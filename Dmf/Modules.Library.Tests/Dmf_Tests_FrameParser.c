@@ -0,0 +1,804 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_FrameParser.c
+
+Abstract:
+
+    Functional tests, fuzz tests and throughput benchmark for Dmf_FrameParser Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_FrameParser.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// One FrameParser Module for each framing type.
+//
+#define NUMBER_OF_FRAMING_TYPES         (FrameParser_FramingType_Maximum - 1)
+// Larger than a COBS block so that all COBS codes are used.
+//
+#define MAXIMUM_FRAME_SIZE              300
+// Number of frames encoded in the stream during each pass.
+//
+#define FRAMES_PER_PASS                 8
+// Largest encoded frame is a SLIP frame where every byte is escaped.
+//
+#define STREAM_BUFFER_SIZE              (FRAMES_PER_PASS * ((2 * MAXIMUM_FRAME_SIZE) + 1))
+// Largest number of bytes parsed at a time.
+//
+#define MAXIMUM_CHUNK_SIZE              64
+// Number of bytes parsed at a time during the benchmark.
+//
+#define BENCHMARK_CHUNK_SIZE            512
+// How long the benchmark runs for each framing type.
+//
+#define BENCHMARK_DURATION_MS           250
+
+#define HEADER_CRC_SYNC_BYTE_0          0xA5
+#define HEADER_CRC_SYNC_BYTE_1          0x5A
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // FrameParser Modules. (Test Modules)
+    //
+    DMFMODULE DmfModuleFrameParser[NUMBER_OF_FRAMING_TYPES];
+    // Thread that runs the tests.
+    //
+    DMFMODULE DmfModuleThread;
+    // Indicates received frames are compared with the expected frames.
+    //
+    BOOLEAN Verify;
+    // Length and content seed of each frame in the stream.
+    //
+    ULONG ExpectedLength[FRAMES_PER_PASS];
+    ULONG ExpectedSeed[FRAMES_PER_PASS];
+    // Number of frames received since the counters were reset.
+    //
+    ULONG FramesReceived;
+    // Number of received frames that do not match the expected frame.
+    //
+    ULONG FramesMismatched;
+    // Payload being encoded or compared.
+    //
+    UCHAR Payload[MAXIMUM_FRAME_SIZE];
+    // Encoded stream.
+    //
+    UCHAR Stream[STREAM_BUFFER_SIZE];
+    // Copy of part of the stream that is parsed. FrameParser decodes in place.
+    //
+    UCHAR Chunk[BENCHMARK_CHUNK_SIZE];
+    // Indicates Module has started closing so that new work is not started.
+    //
+    BOOLEAN Closing;
+} DMF_CONTEXT_Tests_FrameParser;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_FrameParser)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_FrameParser)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+static
+VOID
+Tests_FrameParser_PayloadGenerate(
+    _In_ ULONG Seed,
+    _Out_writes_(PayloadLength) UCHAR* Payload,
+    _In_ ULONG PayloadLength
+    )
+{
+    ULONG value;
+    ULONG byteIndex;
+
+    // Xorshift so that the payload can be generated again from the seed. All byte
+    // values appear, including the ones that SLIP and COBS encode.
+    //
+    value = Seed | 1;
+    for (byteIndex = 0; byteIndex < PayloadLength; byteIndex++)
+    {
+        value ^= value << 13;
+        value ^= value >> 17;
+        value ^= value << 5;
+        Payload[byteIndex] = (UCHAR)value;
+    }
+}
+
+static
+ULONG
+Tests_FrameParser_FrameEncode(
+    _In_ DMFMODULE DmfModuleFrameParser,
+    _In_ FrameParser_FramingType FramingType,
+    _In_reads_(PayloadLength) UCHAR* Payload,
+    _In_ ULONG PayloadLength,
+    _Out_writes_(OutputSize) UCHAR* Output,
+    _In_ ULONG OutputSize
+    )
+{
+    ULONG outputIndex;
+    ULONG payloadIndex;
+    ULONG codeIndex;
+    ULONG crc;
+
+    UNREFERENCED_PARAMETER(OutputSize);
+
+    outputIndex = 0;
+    switch (FramingType)
+    {
+    case FrameParser_FramingType_LengthPrefixed:
+        DmfAssert(OutputSize >= PayloadLength + sizeof(USHORT));
+        Output[outputIndex++] = (UCHAR)PayloadLength;
+        Output[outputIndex++] = (UCHAR)(PayloadLength >> 8);
+        RtlCopyMemory(&Output[outputIndex],
+                      Payload,
+                      PayloadLength);
+        outputIndex += PayloadLength;
+        break;
+    case FrameParser_FramingType_HeaderCrc:
+        DmfAssert(OutputSize >= PayloadLength + 2 + sizeof(USHORT) + sizeof(ULONG));
+        Output[outputIndex++] = HEADER_CRC_SYNC_BYTE_0;
+        Output[outputIndex++] = HEADER_CRC_SYNC_BYTE_1;
+        Output[outputIndex++] = (UCHAR)PayloadLength;
+        Output[outputIndex++] = (UCHAR)(PayloadLength >> 8);
+        RtlCopyMemory(&Output[outputIndex],
+                      Payload,
+                      PayloadLength);
+        outputIndex += PayloadLength;
+        crc = DMF_FrameParser_Crc32(DmfModuleFrameParser,
+                                    0,
+                                    &Output[2],
+                                    sizeof(USHORT) + PayloadLength);
+        Output[outputIndex++] = (UCHAR)crc;
+        Output[outputIndex++] = (UCHAR)(crc >> 8);
+        Output[outputIndex++] = (UCHAR)(crc >> 16);
+        Output[outputIndex++] = (UCHAR)(crc >> 24);
+        break;
+    case FrameParser_FramingType_Slip:
+        DmfAssert(OutputSize >= (2 * PayloadLength) + 1);
+        for (payloadIndex = 0; payloadIndex < PayloadLength; payloadIndex++)
+        {
+            if (0xC0 == Payload[payloadIndex])
+            {
+                Output[outputIndex++] = 0xDB;
+                Output[outputIndex++] = 0xDC;
+            }
+            else if (0xDB == Payload[payloadIndex])
+            {
+                Output[outputIndex++] = 0xDB;
+                Output[outputIndex++] = 0xDD;
+            }
+            else
+            {
+                Output[outputIndex++] = Payload[payloadIndex];
+            }
+        }
+        Output[outputIndex++] = 0xC0;
+        break;
+    case FrameParser_FramingType_Cobs:
+        DmfAssert(OutputSize >= PayloadLength + (PayloadLength / 254) + 2);
+        codeIndex = outputIndex++;
+        Output[codeIndex] = 1;
+        for (payloadIndex = 0; payloadIndex < PayloadLength; payloadIndex++)
+        {
+            if (0 == Payload[payloadIndex])
+            {
+                codeIndex = outputIndex++;
+                Output[codeIndex] = 1;
+                continue;
+            }
+            Output[outputIndex++] = Payload[payloadIndex];
+            Output[codeIndex]++;
+            if ((0xFF == Output[codeIndex]) &&
+                (payloadIndex + 1 < PayloadLength))
+            {
+                codeIndex = outputIndex++;
+                Output[codeIndex] = 1;
+            }
+        }
+        Output[outputIndex++] = 0x00;
+        break;
+    default:
+        DmfAssert(FALSE);
+        break;
+    }
+
+    DmfAssert(outputIndex <= OutputSize);
+
+    return outputIndex;
+}
+
+_Function_class_(EVT_DMF_FrameParser_FrameReceived)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_FrameParser_FrameReceived(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(FrameLength) UCHAR* Frame,
+    _In_ ULONG FrameLength
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_FrameParser* moduleContext;
+    ULONG frameIndex;
+
+    dmfModule = DMF_ParentModuleGet(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    frameIndex = moduleContext->FramesReceived++;
+    if (! moduleContext->Verify)
+    {
+        return;
+    }
+
+    if ((frameIndex >= FRAMES_PER_PASS) ||
+        (FrameLength != moduleContext->ExpectedLength[frameIndex]))
+    {
+        moduleContext->FramesMismatched++;
+        return;
+    }
+
+    Tests_FrameParser_PayloadGenerate(moduleContext->ExpectedSeed[frameIndex],
+                                      moduleContext->Payload,
+                                      FrameLength);
+    if (RtlCompareMemory(Frame,
+                         moduleContext->Payload,
+                         FrameLength) != FrameLength)
+    {
+        moduleContext->FramesMismatched++;
+    }
+}
+
+static
+VOID
+Tests_FrameParser_StreamParse(
+    _In_ DMFMODULE DmfModuleFrameParser,
+    _In_reads_(StreamLength) UCHAR* Stream,
+    _In_ ULONG StreamLength
+    )
+{
+    ULONG offset;
+    ULONG chunkSize;
+
+    // Sometimes parse all the remaining bytes so that the path where frames are not
+    // copied runs, otherwise split frames across calls.
+    //
+    offset = 0;
+    while (offset < StreamLength)
+    {
+        if (0 == TestsUtility_GenerateRandomNumber(0, 3))
+        {
+            chunkSize = StreamLength - offset;
+        }
+        else
+        {
+            chunkSize = TestsUtility_GenerateRandomNumber(1, MAXIMUM_CHUNK_SIZE);
+            if (chunkSize > StreamLength - offset)
+            {
+                chunkSize = StreamLength - offset;
+            }
+        }
+        DMF_FrameParser_Parse(DmfModuleFrameParser,
+                              &Stream[offset],
+                              chunkSize);
+        offset += chunkSize;
+    }
+}
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_FrameParser_Functional(
+    _In_ DMF_CONTEXT_Tests_FrameParser* ModuleContext,
+    _In_ FrameParser_FramingType FramingType
+    )
+{
+    DMFMODULE dmfModuleFrameParser;
+    FrameParser_Statistics statisticsBefore;
+    FrameParser_Statistics statisticsAfter;
+    ULONG frameIndex;
+    ULONG minimumLength;
+    ULONG streamLength;
+
+    PAGED_CODE();
+
+    dmfModuleFrameParser = ModuleContext->DmfModuleFrameParser[FramingType - 1];
+
+    // Empty delimited frames are not reported.
+    //
+    if ((FrameParser_FramingType_Slip == FramingType) ||
+        (FrameParser_FramingType_Cobs == FramingType))
+    {
+        minimumLength = 1;
+    }
+    else
+    {
+        minimumLength = 0;
+    }
+
+    streamLength = 0;
+    for (frameIndex = 0; frameIndex < FRAMES_PER_PASS; frameIndex++)
+    {
+        ModuleContext->ExpectedLength[frameIndex] = TestsUtility_GenerateRandomNumber(minimumLength,
+                                                                                      MAXIMUM_FRAME_SIZE);
+        ModuleContext->ExpectedSeed[frameIndex] = TestsUtility_GenerateRandomNumber(0,
+                                                                                    MAXULONG - 1);
+        Tests_FrameParser_PayloadGenerate(ModuleContext->ExpectedSeed[frameIndex],
+                                          ModuleContext->Payload,
+                                          ModuleContext->ExpectedLength[frameIndex]);
+        streamLength += Tests_FrameParser_FrameEncode(dmfModuleFrameParser,
+                                                      FramingType,
+                                                      ModuleContext->Payload,
+                                                      ModuleContext->ExpectedLength[frameIndex],
+                                                      &ModuleContext->Stream[streamLength],
+                                                      sizeof(ModuleContext->Stream) - streamLength);
+    }
+
+    DMF_FrameParser_StatisticsGet(dmfModuleFrameParser,
+                                  &statisticsBefore);
+
+    ModuleContext->FramesReceived = 0;
+    ModuleContext->FramesMismatched = 0;
+    ModuleContext->Verify = TRUE;
+    Tests_FrameParser_StreamParse(dmfModuleFrameParser,
+                                  ModuleContext->Stream,
+                                  streamLength);
+    ModuleContext->Verify = FALSE;
+
+    DMF_FrameParser_StatisticsGet(dmfModuleFrameParser,
+                                  &statisticsAfter);
+
+    DmfAssert(FRAMES_PER_PASS == ModuleContext->FramesReceived);
+    DmfAssert(0 == ModuleContext->FramesMismatched);
+    DmfAssert(statisticsAfter.FramesReceived - statisticsBefore.FramesReceived == FRAMES_PER_PASS);
+    DmfAssert(statisticsAfter.FramesDropped == statisticsBefore.FramesDropped);
+    DmfAssert(statisticsAfter.BytesSkipped == statisticsBefore.BytesSkipped);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_FrameParser_Fuzz(
+    _In_ DMF_CONTEXT_Tests_FrameParser* ModuleContext,
+    _In_ FrameParser_FramingType FramingType
+    )
+{
+    DMFMODULE dmfModuleFrameParser;
+    FrameParser_Statistics statistics;
+    ULONG streamLength;
+    ULONG byteIndex;
+
+    PAGED_CODE();
+
+    dmfModuleFrameParser = ModuleContext->DmfModuleFrameParser[FramingType - 1];
+
+    // Random bytes must never cause frames larger than the maximum size or a crash.
+    //
+    streamLength = TestsUtility_GenerateRandomNumber(1,
+                                                     sizeof(ModuleContext->Stream));
+    for (byteIndex = 0; byteIndex < streamLength; byteIndex++)
+    {
+        ModuleContext->Stream[byteIndex] = (UCHAR)TestsUtility_GenerateRandomNumber(0,
+                                                                                    0xFF);
+    }
+
+    ModuleContext->FramesReceived = 0;
+    Tests_FrameParser_StreamParse(dmfModuleFrameParser,
+                                  ModuleContext->Stream,
+                                  streamLength);
+
+    DMF_FrameParser_StatisticsGet(dmfModuleFrameParser,
+                                  &statistics);
+    DmfAssert(statistics.FramesReassembled <= statistics.FramesReceived);
+    DmfAssert(statistics.BytesSkipped <= statistics.BytesParsed);
+
+    // The stream now contains garbage. Start the next test from a clean state.
+    //
+    DMF_FrameParser_Reset(dmfModuleFrameParser);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_FrameParser_Benchmark(
+    _In_ DMF_CONTEXT_Tests_FrameParser* ModuleContext,
+    _In_ FrameParser_FramingType FramingType
+    )
+{
+    DMFMODULE dmfModuleFrameParser;
+    ULONG frameIndex;
+    ULONG streamLength;
+    ULONG offset;
+    ULONG chunkSize;
+    ULONGLONG bytesParsed;
+    ULONGLONG startTimeMs;
+    ULONGLONG elapsedTimeMs;
+
+    PAGED_CODE();
+
+    dmfModuleFrameParser = ModuleContext->DmfModuleFrameParser[FramingType - 1];
+
+    streamLength = 0;
+    for (frameIndex = 0; frameIndex < FRAMES_PER_PASS; frameIndex++)
+    {
+        Tests_FrameParser_PayloadGenerate(frameIndex,
+                                          ModuleContext->Payload,
+                                          MAXIMUM_FRAME_SIZE);
+        streamLength += Tests_FrameParser_FrameEncode(dmfModuleFrameParser,
+                                                      FramingType,
+                                                      ModuleContext->Payload,
+                                                      MAXIMUM_FRAME_SIZE,
+                                                      &ModuleContext->Stream[streamLength],
+                                                      sizeof(ModuleContext->Stream) - streamLength);
+    }
+
+    // Parse the stream repeatedly in fixed size chunks, as a serial port returns it.
+    // Each chunk is copied because it is decoded in place.
+    //
+    ModuleContext->FramesReceived = 0;
+    bytesParsed = 0;
+    startTimeMs = TestsUtility_TimeMsGet();
+    do
+    {
+        for (offset = 0; offset < streamLength; offset += chunkSize)
+        {
+            chunkSize = min(BENCHMARK_CHUNK_SIZE,
+                            streamLength - offset);
+            RtlCopyMemory(ModuleContext->Chunk,
+                          &ModuleContext->Stream[offset],
+                          chunkSize);
+            DMF_FrameParser_Parse(dmfModuleFrameParser,
+                                  ModuleContext->Chunk,
+                                  chunkSize);
+        }
+        bytesParsed += streamLength;
+        elapsedTimeMs = TestsUtility_TimeMsGet() - startTimeMs;
+    } while ((elapsedTimeMs < BENCHMARK_DURATION_MS) &&
+             (! ModuleContext->Closing));
+
+    if (elapsedTimeMs > 0)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "FrameParser benchmark: FramingType=%d Bytes/s=%I64d Frames/s=%I64d",
+                    FramingType,
+                    (bytesParsed * 1000) / elapsedTimeMs,
+                    ((ULONGLONG)ModuleContext->FramesReceived * 1000) / elapsedTimeMs);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_FrameParser_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_FrameParser* moduleContext;
+    FrameParser_FramingType framingType;
+    ULONG crc;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Check value of CRC-32 (IEEE 802.3).
+    //
+    crc = DMF_FrameParser_Crc32(moduleContext->DmfModuleFrameParser[0],
+                                0,
+                                (UCHAR*)"123456789",
+                                9);
+    DmfAssert(0xCBF43926 == crc);
+
+    for (framingType = FrameParser_FramingType_LengthPrefixed; framingType < FrameParser_FramingType_Maximum; framingType++)
+    {
+        if (DMF_Thread_IsStopPending(DmfModuleThread) ||
+            moduleContext->Closing)
+        {
+            break;
+        }
+
+        Tests_FrameParser_Functional(moduleContext,
+                                     framingType);
+        Tests_FrameParser_Fuzz(moduleContext,
+                               framingType);
+        Tests_FrameParser_Benchmark(moduleContext,
+                                    framingType);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_FrameParser_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_FrameParser.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_FrameParser* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_FrameParser_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_FrameParser.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_FrameParser* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->Closing = TRUE;
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_FrameParser_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_FrameParser* moduleContext;
+    DMF_CONFIG_FrameParser moduleConfigFrameParser;
+    DMF_CONFIG_Thread moduleConfigThread;
+    ULONG framingTypeIndex;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // FrameParser (Test)
+    // ------------------
+    //
+    for (framingTypeIndex = 0; framingTypeIndex < NUMBER_OF_FRAMING_TYPES; framingTypeIndex++)
+    {
+        DMF_CONFIG_FrameParser_AND_ATTRIBUTES_INIT(&moduleConfigFrameParser,
+                                                   &moduleAttributes);
+        moduleConfigFrameParser.FramingType = (FrameParser_FramingType)(framingTypeIndex + 1);
+        moduleConfigFrameParser.MaximumFrameSize = MAXIMUM_FRAME_SIZE;
+        moduleConfigFrameParser.LengthFieldSize = sizeof(USHORT);
+        moduleConfigFrameParser.SyncBytes[0] = HEADER_CRC_SYNC_BYTE_0;
+        moduleConfigFrameParser.SyncBytes[1] = HEADER_CRC_SYNC_BYTE_1;
+        moduleConfigFrameParser.SyncByteCount = 2;
+        moduleConfigFrameParser.EvtFrameParserFrameReceived = Tests_FrameParser_FrameReceived;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleFrameParser[framingTypeIndex]);
+    }
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_FrameParser_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_FrameParser_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_FrameParser.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_FrameParser;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_FrameParser;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_FrameParser);
+    dmfCallbacksDmf_Tests_FrameParser.ChildModulesAdd = DMF_Tests_FrameParser_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_FrameParser.DeviceOpen = Tests_FrameParser_Open;
+    dmfCallbacksDmf_Tests_FrameParser.DeviceClose = Tests_FrameParser_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_FrameParser,
+                                            Tests_FrameParser,
+                                            DMF_CONTEXT_Tests_FrameParser,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_FrameParser.CallbacksDmf = &dmfCallbacksDmf_Tests_FrameParser;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_FrameParser,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_FrameParser.c
+//
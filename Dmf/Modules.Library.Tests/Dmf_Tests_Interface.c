@@ -0,0 +1,692 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_Interface.c
+
+Abstract:
+
+    Functional tests and scaling benchmark for DMF Interface reference counting
+    (DMF_InterfaceReference/DMF_InterfaceDereference).
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_Interface.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of threads that acquire and release references at the same time.
+//
+#define WORKER_THREAD_COUNT             4
+// Number of Reference/Dereference pairs each worker thread performs before checking
+// if it should stop.
+//
+#define REFERENCES_PER_PASS             1024
+// How long each step of the benchmark runs.
+//
+#define BENCHMARK_STEP_DURATION_MS      1000
+// How long an idle worker thread waits before checking if it is active.
+//
+#define WORKER_IDLE_DELAY_MS            10
+// How long a reference is held while the Interface is unbound.
+//
+#define REFERENCE_HOLD_DELAY_MS         100
+
+// The Interface used by this test. This Module is the Protocol. It has no Methods
+// or Callbacks other than the ones all Interfaces have.
+//
+typedef struct _DMF_INTERFACE_PROTOCOL_TestsInterface_DECLARATION_DATA
+{
+    DMF_INTERFACE_PROTOCOL_DESCRIPTOR DmfProtocolDescriptor;
+} DMF_INTERFACE_PROTOCOL_TestsInterface_DECLARATION_DATA;
+
+typedef struct _DMF_INTERFACE_TRANSPORT_TestsInterface_DECLARATION_DATA
+{
+    DMF_INTERFACE_TRANSPORT_DESCRIPTOR DmfTransportDescriptor;
+} DMF_INTERFACE_TRANSPORT_TestsInterface_DECLARATION_DATA;
+
+DECLARE_DMF_INTERFACE(TestsInterface);
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Threads that acquire and release references.
+    //
+    DMFMODULE DmfModuleThreadWorker[WORKER_THREAD_COUNT];
+    // Thread that runs the benchmark steps and unbinds and binds the Interface.
+    // Any Module can be the Transport of the Interface. This one is used.
+    //
+    DMFMODULE DmfModuleThreadControl;
+    // The Interface while it is bound.
+    //
+    DMFINTERFACE DmfInterface;
+    // Number of worker threads that are currently acquiring references.
+    //
+    volatile LONG ActiveWorkerCount;
+    // Number of worker threads that may be using DmfInterface.
+    //
+    volatile LONG BusyWorkerCount;
+    // Number of Reference/Dereference pairs that succeeded during the current step.
+    //
+    volatile LONG64 ReferenceCount;
+    // Set by the control thread to ask the first worker to hold a reference.
+    //
+    volatile LONG HoldReference;
+    // Set by the first worker while it holds that reference.
+    //
+    volatile LONG ReferenceHeld;
+    // Indicates Module has started closing so that new work is not started.
+    //
+    BOOLEAN Closing;
+} DMF_CONTEXT_Tests_Interface;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_Interface)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_Interface)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+static
+NTSTATUS
+Tests_Interface_ProtocolBind(
+    _In_ DMFINTERFACE DmfInterface
+    )
+{
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_InterfaceProtocolModuleGet(DmfInterface));
+
+    moduleContext->DmfInterface = DmfInterface;
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+static
+VOID
+Tests_Interface_ProtocolUnbind(
+    _In_ DMFINTERFACE DmfInterface
+    )
+{
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_InterfaceProtocolModuleGet(DmfInterface));
+
+    // All references have been released and no new references can be acquired.
+    //
+    DmfAssert(! moduleContext->ReferenceHeld);
+    ntStatus = DMF_InterfaceReference(DmfInterface);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        DMF_InterfaceDereference(DmfInterface);
+    }
+
+    moduleContext->DmfInterface = NULL;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_Interface_WorkersIdleWait(
+    _In_ DMF_CONTEXT_Tests_Interface* ModuleContext
+    )
+{
+    PAGED_CODE();
+
+    InterlockedExchange(&ModuleContext->ActiveWorkerCount,
+                        0);
+    while (InterlockedCompareExchange(&ModuleContext->BusyWorkerCount,
+                                      0,
+                                      0) > 0)
+    {
+        DMF_Utility_DelayMilliseconds(WORKER_IDLE_DELAY_MS);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Interface_WorkThreadWorker(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    DMFINTERFACE dmfInterface;
+    NTSTATUS ntStatus;
+    ULONG workerIndex;
+    ULONG referenceIndex;
+    LONG referencesAcquired;
+    BOOLEAN idle;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    workerIndex = TestsUtility_ThreadIndexGet(moduleContext->DmfModuleThreadWorker,
+                                              WORKER_THREAD_COUNT,
+                                              DmfModuleThread);
+
+    // The control thread waits for BusyWorkerCount to reach zero before it
+    // unbinds the Interface.
+    //
+    idle = FALSE;
+    InterlockedIncrement(&moduleContext->BusyWorkerCount);
+    dmfInterface = moduleContext->DmfInterface;
+
+    if ((workerIndex == 0) &&
+        moduleContext->HoldReference)
+    {
+        // Hold a reference while the control thread unbinds the Interface.
+        //
+        ntStatus = DMF_InterfaceReference(dmfInterface);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (NT_SUCCESS(ntStatus))
+        {
+            InterlockedExchange(&moduleContext->ReferenceHeld,
+                                TRUE);
+            DMF_Utility_DelayMilliseconds(REFERENCE_HOLD_DELAY_MS);
+            InterlockedExchange(&moduleContext->ReferenceHeld,
+                                FALSE);
+            // The Interface may not be used after this call because it is being unbound.
+            //
+            DMF_InterfaceDereference(dmfInterface);
+        }
+        InterlockedExchange(&moduleContext->HoldReference,
+                            FALSE);
+    }
+    else if (workerIndex < (ULONG)moduleContext->ActiveWorkerCount)
+    {
+        DmfAssert(dmfInterface != NULL);
+        referencesAcquired = 0;
+        for (referenceIndex = 0; referenceIndex < REFERENCES_PER_PASS; referenceIndex++)
+        {
+            ntStatus = DMF_InterfaceReference(dmfInterface);
+            DmfAssert(NT_SUCCESS(ntStatus));
+            if (NT_SUCCESS(ntStatus))
+            {
+                referencesAcquired++;
+                DMF_InterfaceDereference(dmfInterface);
+            }
+        }
+        InterlockedAdd64(&moduleContext->ReferenceCount,
+                         referencesAcquired);
+    }
+    else
+    {
+        idle = TRUE;
+    }
+
+    InterlockedDecrement(&moduleContext->BusyWorkerCount);
+
+    if (idle)
+    {
+        DMF_Utility_DelayMilliseconds(WORKER_IDLE_DELAY_MS);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Interface_WorkThreadControl(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(moduleContext->DmfInterface != NULL);
+
+    // Benchmark: Measure how many Reference/Dereference pairs per second are performed
+    // as the number of threads that perform them increases.
+    //
+    TestsUtility_ScalingBenchmarkRun(DmfModuleThread,
+                                     "Interface",
+                                     WORKER_THREAD_COUNT,
+                                     BENCHMARK_STEP_DURATION_MS,
+                                     &moduleContext->ActiveWorkerCount,
+                                     &moduleContext->ReferenceCount,
+                                     &moduleContext->Closing);
+
+    Tests_Interface_WorkersIdleWait(moduleContext);
+
+    if (DMF_Thread_IsStopPending(DmfModuleThread) ||
+        moduleContext->Closing)
+    {
+        goto Exit;
+    }
+
+    // Functional test: Unbind waits for a reference held by another thread to be
+    // released. No references can be acquired after that (see Tests_Interface_ProtocolUnbind).
+    //
+    InterlockedExchange(&moduleContext->HoldReference,
+                        TRUE);
+    while ((! moduleContext->ReferenceHeld) &&
+           moduleContext->HoldReference &&
+           (! moduleContext->Closing))
+    {
+        DMF_Utility_DelayMilliseconds(WORKER_IDLE_DELAY_MS);
+    }
+
+    DMF_INTERFACE_UNBIND(dmfModule,
+                         DmfModuleThread,
+                         TestsInterface);
+    DmfAssert(moduleContext->DmfInterface == NULL);
+
+    // The worker no longer uses the Interface once it has released its reference.
+    //
+    Tests_Interface_WorkersIdleWait(moduleContext);
+
+    ntStatus = DMF_INTERFACE_BIND(dmfModule,
+                                  DmfModuleThread,
+                                  TestsInterface);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = DMF_InterfaceReference(moduleContext->DmfInterface);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (NT_SUCCESS(ntStatus))
+        {
+            DMF_InterfaceDereference(moduleContext->DmfInterface);
+        }
+
+        // Repeat the test, until stop is signaled or the function stopped because the
+        // driver is stopping.
+        //
+        if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+            (! moduleContext->Closing))
+        {
+            DMF_Thread_WorkReady(DmfModuleThread);
+        }
+    }
+
+Exit:
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_Interface_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_Interface.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    ULONG workerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_INTERFACE_BIND(DmfModule,
+                                  moduleContext->DmfModuleThreadControl,
+                                  TestsInterface);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_INTERFACE_BIND fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // Start the threads.
+    //
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadWorker[workerIndex]);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadControl);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Tell the threads they have work to do.
+    //
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadControl);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Interface_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_Interface.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    ULONG workerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->Closing = TRUE;
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadControl);
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+
+    if (moduleContext->DmfInterface != NULL)
+    {
+        DMF_INTERFACE_UNBIND(DmfModule,
+                             moduleContext->DmfModuleThreadControl,
+                             TestsInterface);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_Interface_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+    ULONG workerIndex;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Thread (Workers)
+    // ----------------
+    //
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_Interface_WorkThreadWorker;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+
+    // Thread (Control)
+    // ----------------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_Interface_WorkThreadControl;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadControl);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_Interface_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_Interface.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_Interface;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_Interface;
+    DMF_INTERFACE_PROTOCOL_TestsInterface_DECLARATION_DATA protocolDeclarationData;
+    DMF_INTERFACE_TRANSPORT_TestsInterface_DECLARATION_DATA transportDeclarationData;
+    DMF_CONTEXT_Tests_Interface* moduleContext;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_Interface);
+    dmfCallbacksDmf_Tests_Interface.ChildModulesAdd = DMF_Tests_Interface_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_Interface.DeviceOpen = Tests_Interface_Open;
+    dmfCallbacksDmf_Tests_Interface.DeviceClose = Tests_Interface_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_Interface,
+                                            Tests_Interface,
+                                            DMF_CONTEXT_Tests_Interface,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_Interface.CallbacksDmf = &dmfCallbacksDmf_Tests_Interface;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_Interface,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    moduleContext = DMF_CONTEXT_GET(*DmfModule);
+
+    // This Module is the Protocol.
+    //
+    DMF_INTERFACE_PROTOCOL_DESCRIPTOR_INIT(&protocolDeclarationData.DmfProtocolDescriptor,
+                                           "TestsInterface",
+                                           DMF_INTERFACE_PROTOCOL_TestsInterface_DECLARATION_DATA,
+                                           Tests_Interface_ProtocolBind,
+                                           Tests_Interface_ProtocolUnbind,
+                                           NULL,
+                                           NULL);
+    ntStatus = DMF_ModuleInterfaceDescriptorAdd(*DmfModule,
+                                                (DMF_INTERFACE_DESCRIPTOR*)&protocolDeclarationData);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleInterfaceDescriptorAdd fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // The control thread is the Transport.
+    //
+    DMF_INTERFACE_TRANSPORT_DESCRIPTOR_INIT(&transportDeclarationData.DmfTransportDescriptor,
+                                            "TestsInterface",
+                                            DMF_INTERFACE_TRANSPORT_TestsInterface_DECLARATION_DATA,
+                                            NULL,
+                                            NULL);
+    ntStatus = DMF_ModuleInterfaceDescriptorAdd(moduleContext->DmfModuleThreadControl,
+                                                (DMF_INTERFACE_DESCRIPTOR*)&transportDeclarationData);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleInterfaceDescriptorAdd fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+Exit:
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_Interface.c
+//
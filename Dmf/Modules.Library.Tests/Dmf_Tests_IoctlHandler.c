@@ -9,8 +9,11 @@ Module Name:
 Abstract:
 
     Functional tests for Dmf_IoctlHandler Module.
-    NOTE: This Module simply instantiates an instance of DMF_IoctlHandler. It provides a target
+    NOTE: This Module simply instantiates instances of DMF_IoctlHandler. It provides a target
           for other Test Modules to send and receive data via an IOCTL interface.
+          The instance that handles IOCTL_Tests_IoctlHandler_ZEROBUFFER asks to be opened on
+          first use. Since the device does not present Requests at PASSIVE_LEVEL, DMF must
+          open it as usual so that no IOCTL is dropped.
 
 Environment:
 
@@ -58,6 +61,9 @@ typedef struct
     // Module that stores all pending sleep contexts.
     //
     DMFMODULE DmfModuleBufferPoolPending;
+    // IoctlHandler that asks to be opened on first use.
+    //
+    DMFMODULE DmfModuleIoctlHandlerOpenOnFirstUse;
 } DMF_CONTEXT_Tests_IoctlHandler;
 
 // This macro declares the following function:
@@ -417,9 +423,59 @@ Exit:
 IoctlHandler_IoctlRecord Tests_IoctlHandlerTable[] =
 {
     { (LONG)IOCTL_Tests_IoctlHandler_SLEEP,         sizeof(Tests_IoctlHandler_Sleep), 0, Tests_IoctlHandler_Callback, FALSE },
+};
+
+IoctlHandler_IoctlRecord Tests_IoctlHandlerTableOpenOnFirstUse[] =
+{
     { (LONG)IOCTL_Tests_IoctlHandler_ZEROBUFFER,    0,                                0, Tests_IoctlHandler_Callback, FALSE },
 };
 
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_IoctlHandler_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_IoctlHandler.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_IoctlHandler* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    ntStatus = STATUS_SUCCESS;
+
+    // IOCTLs can be presented at DISPATCH_LEVEL where Modules cannot be opened, so
+    // DMF has ignored OpenOnFirstUse and has already opened the Child Module.
+    //
+    DmfAssert(DMF_ModuleTypeTagGet(moduleContext->DmfModuleIoctlHandlerOpenOnFirstUse) == DMF_MODULE_TYPE_TAG(IoctlHandler));
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(DMF_ChildModulesAdd)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -479,6 +535,20 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES, 
                      NULL);
 
+    // IoctlHandler (Open on First Use)
+    // --------------------------------
+    //
+    DMF_CONFIG_IoctlHandler_AND_ATTRIBUTES_INIT(&moduleConfigIoctlHandler,
+                                                &moduleAttributes);
+    moduleConfigIoctlHandler.IoctlRecords = Tests_IoctlHandlerTableOpenOnFirstUse;
+    moduleConfigIoctlHandler.IoctlRecordCount = _countof(Tests_IoctlHandlerTableOpenOnFirstUse);
+    moduleConfigIoctlHandler.AccessModeFilter = IoctlHandler_AccessModeDefault;
+    moduleAttributes.OpenOnFirstUse = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleIoctlHandlerOpenOnFirstUse);
+
     // TODO: Add second instance for Internal IOCTL.
     //
 
@@ -557,6 +627,7 @@ Return Value:
 
     DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_IoctlHandler);
     dmfCallbacksDmf_Tests_IoctlHandler.ChildModulesAdd = DMF_Tests_IoctlHandler_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_IoctlHandler.DeviceOpen = Tests_IoctlHandler_Open;
 
     DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_IoctlHandler,
                                             Tests_IoctlHandler,
@@ -0,0 +1,592 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ModuleCreate.c
+
+Abstract:
+
+    Functional tests and create/destroy benchmark for Modules that are created
+    and destroyed dynamically.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_ModuleCreate.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of Modules created between checks of the elapsed time.
+//
+#define MODULES_PER_PASS                64
+// How long each step of the benchmark runs.
+//
+#define BENCHMARK_DURATION_MS           250
+// Size of the Ring Buffer Modules that are created.
+//
+#define RING_BUFFER_ITEM_COUNT          4
+// Size of the Hash Table Modules that are created.
+//
+#define HASH_TABLE_SIZE                 8
+
+typedef enum
+{
+    ModuleCreate_Benchmark_RingBuffer = 0,
+    ModuleCreate_Benchmark_HashTable,
+    ModuleCreate_Benchmark_Maximum
+} ModuleCreate_Benchmark;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Thread that runs the tests.
+    //
+    DMFMODULE DmfModuleThread;
+    // Indicates Module has started closing so that new work is not started.
+    //
+    BOOLEAN Closing;
+} DMF_CONTEXT_Tests_ModuleCreate;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_ModuleCreate)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_ModuleCreate)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ModuleCreate_RingBufferCreate(
+    _In_ WDFDEVICE Device,
+    _Out_ DMFMODULE* DmfModuleRingBuffer
+    )
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_RingBuffer moduleConfigRingBuffer;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_RingBuffer_AND_ATTRIBUTES_INIT(&moduleConfigRingBuffer,
+                                              &moduleAttributes);
+    moduleConfigRingBuffer.ItemCount = RING_BUFFER_ITEM_COUNT;
+    moduleConfigRingBuffer.ItemSize = sizeof(ULONG);
+    moduleConfigRingBuffer.Mode = RingBuffer_Mode_DeleteOldestIfFullOnWrite;
+    moduleAttributes.ClientModuleInstanceName = "Tests_ModuleCreate.RingBuffer";
+    ntStatus = DMF_RingBuffer_Create(Device,
+                                     &moduleAttributes,
+                                     &objectAttributes,
+                                     DmfModuleRingBuffer);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ModuleCreate_HashTableCreate(
+    _In_ WDFDEVICE Device,
+    _Out_ DMFMODULE* DmfModuleHashTable
+    )
+{
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_HashTable moduleConfigHashTable;
+
+    PAGED_CODE();
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = Device;
+
+    DMF_CONFIG_HashTable_AND_ATTRIBUTES_INIT(&moduleConfigHashTable,
+                                             &moduleAttributes);
+    moduleConfigHashTable.MaximumKeyLength = sizeof(ULONG);
+    moduleConfigHashTable.MaximumValueLength = sizeof(ULONG);
+    moduleConfigHashTable.MaximumTableSize = HASH_TABLE_SIZE;
+    ntStatus = DMF_HashTable_Create(Device,
+                                    &moduleAttributes,
+                                    &objectAttributes,
+                                    DmfModuleHashTable);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_ModuleCreate_Functional(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    NTSTATUS ntStatus;
+    WDFDEVICE device;
+    DMFMODULE dmfModuleRingBuffer;
+    DMFMODULE dmfModuleHashTable;
+    ULONG itemIndex;
+    ULONG data;
+    ULONG key;
+    ULONG value;
+    ULONG valueLength;
+
+    PAGED_CODE();
+
+    device = DMF_ParentDeviceGet(DmfModule);
+
+    // The Module uses the Config that was copied when it was created: It holds
+    // RING_BUFFER_ITEM_COUNT items of the configured size.
+    //
+    ntStatus = Tests_ModuleCreate_RingBufferCreate(device,
+                                                   &dmfModuleRingBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // It can fail when driver is being removed.
+        //
+        goto Exit;
+    }
+
+    for (itemIndex = 0; itemIndex < RING_BUFFER_ITEM_COUNT * 2; itemIndex++)
+    {
+        ntStatus = DMF_RingBuffer_Write(dmfModuleRingBuffer,
+                                        (UCHAR*)&itemIndex,
+                                        sizeof(itemIndex));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    for (itemIndex = RING_BUFFER_ITEM_COUNT; itemIndex < RING_BUFFER_ITEM_COUNT * 2; itemIndex++)
+    {
+        ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer,
+                                       (UCHAR*)&data,
+                                       sizeof(data));
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(data == itemIndex);
+    }
+    ntStatus = DMF_RingBuffer_Read(dmfModuleRingBuffer,
+                                   (UCHAR*)&data,
+                                   sizeof(data));
+    DmfAssert(! NT_SUCCESS(ntStatus));
+
+    WdfObjectDelete(dmfModuleRingBuffer);
+
+    // Hash Table uses a reader/writer lock, which is allocated with the Module.
+    //
+    ntStatus = Tests_ModuleCreate_HashTableCreate(device,
+                                                  &dmfModuleHashTable);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    for (key = 0; key < HASH_TABLE_SIZE; key++)
+    {
+        value = ~key;
+        ntStatus = DMF_HashTable_Write(dmfModuleHashTable,
+                                       (UCHAR*)&key,
+                                       sizeof(key),
+                                       (UCHAR*)&value,
+                                       sizeof(value));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    for (key = 0; key < HASH_TABLE_SIZE; key++)
+    {
+        ntStatus = DMF_HashTable_Read(dmfModuleHashTable,
+                                      (UCHAR*)&key,
+                                      sizeof(key),
+                                      (UCHAR*)&value,
+                                      sizeof(value),
+                                      &valueLength);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(sizeof(value) == valueLength);
+        DmfAssert(~key == value);
+    }
+
+    WdfObjectDelete(dmfModuleHashTable);
+
+Exit:
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_ModuleCreate_Benchmark(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_Tests_ModuleCreate* ModuleContext,
+    _In_ ModuleCreate_Benchmark Benchmark
+    )
+{
+    NTSTATUS ntStatus;
+    WDFDEVICE device;
+    DMFMODULE dmfModuleCreated;
+    ULONG moduleIndex;
+    ULONGLONG numberOfModules;
+    ULONGLONG startTimeMs;
+    ULONGLONG elapsedTimeMs;
+
+    PAGED_CODE();
+
+    device = DMF_ParentDeviceGet(DmfModule);
+
+    numberOfModules = 0;
+    startTimeMs = TestsUtility_TimeMsGet();
+    do
+    {
+        for (moduleIndex = 0; moduleIndex < MODULES_PER_PASS; moduleIndex++)
+        {
+            switch (Benchmark)
+            {
+                case ModuleCreate_Benchmark_RingBuffer:
+                {
+                    ntStatus = Tests_ModuleCreate_RingBufferCreate(device,
+                                                                   &dmfModuleCreated);
+                    break;
+                }
+                case ModuleCreate_Benchmark_HashTable:
+                {
+                    ntStatus = Tests_ModuleCreate_HashTableCreate(device,
+                                                                  &dmfModuleCreated);
+                    break;
+                }
+                default:
+                {
+                    DmfAssert(FALSE);
+                    ntStatus = STATUS_NOT_SUPPORTED;
+                    break;
+                }
+            }
+            if (! NT_SUCCESS(ntStatus))
+            {
+                // It can fail when driver is being removed.
+                //
+                goto Exit;
+            }
+
+            // The Module is closed and destroyed when it is deleted.
+            //
+            WdfObjectDelete(dmfModuleCreated);
+        }
+        numberOfModules += MODULES_PER_PASS;
+        elapsedTimeMs = TestsUtility_TimeMsGet() - startTimeMs;
+    } while ((elapsedTimeMs < BENCHMARK_DURATION_MS) &&
+             (! ModuleContext->Closing));
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "ModuleCreate benchmark: Benchmark=%d Modules=%I64d Nanoseconds/Module=%I64d",
+                Benchmark,
+                numberOfModules,
+                (elapsedTimeMs * 1000 * 1000) / numberOfModules);
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ModuleCreate_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_ModuleCreate* moduleContext;
+    ModuleCreate_Benchmark benchmark;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    Tests_ModuleCreate_Functional(dmfModule);
+
+    for (benchmark = ModuleCreate_Benchmark_RingBuffer; benchmark < ModuleCreate_Benchmark_Maximum; benchmark++)
+    {
+        if (DMF_Thread_IsStopPending(DmfModuleThread) ||
+            moduleContext->Closing)
+        {
+            break;
+        }
+
+        Tests_ModuleCreate_Benchmark(dmfModule,
+                                     moduleContext,
+                                     benchmark);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ModuleCreate_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_ModuleCreate.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_ModuleCreate* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ModuleCreate_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_ModuleCreate.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_ModuleCreate* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->Closing = TRUE;
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_ModuleCreate_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_ModuleCreate* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_ModuleCreate_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_ModuleCreate_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_ModuleCreate.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_ModuleCreate;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_ModuleCreate;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_ModuleCreate);
+    dmfCallbacksDmf_Tests_ModuleCreate.ChildModulesAdd = DMF_Tests_ModuleCreate_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_ModuleCreate.DeviceOpen = Tests_ModuleCreate_Open;
+    dmfCallbacksDmf_Tests_ModuleCreate.DeviceClose = Tests_ModuleCreate_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_ModuleCreate,
+                                            Tests_ModuleCreate,
+                                            DMF_CONTEXT_Tests_ModuleCreate,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_ModuleCreate.CallbacksDmf = &dmfCallbacksDmf_Tests_ModuleCreate;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_ModuleCreate,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ModuleCreate.c
+//
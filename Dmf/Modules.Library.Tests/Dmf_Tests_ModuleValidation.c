@@ -0,0 +1,543 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ModuleValidation.c
+
+Abstract:
+
+    Functional tests and Method call benchmark for the Module handle validation
+    done by DMFMODULE_VALIDATE_IN_METHOD, including the open of Modules that are
+    opened on first use.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_ModuleValidation.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of calls made between checks of the elapsed time.
+//
+#define CALLS_PER_PASS                  4096
+// How long each step of the benchmark runs.
+//
+#define BENCHMARK_DURATION_MS           250
+
+typedef enum
+{
+    ModuleValidation_Benchmark_CustomType = 0,
+    ModuleValidation_Benchmark_TypeTag,
+    ModuleValidation_Benchmark_MethodCall,
+    ModuleValidation_Benchmark_Maximum
+} ModuleValidation_Benchmark;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Thread that runs the tests. Its Methods are also the ones that are called
+    // during the benchmark.
+    //
+    DMFMODULE DmfModuleThread;
+    // Thread that is opened on first use. It is never started. Its Methods are only
+    // called to open it.
+    //
+    DMFMODULE DmfModuleThreadOpenOnFirstUse;
+    // Indicates that the Method call that opens DmfModuleThreadOpenOnFirstUse has been tested.
+    //
+    BOOLEAN OpenOnFirstUseTested;
+    // Number of checks that passed during the benchmark. It is kept so that the
+    // checks are not optimized away.
+    //
+    ULONGLONG ChecksPassed;
+    // Indicates Module has started closing so that new work is not started.
+    //
+    BOOLEAN Closing;
+} DMF_CONTEXT_Tests_ModuleValidation;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_ModuleValidation)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_ModuleValidation)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_ModuleValidation_Functional(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_CONTEXT_Tests_ModuleValidation* ModuleContext
+    )
+{
+    BOOLEAN isCustomType;
+    BOOLEAN isTypeTag;
+
+    PAGED_CODE();
+
+    // The type tag check must agree with the WDF custom type check for a handle
+    // of the expected type...
+    //
+    isCustomType = WdfObjectIsCustomType(ModuleContext->DmfModuleThread,
+                                         Thread);
+    isTypeTag = (DMF_ModuleTypeTagGet(ModuleContext->DmfModuleThread) == DMF_MODULE_TYPE_TAG(Thread));
+    DmfAssert(isCustomType);
+    DmfAssert(isTypeTag);
+
+    // ...and for a handle of another type.
+    //
+    isCustomType = WdfObjectIsCustomType(DmfModule,
+                                         Thread);
+    isTypeTag = (DMF_ModuleTypeTagGet(DmfModule) == DMF_MODULE_TYPE_TAG(Thread));
+    DmfAssert(! isCustomType);
+    DmfAssert(! isTypeTag);
+
+    // All instances of a Module type have the same tag.
+    //
+    DmfAssert(DMF_ModuleTypeTagGet(DmfModule) == DMF_MODULE_TYPE_TAG(Tests_ModuleValidation));
+    DmfAssert(DMF_MODULE_TYPE_TAG(Thread) != DMF_MODULE_TYPE_TAG(Tests_ModuleValidation));
+
+    // The tag read from the table of tags is the one stored in the Module.
+    //
+    DmfAssert(DMF_ModuleTypeTagGet(DmfModule) == DMF_ModuleTypeTagObjectGet(DmfModule));
+    DmfAssert(DMF_ModuleTypeTagGet(ModuleContext->DmfModuleThread) == DMF_ModuleTypeTagObjectGet(ModuleContext->DmfModuleThread));
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_ModuleValidation_OpenOnFirstUse(
+    _In_ DMF_CONTEXT_Tests_ModuleValidation* ModuleContext
+    )
+{
+    DMFMODULE dmfModuleThread;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    if (ModuleContext->OpenOnFirstUseTested)
+    {
+        goto Exit;
+    }
+
+    dmfModuleThread = ModuleContext->DmfModuleThreadOpenOnFirstUse;
+
+    // The Module has not been used yet, so its tag does not match the tag its Methods expect...
+    //
+    DmfAssert(DMF_ModuleTypeTagGet(dmfModuleThread) == DMF_MODULE_TYPE_TAG_OPEN_DEFERRED(DMF_MODULE_TYPE_TAG(Thread)));
+    DmfAssert(DMF_ModuleTypeTagGet(dmfModuleThread) == DMF_ModuleTypeTagObjectGet(dmfModuleThread));
+
+    // ...so calling a Method without referencing the Module first opens it.
+    //
+    DmfAssert(! DMF_Thread_IsStopPending(dmfModuleThread));
+    DmfAssert(DMF_ModuleTypeTagGet(dmfModuleThread) == DMF_MODULE_TYPE_TAG(Thread));
+    DmfAssert(DMF_ModuleTypeTagGet(dmfModuleThread) == DMF_ModuleTypeTagObjectGet(dmfModuleThread));
+
+    // It is now open like any other Module.
+    //
+    ntStatus = DMF_ModuleReference(dmfModuleThread);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        DMF_ModuleDereference(dmfModuleThread);
+    }
+
+    ModuleContext->OpenOnFirstUseTested = TRUE;
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_ModuleValidation_Benchmark(
+    _In_ DMF_CONTEXT_Tests_ModuleValidation* ModuleContext,
+    _In_ ModuleValidation_Benchmark Benchmark
+    )
+{
+    DMFMODULE dmfModuleThread;
+    ULONG callIndex;
+    ULONGLONG numberOfCalls;
+    ULONGLONG startTimeMs;
+    ULONGLONG elapsedTimeMs;
+
+    PAGED_CODE();
+
+    dmfModuleThread = ModuleContext->DmfModuleThread;
+
+    numberOfCalls = 0;
+    startTimeMs = TestsUtility_TimeMsGet();
+    do
+    {
+        switch (Benchmark)
+        {
+            case ModuleValidation_Benchmark_CustomType:
+                // What Methods did in all builds before the type tag was added.
+                //
+                for (callIndex = 0; callIndex < CALLS_PER_PASS; callIndex++)
+                {
+                    if (WdfObjectIsCustomType(dmfModuleThread,
+                                              Thread))
+                    {
+                        ModuleContext->ChecksPassed++;
+                    }
+                }
+                break;
+            case ModuleValidation_Benchmark_TypeTag:
+                // What Methods do in non-debug builds by default.
+                //
+                for (callIndex = 0; callIndex < CALLS_PER_PASS; callIndex++)
+                {
+                    if (DMF_ModuleTypeTagGet(dmfModuleThread) == DMF_MODULE_TYPE_TAG(Thread))
+                    {
+                        ModuleContext->ChecksPassed++;
+                    }
+                }
+                break;
+            case ModuleValidation_Benchmark_MethodCall:
+                // A complete call to a Method that does very little other than validate its handle.
+                //
+                for (callIndex = 0; callIndex < CALLS_PER_PASS; callIndex++)
+                {
+                    if (! DMF_Thread_IsStopPending(dmfModuleThread))
+                    {
+                        ModuleContext->ChecksPassed++;
+                    }
+                }
+                break;
+            default:
+                DmfAssert(FALSE);
+                break;
+        }
+        numberOfCalls += CALLS_PER_PASS;
+        elapsedTimeMs = TestsUtility_TimeMsGet() - startTimeMs;
+    } while ((elapsedTimeMs < BENCHMARK_DURATION_MS) &&
+             (! ModuleContext->Closing));
+
+    // Nanoseconds per call, scaled by 1000 so that sub-nanosecond differences are visible.
+    //
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "ModuleValidation benchmark: Benchmark=%d Calls=%I64d Picoseconds/Call=%I64d",
+                Benchmark,
+                numberOfCalls,
+                (elapsedTimeMs * 1000 * 1000 * 1000) / numberOfCalls);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ModuleValidation_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_ModuleValidation* moduleContext;
+    ModuleValidation_Benchmark benchmark;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    Tests_ModuleValidation_Functional(dmfModule,
+                                      moduleContext);
+
+    Tests_ModuleValidation_OpenOnFirstUse(moduleContext);
+
+    for (benchmark = ModuleValidation_Benchmark_CustomType; benchmark < ModuleValidation_Benchmark_Maximum; benchmark++)
+    {
+        if (DMF_Thread_IsStopPending(DmfModuleThread) ||
+            moduleContext->Closing)
+        {
+            break;
+        }
+
+        Tests_ModuleValidation_Benchmark(moduleContext,
+                                         benchmark);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ModuleValidation_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_ModuleValidation.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_ModuleValidation* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ModuleValidation_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_ModuleValidation.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_ModuleValidation* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->Closing = TRUE;
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_ModuleValidation_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_ModuleValidation* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_ModuleValidation_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    // Thread (Open on First Use)
+    // --------------------------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_ModuleValidation_WorkThread;
+    moduleAttributes.OpenOnFirstUse = TRUE;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadOpenOnFirstUse);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_ModuleValidation_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_ModuleValidation.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_ModuleValidation;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_ModuleValidation;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_ModuleValidation);
+    dmfCallbacksDmf_Tests_ModuleValidation.ChildModulesAdd = DMF_Tests_ModuleValidation_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_ModuleValidation.DeviceOpen = Tests_ModuleValidation_Open;
+    dmfCallbacksDmf_Tests_ModuleValidation.DeviceClose = Tests_ModuleValidation_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_ModuleValidation,
+                                            Tests_ModuleValidation,
+                                            DMF_CONTEXT_Tests_ModuleValidation,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_ModuleValidation.CallbacksDmf = &dmfCallbacksDmf_Tests_ModuleValidation;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_ModuleValidation,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ModuleValidation.c
+//
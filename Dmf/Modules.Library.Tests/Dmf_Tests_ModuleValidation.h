@@ -0,0 +1,32 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ModuleValidation.h
+
+Abstract:
+
+    Companion file to Dmf_Tests_ModuleValidation.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// This macro declares the following functions:
+// DMF_Tests_ModuleValidation_ATTRIBUTES_INIT()
+// DMF_Tests_ModuleValidation_Create()
+//
+DECLARE_DMF_MODULE_NO_CONFIG(Tests_ModuleValidation)
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ModuleValidation.h
+//
@@ -0,0 +1,301 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ParallelOpen.c
+
+Abstract:
+
+    Functional tests for opening the Modules of a Module Collection in parallel
+    (DMF_MODULE_ATTRIBUTES.OpenInParallel). The Client adds several instances of this
+    Module, some of which set OpenInParallel. Each instance checks that the instances
+    it must be opened after are open when its Open callback starts.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_ParallelOpen.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Shared by all the instances of this Module of a WDFDEVICE.
+//
+typedef struct
+{
+    // Number of instances whose Open callback is running.
+    //
+    LONG volatile NumberOfOpensRunning;
+    // Largest value of NumberOfOpensRunning since the device was added.
+    //
+    LONG volatile MaximumNumberOfOpensRunning;
+    // Number of instances that are open.
+    //
+    LONG volatile NumberOfModulesOpen;
+} TESTS_PARALLELOPEN_SHARED;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(TESTS_PARALLELOPEN_SHARED, Tests_ParallelOpen_SharedContextGet)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // State shared by the instances of the device.
+    //
+    TESTS_PARALLELOPEN_SHARED* Shared;
+} DMF_CONTEXT_Tests_ParallelOpen;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_ParallelOpen)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(Tests_ParallelOpen)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_ParallelOpen_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_ParallelOpen.
+    Check the order in which the instances of the device are opened.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    DMF_CONTEXT_Tests_ParallelOpen* moduleContext;
+    DMF_CONFIG_Tests_ParallelOpen* moduleConfig;
+    TESTS_PARALLELOPEN_SHARED* shared;
+    LONG numberOfOpensRunning;
+    LONG maximumNumberOfOpensRunning;
+    LONG numberOfModulesOpen;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    shared = moduleContext->Shared;
+
+    numberOfOpensRunning = InterlockedIncrement(&shared->NumberOfOpensRunning);
+    do
+    {
+        maximumNumberOfOpensRunning = shared->MaximumNumberOfOpensRunning;
+        if (numberOfOpensRunning <= maximumNumberOfOpensRunning)
+        {
+            break;
+        }
+    } while (InterlockedCompareExchange(&shared->MaximumNumberOfOpensRunning,
+                                        numberOfOpensRunning,
+                                        maximumNumberOfOpensRunning) != maximumNumberOfOpensRunning);
+    numberOfModulesOpen = shared->NumberOfModulesOpen;
+
+    TraceInformation(DMF_TRACE, "DmfModule=0x%p NumberOfModulesOpen=%d NumberOfOpensRunning=%d MaximumNumberOfOpensRunning=%d",
+                     DmfModule,
+                     numberOfModulesOpen,
+                     numberOfOpensRunning,
+                     shared->MaximumNumberOfOpensRunning);
+
+    // The Modules this Module must be opened after are open.
+    //
+    DmfAssert(numberOfModulesOpen >= moduleConfig->ModulesOpenBefore);
+    if (moduleConfig->OpensAlone)
+    {
+        // Modules that do not set OpenInParallel are opened alone.
+        //
+        DmfAssert(1 == numberOfOpensRunning);
+    }
+
+    DMF_Utility_DelayMilliseconds(moduleConfig->OpenDelayMs);
+
+    InterlockedIncrement(&shared->NumberOfModulesOpen);
+    InterlockedDecrement(&shared->NumberOfOpensRunning);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", STATUS_SUCCESS);
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ParallelOpen_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_ParallelOpen.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_ParallelOpen* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext->Shared->NumberOfModulesOpen > 0);
+    InterlockedDecrement(&moduleContext->Shared->NumberOfModulesOpen);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_ParallelOpen_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_ParallelOpen.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_ParallelOpen;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_ParallelOpen;
+    WDF_OBJECT_ATTRIBUTES sharedAttributes;
+    TESTS_PARALLELOPEN_SHARED* shared;
+    DMF_CONTEXT_Tests_ParallelOpen* moduleContext;
+
+    PAGED_CODE();
+
+    // Instances are created one at a time, before any of them is opened. The first
+    // instance allocates the shared state. The others get its address.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&sharedAttributes,
+                                            TESTS_PARALLELOPEN_SHARED);
+    ntStatus = WdfObjectAllocateContext(Device,
+                                        &sharedAttributes,
+                                        (VOID**)&shared);
+    if ((! NT_SUCCESS(ntStatus)) ||
+        (NULL == shared))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAllocateContext fails: ntStatus=%!STATUS!", ntStatus);
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_ParallelOpen);
+    dmfCallbacksDmf_Tests_ParallelOpen.DeviceOpen = Tests_ParallelOpen_Open;
+    dmfCallbacksDmf_Tests_ParallelOpen.DeviceClose = Tests_ParallelOpen_Close;
+
+    // Only Modules opened during PrepareHardware or SelfManagedIoInit can be opened in parallel.
+    //
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_ParallelOpen,
+                                            Tests_ParallelOpen,
+                                            DMF_CONTEXT_Tests_ParallelOpen,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_PrepareHardware);
+
+    dmfModuleDescriptor_Tests_ParallelOpen.CallbacksDmf = &dmfCallbacksDmf_Tests_ParallelOpen;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_ParallelOpen,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    moduleContext = DMF_CONTEXT_GET(*DmfModule);
+    moduleContext->Shared = shared;
+
+Exit:
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ParallelOpen.c
+//
@@ -0,0 +1,50 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_ParallelOpen.h
+
+Abstract:
+
+    Companion file to Dmf_Tests_ParallelOpen.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// Client uses this structure to configure the Module specific parameters.
+//
+typedef struct
+{
+    // How long this Module's Open callback takes.
+    //
+    ULONG OpenDelayMs;
+    // Number of Tests_ParallelOpen Modules of the device that must be open when
+    // this Module's Open callback starts.
+    //
+    LONG ModulesOpenBefore;
+    // TRUE means that no other Tests_ParallelOpen Module of the device may be opening
+    // while this Module is opening.
+    //
+    BOOLEAN OpensAlone;
+} DMF_CONFIG_Tests_ParallelOpen;
+
+// This macro declares the following functions:
+// DMF_Tests_ParallelOpen_ATTRIBUTES_INIT()
+// DMF_CONFIG_Tests_ParallelOpen_AND_ATTRIBUTES_INIT()
+// DMF_Tests_ParallelOpen_Create()
+//
+DECLARE_DMF_MODULE(Tests_ParallelOpen)
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_ParallelOpen.h
+//
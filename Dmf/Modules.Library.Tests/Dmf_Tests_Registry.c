@@ -293,6 +293,46 @@ RegistryValueComparisonFunction_IfDefault(
 }
 
 #if !defined(DMF_USER_MODE)
+_Function_class_(EVT_DMF_Registry_ValueValidate)
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+RegistryValueValidate_IfOriginal(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR ValueName,
+    _In_reads_bytes_(ValueDataSize) VOID* ValueData,
+    _In_ ULONG ValueDataSize
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(ValueName);
+
+    return ((sizeof(ulongOriginal) == ValueDataSize) &&
+            (*(ULONG*)ValueData == ulongOriginal));
+}
+
+_Function_class_(EVT_DMF_Registry_ValueValidate)
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+static
+BOOLEAN
+RegistryValueValidate_IfZero(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR ValueName,
+    _In_reads_bytes_(ValueDataSize) VOID* ValueData,
+    _In_ ULONG ValueDataSize
+    )
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(ValueName);
+
+    return ((sizeof(ULONG) == ValueDataSize) &&
+            (0 == *(ULONG*)ValueData));
+}
+
 // User-mode driver cannot create arbitrary keys at runtime, 
 // so test should not delete them at runtime.  
 // For User-mode, The arbitrary path is created through INF and not deleted during test.
@@ -1705,6 +1745,330 @@ Tests_Registry_TreeWriteDeferred(
     DmfAssert(STATUS_SUCCESS == ntStatus);
 }
 #pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_Registry_Cache(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_Registry* moduleContext;
+    NTSTATUS ntStatus;
+    Registry_CacheStatistics statisticsBefore;
+    Registry_CacheStatistics statisticsAfter;
+    HANDLE registryHandle;
+    ULONG ulong;
+    ULONG readIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Write the value to cache.
+    //
+    ntStatus = DMF_Registry_PathAndValueWriteDword(moduleContext->DmfModuleRegistry,
+                                                   REGISTRY_PATH_NAME,
+                                                   VALUENAME_DWORD,
+                                                   ulongOriginal);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    DMF_Registry_CacheEnable(moduleContext->DmfModuleRegistry);
+
+    // The first read is a miss. The others are hits.
+    //
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsBefore);
+    for (readIndex = 0; readIndex < 4; readIndex++)
+    {
+        ZERO_BUFFER(ulong);
+        ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                      REGISTRY_PATH_NAME,
+                                                      VALUENAME_DWORD,
+                                                      &ulong);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(ulong == ulongOriginal);
+    }
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsAfter);
+    DmfAssert(statisticsAfter.Misses - statisticsBefore.Misses == 1);
+    DmfAssert(statisticsAfter.Hits - statisticsBefore.Hits == 3);
+    DmfAssert(statisticsAfter.Invalidations == statisticsBefore.Invalidations);
+
+    // Change the value without using the path Methods.
+    //
+    ntStatus = DMF_Registry_HandleOpenByNameEx(moduleContext->DmfModuleRegistry,
+                                               REGISTRY_PATH_NAME,
+                                               GENERIC_ALL,
+                                               FALSE,
+                                               &registryHandle);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        ntStatus = DMF_Registry_ValueWriteDword(moduleContext->DmfModuleRegistry,
+                                                registryHandle,
+                                                VALUENAME_DWORD,
+                                                ~ulongOriginal);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DMF_Registry_HandleClose(moduleContext->DmfModuleRegistry,
+                                 registryHandle);
+    }
+
+    // Give the change notification time to arrive.
+    //
+    ntStatus = DMF_AlertableSleep_Sleep(moduleContext->DmfModuleAlertableSleep,
+                                        0,
+                                        1000);
+    DMF_AlertableSleep_ResetForReuse(moduleContext->DmfModuleAlertableSleep,
+                                     0);
+    if ((! NT_SUCCESS(ntStatus)) ||
+        moduleContext->AbortTests)
+    {
+        goto Exit;
+    }
+
+    // The cached key is discarded so the new value is read from the registry and cached again.
+    //
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsBefore);
+    for (readIndex = 0; readIndex < 2; readIndex++)
+    {
+        ZERO_BUFFER(ulong);
+        ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                      REGISTRY_PATH_NAME,
+                                                      VALUENAME_DWORD,
+                                                      &ulong);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        DmfAssert(ulong == ~ulongOriginal);
+    }
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsAfter);
+    DmfAssert(statisticsAfter.Invalidations - statisticsBefore.Invalidations == 1);
+    DmfAssert(statisticsAfter.Misses - statisticsBefore.Misses == 1);
+    DmfAssert(statisticsAfter.Hits - statisticsBefore.Hits == 1);
+
+    // Nothing is counted while the cache is disabled.
+    //
+    DMF_Registry_CacheDisable(moduleContext->DmfModuleRegistry);
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsBefore);
+    ZERO_BUFFER(ulong);
+    ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                  REGISTRY_PATH_NAME,
+                                                  VALUENAME_DWORD,
+                                                  &ulong);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(ulong == ~ulongOriginal);
+    DMF_Registry_CacheStatisticsGet(moduleContext->DmfModuleRegistry,
+                                    &statisticsAfter);
+    DmfAssert(statisticsAfter.Hits == statisticsBefore.Hits);
+    DmfAssert(statisticsAfter.Misses == statisticsBefore.Misses);
+
+Exit:
+
+    DMF_Registry_CacheDisable(moduleContext->DmfModuleRegistry);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_Registry_TreeRead(
+    _In_ DMFMODULE DmfModuleRegistry
+    )
+{
+    NTSTATUS ntStatus;
+    WCHAR string[64];
+    UCHAR binary[4];
+    ULONG ulong;
+    ULONG ulongMismatch;
+    ULONG ulongRejected;
+    ULONG ulongMissing;
+    ULONG ulongMissingKey;
+    ULONG ulongNoDefault;
+    ULONGLONG ulonglong;
+    ULONG ulongDefault;
+    UCHAR binaryDefault[sizeof(binary)];
+
+    PAGED_CODE();
+
+    ulongDefault = 0x5A5A5A5A;
+    RtlFillMemory(binaryDefault,
+                  sizeof(binaryDefault),
+                  0xA5);
+
+    // Valid values are read. The default is used when the type does not match, the validation
+    // callback rejects the value, the value or key does not exist or the value does not fit.
+    //
+    Registry_ReadEntry readEntries[] =
+    {
+        { REGISTRY_PATH_NAME, VALUENAME_DWORD, REG_DWORD, &ulong, sizeof(ulong), &ulongDefault, sizeof(ulongDefault), RegistryValueValidate_IfOriginal },
+        { REGISTRY_PATH_NAME, VALUENAME_QWORD, REG_QWORD, &ulonglong, sizeof(ulonglong), NULL, 0, NULL },
+        { REGISTRY_PATH_NAME, VALUENAME_STRING, REG_SZ, string, sizeof(string), NULL, 0, NULL },
+        { REGISTRY_PATH_NAME, VALUENAME_STRING, REG_DWORD, &ulongMismatch, sizeof(ulongMismatch), &ulongDefault, sizeof(ulongDefault), NULL },
+        { REGISTRY_PATH_NAME, VALUENAME_DWORD, REG_DWORD, &ulongRejected, sizeof(ulongRejected), &ulongDefault, sizeof(ulongDefault), RegistryValueValidate_IfZero },
+        { REGISTRY_PATH_NAME, L"missing", REG_DWORD, &ulongMissing, sizeof(ulongMissing), &ulongDefault, sizeof(ulongDefault), NULL },
+        { REGISTRY_PATH_NAME L"\\" SUBKEYNAME_1, VALUENAME_DWORD, REG_DWORD, &ulongMissingKey, sizeof(ulongMissingKey), &ulongDefault, sizeof(ulongDefault), NULL },
+        { REGISTRY_PATH_NAME, VALUENAME_BINARY, REG_BINARY, binary, sizeof(binary), binaryDefault, sizeof(binaryDefault), NULL },
+    };
+
+    ZERO_BUFFER(string);
+    ZERO_BUFFER(binary);
+    ZERO_BUFFER(ulong);
+    ZERO_BUFFER(ulongMismatch);
+    ZERO_BUFFER(ulongRejected);
+    ZERO_BUFFER(ulongMissing);
+    ZERO_BUFFER(ulongMissingKey);
+    ZERO_BUFFER(ulonglong);
+    ntStatus = DMF_Registry_TreeRead(DmfModuleRegistry,
+                                     readEntries,
+                                     ARRAYSIZE(readEntries));
+    DmfAssert(STATUS_SUCCESS == ntStatus);
+    DmfAssert(ulong == ulongOriginal);
+    DmfAssert(ulonglong == ulonglongOriginal);
+    DmfAssert(0 == wcscmp(string,
+                          stringOriginal));
+    DmfAssert(ulongMismatch == ulongDefault);
+    DmfAssert(ulongRejected == ulongDefault);
+    DmfAssert(ulongMissing == ulongDefault);
+    DmfAssert(ulongMissingKey == ulongDefault);
+    DmfAssert(sizeof(binaryDefault) == RtlCompareMemory(binary,
+                                                        binaryDefault,
+                                                        sizeof(binaryDefault)));
+
+    // Without a default, the destination is left unchanged and the failure is returned.
+    //
+    Registry_ReadEntry readEntriesNoDefault[] =
+    {
+        { REGISTRY_PATH_NAME, L"missing", REG_DWORD, &ulongNoDefault, sizeof(ulongNoDefault), NULL, 0, NULL },
+        { REGISTRY_PATH_NAME, VALUENAME_DWORD, REG_DWORD, &ulong, sizeof(ulong), NULL, 0, NULL },
+    };
+
+    ulongNoDefault = ulongDefault;
+    ZERO_BUFFER(ulong);
+    ntStatus = DMF_Registry_TreeRead(DmfModuleRegistry,
+                                     readEntriesNoDefault,
+                                     ARRAYSIZE(readEntriesNoDefault));
+    DmfAssert(! NT_SUCCESS(ntStatus));
+    DmfAssert(ulongNoDefault == ulongDefault);
+    // Other entries are still read.
+    //
+    DmfAssert(ulong == ulongOriginal);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+Tests_Registry_DeferredWrite(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_Registry* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG ulong;
+    ULONG writeIndex;
+    ULONGLONG ulonglong;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Keep the writes pending until they are flushed on demand.
+    //
+    DMF_Registry_DeferredWriteIntervalSet(moduleContext->DmfModuleRegistry,
+                                          60000);
+
+    // Only the last of several writes to the same value reaches the registry.
+    //
+    for (writeIndex = 1; writeIndex <= 3; writeIndex++)
+    {
+        ulong = writeIndex;
+        ntStatus = DMF_Registry_PathAndValueWriteDeferred(moduleContext->DmfModuleRegistry,
+                                                          REGISTRY_PATH_NAME,
+                                                          VALUENAME_DWORD,
+                                                          REG_DWORD,
+                                                          (UCHAR*)&ulong,
+                                                          sizeof(ulong));
+        DmfAssert(NT_SUCCESS(ntStatus));
+    }
+    ulonglong = ulonglongOriginal;
+    ntStatus = DMF_Registry_PathAndValueWriteDeferred(moduleContext->DmfModuleRegistry,
+                                                      REGISTRY_PATH_NAME,
+                                                      VALUENAME_QWORD,
+                                                      REG_QWORD,
+                                                      (UCHAR*)&ulonglong,
+                                                      sizeof(ulonglong));
+    DmfAssert(NT_SUCCESS(ntStatus));
+    // The data is copied.
+    //
+    ulong = 0;
+    ulonglong = 0;
+
+    // Nothing is written until the writes are flushed.
+    //
+    ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                  REGISTRY_PATH_NAME,
+                                                  VALUENAME_DWORD,
+                                                  &ulong);
+    DmfAssert(STATUS_OBJECT_NAME_NOT_FOUND == ntStatus);
+
+    ntStatus = DMF_Registry_DeferredWriteFlush(moduleContext->DmfModuleRegistry);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    ZERO_BUFFER(ulong);
+    ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                  REGISTRY_PATH_NAME,
+                                                  VALUENAME_DWORD,
+                                                  &ulong);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(3 == ulong);
+    ZERO_BUFFER(ulonglong);
+    ntStatus = DMF_Registry_PathAndValueReadQword(moduleContext->DmfModuleRegistry,
+                                                  REGISTRY_PATH_NAME,
+                                                  VALUENAME_QWORD,
+                                                  &ulonglong);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(ulonglong == ulonglongOriginal);
+
+    // Flushing when nothing is pending does nothing.
+    //
+    ntStatus = DMF_Registry_DeferredWriteFlush(moduleContext->DmfModuleRegistry);
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    // Pending writes are also flushed when the interval expires.
+    //
+    DMF_Registry_DeferredWriteIntervalSet(moduleContext->DmfModuleRegistry,
+                                          100);
+    ulong = ulongOriginal;
+    ntStatus = DMF_Registry_PathAndValueWriteDeferred(moduleContext->DmfModuleRegistry,
+                                                      REGISTRY_PATH_NAME,
+                                                      VALUENAME_DWORD,
+                                                      REG_DWORD,
+                                                      (UCHAR*)&ulong,
+                                                      sizeof(ulong));
+    DmfAssert(NT_SUCCESS(ntStatus));
+
+    ntStatus = DMF_AlertableSleep_Sleep(moduleContext->DmfModuleAlertableSleep,
+                                        0,
+                                        2000);
+    DMF_AlertableSleep_ResetForReuse(moduleContext->DmfModuleAlertableSleep,
+                                     0);
+    if ((! NT_SUCCESS(ntStatus)) ||
+        moduleContext->AbortTests)
+    {
+        return;
+    }
+
+    ZERO_BUFFER(ulong);
+    ntStatus = DMF_Registry_PathAndValueReadDword(moduleContext->DmfModuleRegistry,
+                                                  REGISTRY_PATH_NAME,
+                                                  VALUENAME_DWORD,
+                                                  &ulong);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    DmfAssert(ulong == ulongOriginal);
+}
+#pragma code_seg()
 #endif
 
 #pragma code_seg("PAGE")
@@ -2023,6 +2387,68 @@ Return Value:
     //
     Tests_Registry_Path_DeleteValues(moduleContext->DmfModuleRegistry);
     Tests_Registry_Path_DeletePath(moduleContext->DmfModuleRegistry);
+
+    // Tree Read Tests
+    // ---------------
+    //
+
+    // Make sure the path does not exist
+    //
+    Tests_Registry_ValidatePathDeleted(moduleContext->DmfModuleRegistry);
+
+    // Write the values and read them back with a table.
+    //
+    Tests_Registry_Path_WriteValues(moduleContext->DmfModuleRegistry);
+    Tests_Registry_TreeRead(moduleContext->DmfModuleRegistry);
+
+    // Delete everything we wrote.
+    //
+    Tests_Registry_Path_DeleteValues(moduleContext->DmfModuleRegistry);
+    Tests_Registry_Path_DeletePath(moduleContext->DmfModuleRegistry);
+
+    // Cache Tests
+    // -----------
+    //
+
+    // Make sure the path does not exist
+    //
+    Tests_Registry_ValidatePathDeleted(moduleContext->DmfModuleRegistry);
+
+    // Read a cached value and change it from outside the cache.
+    //
+    Tests_Registry_Cache(DmfModule);
+
+    // Delete everything we wrote.
+    //
+    Tests_Registry_Path_DeleteValues(moduleContext->DmfModuleRegistry);
+    Tests_Registry_Path_DeletePath(moduleContext->DmfModuleRegistry);
+
+    if (moduleContext->AbortTests)
+    {
+        goto Exit;
+    }
+
+    // Deferred Value Write Tests
+    // --------------------------
+    //
+
+    // Make sure the path does not exist
+    //
+    Tests_Registry_ValidatePathDeleted(moduleContext->DmfModuleRegistry);
+
+    // Coalesce pending writes and flush them on demand and by the timer.
+    //
+    Tests_Registry_DeferredWrite(DmfModule);
+
+    // Delete everything we wrote.
+    //
+    Tests_Registry_Path_DeleteValues(moduleContext->DmfModuleRegistry);
+    Tests_Registry_Path_DeletePath(moduleContext->DmfModuleRegistry);
+
+    if (moduleContext->AbortTests)
+    {
+        goto Exit;
+    }
 #endif
 
 
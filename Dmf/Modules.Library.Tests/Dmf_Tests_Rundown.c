@@ -0,0 +1,485 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_Rundown.c
+
+Abstract:
+
+    Functional tests and scaling benchmark for Dmf_Rundown Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include "Dmf_Tests_Rundown.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of threads that acquire and release references at the same time.
+//
+#define WORKER_THREAD_COUNT             4
+// Number of Reference/Dereference pairs each worker thread performs before checking
+// if it should stop.
+//
+#define REFERENCES_PER_PASS             1024
+// How long each step of the benchmark runs.
+//
+#define BENCHMARK_STEP_DURATION_MS      1000
+// How long an idle worker thread waits before checking if it is active.
+//
+#define WORKER_IDLE_DELAY_MS            10
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Rundown Module. (Test Module)
+    //
+    DMFMODULE DmfModuleRundown;
+    // Threads that acquire and release references.
+    //
+    DMFMODULE DmfModuleThreadWorker[WORKER_THREAD_COUNT];
+    // Thread that runs the benchmark steps and ends and restarts rundown.
+    //
+    DMFMODULE DmfModuleThreadControl;
+    // Number of worker threads that are currently acquiring references.
+    //
+    volatile LONG ActiveWorkerCount;
+    // Number of Reference/Dereference pairs that succeeded during the current step.
+    //
+    volatile LONG64 ReferenceCount;
+    // Indicates Module has started closing so that new work is not started.
+    //
+    BOOLEAN Closing;
+} DMF_CONTEXT_Tests_Rundown;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_Rundown)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_Rundown)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Rundown_WorkThreadWorker(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_Rundown* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG workerIndex;
+    ULONG referenceIndex;
+    LONG referencesAcquired;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    workerIndex = TestsUtility_ThreadIndexGet(moduleContext->DmfModuleThreadWorker,
+                                              WORKER_THREAD_COUNT,
+                                              DmfModuleThread);
+
+    if (workerIndex < (ULONG)moduleContext->ActiveWorkerCount)
+    {
+        // References fail while rundown is ended. That is expected.
+        //
+        referencesAcquired = 0;
+        for (referenceIndex = 0; referenceIndex < REFERENCES_PER_PASS; referenceIndex++)
+        {
+            ntStatus = DMF_Rundown_Reference(moduleContext->DmfModuleRundown);
+            if (NT_SUCCESS(ntStatus))
+            {
+                referencesAcquired++;
+                DMF_Rundown_Dereference(moduleContext->DmfModuleRundown);
+            }
+        }
+        InterlockedAdd64(&moduleContext->ReferenceCount,
+                         referencesAcquired);
+    }
+    else
+    {
+        DMF_Utility_DelayMilliseconds(WORKER_IDLE_DELAY_MS);
+    }
+
+    // Repeat the test, until stop is signaled or the function stopped because the
+    // driver is stopping.
+    //
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Rundown_WorkThreadControl(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Tests_Rundown* moduleContext;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Benchmark: Measure how many Reference/Dereference pairs per second are performed
+    // as the number of threads that perform them increases.
+    //
+    TestsUtility_ScalingBenchmarkRun(DmfModuleThread,
+                                     "Rundown",
+                                     WORKER_THREAD_COUNT,
+                                     BENCHMARK_STEP_DURATION_MS,
+                                     &moduleContext->ActiveWorkerCount,
+                                     &moduleContext->ReferenceCount,
+                                     &moduleContext->Closing);
+
+    // Functional test: After rundown ends no references can be acquired until it is
+    // started again. Workers keep trying while this happens.
+    //
+    DMF_Rundown_EndAndWait(moduleContext->DmfModuleRundown);
+    ntStatus = DMF_Rundown_Reference(moduleContext->DmfModuleRundown);
+    DmfAssert(! NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        DMF_Rundown_Dereference(moduleContext->DmfModuleRundown);
+    }
+
+    if ((! DMF_Thread_IsStopPending(DmfModuleThread)) &&
+        (! moduleContext->Closing))
+    {
+        DMF_Rundown_Start(moduleContext->DmfModuleRundown);
+        ntStatus = DMF_Rundown_Reference(moduleContext->DmfModuleRundown);
+        DmfAssert(NT_SUCCESS(ntStatus));
+        if (NT_SUCCESS(ntStatus))
+        {
+            DMF_Rundown_Dereference(moduleContext->DmfModuleRundown);
+        }
+
+        // Repeat the test, until stop is signaled or the function stopped because the
+        // driver is stopping.
+        //
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Tests_Rundown_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Test_Rundown.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_Rundown* moduleContext;
+    ULONG workerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_Rundown_Start(moduleContext->DmfModuleRundown);
+
+    // Start the threads.
+    //
+    ntStatus = STATUS_SUCCESS;
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadWorker[workerIndex]);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThreadControl);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
+    // Tell the threads they have work to do.
+    //
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+    DMF_Thread_WorkReady(moduleContext->DmfModuleThreadControl);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_Rundown_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Close an instance of a DMF Module of type Test_Rundown.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_Rundown* moduleContext;
+    ULONG workerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleContext->Closing = TRUE;
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThreadControl);
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_Thread_Stop(moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+
+    DMF_Rundown_EndAndWait(moduleContext->DmfModuleRundown);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_Rundown_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_Rundown* moduleContext;
+    DMF_CONFIG_Thread moduleConfigThread;
+    ULONG workerIndex;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Rundown (Test)
+    // --------------
+    //
+    DMF_Rundown_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleRundown);
+
+    // Thread (Workers)
+    // ----------------
+    //
+    for (workerIndex = 0; workerIndex < WORKER_THREAD_COUNT; workerIndex++)
+    {
+        DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                              &moduleAttributes);
+        moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+        moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_Rundown_WorkThreadWorker;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleThreadWorker[workerIndex]);
+    }
+
+    // Thread (Control)
+    // ----------------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_Rundown_WorkThreadControl;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThreadControl);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_Rundown_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Test_Rundown.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_Rundown;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_Rundown;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_Rundown);
+    dmfCallbacksDmf_Tests_Rundown.ChildModulesAdd = DMF_Tests_Rundown_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_Rundown.DeviceOpen = Tests_Rundown_Open;
+    dmfCallbacksDmf_Tests_Rundown.DeviceClose = Tests_Rundown_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_Rundown,
+                                            Tests_Rundown,
+                                            DMF_CONTEXT_Tests_Rundown,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_Tests_Rundown.CallbacksDmf = &dmfCallbacksDmf_Tests_Rundown;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_Rundown,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_Rundown.c
+//
@@ -190,6 +190,130 @@ TaskDescriptionArray[] = {
 #define TASK_COUNT                  (ARRAYSIZE(TaskDescriptionArray))
 #define TASK_DELAY_MS               (1000)
 
+// Configuration of a task that uses the shared scheduler.
+// All these tasks are deferred and start in D0Entry.
+//
+typedef struct
+{
+    ScheduledTask_Persistence_Type PersistenceType;
+    ULONG TimeMsBeforeInitialCall;
+    ULONG SharedSchedulerToleranceMs;
+    ULONG SharedSchedulerTaskId;
+} Tests_ScheduledTask_SharedTaskDescription;
+
+// Context data for a task that uses the shared scheduler.
+//
+typedef struct
+{
+    // A number of times this task's callback started.
+    //
+    LONG TimesExecuted;
+    // A number of times this task's callback finished.
+    //
+    LONG TimesFinished;
+    // Order in which the shared scheduler executed this task relative to the other tasks.
+    //
+    LONG ExecutionOrder;
+    // Time when this task's callback last started.
+    //
+    ULONGLONG ExecutionTimeMs;
+    // And index for this task's description in SharedTaskDescriptionArray.
+    //
+    ULONG DescriptionIndex;
+} Tests_ScheduledTask_SharedTaskContext;
+
+// Format of the records in the registry value the shared scheduler writes TimesRun to.
+//
+typedef struct
+{
+    ULONG TaskId;
+    ULONG TimesRun;
+} Tests_ScheduledTask_TimesRunRecord;
+
+#define SHARED_TIMES_RUN_VALUE_NAME         L"ScheduledTaskTimesRun"
+#define SHARED_TIMES_RUN_RECORD_MAXIMUM     (64)
+#define SHARED_TASK_ID_FIRST                (1001)
+#define SHARED_TASK_ID_SECOND               (1002)
+// Tasks that execute together in the same timer callback must start within this time.
+//
+#define SHARED_TASK_COALESCE_MAXIMUM_MS     (100)
+// Time the task that is closed while it executes keeps executing.
+//
+#define SHARED_TASK_CLOSE_WAIT_MS           (1000)
+
+// Indexes of the tasks in SharedTaskDescriptionArray.
+//
+#define SHARED_TASK_ORDER_THIRD             (0)
+#define SHARED_TASK_ORDER_FIRST             (1)
+#define SHARED_TASK_ORDER_SECOND            (2)
+#define SHARED_TASK_COALESCE_EARLY          (3)
+#define SHARED_TASK_COALESCE_LATE           (4)
+#define SHARED_TASK_PERSISTENT_FIRST        (5)
+#define SHARED_TASK_PERSISTENT_SECOND       (6)
+#define SHARED_TASK_CLOSE_WAIT              (7)
+
+// Array of descriptions for all the tasks that use the shared scheduler.
+// All of them are validated by the same timer as the other tasks, so they
+// all start executing before TASK_DELAY_MS * 2.
+//
+static
+Tests_ScheduledTask_SharedTaskDescription
+SharedTaskDescriptionArray[] = {
+    // Added in a different order than their deadlines. They must execute in
+    // the order of their deadlines.
+    //
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        600,
+        0,
+        0
+    },
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        200,
+        0,
+        0
+    },
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        400,
+        0,
+        0
+    },
+    // The second task's tolerance allows it to execute 300 ms early together
+    // with the first task.
+    //
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        1000,
+        0,
+        0
+    },
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        1300,
+        400,
+        0
+    },
+    // Persistent tasks that execute together. TimesRun of both of them is
+    // written once after both of them have executed.
+    //
+    {   ScheduledTask_Persistence_PersistentAcrossReboots,
+        1500,
+        0,
+        SHARED_TASK_ID_FIRST
+    },
+    {   ScheduledTask_Persistence_PersistentAcrossReboots,
+        1550,
+        100,
+        SHARED_TASK_ID_SECOND
+    },
+    // Still executing when validation closes it. Close must wait for it.
+    //
+    {   ScheduledTask_Persistence_NotPersistentAcrossReboots,
+        1700,
+        0,
+        0
+    }
+};
+
+#define SHARED_TASK_COUNT           (ARRAYSIZE(SharedTaskDescriptionArray))
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -206,6 +330,19 @@ typedef struct
     // Timer for delayed validation.
     //
     WDFTIMER ValidationTimer;
+    // ScheduledTask Modules that use the shared scheduler.
+    //
+    DMFMODULE DmfModuleSharedScheduledTask[SHARED_TASK_COUNT];
+    // Callback contexts for the above.
+    //
+    Tests_ScheduledTask_SharedTaskContext SharedTaskContext[SHARED_TASK_COUNT];
+    // Incremented by each callback of the above to record the order they execute in.
+    //
+    LONG SharedExecutionSequence;
+    // Validation closed and opened SHARED_TASK_CLOSE_WAIT manually. So, this Module
+    // closes it instead of DMF.
+    //
+    BOOLEAN SharedCloseWaitOpenedManually;
 } DMF_CONTEXT_Tests_ScheduledTask;
 
 // This macro declares the following function:
@@ -260,6 +397,225 @@ Tests_ScheduledTask_TaskCallback(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_ScheduledTask_SharedTimesRunRead(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TaskId,
+    _Out_ ULONG* TimesRun
+    )
+{
+    NTSTATUS ntStatus;
+    WDFKEY wdfKey;
+    WDFDRIVER driver;
+    UNICODE_STRING valueNameString;
+    Tests_ScheduledTask_TimesRunRecord timesRunRecords[SHARED_TIMES_RUN_RECORD_MAXIMUM];
+    ULONG valueLength;
+    ULONG recordIndex;
+
+    PAGED_CODE();
+
+    *TimesRun = 0;
+    wdfKey = NULL;
+    driver = WdfDeviceGetDriver(DMF_ParentDeviceGet(DmfModule));
+
+    // Read what the shared scheduler has written to the registry, not what it holds in memory.
+    //
+    ntStatus = WdfDriverOpenParametersRegistryKey(driver,
+                                                  KEY_READ,
+                                                  WDF_NO_OBJECT_ATTRIBUTES,
+                                                  &wdfKey);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfDriverOpenParametersRegistryKey ntStatus=%!STATUS!", ntStatus);
+        wdfKey = NULL;
+        goto Exit;
+    }
+
+    valueLength = 0;
+    RtlInitUnicodeString(&valueNameString,
+                         SHARED_TIMES_RUN_VALUE_NAME);
+    ntStatus = WdfRegistryQueryValue(wdfKey,
+                                     &valueNameString,
+                                     sizeof(timesRunRecords),
+                                     timesRunRecords,
+                                     &valueLength,
+                                     NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRegistryQueryValue ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    ntStatus = STATUS_NOT_FOUND;
+    for (recordIndex = 0; recordIndex < valueLength / sizeof(Tests_ScheduledTask_TimesRunRecord); recordIndex++)
+    {
+        if (timesRunRecords[recordIndex].TaskId == TaskId)
+        {
+            *TimesRun = timesRunRecords[recordIndex].TimesRun;
+            ntStatus = STATUS_SUCCESS;
+            break;
+        }
+    }
+
+Exit:
+
+    if (wdfKey != NULL)
+    {
+        WdfRegistryClose(wdfKey);
+        wdfKey = NULL;
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_ScheduledTask_Callback)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+ScheduledTask_Result_Type 
+Tests_ScheduledTask_SharedTaskCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* CallbackContext,
+    _In_ WDF_POWER_DEVICE_STATE PreviousState)
+{
+    DMF_CONTEXT_Tests_ScheduledTask* moduleContext;
+    Tests_ScheduledTask_SharedTaskContext* taskContext;
+    NTSTATUS ntStatus;
+    ULONG timesRun;
+
+    UNREFERENCED_PARAMETER(PreviousState);
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DMF_ParentModuleGet(DmfModule));
+
+    taskContext = (Tests_ScheduledTask_SharedTaskContext*)CallbackContext;
+    DmfAssert(taskContext != NULL);
+
+    DmfAssert(taskContext->DescriptionIndex < SHARED_TASK_COUNT);
+
+    taskContext->ExecutionOrder = InterlockedIncrement(&moduleContext->SharedExecutionSequence);
+    taskContext->ExecutionTimeMs = TestsUtility_TimeMsGet();
+    InterlockedIncrement(&taskContext->TimesExecuted);
+
+    switch (taskContext->DescriptionIndex)
+    {
+    case SHARED_TASK_PERSISTENT_SECOND:
+        // The first persistent task has executed in the same timer callback just before
+        // this one. Its TimesRun is set, but it is not written until this one has executed.
+        //
+        ntStatus = DMF_ScheduledTask_TimesRunGet(moduleContext->DmfModuleSharedScheduledTask[SHARED_TASK_PERSISTENT_FIRST],
+                                                 &timesRun);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+        DmfAssert(1 == timesRun);
+
+        ntStatus = Tests_ScheduledTask_SharedTimesRunRead(DmfModule,
+                                                          SHARED_TASK_ID_FIRST,
+                                                          &timesRun);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+        DmfAssert(0 == timesRun);
+        break;
+
+    case SHARED_TASK_CLOSE_WAIT:
+        // Keep executing so that validation closes this task while it executes.
+        //
+        DMF_Utility_DelayMilliseconds(SHARED_TASK_CLOSE_WAIT_MS);
+        break;
+
+    default:
+        break;
+    }
+
+    InterlockedIncrement(&taskContext->TimesFinished);
+
+    return ScheduledTask_WorkResult_Success;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_ScheduledTask_SharedValidate(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ScheduledTask* moduleContext;
+    Tests_ScheduledTask_SharedTaskContext* taskContext;
+    DMFMODULE scheduledTaskModule;
+    NTSTATUS ntStatus;
+    ULONG index;
+    ULONG timesRun;
+    ULONG waitMs;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    taskContext = moduleContext->SharedTaskContext;
+
+    for (index = 0; index < SHARED_TASK_COUNT; index++)
+    {
+        DmfAssert(taskContext[index].DescriptionIndex == index);
+        DmfAssert(taskContext[index].TimesExecuted > 0);
+    }
+
+    // Tasks execute in the order of their deadlines.
+    //
+    DmfAssert(taskContext[SHARED_TASK_ORDER_FIRST].ExecutionOrder < taskContext[SHARED_TASK_ORDER_SECOND].ExecutionOrder);
+    DmfAssert(taskContext[SHARED_TASK_ORDER_SECOND].ExecutionOrder < taskContext[SHARED_TASK_ORDER_THIRD].ExecutionOrder);
+    DmfAssert(taskContext[SHARED_TASK_ORDER_THIRD].ExecutionOrder < taskContext[SHARED_TASK_COALESCE_EARLY].ExecutionOrder);
+
+    // The late task executes right after the early task instead of at its own deadline.
+    //
+    DmfAssert(taskContext[SHARED_TASK_COALESCE_EARLY].ExecutionOrder + 1 == taskContext[SHARED_TASK_COALESCE_LATE].ExecutionOrder);
+    DmfAssert(taskContext[SHARED_TASK_COALESCE_LATE].ExecutionTimeMs - taskContext[SHARED_TASK_COALESCE_EARLY].ExecutionTimeMs < SHARED_TASK_COALESCE_MAXIMUM_MS);
+
+    // Persistent tasks execute only once and both of their TimesRun are written.
+    //
+    for (index = SHARED_TASK_PERSISTENT_FIRST; index <= SHARED_TASK_PERSISTENT_SECOND; index++)
+    {
+        DmfAssert(1 == taskContext[index].TimesExecuted);
+
+        ntStatus = DMF_ScheduledTask_TimesRunGet(moduleContext->DmfModuleSharedScheduledTask[index],
+                                                 &timesRun);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+        DmfAssert(1 == timesRun);
+
+        ntStatus = Tests_ScheduledTask_SharedTimesRunRead(DmfModule,
+                                                          SharedTaskDescriptionArray[index].SharedSchedulerTaskId,
+                                                          &timesRun);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+        DmfAssert(1 == timesRun);
+    }
+
+    // Close the task while its callback executes. Close must not return until the callback
+    // has finished. Then, open it again so that it executes again after the next D0Entry.
+    //
+    scheduledTaskModule = moduleContext->DmfModuleSharedScheduledTask[SHARED_TASK_CLOSE_WAIT];
+    taskContext = &moduleContext->SharedTaskContext[SHARED_TASK_CLOSE_WAIT];
+    waitMs = 0;
+    while ((taskContext->TimesExecuted == taskContext->TimesFinished) &&
+           (waitMs < SHARED_TASK_CLOSE_WAIT_MS))
+    {
+        DMF_Utility_DelayMilliseconds(10);
+        waitMs += 10;
+    }
+    DmfAssert(taskContext->TimesExecuted == taskContext->TimesFinished + 1);
+
+    DMF_ModuleClose(scheduledTaskModule);
+    DmfAssert(taskContext->TimesExecuted == taskContext->TimesFinished);
+
+    ntStatus = DMF_ModuleOpen(scheduledTaskModule);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    moduleContext->SharedCloseWaitOpenedManually = NT_SUCCESS(ntStatus);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_WDF_TIMER)
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -293,6 +649,8 @@ Tests_ScheduledTask_ValidationTimerCallback(
         //
         DmfAssert(taskDescription->TimesShouldExecute == taskContext->TimesExecuted);
     }
+
+    Tests_ScheduledTask_SharedValidate(dmfModule);
 }
 #pragma code_seg()
 
@@ -354,6 +712,46 @@ Tests_ScheduledTask_TestTimesRun(
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+void
+Tests_ScheduledTask_SharedTimesRunReset(
+    _In_ DMFMODULE DmfModule
+    )
+{
+    DMF_CONTEXT_Tests_ScheduledTask* moduleContext;
+    NTSTATUS ntStatus;
+    ULONG index;
+    ULONG timesRun;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Set to zero so that persistent tasks run. Since no callbacks are executing,
+    // it is written immediately.
+    //
+    for (index = 0; index < SHARED_TASK_COUNT; index++)
+    {
+        if (SharedTaskDescriptionArray[index].PersistenceType != ScheduledTask_Persistence_PersistentAcrossReboots)
+        {
+            continue;
+        }
+
+        ntStatus = DMF_ScheduledTask_TimesRunSet(moduleContext->DmfModuleSharedScheduledTask[index],
+                                                 0);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+
+        ntStatus = Tests_ScheduledTask_SharedTimesRunRead(DmfModule,
+                                                          SharedTaskDescriptionArray[index].SharedSchedulerTaskId,
+                                                          &timesRun);
+        DmfAssert(STATUS_SUCCESS == ntStatus);
+        DmfAssert(0 == timesRun);
+    }
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
@@ -614,6 +1012,7 @@ Return Value:
     // Test APIs to get/set TimesRun value.
     //
     Tests_ScheduledTask_TestTimesRun(DmfModule);
+    Tests_ScheduledTask_SharedTimesRunReset(DmfModule);
     
     // Run tasks that are manually scheduled.
     //
@@ -662,6 +1061,14 @@ Return Value:
     WdfObjectDelete(moduleContext->ValidationTimer);
     moduleContext->ValidationTimer = NULL;
 
+    // DMF does not close Child Modules that the Client opened manually.
+    //
+    if (moduleContext->SharedCloseWaitOpenedManually)
+    {
+        DMF_ModuleClose(moduleContext->DmfModuleSharedScheduledTask[SHARED_TASK_CLOSE_WAIT]);
+        moduleContext->SharedCloseWaitOpenedManually = FALSE;
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -727,6 +1134,31 @@ Return Value:
                          &moduleContext->DmfModuleScheduledTask[scheduledTaskIndex]);
     }
 
+    // ScheduledTask (Shared Scheduler)
+    // --------------------------------
+    //
+    for (ULONG scheduledTaskIndex = 0; scheduledTaskIndex < SHARED_TASK_COUNT; scheduledTaskIndex++)
+    {
+        DMF_CONFIG_ScheduledTask_AND_ATTRIBUTES_INIT(&moduleConfigScheduledTask,
+                                                     &moduleAttributes);
+        moduleContext->SharedTaskContext[scheduledTaskIndex].DescriptionIndex = scheduledTaskIndex;
+        moduleContext->SharedTaskContext[scheduledTaskIndex].TimesExecuted = 0;
+        moduleContext->SharedTaskContext[scheduledTaskIndex].TimesFinished = 0;
+        moduleConfigScheduledTask.EvtScheduledTaskCallback = Tests_ScheduledTask_SharedTaskCallback;
+        moduleConfigScheduledTask.CallbackContext = &moduleContext->SharedTaskContext[scheduledTaskIndex];
+        moduleConfigScheduledTask.PersistenceType = SharedTaskDescriptionArray[scheduledTaskIndex].PersistenceType;
+        moduleConfigScheduledTask.ExecutionMode = ScheduledTask_ExecutionMode_Deferred;
+        moduleConfigScheduledTask.ExecuteWhen = ScheduledTask_ExecuteWhen_D0Entry;
+        moduleConfigScheduledTask.TimeMsBeforeInitialCall = SharedTaskDescriptionArray[scheduledTaskIndex].TimeMsBeforeInitialCall;
+        moduleConfigScheduledTask.UseSharedScheduler = TRUE;
+        moduleConfigScheduledTask.SharedSchedulerToleranceMs = SharedTaskDescriptionArray[scheduledTaskIndex].SharedSchedulerToleranceMs;
+        moduleConfigScheduledTask.SharedSchedulerTaskId = SharedTaskDescriptionArray[scheduledTaskIndex].SharedSchedulerTaskId;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleSharedScheduledTask[scheduledTaskIndex]);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -0,0 +1,1171 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+
+Module Name:
+
+    Dmf_Tests_SpbTarget.c
+
+Abstract:
+
+    Functional tests for Dmf_SpbTarget Module transactions. This Module simulates an SPB
+    controller with a register file and gives its own device stack to DMF_SpbTarget as
+    the SPB IoTarget.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.Tests.h"
+#include "DmfModules.Library.Tests.Trace.h"
+
+#include <spb.h>
+
+#include "Dmf_Tests_SpbTarget.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// Number of registers of the simulated device. Register addresses are one byte.
+//
+#define SIMULATED_REGISTER_COUNT                (256)
+// The simulated controller holds each sequence this long so that DMF_SpbTarget
+// always has a full window of sequences outstanding.
+//
+#define SEQUENCE_COMPLETION_DELAY_MS            (20)
+// Number of sequences DMF_SpbTarget may have outstanding at the controller.
+//
+#define TRANSACTIONS_OUTSTANDING_MAXIMUM        (3)
+// Keep the timeout short so that sequences sent while the device is leaving D0
+// do not delay driver disable.
+//
+#define TRANSACTION_TIMEOUT_MS                  (1000)
+// Number of registers written and read back by the coalescing test.
+//
+#define COALESCING_REGISTER_COUNT               (8)
+// Number of batches and transactions per batch sent by the window test.
+//
+#define WINDOW_BATCH_COUNT                      (4)
+#define WINDOW_TRANSACTIONS_PER_BATCH           (TRANSACTIONS_OUTSTANDING_MAXIMUM)
+
+// A sequence held by the simulated controller until its timer expires.
+//
+typedef struct
+{
+    WDFREQUEST Request;
+    NTSTATUS NtStatus;
+    size_t BytesTransferred;
+} SEQUENCE_CONTEXT;
+
+// Used by the test thread to wait for the batches it submitted.
+//
+typedef struct
+{
+    // Number of batches not yet complete plus one for the submitting thread.
+    //
+    LONG BatchesPending;
+    // First failure reported for any batch.
+    //
+    NTSTATUS NtStatus;
+    // Set when all batches are complete.
+    //
+    DMF_PORTABLE_EVENT BatchesCompleteEvent;
+} BATCHES_WAIT_CONTEXT;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Module under test.
+    //
+    DMFMODULE DmfModuleSpbTarget;
+    // The simulated controller is this device's own stack.
+    //
+    DMFMODULE DmfModuleSelfTarget;
+    // Sequences held by the simulated controller.
+    //
+    DMFMODULE DmfModuleBufferPoolFree;
+    DMFMODULE DmfModuleBufferPoolPending;
+    // Work thread that submits transactions.
+    //
+    DMFMODULE DmfModuleThread;
+    // Registers of the simulated device.
+    //
+    UCHAR Registers[SIMULATED_REGISTER_COUNT];
+    // Sequences received by the simulated controller.
+    //
+    LONG SequencesReceived;
+    // Sequences held by the simulated controller now and the most held at once.
+    //
+    LONG SequencesOutstanding;
+    LONG SequencesOutstandingMaximum;
+} DMF_CONTEXT_Tests_SpbTarget;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(Tests_SpbTarget)
+
+// This Module has no Config.
+//
+DMF_MODULE_DECLARE_NO_CONFIG(Tests_SpbTarget)
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+NTSTATUS
+Tests_SpbTarget_SequenceExecute(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_bytes_(TransferListSize) SPB_TRANSFER_LIST* TransferList,
+    _In_ size_t TransferListSize,
+    _Out_ size_t* BytesTransferred
+    )
+/*++
+
+Routine Description:
+
+    Execute an SPB sequence against the simulated register file. The first byte written
+    in a sequence is the register address. The address increments after every byte
+    that is written or read. Caller holds the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TransferList - The sequence to execute.
+    TransferListSize - Size of the buffer that contains TransferList.
+    BytesTransferred - Number of bytes written and read by the sequence.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    SPB_TRANSFER_LIST_ENTRY* transfer;
+    SPB_TRANSFER_BUFFER_LIST_ENTRY* bufferListEntries;
+    ULONG numberOfBufferListEntries;
+    ULONG transferIndex;
+    ULONG entryIndex;
+    ULONG byteIndex;
+    UCHAR* buffer;
+    ULONG registerAddress;
+    BOOLEAN registerAddressReceived;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    *BytesTransferred = 0;
+    registerAddress = 0;
+    registerAddressReceived = FALSE;
+
+    if ((TransferList->Size != sizeof(SPB_TRANSFER_LIST)) ||
+        (0 == TransferList->TransferCount) ||
+        (TransferListSize < FIELD_OFFSET(SPB_TRANSFER_LIST, Transfers) + (TransferList->TransferCount * sizeof(SPB_TRANSFER_LIST_ENTRY))))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+    for (transferIndex = 0; transferIndex < TransferList->TransferCount; transferIndex++)
+    {
+        #pragma warning(suppress: 6201)
+        transfer = &TransferList->Transfers[transferIndex];
+
+        switch (transfer->Buffer.Format)
+        {
+            case SpbTransferBufferFormatSimple:
+            {
+                bufferListEntries = &transfer->Buffer.Simple;
+                numberOfBufferListEntries = 1;
+                break;
+            }
+            case SpbTransferBufferFormatList:
+            {
+                bufferListEntries = transfer->Buffer.BufferList.List;
+                numberOfBufferListEntries = transfer->Buffer.BufferList.ListCe;
+                break;
+            }
+            default:
+            {
+                // DMF_SpbTarget does not send MDLs.
+                //
+                DmfAssert(FALSE);
+                ntStatus = STATUS_NOT_SUPPORTED;
+                goto Exit;
+            }
+        }
+
+        for (entryIndex = 0; entryIndex < numberOfBufferListEntries; entryIndex++)
+        {
+            buffer = (UCHAR*)bufferListEntries[entryIndex].Buffer;
+            for (byteIndex = 0; byteIndex < bufferListEntries[entryIndex].BufferCb; byteIndex++)
+            {
+                if (SpbTransferDirectionToDevice == transfer->Direction)
+                {
+                    if (! registerAddressReceived)
+                    {
+                        registerAddress = buffer[byteIndex];
+                        registerAddressReceived = TRUE;
+                        continue;
+                    }
+                    moduleContext->Registers[registerAddress] = buffer[byteIndex];
+                }
+                else
+                {
+                    buffer[byteIndex] = moduleContext->Registers[registerAddress];
+                }
+                registerAddress = (registerAddress + 1) % SIMULATED_REGISTER_COUNT;
+            }
+            *BytesTransferred += bufferListEntries[entryIndex].BufferCb;
+        }
+    }
+
+Exit:
+
+    return ntStatus;
+}
+
+_Function_class_(EVT_DMF_BufferPool_TimerCallback)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+Tests_SpbTarget_BufferPool_TimerCallback(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientBuffer,
+    _In_ VOID* ClientBufferContext,
+    _In_opt_ VOID* ClientDriverCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Complete a sequence held by the simulated controller.
+
+Arguments:
+
+    DmfModule - The Child BufferPool Module that held the sequence.
+    ClientBuffer - The SEQUENCE_CONTEXT of the sequence.
+    ClientBufferContext - Not used.
+    ClientDriverCallbackContext - Not used.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModuleParent;
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    SEQUENCE_CONTEXT* sequenceContext;
+
+    UNREFERENCED_PARAMETER(ClientBufferContext);
+    UNREFERENCED_PARAMETER(ClientDriverCallbackContext);
+
+    dmfModuleParent = DMF_ParentModuleGet(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(dmfModuleParent);
+
+    sequenceContext = (SEQUENCE_CONTEXT*)ClientBuffer;
+
+    DMF_ModuleLock(dmfModuleParent);
+    DmfAssert(moduleContext->SequencesOutstanding > 0);
+    moduleContext->SequencesOutstanding--;
+    DMF_ModuleUnlock(dmfModuleParent);
+
+    // This may send the next sequence to this Module before returning.
+    //
+    WdfRequestCompleteWithInformation(sequenceContext->Request,
+                                      sequenceContext->NtStatus,
+                                      sequenceContext->BytesTransferred);
+
+    DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolFree,
+                       ClientBuffer);
+}
+
+_Function_class_(EVT_DMF_SpbTarget_TransactionsComplete)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+Tests_SpbTarget_TransactionsComplete(
+    _In_ DMFMODULE DmfModule,
+    _In_ SpbTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_opt_ VOID* ClientContext,
+    _In_ NTSTATUS NtStatus
+    )
+/*++
+
+Routine Description:
+
+    Record the status of a completed batch and wake the test thread when it was the
+    last one.
+
+Arguments:
+
+    DmfModule - The Child SpbTarget Module.
+    Transactions - The transactions of the batch.
+    NumberOfTransactions - Number of entries in Transactions.
+    ClientContext - The BATCHES_WAIT_CONTEXT of the test thread.
+    NtStatus - Completion status of the batch.
+
+Return Value:
+
+    None
+
+--*/
+{
+    BATCHES_WAIT_CONTEXT* waitContext;
+
+    UNREFERENCED_PARAMETER(DmfModule);
+    UNREFERENCED_PARAMETER(Transactions);
+    UNREFERENCED_PARAMETER(NumberOfTransactions);
+
+    waitContext = (BATCHES_WAIT_CONTEXT*)ClientContext;
+    DmfAssert(waitContext != NULL);
+
+    if (! NT_SUCCESS(NtStatus))
+    {
+        InterlockedCompareExchange((LONG volatile*)&waitContext->NtStatus,
+                                   NtStatus,
+                                   STATUS_SUCCESS);
+    }
+
+    if (0 == InterlockedDecrement(&waitContext->BatchesPending))
+    {
+        DMF_Portable_EventSet(&waitContext->BatchesCompleteEvent);
+    }
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Tests_SpbTarget_BatchesRun(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(TransactionsPerBatch * NumberOfBatches) SpbTarget_Transaction* Transactions,
+    _In_ ULONG TransactionsPerBatch,
+    _In_ ULONG NumberOfBatches,
+    _Out_ LONG* SequencesReceived,
+    _Out_ LONG* SequencesOutstandingMaximum
+    )
+/*++
+
+Routine Description:
+
+    Submit consecutive batches of transactions without waiting between them. Then, wait
+    for all of them to complete.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Transactions - The transactions of all the batches, one batch after another.
+    TransactionsPerBatch - Number of transactions in each batch.
+    NumberOfBatches - Number of batches.
+    SequencesReceived - Number of sequences the simulated controller received for the batches.
+    SequencesOutstandingMaximum - Most sequences the simulated controller held at once.
+
+Return Value:
+
+    NTSTATUS of the first batch that failed.
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    BATCHES_WAIT_CONTEXT waitContext;
+    LONG sequencesReceivedBefore;
+    ULONG batchIndex;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    waitContext.BatchesPending = 1;
+    waitContext.NtStatus = STATUS_SUCCESS;
+    DMF_Portable_EventCreate(&waitContext.BatchesCompleteEvent,
+                             NotificationEvent,
+                             FALSE);
+
+    DMF_ModuleLock(DmfModule);
+    sequencesReceivedBefore = moduleContext->SequencesReceived;
+    moduleContext->SequencesOutstandingMaximum = 0;
+    DMF_ModuleUnlock(DmfModule);
+
+    for (batchIndex = 0; batchIndex < NumberOfBatches; batchIndex++)
+    {
+        InterlockedIncrement(&waitContext.BatchesPending);
+        ntStatus = DMF_SpbTarget_TransactionsSubmit(moduleContext->DmfModuleSpbTarget,
+                                                    &Transactions[batchIndex * TransactionsPerBatch],
+                                                    TransactionsPerBatch,
+                                                    Tests_SpbTarget_TransactionsComplete,
+                                                    &waitContext);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // The count cannot reach zero here because this thread holds one.
+            //
+            InterlockedDecrement(&waitContext.BatchesPending);
+            InterlockedCompareExchange((LONG volatile*)&waitContext.NtStatus,
+                                       ntStatus,
+                                       STATUS_SUCCESS);
+            break;
+        }
+    }
+
+    if (InterlockedDecrement(&waitContext.BatchesPending) > 0)
+    {
+        DMF_Portable_EventWaitForSingleObject(&waitContext.BatchesCompleteEvent,
+                                              NULL,
+                                              FALSE);
+    }
+    DMF_Portable_EventClose(&waitContext.BatchesCompleteEvent);
+
+    DMF_ModuleLock(DmfModule);
+    *SequencesReceived = moduleContext->SequencesReceived - sequencesReceivedBefore;
+    *SequencesOutstandingMaximum = moduleContext->SequencesOutstandingMaximum;
+    DMF_ModuleUnlock(DmfModule);
+
+    return waitContext.NtStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_SpbTarget_ReadCoalescing(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Write registers one at a time. Then read them back using adjacent reads, which must
+    be sent as a single sequence, followed by a read that is not adjacent.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    SpbTarget_Transaction transactions[COALESCING_REGISTER_COUNT];
+    UCHAR writeValues[COALESCING_REGISTER_COUNT];
+    UCHAR readValues[COALESCING_REGISTER_COUNT + 1];
+    ULONG firstRegister;
+    ULONG registerIndex;
+    LONG sequencesReceived;
+    LONG sequencesOutstandingMaximum;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    firstRegister = TestsUtility_GenerateRandomNumber(0,
+                                                      SIMULATED_REGISTER_COUNT - COALESCING_REGISTER_COUNT);
+
+    // Writes are never coalesced.
+    //
+    RtlZeroMemory(transactions,
+                  sizeof(transactions));
+    for (registerIndex = 0; registerIndex < COALESCING_REGISTER_COUNT; registerIndex++)
+    {
+        writeValues[registerIndex] = (UCHAR)TestsUtility_GenerateRandomNumber(0,
+                                                                              0xFF);
+        transactions[registerIndex].TransactionType = SpbTarget_TransactionType_RegisterWrite;
+        transactions[registerIndex].RegisterAddress = firstRegister + registerIndex;
+        transactions[registerIndex].Buffer = &writeValues[registerIndex];
+        transactions[registerIndex].BufferLength = 1;
+    }
+
+    ntStatus = Tests_SpbTarget_BatchesRun(DmfModule,
+                                          transactions,
+                                          COALESCING_REGISTER_COUNT,
+                                          1,
+                                          &sequencesReceived,
+                                          &sequencesOutstandingMaximum);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // The device is leaving D0.
+        //
+        DmfAssert((STATUS_CANCELLED == ntStatus) ||
+                  (STATUS_IO_TIMEOUT == ntStatus) ||
+                  (STATUS_INVALID_DEVICE_STATE == ntStatus));
+        goto Exit;
+    }
+    DmfAssert(COALESCING_REGISTER_COUNT == sequencesReceived);
+
+    // Adjacent reads of different lengths followed by a read of the first register.
+    //
+    RtlZeroMemory(transactions,
+                  sizeof(transactions));
+    RtlZeroMemory(readValues,
+                  sizeof(readValues));
+    transactions[0].TransactionType = SpbTarget_TransactionType_RegisterRead;
+    transactions[0].RegisterAddress = firstRegister;
+    transactions[0].Buffer = &readValues[0];
+    transactions[0].BufferLength = 2;
+    transactions[1].TransactionType = SpbTarget_TransactionType_RegisterRead;
+    transactions[1].RegisterAddress = firstRegister + 2;
+    transactions[1].Buffer = &readValues[2];
+    transactions[1].BufferLength = 1;
+    transactions[2].TransactionType = SpbTarget_TransactionType_RegisterRead;
+    transactions[2].RegisterAddress = firstRegister + 3;
+    transactions[2].Buffer = &readValues[3];
+    transactions[2].BufferLength = COALESCING_REGISTER_COUNT - 3;
+    transactions[3].TransactionType = SpbTarget_TransactionType_RegisterRead;
+    transactions[3].RegisterAddress = firstRegister;
+    transactions[3].Buffer = &readValues[COALESCING_REGISTER_COUNT];
+    transactions[3].BufferLength = 1;
+
+    ntStatus = Tests_SpbTarget_BatchesRun(DmfModule,
+                                          transactions,
+                                          4,
+                                          1,
+                                          &sequencesReceived,
+                                          &sequencesOutstandingMaximum);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // The device is leaving D0.
+        //
+        DmfAssert((STATUS_CANCELLED == ntStatus) ||
+                  (STATUS_IO_TIMEOUT == ntStatus) ||
+                  (STATUS_INVALID_DEVICE_STATE == ntStatus));
+        goto Exit;
+    }
+    DmfAssert(2 == sequencesReceived);
+    for (registerIndex = 0; registerIndex < 4; registerIndex++)
+    {
+        DmfAssert(NT_SUCCESS(transactions[registerIndex].NtStatus));
+    }
+    DmfAssert(RtlCompareMemory(readValues,
+                               writeValues,
+                               COALESCING_REGISTER_COUNT) == COALESCING_REGISTER_COUNT);
+    DmfAssert(readValues[COALESCING_REGISTER_COUNT] == writeValues[0]);
+
+Exit:
+    ;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_SpbTarget_OutstandingWindow(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Submit several batches of reads that cannot be coalesced without waiting between
+    them. Every read is sent as its own sequence and the controller never holds more
+    sequences than the configured window.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    SpbTarget_Transaction transactions[WINDOW_BATCH_COUNT * WINDOW_TRANSACTIONS_PER_BATCH];
+    UCHAR readValues[WINDOW_BATCH_COUNT * WINDOW_TRANSACTIONS_PER_BATCH];
+    ULONG transactionIndex;
+    LONG sequencesReceived;
+    LONG sequencesOutstandingMaximum;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Read every other register so that no two reads are adjacent.
+    //
+    RtlZeroMemory(transactions,
+                  sizeof(transactions));
+    for (transactionIndex = 0; transactionIndex < ARRAYSIZE(transactions); transactionIndex++)
+    {
+        transactions[transactionIndex].TransactionType = SpbTarget_TransactionType_RegisterRead;
+        transactions[transactionIndex].RegisterAddress = 2 * (transactionIndex % WINDOW_TRANSACTIONS_PER_BATCH);
+        transactions[transactionIndex].Buffer = &readValues[transactionIndex];
+        transactions[transactionIndex].BufferLength = 1;
+    }
+
+    ntStatus = Tests_SpbTarget_BatchesRun(DmfModule,
+                                          transactions,
+                                          WINDOW_TRANSACTIONS_PER_BATCH,
+                                          WINDOW_BATCH_COUNT,
+                                          &sequencesReceived,
+                                          &sequencesOutstandingMaximum);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // The device is leaving D0.
+        //
+        DmfAssert((STATUS_CANCELLED == ntStatus) ||
+                  (STATUS_IO_TIMEOUT == ntStatus) ||
+                  (STATUS_INVALID_DEVICE_STATE == ntStatus));
+        goto Exit;
+    }
+    DmfAssert(ARRAYSIZE(transactions) == sequencesReceived);
+    DmfAssert(TRANSACTIONS_OUTSTANDING_MAXIMUM == sequencesOutstandingMaximum);
+
+    // Only this thread writes registers so they have not changed since they were read.
+    //
+    DMF_ModuleLock(DmfModule);
+    for (transactionIndex = 0; transactionIndex < ARRAYSIZE(transactions); transactionIndex++)
+    {
+        DmfAssert(readValues[transactionIndex] == moduleContext->Registers[transactions[transactionIndex].RegisterAddress]);
+    }
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+    ;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(EVT_DMF_Thread_Function)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Tests_SpbTarget_WorkThread(
+    _In_ DMFMODULE DmfModuleThread
+    )
+{
+    DMFMODULE dmfModule;
+
+    PAGED_CODE();
+
+    dmfModule = DMF_ParentModuleGet(DmfModuleThread);
+
+    Tests_SpbTarget_ReadCoalescing(dmfModule);
+    Tests_SpbTarget_OutstandingWindow(dmfModule);
+
+    // Repeat the test, until stop is signaled.
+    //
+    if (!DMF_Thread_IsStopPending(DmfModuleThread))
+    {
+        DMF_Thread_WorkReady(DmfModuleThread);
+    }
+
+    TestsUtility_YieldExecution();
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_Function_class_(DMF_ModuleDeviceIoControl)
+_IRQL_requires_same_
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+DMF_Tests_SpbTarget_ModuleDeviceIoControl(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFQUEUE Queue,
+    _In_ WDFREQUEST Request,
+    _In_ size_t OutputBufferLength,
+    _In_ size_t InputBufferLength,
+    _In_ ULONG IoControlCode
+    )
+/*++
+
+Routine Description:
+
+    The simulated SPB controller. Executes each sequence immediately but holds the
+    request for SEQUENCE_COMPLETION_DELAY_MS before completing it.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Queue - Target WDF queue for the IOCTL (not used).
+    Request - The WDF Request containing the IOCTL.
+    OutputBufferLength - Output buffer length in the IOCTL (not used).
+    InputBufferLength - Input buffer length in the IOCTL (not used).
+    IoControlCode - The given IOCTL code.
+
+Return Value:
+
+    TRUE if this Module handled the IOCTL.
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    SEQUENCE_CONTEXT* sequenceContext;
+    VOID* inputBuffer;
+    size_t inputBufferSize;
+    size_t bytesTransferred;
+    BOOLEAN handled;
+    NTSTATUS ntStatus;
+
+    UNREFERENCED_PARAMETER(Queue);
+    UNREFERENCED_PARAMETER(OutputBufferLength);
+    UNREFERENCED_PARAMETER(InputBufferLength);
+
+    if (IoControlCode != IOCTL_SPB_EXECUTE_SEQUENCE)
+    {
+        handled = FALSE;
+        goto Exit;
+    }
+
+    handled = TRUE;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // DMF_SpbTarget sends from kernel-mode so the sequence can be retrieved directly.
+    //
+    ntStatus = WdfRequestRetrieveInputBuffer(Request,
+                                             sizeof(SPB_TRANSFER_LIST),
+                                             &inputBuffer,
+                                             &inputBufferSize);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRequestRetrieveInputBuffer fails: ntStatus=%!STATUS!", ntStatus);
+        WdfRequestComplete(Request,
+                           ntStatus);
+        goto Exit;
+    }
+
+    ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolFree,
+                                  (VOID**)&sequenceContext,
+                                  NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // DMF_SpbTarget never has more sequences outstanding than there are buffers.
+        //
+        DmfAssert(FALSE);
+        WdfRequestComplete(Request,
+                           ntStatus);
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+    ntStatus = Tests_SpbTarget_SequenceExecute(DmfModule,
+                                               (SPB_TRANSFER_LIST*)inputBuffer,
+                                               inputBufferSize,
+                                               &bytesTransferred);
+    moduleContext->SequencesReceived++;
+    moduleContext->SequencesOutstanding++;
+    if (moduleContext->SequencesOutstanding > moduleContext->SequencesOutstandingMaximum)
+    {
+        moduleContext->SequencesOutstandingMaximum = moduleContext->SequencesOutstanding;
+    }
+    DMF_ModuleUnlock(DmfModule);
+
+    sequenceContext->Request = Request;
+    sequenceContext->NtStatus = ntStatus;
+    sequenceContext->BytesTransferred = bytesTransferred;
+    DMF_BufferPool_PutInSinkWithTimer(moduleContext->DmfModuleBufferPoolPending,
+                                      sequenceContext,
+                                      SEQUENCE_COMPLETION_DELAY_MS,
+                                      Tests_SpbTarget_BufferPool_TimerCallback,
+                                      NULL);
+
+Exit:
+
+    return handled;
+}
+
+_Function_class_(DMF_ModuleD0Entry)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_Tests_SpbTarget_ModuleD0Entry(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDF_POWER_DEVICE_STATE PreviousState
+    )
+/*++
+
+Routine Description:
+
+    Starts the work thread.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    PreviousState - The WDF Power State that the given DMF Module should exit from.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+
+    UNREFERENCED_PARAMETER(PreviousState);
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_Thread_Start(moduleContext->DmfModuleThread);
+    DmfAssert(NT_SUCCESS(ntStatus));
+    if (NT_SUCCESS(ntStatus))
+    {
+        DMF_Thread_WorkReady(moduleContext->DmfModuleThread);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+
+    return STATUS_SUCCESS;
+}
+
+_Function_class_(DMF_ModuleD0Exit)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_Tests_SpbTarget_ModuleD0Exit(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDF_POWER_DEVICE_STATE TargetState
+    )
+/*++
+
+Routine Description:
+
+    Stops the work thread.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetState - The WDF Power State that the given DMF Module will enter.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+
+    UNREFERENCED_PARAMETER(TargetState);
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_Thread_Stop(moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+
+    return STATUS_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Tests_SpbTarget_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    DMF_CONFIG_SpbTarget moduleConfigSpbTarget;
+    DMF_CONFIG_BufferPool moduleConfigBufferPool;
+    DMF_CONFIG_Thread moduleConfigThread;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // SpbTarget
+    // ---------
+    //
+    DMF_CONFIG_SpbTarget_AND_ATTRIBUTES_INIT(&moduleConfigSpbTarget,
+                                             &moduleAttributes);
+    moduleConfigSpbTarget.IoTargetSetByClient = TRUE;
+    moduleConfigSpbTarget.TransactionRegisterAddressLength = 1;
+    moduleConfigSpbTarget.TransactionsOutstandingMaximum = TRANSACTIONS_OUTSTANDING_MAXIMUM;
+    moduleConfigSpbTarget.TransactionTimeoutMs = TRANSACTION_TIMEOUT_MS;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleSpbTarget);
+
+    // SelfTarget
+    // ----------
+    //
+    DMF_SelfTarget_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleSelfTarget);
+
+    // BufferPool Source
+    // -----------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = sizeof(SEQUENCE_CONTEXT);
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = 2 * TRANSACTIONS_OUTSTANDING_MAXIMUM;
+    moduleConfigBufferPool.Mode.SourceSettings.CreateWithTimer = TRUE;
+#if !defined(DMF_USER_MODE)
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+#endif
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolFree);
+
+    // BufferPool Sink
+    // ---------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Sink;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolPending);
+
+    // Thread
+    // ------
+    //
+    DMF_CONFIG_Thread_AND_ATTRIBUTES_INIT(&moduleConfigThread,
+                                          &moduleAttributes);
+    moduleConfigThread.ThreadControlType = ThreadControlType_DmfControl;
+    moduleConfigThread.ThreadControl.DmfControl.EvtThreadWork = Tests_SpbTarget_WorkThread;
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleThread);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_Tests_SpbTarget_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Tests_SpbTarget. Gives this device's
+    own stack to the Module under test as its SPB IoTarget.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+    WDFIOTARGET ioTarget;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_SelfTarget_Get(moduleContext->DmfModuleSelfTarget,
+                                  &ioTarget);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_SelfTarget_Get fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    DMF_SpbTarget_IoTargetSet(moduleContext->DmfModuleSpbTarget,
+                              ioTarget);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_Tests_SpbTarget_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type Tests_SpbTarget.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Tests_SpbTarget* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_SpbTarget_IoTargetClear(moduleContext->DmfModuleSpbTarget);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_Tests_SpbTarget_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type Tests_SpbTarget.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Tests_SpbTarget;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_Tests_SpbTarget;
+    DMF_CALLBACKS_WDF dmfCallbacksWdf_Tests_SpbTarget;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Tests_SpbTarget);
+    dmfCallbacksDmf_Tests_SpbTarget.ChildModulesAdd = DMF_Tests_SpbTarget_ChildModulesAdd;
+    dmfCallbacksDmf_Tests_SpbTarget.DeviceOpen = DMF_Tests_SpbTarget_Open;
+    dmfCallbacksDmf_Tests_SpbTarget.DeviceClose = DMF_Tests_SpbTarget_Close;
+
+    DMF_CALLBACKS_WDF_INIT(&dmfCallbacksWdf_Tests_SpbTarget);
+    dmfCallbacksWdf_Tests_SpbTarget.ModuleD0Entry = DMF_Tests_SpbTarget_ModuleD0Entry;
+    dmfCallbacksWdf_Tests_SpbTarget.ModuleD0Exit = DMF_Tests_SpbTarget_ModuleD0Exit;
+    dmfCallbacksWdf_Tests_SpbTarget.ModuleDeviceIoControl = DMF_Tests_SpbTarget_ModuleDeviceIoControl;
+
+    // DISPATCH_LEVEL because the simulated controller takes the Module lock while
+    // dispatching and completing sequences.
+    //
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Tests_SpbTarget,
+                                            Tests_SpbTarget,
+                                            DMF_CONTEXT_Tests_SpbTarget,
+                                            DMF_MODULE_OPTIONS_DISPATCH,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_D0Entry);
+
+    dmfModuleDescriptor_Tests_SpbTarget.CallbacksDmf = &dmfCallbacksDmf_Tests_SpbTarget;
+    dmfModuleDescriptor_Tests_SpbTarget.CallbacksWdf = &dmfCallbacksWdf_Tests_SpbTarget;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_Tests_SpbTarget,
+                                DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+// eof: Dmf_Tests_SpbTarget.c
+//
@@ -183,6 +183,148 @@ Return Value:
 }
 #pragma code_seg()
 
+_IRQL_requires_same_
+ULONGLONG
+TestsUtility_TimeMsGet()
+/*++
+
+Routine Description:
+
+    This function returns a time in milliseconds that is used to measure intervals.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    The current time in milliseconds.
+
+    --*/
+{
+#if defined(DMF_USER_MODE)
+    return GetTickCount64();
+#else
+    // Interrupt time is in 100 nanosecond units.
+    //
+    return KeQueryInterruptTime() / 10000;
+#endif
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+TestsUtility_ThreadIndexGet(
+    _In_reads_(NumberOfThreads) DMFMODULE* DmfModuleThreads,
+    _In_ ULONG NumberOfThreads,
+    _In_ DMFMODULE DmfModuleThread
+    )
+/*++
+
+Routine Description:
+
+    This function finds a Thread Module in an array of Thread Modules.
+
+Arguments:
+
+    DmfModuleThreads - The array of Thread Modules.
+    NumberOfThreads - Number of entries in DmfModuleThreads.
+    DmfModuleThread - The Thread Module to find.
+
+Return Value:
+
+    Index of DmfModuleThread in DmfModuleThreads.
+
+    --*/
+{
+    ULONG threadIndex;
+
+    for (threadIndex = 0; threadIndex < NumberOfThreads; threadIndex++)
+    {
+        if (DmfModuleThreads[threadIndex] == DmfModuleThread)
+        {
+            break;
+        }
+    }
+    DmfAssert(threadIndex < NumberOfThreads);
+
+    return threadIndex;
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+TestsUtility_ScalingBenchmarkRun(
+    _In_ DMFMODULE DmfModuleThread,
+    _In_z_ CHAR* BenchmarkName,
+    _In_ LONG MaximumThreadCount,
+    _In_ ULONG StepDurationMs,
+    _Inout_ volatile LONG* ActiveThreadCount,
+    _Inout_ volatile LONG64* OperationCount,
+    _In_ volatile BOOLEAN* Closing
+    )
+/*++
+
+Routine Description:
+
+    This function measures how many operations per second worker threads perform as the
+    number of worker threads that perform them increases from 1 to MaximumThreadCount.
+    Worker threads with an index less than ActiveThreadCount perform operations and add
+    the number they performed to OperationCount.
+
+Arguments:
+
+    DmfModuleThread - The Thread Module that runs the benchmark.
+    BenchmarkName - Name used in the trace of the results.
+    MaximumThreadCount - Number of worker threads.
+    StepDurationMs - How long each step runs.
+    ActiveThreadCount - Number of worker threads that perform operations.
+    OperationCount - Number of operations performed during the current step.
+    Closing - Indicates the caller is closing so that the benchmark stops.
+
+Return Value:
+
+    None.
+
+    --*/
+{
+    LONG activeThreadCount;
+    ULONGLONG startTimeMs;
+    ULONGLONG elapsedTimeMs;
+    LONG64 operationCount;
+
+    PAGED_CODE();
+
+    for (activeThreadCount = 1; activeThreadCount <= MaximumThreadCount; activeThreadCount++)
+    {
+        if (DMF_Thread_IsStopPending(DmfModuleThread) ||
+            *Closing)
+        {
+            break;
+        }
+
+        InterlockedExchange64(OperationCount,
+                              0);
+        InterlockedExchange(ActiveThreadCount,
+                            activeThreadCount);
+        startTimeMs = TestsUtility_TimeMsGet();
+
+        DMF_Utility_DelayMilliseconds(StepDurationMs);
+
+        operationCount = InterlockedCompareExchange64(OperationCount,
+                                                      0,
+                                                      0);
+        elapsedTimeMs = TestsUtility_TimeMsGet() - startTimeMs;
+        if (elapsedTimeMs > 0)
+        {
+            TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "%s benchmark: Threads=%d Operations/s=%I64d",
+                        BenchmarkName,
+                        activeThreadCount,
+                        (operationCount * 1000) / (LONG64)elapsedTimeMs);
+        }
+    }
+}
+#pragma code_seg()
+
 #define CRC_INITIAL_VALUE 0xFFFFU
 #define CRC(crcval, data)   ((UINT16)((crcval) << 8) ^ CRCTable[(((crcval) >> 8) ^ ((UINT16)(data) & 0xFFU))])
 
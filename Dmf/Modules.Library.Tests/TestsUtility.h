@@ -49,5 +49,29 @@ TestsUtility_CrcCompute(
     _In_ UINT32 NumberOfBytes
     );
 
+_IRQL_requires_same_
+ULONGLONG
+TestsUtility_TimeMsGet();
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+TestsUtility_ThreadIndexGet(
+    _In_reads_(NumberOfThreads) DMFMODULE* DmfModuleThreads,
+    _In_ ULONG NumberOfThreads,
+    _In_ DMFMODULE DmfModuleThread
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+TestsUtility_ScalingBenchmarkRun(
+    _In_ DMFMODULE DmfModuleThread,
+    _In_z_ CHAR* BenchmarkName,
+    _In_ LONG MaximumThreadCount,
+    _In_ ULONG StepDurationMs,
+    _Inout_ volatile LONG* ActiveThreadCount,
+    _Inout_ volatile LONG64* OperationCount,
+    _In_ volatile BOOLEAN* Closing
+    );
+
 // eof: TestsUtility.h
 //
@@ -45,6 +45,7 @@ extern "C"
 // All the Modules in this Library.
 //
 #include "Dmf_PingPongBuffer.h"
+#include "Dmf_FrameParser.h"
 #include "Dmf_HidPortableDeviceButtons.h"
 #include "Dmf_CrashDump.h"
 #include "Dmf_ScheduledTask.h"
@@ -52,6 +53,7 @@ extern "C"
 #include "Dmf_InterruptResource.h"
 #include "Dmf_GpioTarget.h"
 #include "Dmf_HidTarget.h"
+#include "Dmf_SpbTarget.h"
 #include "Dmf_I2cTarget.h"
 #include "Dmf_AlertableSleep.h"
 #include "Dmf_NotifyUserWithEvent.h"
@@ -81,7 +83,6 @@ extern "C"
 #include "Dmf_VirtualHidKeyboard.h"
 #include "Dmf_ComponentFirmwareUpdateHidTransport.h"
 #include "Dmf_ComponentFirmwareUpdate.h"
-#include "Dmf_SpbTarget.h"
 #include "Dmf_VirtualHidAmbientLightSensor.h"
 #include "Dmf_VirtualHidAmbientColorSensor.h"
 #include "Dmf_String.h"
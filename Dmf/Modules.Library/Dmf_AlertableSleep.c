@@ -31,6 +31,36 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Wait block flags.
+// A thread is waiting on the wait block's event.
+//
+#define AlertableSleep_WaitBlockState_Waiting       0x00000001
+// The event has been interrupted. Do not wait anymore.
+//
+#define AlertableSleep_WaitBlockState_DoNotWait     0x00000002
+
+// Resources of a single event when events are allocated on demand.
+//
+typedef struct _ALERTABLE_SLEEP_WAIT_BLOCK
+{
+    // The event that interrupts the delay.
+    //
+    DMF_PORTABLE_EVENT Event;
+    // AlertableSleep_WaitBlockState_* flags. Only updated with interlocked operations.
+    //
+    volatile LONG State;
+    // Value of AbortAllGeneration when the event was last reset for reuse. If it is
+    // different than the current value, the event has been interrupted by AbortAll.
+    //
+    volatile LONG ResetGeneration;
+    // Memory that holds this structure.
+    //
+    WDFMEMORY Memory;
+    // Next allocated wait block.
+    //
+    struct _ALERTABLE_SLEEP_WAIT_BLOCK* Next;
+} ALERTABLE_SLEEP_WAIT_BLOCK;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -54,6 +84,28 @@ typedef struct
     // must fail.
     //
     BOOLEAN Closing;
+
+    // Support for events allocated on demand.
+    // ---------------------------------------
+    //
+    BOOLEAN AllocateEventsOnDemand;
+    // Wait block of each event. An entry is NULL until the event is first used.
+    //
+    ALERTABLE_SLEEP_WAIT_BLOCK* volatile* WaitBlocks;
+    WDFMEMORY WaitBlocksMemory;
+    // All allocated wait blocks so that AbortAll only visits events that have been used.
+    // Wait blocks are added under the Module lock but the list is read without it.
+    //
+    ALERTABLE_SLEEP_WAIT_BLOCK* volatile WaitBlockList;
+    // Incremented each time all events are interrupted.
+    //
+    volatile LONG AbortAllGeneration;
+    // Number of threads that are executing DMF_AlertableSleep_Sleep().
+    //
+    volatile LONG ActiveSleeperCount;
+    // Set when the last thread leaves DMF_AlertableSleep_Sleep() after Module starts closing.
+    //
+    DMF_PORTABLE_EVENT SleepersDoneEvent;
 } DMF_CONTEXT_AlertableSleep;
 
 // This macro declares the following function:
@@ -75,6 +127,284 @@ DMF_MODULE_DECLARE_CONFIG(AlertableSleep)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+ALERTABLE_SLEEP_WAIT_BLOCK*
+AlertableSleep_WaitBlockGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG EventIndex
+    )
+/*++
+
+Routine Description:
+
+    Given an event index, return its wait block. The wait block is allocated the first
+    time the event is used. Only the allocation acquires the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    EventIndex - The given event index.
+
+Return Value:
+
+    The wait block or NULL if it cannot be allocated.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(EventIndex < moduleContext->EventCount);
+
+    waitBlock = moduleContext->WaitBlocks[EventIndex];
+    if (waitBlock != NULL)
+    {
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    // Another thread may have allocated it.
+    //
+    waitBlock = moduleContext->WaitBlocks[EventIndex];
+    if (waitBlock != NULL)
+    {
+        goto ExitUnlock;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(ALERTABLE_SLEEP_WAIT_BLOCK),
+                               &memory,
+                               (VOID**)&waitBlock);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        waitBlock = NULL;
+        goto ExitUnlock;
+    }
+
+    RtlZeroMemory(waitBlock,
+                  sizeof(ALERTABLE_SLEEP_WAIT_BLOCK));
+    waitBlock->Memory = memory;
+    // This object enforces that only a single thread waits on a particular event index.
+    // Therefore, SynchronizationEvent is used.
+    //
+    DMF_Portable_EventCreate(&waitBlock->Event,
+                             SynchronizationEvent,
+                             FALSE);
+
+    // Add it to the list before making it visible so that AbortAll always sees
+    // wait blocks that threads can wait on.
+    //
+    waitBlock->Next = moduleContext->WaitBlockList;
+    InterlockedExchangePointer((PVOID volatile*)&moduleContext->WaitBlockList,
+                               waitBlock);
+    InterlockedExchangePointer((PVOID volatile*)&moduleContext->WaitBlocks[EventIndex],
+                               waitBlock);
+
+ExitUnlock:
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    return waitBlock;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+AlertableSleep_OnDemandClose(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Interrupt all the events, wait for all threads to leave DMF_AlertableSleep_Sleep()
+    and free all the wait blocks.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
+    ALERTABLE_SLEEP_WAIT_BLOCK* nextWaitBlock;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext->Closing);
+
+    // Set all the events to cause all waiting threads to resume execution.
+    //
+    DMF_AlertableSleep_AbortAll(DmfModule);
+
+    // Threads that are still in DMF_AlertableSleep_Sleep() may be using the wait blocks.
+    // The last one to leave sets the event.
+    //
+    if (InterlockedCompareExchange(&moduleContext->ActiveSleeperCount,
+                                   0,
+                                   0) != 0)
+    {
+        DMF_Portable_EventWaitForSingleObject(&moduleContext->SleepersDoneEvent,
+                                              NULL,
+                                              FALSE);
+    }
+
+    waitBlock = moduleContext->WaitBlockList;
+    moduleContext->WaitBlockList = NULL;
+    while (waitBlock != NULL)
+    {
+        nextWaitBlock = waitBlock->Next;
+        DmfAssert(0 == (waitBlock->State & AlertableSleep_WaitBlockState_Waiting));
+        DMF_Portable_EventClose(&waitBlock->Event);
+        WdfObjectDelete(waitBlock->Memory);
+        waitBlock = nextWaitBlock;
+    }
+
+    WdfObjectDelete(moduleContext->WaitBlocksMemory);
+    moduleContext->WaitBlocksMemory = NULL;
+    moduleContext->WaitBlocks = NULL;
+
+    DMF_Portable_EventClose(&moduleContext->SleepersDoneEvent);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+AlertableSleep_OnDemandSleep(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG EventIndex,
+    _In_ ULONG Milliseconds
+    )
+/*++
+
+Routine Description:
+
+    DMF_AlertableSleep_Sleep() for events allocated on demand. Only interlocked operations
+    are used to decide whether or not to wait.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    EventIndex - Which event the caller wants to wait on.
+    Milliseconds - How long the caller wants to wait.
+
+Return Value:
+
+    STATUS_UNSUCCESSFUL - The timer was interrupted.
+    STATUS_SUCCESS - The full delay happened.
+    STATUS_INSUFFICIENT_RESOURCES - The event could not be allocated.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
+    LONG waitBlockState;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_UNSUCCESSFUL;
+
+    // Close waits for this count to reach zero before freeing wait blocks. It is incremented
+    // before checking Closing so that Close either sees this thread or this thread sees Closing.
+    //
+    InterlockedIncrement(&moduleContext->ActiveSleeperCount);
+
+    if (moduleContext->Closing)
+    {
+        // Don't wait on the event if the Module is closing.
+        //
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Event[%u] closing. Do not wait.", EventIndex);
+        goto Exit;
+    }
+
+    waitBlock = AlertableSleep_WaitBlockGet(DmfModule,
+                                            EventIndex);
+    if (NULL == waitBlock)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    waitBlockState = InterlockedOr(&waitBlock->State,
+                                   AlertableSleep_WaitBlockState_Waiting);
+    DmfAssert(0 == (waitBlockState & AlertableSleep_WaitBlockState_Waiting));
+
+    if ((waitBlockState & AlertableSleep_WaitBlockState_DoNotWait) ||
+        (waitBlock->ResetGeneration != moduleContext->AbortAllGeneration))
+    {
+        // The event has already been interrupted. Do not wait and return unsuccessful.
+        //
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Event[%u] already interrupted. Do not wait.", EventIndex);
+    }
+    else
+    {
+        // Wait for the time specified by the caller or until the event is set.
+        // If AbortAll runs after the checks above, it sets this event.
+        //
+        ntStatus = DMF_Portable_EventWaitForSingleObject(&waitBlock->Event,
+                                                         &Milliseconds,
+                                                         TRUE);
+        if (STATUS_TIMEOUT == ntStatus)
+        {
+            // The thread delayed for the time specified by the caller. It is considered success.
+            //
+            ntStatus = STATUS_SUCCESS;
+        }
+        else
+        {
+            // The thread started running again because the event was set. It means the full delay
+            // did not happen. It is considered unsuccessful.
+            //
+            ntStatus = STATUS_UNSUCCESSFUL;
+        }
+    }
+
+    InterlockedAnd(&waitBlock->State,
+                   ~AlertableSleep_WaitBlockState_Waiting);
+
+Exit:
+
+    if ((0 == InterlockedDecrement(&moduleContext->ActiveSleeperCount)) &&
+        (moduleContext->Closing))
+    {
+        DMF_Portable_EventSet(&moduleContext->SleepersDoneEvent);
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -113,6 +443,7 @@ Return Value:
     NTSTATUS ntStatus;
     DMF_CONTEXT_AlertableSleep* moduleContext;
     DMF_CONFIG_AlertableSleep* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
 
     PAGED_CODE();
 
@@ -127,8 +458,42 @@ Return Value:
     // Copy this so that Module Config is not queried often.
     //
     DmfAssert(moduleConfig->EventCount > 0);
-    DmfAssert(moduleConfig->EventCount <= ALERTABLE_SLEEP_MAXIMUM_TIMERS);
     moduleContext->EventCount = moduleConfig->EventCount;
+    moduleContext->AllocateEventsOnDemand = moduleConfig->AllocateEventsOnDemand;
+
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        // Only allocate the table of wait blocks now. Each wait block is allocated
+        // the first time its event is used.
+        //
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   moduleContext->EventCount * sizeof(ALERTABLE_SLEEP_WAIT_BLOCK*),
+                                   &moduleContext->WaitBlocksMemory,
+                                   (VOID**)&moduleContext->WaitBlocks);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            moduleContext->WaitBlocksMemory = NULL;
+            moduleContext->WaitBlocks = NULL;
+            goto Exit;
+        }
+        RtlZeroMemory((VOID*)moduleContext->WaitBlocks,
+                      moduleContext->EventCount * sizeof(ALERTABLE_SLEEP_WAIT_BLOCK*));
+
+        moduleContext->WaitBlockList = NULL;
+        moduleContext->AbortAllGeneration = 0;
+        moduleContext->ActiveSleeperCount = 0;
+        DMF_Portable_EventCreate(&moduleContext->SleepersDoneEvent,
+                                 NotificationEvent,
+                                 FALSE);
+        goto Exit;
+    }
+
+    DmfAssert(moduleConfig->EventCount <= ALERTABLE_SLEEP_MAXIMUM_TIMERS);
 
     for (ULONG eventIndex = 0; eventIndex < moduleConfig->EventCount; eventIndex++)
     {
@@ -146,6 +511,8 @@ Return Value:
         moduleContext->DoNotWait[eventIndex] = FALSE;
     }
 
+Exit:
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -189,6 +556,12 @@ Return Value:
     moduleContext->Closing = TRUE;
     DMF_ModuleUnlock(DmfModule);
 
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        AlertableSleep_OnDemandClose(DmfModule);
+        goto Exit;
+    }
+
     ULONG eventIndex;
 
     for (eventIndex = 0; eventIndex < moduleContext->EventCount; eventIndex++)
@@ -209,6 +582,8 @@ Return Value:
         DMF_Portable_EventClose(&moduleContext->Event[eventIndex]);
     }
 
+Exit:
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -313,6 +688,7 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
 
     PAGED_CODE();
 
@@ -333,6 +709,21 @@ Return Value:
         goto Exit;
     }
 
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        // The wait block is allocated if necessary so that the next wait fails.
+        //
+        waitBlock = AlertableSleep_WaitBlockGet(DmfModule,
+                                                EventIndex);
+        if (waitBlock != NULL)
+        {
+            InterlockedOr(&waitBlock->State,
+                          AlertableSleep_WaitBlockState_DoNotWait);
+            DMF_Portable_EventSet(&waitBlock->Event);
+        }
+        goto Exit;
+    }
+
     DMF_ModuleLock(DmfModule);
 
     // Don't let the caller wait on this event again because it has been
@@ -354,6 +745,78 @@ Exit:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_AlertableSleep_AbortAll(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Set all the events to allow all waiting threads to continue execution. Each event
+    stays interrupted until DMF_AlertableSleep_ResetForReuse() is called for it.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
+    ULONG eventIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // By design this Method can be called by Close callback.
+    //
+    DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
+                                            AlertableSleep);
+
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        // Interrupt all events, including the ones that have not been allocated yet,
+        // with a single interlocked operation. Then, wake the threads that are waiting.
+        // Only wait blocks that have been allocated are visited.
+        //
+        InterlockedIncrement(&moduleContext->AbortAllGeneration);
+        waitBlock = (ALERTABLE_SLEEP_WAIT_BLOCK*)InterlockedCompareExchangePointer((PVOID volatile*)&moduleContext->WaitBlockList,
+                                                                                   NULL,
+                                                                                   NULL);
+        while (waitBlock != NULL)
+        {
+            DMF_Portable_EventSet(&waitBlock->Event);
+            waitBlock = waitBlock->Next;
+        }
+        goto Exit;
+    }
+
+    DMF_ModuleLock(DmfModule);
+
+    for (eventIndex = 0; eventIndex < moduleContext->EventCount; eventIndex++)
+    {
+        moduleContext->DoNotWait[eventIndex] = TRUE;
+        DMF_Portable_EventSet(&moduleContext->Event[eventIndex]);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
@@ -384,6 +847,7 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_AlertableSleep* moduleContext;
+    ALERTABLE_SLEEP_WAIT_BLOCK* waitBlock;
 
     PAGED_CODE();
 
@@ -400,6 +864,28 @@ Return Value:
         goto Exit;
     }
 
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        waitBlock = AlertableSleep_WaitBlockGet(DmfModule,
+                                                EventIndex);
+        if (waitBlock != NULL)
+        {
+            // NOTE: Only call this function from the WAITING thread.
+            //
+            DmfAssert(0 == (waitBlock->State & AlertableSleep_WaitBlockState_Waiting));
+            // Allow the caller to wait on this event, including after AbortAll.
+            //
+            InterlockedAnd(&waitBlock->State,
+                           ~AlertableSleep_WaitBlockState_DoNotWait);
+            InterlockedExchange(&waitBlock->ResetGeneration,
+                                moduleContext->AbortAllGeneration);
+            // Clear the event so that threads will wait.
+            //
+            DMF_Portable_EventReset(&waitBlock->Event);
+        }
+        goto Exit;
+    }
+
     DMF_ModuleLock(DmfModule);
 
     // Allow the caller to wait on this event.
@@ -475,6 +961,16 @@ Return Value:
         goto Exit;
     }
 
+    if (moduleContext->AllocateEventsOnDemand)
+    {
+        // The Module lock is not acquired in this mode.
+        //
+        ntStatus = AlertableSleep_OnDemandSleep(DmfModule,
+                                                EventIndex,
+                                                Milliseconds);
+        goto Exit;
+    }
+
     DMF_ModuleLock(DmfModule);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Wait EventIndex=%u: Milliseconds%d-ms DoNotWait=%d Closing=%!bool!",
@@ -30,6 +30,11 @@ typedef struct
     // against a caller sleeping using the same event twice.
     //
     ULONG EventCount;
+    // If TRUE, EventCount is not limited to ALERTABLE_SLEEP_MAXIMUM_TIMERS and the
+    // resources for each event are allocated the first time the event is used.
+    // In this mode, DMF_AlertableSleep_Sleep() does not acquire the Module lock.
+    //
+    BOOLEAN AllocateEventsOnDemand;
 } DMF_CONFIG_AlertableSleep;
 
 // This macro declares the following functions:
@@ -49,6 +54,12 @@ DMF_AlertableSleep_Abort(
     _In_ ULONG EventIndex
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_AlertableSleep_AbortAll(
+    _In_ DMFMODULE DmfModule
+    );
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
 DMF_AlertableSleep_ResetForReuse(
@@ -85,6 +85,18 @@ typedef struct _PAYLOAD_RESPONSE
     COMPONENT_FIRMWARE_UPDATE_PAYLOAD_RESPONSE ResponseStatus;
 } PAYLOAD_RESPONSE;
 
+// Structure to hold a payload chunk that was sent to device while other chunks are outstanding.
+// Position in the payload is where this chunk starts so that it can be sent again.
+//
+typedef struct _PAYLOAD_WINDOW_ENTRY
+{
+    UINT16 SequenceNumber;
+    ULONG PayloadBufferBinRecordStartIndex;
+    BYTE PayloadBufferBinRecordDataOffset;
+    BOOLEAN ResponseReceived;
+    COMPONENT_FIRMWARE_UPDATE_PAYLOAD_RESPONSE ResponseStatus;
+} PAYLOAD_WINDOW_ENTRY;
+
 // This context associated with the plugged in protocol Module.
 //
 typedef struct _CONTEXT_ComponentFirmwareUpdateTransaction
@@ -137,6 +149,9 @@ typedef struct _CONTEXT_ComponentFirmwareUpdateTransport
     // Payload buffer fill alignment this transport needs.
     //
     UINT TransportPayloadFillAlignment;
+    // Maximum number of payload chunks this transport can have outstanding.
+    //
+    ULONG TransportMaximumOutstandingPayloads;
 } CONTEXT_ComponentFirmwareUpdateTransport;
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(CONTEXT_ComponentFirmwareUpdateTransport, ComponentFirmwareUpdateTransportContextGet)
 
@@ -203,6 +218,11 @@ PCWSTR ComponentFirmwareUpdate_ResumeOnConnectValueName = L"ResumeOnConnect";
 #define SizeOfFirmwareVersion (60)
 
 #define Thread_NumberOfWaitObjects (2)
+
+// Maximum number of payload chunks that are outstanding at the same time.
+//
+#define PayloadWindowSizeMaximum (16)
+
 const BYTE FWUPDATE_DRIVER_TOKEN = 0xA0;
 const BYTE FWUPDATE_INFORMATION_TOKEN = 0xFF;
 const BYTE FWUPDATE_COMMAND_TOKEN = 0xFE;
@@ -877,6 +897,464 @@ Exit:
     return ntStatus;
 }
 #pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+ComponentFirmwareUpdate_PayloadWindowResponseMatch(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(WindowSize) PAYLOAD_WINDOW_ENTRY* Window,
+    _In_ ULONG WindowSize,
+    _In_ ULONG WindowHead,
+    _In_ ULONG WindowCount
+    )
+/*++
+
+Routine Description:
+
+    Waits for the next response to an outstanding payload chunk and records it in the window entry
+    of the chunk with the matching sequence number. Responses that are already queued are processed
+    without waiting. Responses to chunks older than the oldest outstanding chunk are ignored.
+
+Arguments:
+
+    DmfModule - This Module's DMF Object.
+    Window - Circular array of the outstanding payload chunks.
+    WindowSize - Number of entries in Window.
+    WindowHead - Index in Window of the oldest outstanding payload chunk.
+    WindowCount - Number of outstanding payload chunks.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ComponentFirmwareUpdate* moduleContext;
+    CONTEXT_ComponentFirmwareUpdateTransaction* componentFirmwareUpdateTransactionContext;
+    CONTEXT_ComponentFirmwareUpdateTransport* componentFirmwareUpdateTransportContext;
+
+    const UINT maxUnmatchedResponses = 3;
+    UINT unmatchedResponses;
+    BOOL responseMatched;
+    UINT16 windowOffset;
+
+    VOID* clientBuffer = NULL;
+    VOID* clientBufferContext = NULL;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(WindowCount > 0);
+    DmfAssert(WindowCount <= WindowSize);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    componentFirmwareUpdateTransactionContext = ComponentFirmwareUpdateTransactionContextGet(moduleContext->DmfInterfaceComponentFirmwareUpdate);
+    DmfAssert(componentFirmwareUpdateTransactionContext != NULL);
+
+    componentFirmwareUpdateTransportContext = ComponentFirmwareUpdateTransportContextGet(moduleContext->DmfInterfaceComponentFirmwareUpdate);
+    DmfAssert(componentFirmwareUpdateTransportContext != NULL);
+
+    ntStatus = STATUS_SUCCESS;
+    responseMatched = FALSE;
+    unmatchedResponses = 0;
+    while (!responseMatched)
+    {
+        clientBufferContext = NULL;
+        clientBuffer = NULL;
+
+        ntStatus = DMF_BufferQueue_Dequeue(componentFirmwareUpdateTransactionContext->DmfModuleBufferQueue,
+                                           &clientBuffer,
+                                           &clientBufferContext);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // No response is queued. Wait for the next one.
+            //
+            if (unmatchedResponses >= maxUnmatchedResponses)
+            {
+                TraceEvents(TRACE_LEVEL_ERROR,
+                            DMF_TRACE,
+                            "Never matched sequence number.");
+                ntStatus = STATUS_DEVICE_PROTOCOL_ERROR;
+                goto Exit;
+            }
+
+            ntStatus = ComponentFirmwareUpdate_WaitForResponse(DmfModule,
+                                                               componentFirmwareUpdateTransportContext->TransportWaitTimeout);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR,
+                            DMF_TRACE,
+                            "WaitForResponse fails: ntStatus=%!STATUS!",
+                            ntStatus);
+                goto Exit;
+            }
+
+            // The event is also set when the transport fails to deliver a response.
+            //
+            unmatchedResponses++;
+            continue;
+        }
+
+        DmfAssert(clientBuffer != NULL);
+        DmfAssert(clientBufferContext != NULL);
+
+        PAYLOAD_RESPONSE* payloadResponse = (PAYLOAD_RESPONSE*)clientBuffer;
+#if defined(DEBUG)
+        ULONG* payloadResponseLength = (ULONG*)clientBufferContext;
+        DmfAssert(*payloadResponseLength == sizeof(PAYLOAD_RESPONSE));
+#endif // defined(DEBUG)
+
+        // Distance from the oldest outstanding chunk. Sequence numbers before it wrap to negative values.
+        //
+        windowOffset = (UINT16)(payloadResponse->SequenceNumber - Window[WindowHead].SequenceNumber);
+        if ((INT16)windowOffset < 0)
+        {
+            // This can happen if the device resends a message.
+            //
+            TraceEvents(TRACE_LEVEL_ERROR,
+                        DMF_TRACE,
+                        "Ignoring response for sequenceNumber(%d) older than oldest outstanding sequenceNumber(%d)",
+                        payloadResponse->SequenceNumber,
+                        Window[WindowHead].SequenceNumber);
+            unmatchedResponses++;
+        }
+        else if (windowOffset >= WindowCount)
+        {
+            // This is an error case.
+            //
+            TraceEvents(TRACE_LEVEL_ERROR,
+                        DMF_TRACE,
+                        "Response for sequenceNumber(%d) that was never sent. Oldest outstanding sequenceNumber(%d) Outstanding(%d)",
+                        payloadResponse->SequenceNumber,
+                        Window[WindowHead].SequenceNumber,
+                        WindowCount);
+            ntStatus = STATUS_DEVICE_PROTOCOL_ERROR;
+        }
+        else
+        {
+            PAYLOAD_WINDOW_ENTRY* windowEntry = &Window[(WindowHead + windowOffset) % WindowSize];
+            windowEntry->ResponseStatus = payloadResponse->ResponseStatus;
+            windowEntry->ResponseReceived = TRUE;
+            responseMatched = TRUE;
+        }
+
+        // We are done with the buffer from consumer; put it back to producer.
+        //
+        DMF_BufferQueue_Reuse(componentFirmwareUpdateTransactionContext->DmfModuleBufferQueue,
+                              clientBuffer);
+        clientBuffer = NULL;
+
+        if (!NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+ComponentFirmwareUpdate_PayloadWindowSend(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(PayloadBufferSize) const BYTE* PayloadBuffer,
+    _In_ const size_t PayloadBufferSize,
+    _Inout_updates_bytes_(TransferBufferSize) UCHAR* TransferBuffer,
+    _In_ const size_t TransferBufferSize,
+    _In_ const ULONG WindowSize,
+    _Inout_ UINT16 &SequenceNumber,
+    _Inout_ ULONG &PayloadBufferBinRecordStartIndex,
+    _Inout_ BYTE &PayloadBufferBinRecordDataOffset,
+    _Out_ COMPONENT_FIRMWARE_UPDATE_PAYLOAD_RESPONSE* PayloadResponse,
+    _Out_ BOOL* UpdateInterruptedFromIoFailure
+    )
+/*++
+
+Routine Description:
+
+    Sends the rest of a payload keeping up to WindowSize payload chunks outstanding.
+    If a chunk fails or its response times out while other chunks are outstanding, the responses to the
+    other chunks are collected and the payload is sent again from the failed chunk, one chunk at a time,
+    until that chunk is acknowledged. A failure while only one chunk is outstanding is returned to the Caller.
+
+Arguments:
+
+    DmfModule - This Module's DMF Object.
+    PayloadBuffer - Payload data from the blob. This is the whole payload.
+    PayloadBufferSize - Size of the above buffer.
+    TransferBuffer - Buffer sent to the transport. Transport header followed by the payload chunk.
+    TransferBufferSize - Size of TransferBuffer.
+    WindowSize - Maximum number of payload chunks outstanding.
+    SequenceNumber - Sequence number of the first chunk to send. On return, sequence number of the oldest chunk
+                     that was not acknowledged.
+    PayloadBufferBinRecordStartIndex - Position in PayloadBuffer of the first chunk to send. On return, position of the
+                                       oldest chunk that was not acknowledged.
+    PayloadBufferBinRecordDataOffset - Data offset into the bin record above.
+    PayloadResponse - Response retrieved from the device.
+    UpdateInterruptedFromIoFailure - Set to TRUE if the transfer stopped because the device did not respond.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ComponentFirmwareUpdate* moduleContext;
+    CONTEXT_ComponentFirmwareUpdateTransport* componentFirmwareUpdateTransportContext;
+
+    PAYLOAD_WINDOW_ENTRY window[PayloadWindowSizeMaximum];
+    PAYLOAD_WINDOW_ENTRY* windowEntry;
+    ULONG windowHead;
+    ULONG windowCount;
+    ULONG windowLimit;
+    ULONG responsesPending;
+
+    UCHAR* payloadBuffer;
+    UINT16 nextSequenceNumber;
+    ULONG nextPayloadBufferBinRecordStartIndex;
+    BYTE nextPayloadBufferBinRecordDataOffset;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(WindowSize > 1);
+    DmfAssert(WindowSize <= PayloadWindowSizeMaximum);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    componentFirmwareUpdateTransportContext = ComponentFirmwareUpdateTransportContextGet(moduleContext->DmfInterfaceComponentFirmwareUpdate);
+    DmfAssert(componentFirmwareUpdateTransportContext != NULL);
+
+    *PayloadResponse = COMPONENT_FIRMWARE_UPDATE_SUCCESS;
+    *UpdateInterruptedFromIoFailure = FALSE;
+
+    payloadBuffer = TransferBuffer + componentFirmwareUpdateTransportContext->TransportHeaderSize;
+    nextSequenceNumber = SequenceNumber;
+    nextPayloadBufferBinRecordStartIndex = PayloadBufferBinRecordStartIndex;
+    nextPayloadBufferBinRecordDataOffset = PayloadBufferBinRecordDataOffset;
+
+    windowHead = 0;
+    windowCount = 0;
+    windowLimit = WindowSize;
+    ntStatus = STATUS_SUCCESS;
+
+    while ((nextPayloadBufferBinRecordStartIndex < PayloadBufferSize) || (windowCount > 0))
+    {
+        // Send chunks until the window is full or the whole payload is sent.
+        //
+        while ((windowCount < windowLimit) && (nextPayloadBufferBinRecordStartIndex < PayloadBufferSize))
+        {
+            // Record where this chunk starts before filling it so that it can be sent again.
+            //
+            windowEntry = &window[(windowHead + windowCount) % WindowSize];
+            windowEntry->SequenceNumber = nextSequenceNumber;
+            windowEntry->PayloadBufferBinRecordStartIndex = nextPayloadBufferBinRecordStartIndex;
+            windowEntry->PayloadBufferBinRecordDataOffset = nextPayloadBufferBinRecordDataOffset;
+            windowEntry->ResponseReceived = FALSE;
+            windowCount++;
+
+            TraceEvents(TRACE_LEVEL_INFORMATION,
+                        DMF_TRACE,
+                        "Current sequenceNumber: %d, PayloadIndex: %d, Payload Total size: %Iu Outstanding: %d",
+                        nextSequenceNumber,
+                        nextPayloadBufferBinRecordStartIndex,
+                        PayloadBufferSize,
+                        windowCount);
+
+            ntStatus = ComponentFirmwareUpdate_PayloadBufferFill(DmfModule,
+                                                                 nextSequenceNumber,
+                                                                 PayloadBuffer,
+                                                                 PayloadBufferSize,
+                                                                 nextPayloadBufferBinRecordStartIndex,
+                                                                 nextPayloadBufferBinRecordDataOffset,
+                                                                 payloadBuffer,
+                                                                 SizeOfPayload);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR,
+                            DMF_TRACE,
+                            "PayloadBufferFill fails: ntStatus=%!STATUS!",
+                            ntStatus);
+                goto Exit;
+            }
+
+            ntStatus = DMF_ComponentFirmwareUpdate_TransportPayloadSend(moduleContext->DmfInterfaceComponentFirmwareUpdate,
+                                                                        TransferBuffer,
+                                                                        TransferBufferSize,
+                                                                        componentFirmwareUpdateTransportContext->TransportHeaderSize);
+            if (!NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR,
+                            DMF_TRACE,
+                            "DMF_ComponentFirmwareUpdateTransport_PayloadSend fails: ntStatus=%!STATUS!",
+                            ntStatus);
+                goto Exit;
+            }
+
+            ++nextSequenceNumber;
+        }
+
+        // Wait for the response to any outstanding chunk.
+        //
+        ntStatus = ComponentFirmwareUpdate_PayloadWindowResponseMatch(DmfModule,
+                                                                      window,
+                                                                      WindowSize,
+                                                                      windowHead,
+                                                                      windowCount);
+        if (!NT_SUCCESS(ntStatus))
+        {
+            // Treat timeout as IoFailure.
+            //
+            if (ntStatus == STATUS_INVALID_DEVICE_STATE)
+            {
+                if (windowLimit > 1)
+                {
+                    // Device may have dropped chunks that it could not buffer.
+                    // Send again from the oldest chunk that was not acknowledged, one chunk at a time.
+                    //
+                    TraceEvents(TRACE_LEVEL_WARNING,
+                                DMF_TRACE,
+                                "Response timed out with %d chunks outstanding. Sending again from sequenceNumber(%d)",
+                                windowCount,
+                                window[windowHead].SequenceNumber);
+                    nextSequenceNumber = window[windowHead].SequenceNumber;
+                    nextPayloadBufferBinRecordStartIndex = window[windowHead].PayloadBufferBinRecordStartIndex;
+                    nextPayloadBufferBinRecordDataOffset = window[windowHead].PayloadBufferBinRecordDataOffset;
+                    windowCount = 0;
+                    windowLimit = 1;
+                    ntStatus = STATUS_SUCCESS;
+                    continue;
+                }
+
+                *UpdateInterruptedFromIoFailure = TRUE;
+            }
+
+            TraceEvents(TRACE_LEVEL_ERROR,
+                        DMF_TRACE,
+                        "PayloadWindowResponseMatch fails: ntStatus=%!STATUS!",
+                        ntStatus);
+            goto Exit;
+        }
+
+        // Retire the acknowledged chunks in the order they were sent.
+        //
+        while ((windowCount > 0) && window[windowHead].ResponseReceived)
+        {
+            windowEntry = &window[windowHead];
+            if (windowEntry->ResponseStatus != COMPONENT_FIRMWARE_UPDATE_SUCCESS)
+            {
+                if (windowLimit == 1)
+                {
+                    // The chunk failed on its own. Report it the same way stop-and-wait transfer does.
+                    //
+                    *PayloadResponse = windowEntry->ResponseStatus;
+                    TraceEvents(TRACE_LEVEL_ERROR,
+                                DMF_TRACE,
+                                "PayloadResponseProcess returns: %d",
+                                *PayloadResponse);
+                    goto Exit;
+                }
+
+                TraceEvents(TRACE_LEVEL_WARNING,
+                            DMF_TRACE,
+                            "sequenceNumber(%d) failed with %d chunks outstanding. Sending again from it.",
+                            windowEntry->SequenceNumber,
+                            windowCount);
+
+                // Collect the responses to the other outstanding chunks so they are not matched
+                // to the chunks that are sent again.
+                //
+                while (TRUE)
+                {
+                    responsesPending = 0;
+                    for (ULONG windowIndex = 0; windowIndex < windowCount; windowIndex++)
+                    {
+                        if (! window[(windowHead + windowIndex) % WindowSize].ResponseReceived)
+                        {
+                            responsesPending++;
+                        }
+                    }
+
+                    if (responsesPending == 0)
+                    {
+                        break;
+                    }
+
+                    ntStatus = ComponentFirmwareUpdate_PayloadWindowResponseMatch(DmfModule,
+                                                                                  window,
+                                                                                  WindowSize,
+                                                                                  windowHead,
+                                                                                  windowCount);
+                    if (!NT_SUCCESS(ntStatus))
+                    {
+                        if (ntStatus == STATUS_INVALID_DEVICE_STATE)
+                        {
+                            *UpdateInterruptedFromIoFailure = TRUE;
+                        }
+
+                        TraceEvents(TRACE_LEVEL_ERROR,
+                                    DMF_TRACE,
+                                    "PayloadWindowResponseMatch fails: ntStatus=%!STATUS!",
+                                    ntStatus);
+                        goto Exit;
+                    }
+                }
+
+                nextSequenceNumber = windowEntry->SequenceNumber;
+                nextPayloadBufferBinRecordStartIndex = windowEntry->PayloadBufferBinRecordStartIndex;
+                nextPayloadBufferBinRecordDataOffset = windowEntry->PayloadBufferBinRecordDataOffset;
+                windowCount = 0;
+                windowLimit = 1;
+                break;
+            }
+
+            windowHead = (windowHead + 1) % WindowSize;
+            windowCount--;
+
+            // A chunk sent again after a failure has been acknowledged. Open the window again.
+            //
+            windowLimit = WindowSize;
+        }
+    }
+
+Exit:
+
+    // Return the position of the oldest chunk that was not acknowledged so that the Caller
+    // can save it as the resume point.
+    //
+    if (windowCount > 0)
+    {
+        SequenceNumber = window[windowHead].SequenceNumber;
+        PayloadBufferBinRecordStartIndex = window[windowHead].PayloadBufferBinRecordStartIndex;
+        PayloadBufferBinRecordDataOffset = window[windowHead].PayloadBufferBinRecordDataOffset;
+    }
+    else
+    {
+        SequenceNumber = nextSequenceNumber;
+        PayloadBufferBinRecordStartIndex = nextPayloadBufferBinRecordStartIndex;
+        PayloadBufferBinRecordDataOffset = nextPayloadBufferBinRecordDataOffset;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
 //-- Helper functions ---
 //--------END------------
 
@@ -2319,6 +2797,10 @@ Return Value:
 
     BOOL updateInterruptedFromIoFailure = FALSE;
 
+    // Number of payload chunks that can be outstanding.
+    //
+    ULONG payloadWindowSize;
+
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
@@ -2518,6 +3000,50 @@ Return Value:
         goto Exit;
     }
 
+    // Keep more than one payload chunk outstanding only if both the Client and the transport allow it.
+    //
+    payloadWindowSize = 1;
+    if (moduleConfig->SupportPayloadPipelining)
+    {
+        payloadWindowSize = componentFirmwareUpdateTransportContext->TransportMaximumOutstandingPayloads;
+        if ((moduleConfig->MaximumOutstandingPayloads != 0) &&
+            (moduleConfig->MaximumOutstandingPayloads < payloadWindowSize))
+        {
+            payloadWindowSize = moduleConfig->MaximumOutstandingPayloads;
+        }
+        if (payloadWindowSize > PayloadWindowSizeMaximum)
+        {
+            payloadWindowSize = PayloadWindowSizeMaximum;
+        }
+    }
+
+    if (payloadWindowSize > 1)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION,
+                    DMF_TRACE,
+                    "Sending payload with up to %d chunks outstanding",
+                    payloadWindowSize);
+
+        ntStatus = ComponentFirmwareUpdate_PayloadWindowSend(DmfModule,
+                                                             (BYTE*)payloadContent,
+                                                             firmwareInformation->PayloadSize,
+                                                             bufferHeader,
+                                                             allocatedSize,
+                                                             payloadWindowSize,
+                                                             sequenceNumber,
+                                                             payloadBufferBinRecordStartIndex,
+                                                             payloadBufferBinRecordDataOffset,
+                                                             PayloadResponse,
+                                                             &updateInterruptedFromIoFailure);
+
+        // The position returned is the oldest chunk that was not acknowledged.
+        //
+        resumeSequenceNumber = sequenceNumber;
+        resumePayloadBufferBinRecordStartIndex = payloadBufferBinRecordStartIndex;
+        resumePayloadBufferBinRecordDataOffset = payloadBufferBinRecordDataOffset;
+        goto Exit;
+    }
+
     // Proceed while there is some payload data still needed to send..
     //
     while (payloadBufferBinRecordStartIndex < firmwareInformation->PayloadSize)
@@ -4902,6 +5428,7 @@ Return Value:
     configComponentFirmwareUpdateTransport->TransportOfferBufferRequiredSize = transportBindData.TransportOfferBufferRequiredSize;
     configComponentFirmwareUpdateTransport->TransportWaitTimeout = transportBindData.TransportWaitTimeout;
     configComponentFirmwareUpdateTransport->TransportPayloadFillAlignment = transportBindData.TransportPayloadFillAlignment;
+    configComponentFirmwareUpdateTransport->TransportMaximumOutstandingPayloads = transportBindData.TransportMaximumOutstandingPayloads;
 
     // Allocate a Context to keep items for transaction response response specific processing.
     //
@@ -4931,7 +5458,14 @@ Return Value:
     DMF_CONFIG_BufferQueue_AND_ATTRIBUTES_INIT(&bufferQueueModuleConfig,
                                                &moduleAttributes);
     bufferQueueModuleConfig.SourceSettings.EnableLookAside = TRUE;
+    // Make room for a response to every payload chunk that can be outstanding.
+    //
     bufferQueueModuleConfig.SourceSettings.BufferCount = 5;
+    if (transportBindData.TransportMaximumOutstandingPayloads > bufferQueueModuleConfig.SourceSettings.BufferCount)
+    {
+        bufferQueueModuleConfig.SourceSettings.BufferCount = min(transportBindData.TransportMaximumOutstandingPayloads,
+                                                                 PayloadWindowSizeMaximum);
+    }
     bufferQueueModuleConfig.SourceSettings.BufferSize = sizeof(PAYLOAD_RESPONSE);
     bufferQueueModuleConfig.SourceSettings.BufferContextSize = sizeof(ULONG);
     bufferQueueModuleConfig.SourceSettings.PoolType = NonPagedPoolNx;
@@ -76,6 +76,16 @@ typedef struct
     //
     BOOLEAN ForceIgnoreVersion;
 
+    // Does this component support having more than one payload chunk outstanding?
+    // Only used when the transport also supports more than one outstanding payload chunk.
+    //
+    BOOLEAN SupportPayloadPipelining;
+
+    // Maximum number of payload chunks outstanding when SupportPayloadPipelining is set.
+    // 0 means use the maximum the transport supports.
+    //
+    ULONG MaximumOutstandingPayloads;
+
     //----- END:  CFU protocol related -------
     //
 
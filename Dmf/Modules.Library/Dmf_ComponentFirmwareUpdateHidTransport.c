@@ -1077,6 +1077,9 @@ Return:
     TransportBindData->TransportOfferBufferRequiredSize = SizeOfOffer;
     TransportBindData->TransportWaitTimeout = moduleContext->HidDeviceWaitTimeoutMs;
     TransportBindData->TransportPayloadFillAlignment = moduleConfig->PayloadFillAlignment;
+    // Each pended input report read can hold one payload response.
+    //
+    TransportBindData->TransportMaximumOutstandingPayloads = moduleConfig->NumberOfInputReportReadsPended;
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -53,8 +53,40 @@ typedef struct
     UNICODE_STRING SymbolicLinkName;
     DMFMODULE DmfModuleRequestTarget;
     DeviceInterfaceMultipleTarget_Target DmfIoTarget;
+    // Hash of SymbolicLinkName. Computed once when the name is stored.
+    //
+    ULONG SymbolicLinkNameHash;
+    // Location of this target in the index keyed by DmfIoTarget.
+    //
+    LIST_ENTRY HandleIndexListEntry;
+    // Location of this target in the index keyed by SymbolicLinkName.
+    //
+    LIST_ENTRY SymbolicLinkIndexListEntry;
+    // Location of this target in the list of open targets that SendToAny/SendToAll choose from.
+    //
+    LIST_ENTRY TargetListEntry;
+    // Number of Requests sent to this target by SendToAny/SendToAll that have not completed.
+    //
+    LONG OutstandingRequests;
+    // Indicates if SendToAny/SendToAll may choose this target. Cleared while the target
+    // is being removed. Protected by the Module lock.
+    //
+    BOOLEAN AcceptingRequests;
+    // Set when OutstandingRequests drops to zero after the target stops accepting Requests.
+    // The target is not destroyed until all the Requests sent to it have completed.
+    //
+    DMF_PORTABLE_EVENT RequestsDrainedEvent;
 } DeviceInterfaceMultipleTarget_IoTarget;
 
+// Number of buckets in each target index. Must be a power of two.
+//
+#define DeviceInterfaceMultipleTarget_IndexBucketCount  64
+
+// Number of SendToAny contexts allocated when the Module is created. More are allocated
+// from the lookaside list of the pool when they are all in use.
+//
+#define DeviceInterfaceMultipleTarget_SendContextsPreallocated  16
+
 typedef struct
 {
     // Details of the Target. 
@@ -67,18 +99,57 @@ typedef struct
 
 WDF_DECLARE_CONTEXT_TYPE(DeviceInterfaceMultipleTarget_IoTargetContext);
 
+// Aggregates the completions of a Request sent by SendToAll.
+//
+typedef struct
+{
+    // This Module's handle.
+    //
+    DMFMODULE DmfModule;
+    // The memory that contains this structure.
+    //
+    WDFMEMORY Memory;
+    // One reference per Request that has not completed plus one held by the sender.
+    //
+    LONG NumberOfTargetsPending;
+    // Number of Requests that completed successfully.
+    //
+    LONG NumberOfTargetsSucceeded;
+    // Number of Requests that were sent.
+    //
+    ULONG NumberOfTargetsSent;
+    // Client's callback and context.
+    //
+    EVT_DMF_DeviceInterfaceMultipleTarget_BroadcastCompletion* EvtBroadcastCompletion;
+    VOID* ClientRequestContext;
+} DeviceInterfaceMultipleTarget_BroadcastContext;
+
+// Context of a single Request sent by SendToAny or SendToAll.
+// For SendToAll, the response buffer for this target immediately follows this structure.
+//
 typedef struct
 {
-    // If set to TRUE, Buffer will be removed from buffer pool if found during enumeration.
+    // Used to build the list of Requests to send in SendToAll.
+    //
+    LIST_ENTRY ListEntry;
+    // This Module's handle.
+    //
+    DMFMODULE DmfModule;
+    // The memory that contains this structure. NULL when this structure is from the pool of
+    // contexts that have no response buffer.
     //
-    BOOLEAN RemoveBuffer;
-    // Data used in the enumeration callback functions.
+    WDFMEMORY Memory;
+    // The target the Request is sent to.
     //
-    VOID* ContextData;
-    // Set to TRUE in enumeration callback if buffer is found.
+    DeviceInterfaceMultipleTarget_IoTarget* Target;
+    // Client's callback and context.
+    //
+    EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtSendCompletion;
+    VOID* ClientRequestContext;
+    // Set only for SendToAll.
     //
-    BOOLEAN BufferFound;
-} DeviceInterfaceMultipleTarget_EnumerationContext;
+    DeviceInterfaceMultipleTarget_BroadcastContext* BroadcastContext;
+} DeviceInterfaceMultipleTarget_SendContext;
 
 // These are virtual Methods that are set based on the transport.
 // These functions are common to both the Stream and Target transport.
@@ -147,11 +218,29 @@ typedef struct
     VOID* DeviceInterfaceNotification;
 #endif // defined(DMF_USER_MODE)
 
+    // Source of target buffers. Open targets are tracked by the indexes below.
+    //
     DMFMODULE DmfModuleBufferQueue;
+    // Source of the contexts of Requests that have no response buffer so that
+    // SendToAny does not create a WDFMEMORY for each Request.
+    //
+    DMFMODULE DmfModuleBufferPoolSendContext;
     // Ensures that Module Open/Close are called a single time.
     //
     LONG NumberOfTargetsCreated;
 
+    // Open targets indexed by DmfIoTarget handle and by symbolic link name so that
+    // PnP notifications find their target without walking all the targets.
+    // Both indexes are protected by the Module lock and are always updated together.
+    //
+    LIST_ENTRY TargetIndexByHandle[DeviceInterfaceMultipleTarget_IndexBucketCount];
+    LIST_ENTRY TargetIndexBySymbolicLink[DeviceInterfaceMultipleTarget_IndexBucketCount];
+    ULONG NumberOfTargetsInIndex;
+    // The same open targets in a single list so that selecting a target does not walk all the
+    // buckets. Round robin selection moves the chosen target to the tail. Protected by the Module lock.
+    //
+    LIST_ENTRY TargetList;
+
     // Redirect Input buffer callback from ContinuousRequestTarget to this callback.
     //
     EVT_DMF_ContinuousRequestTarget_BufferInput* EvtContinuousRequestTargetBufferInput;
@@ -201,6 +290,83 @@ DMF_MODULE_DECLARE_CONFIG(DeviceInterfaceMultipleTarget)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+static
+VOID
+DeviceInterfaceMultipleTarget_TargetRequestDereference(
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+/*++
+
+Routine Description:
+
+    Release the outstanding Request count taken when SendToAny/SendToAll chose the given target.
+    If the target is being removed and this was its last Request, let the removal continue.
+
+Arguments:
+
+    Target - The given target.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(Target->OutstandingRequests > 0);
+    if ((InterlockedDecrement(&Target->OutstandingRequests) == 0) &&
+        (! Target->AcceptingRequests))
+    {
+        DMF_Portable_EventSet(&Target->RequestsDrainedEvent);
+    }
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DeviceInterfaceMultipleTarget_TargetRequestsDrain(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+/*++
+
+Routine Description:
+
+    Wait for all the Requests that SendToAny/SendToAll sent (or are about to send) to the given target
+    to complete. The target no longer accepts Requests and its IoTarget is closed, so Requests that
+    are sent now fail right away.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Target - The given target.
+
+Return Value:
+
+    None
+
+--*/
+{
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    DmfAssert(! Target->AcceptingRequests);
+
+    // The event is an auto-reset event. A stale signal left by a canceled QueryRemove
+    // only causes the count to be checked again.
+    //
+    while (InterlockedCompareExchange(&Target->OutstandingRequests,
+                                      0,
+                                      0) > 0)
+    {
+        DMF_Portable_EventWaitForSingleObject(&Target->RequestsDrainedEvent,
+                                              NULL,
+                                              FALSE);
+    }
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
@@ -242,6 +408,13 @@ Return Value:
     if (Target->IoTarget != NULL)
     {
         WdfIoTargetClose(Target->IoTarget);
+
+        // SendToAny/SendToAll may have chosen this target before it stopped accepting Requests.
+        // Its Child Module and IoTarget must remain valid until those Requests are done.
+        //
+        DeviceInterfaceMultipleTarget_TargetRequestsDrain(DmfModule,
+                                                          Target);
+
         if (moduleConfig->EvtDeviceInterfaceMultipleTargetOnStateChange)
         {
             moduleConfig->EvtDeviceInterfaceMultipleTargetOnStateChange(DmfModule,
@@ -258,6 +431,74 @@ Return Value:
 }
 #pragma code_seg()
 
+static
+ULONG
+DeviceInterfaceMultipleTarget_SymbolicLinkNameHash(
+    _In_ UNICODE_STRING* SymbolicLinkName
+    )
+/*++
+
+Routine Description:
+
+    Calculate the hash (FNV-1a) of the given symbolic link name. The comparison of symbolic
+    link names is an exact byte comparison so the hash is calculated over the same bytes.
+
+Arguments:
+
+    SymbolicLinkName - The given symbolic link name.
+
+Return Value:
+
+    The hash of the given symbolic link name.
+
+--*/
+{
+    ULONG hash;
+    UCHAR* nameBytes;
+    USHORT byteIndex;
+
+    hash = 2166136261;
+    nameBytes = (UCHAR*)SymbolicLinkName->Buffer;
+    for (byteIndex = 0; byteIndex < SymbolicLinkName->Length; byteIndex++)
+    {
+        hash ^= nameBytes[byteIndex];
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+static
+ULONG
+DeviceInterfaceMultipleTarget_HandleBucketGet(
+    _In_ DeviceInterfaceMultipleTarget_Target Target
+    )
+/*++
+
+Routine Description:
+
+    Get the bucket of the handle index that holds the given target handle.
+
+Arguments:
+
+    Target - The given target handle.
+
+Return Value:
+
+    Index of the bucket.
+
+--*/
+{
+    ULONG_PTR handleValue;
+
+    // Low bits of WDF handles are always the same. Fold the rest of the value.
+    //
+    handleValue = (ULONG_PTR)Target >> 4;
+    handleValue ^= handleValue >> 16;
+
+    return (ULONG)(handleValue & (DeviceInterfaceMultipleTarget_IndexBucketCount - 1));
+}
+
 VOID
 DeviceInterfaceMultipleTarget_SymbolicLinkNameClear(
     _In_ DMFMODULE DmfModule,
@@ -273,7 +514,7 @@ Routine Description:
 Arguments:
 
     DmfModule - This Module's DMF Module handle.
-    Target - 
+    Target - The target whose symbolic link name is deleted.
 
 Return Value:
 
@@ -360,6 +601,8 @@ Return Value:
         goto Exit;
     }
 
+    Target->SymbolicLinkNameHash = DeviceInterfaceMultipleTarget_SymbolicLinkNameHash(&Target->SymbolicLinkName);
+
 Exit:
     
     return ntStatus;
@@ -396,6 +639,13 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // SendToAny/SendToAll must not choose this target from now on. Every path that destroys
+    // a target (QueryRemove, surprise removal, interface removal and cleanup) comes here.
+    //
+    DMF_ModuleLock(DmfModule);
+    Target->AcceptingRequests = FALSE;
+    DMF_ModuleUnlock(DmfModule);
+
     // It is important to check the IoTarget because it may have been closed via 
     // two asynchronous removal paths: 1. Device is removed. 2. Underlying target is removed.
     //
@@ -426,7 +676,11 @@ Return Value:
     if (Target->DmfIoTarget)
     {
         WdfObjectDelete(Target->DmfIoTarget);
+        Target->DmfIoTarget = NULL;
     }
+
+    DmfAssert(0 == Target->OutstandingRequests);
+    DMF_Portable_EventClose(&Target->RequestsDrainedEvent);
 }
 #pragma code_seg()
 
@@ -545,164 +799,756 @@ DeviceInterfaceMultipleTarget_Stream_Send(
                                             SingleAsynchronousRequestClientContext);
 }
 
-VOID
-DeviceInterfaceMultipleTarget_Stream_IoTargetSet(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
-    _In_ WDFIOTARGET IoTarget
-    )
+VOID
+DeviceInterfaceMultipleTarget_Stream_IoTargetSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
+    _In_ WDFIOTARGET IoTarget
+    )
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext->ContinuousReaderMode);
+    DMF_ContinuousRequestTarget_IoTargetSet(Target->DmfModuleRequestTarget,
+                                            IoTarget);
+}
+
+VOID
+DeviceInterfaceMultipleTarget_Stream_IoTargetClear(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext->ContinuousReaderMode);
+    DMF_ContinuousRequestTarget_IoTargetClear(Target->DmfModuleRequestTarget);
+}
+
+// RequestTarget Methods
+// ---------------------
+//
+
+NTSTATUS
+DeviceInterfaceMultipleTarget_Target_SendSynchronously(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _Out_opt_ size_t* BytesWritten
+    )
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(! moduleContext->ContinuousReaderMode);
+    ntStatus = DMF_RequestTarget_SendSynchronously(Target->DmfModuleRequestTarget,
+                                                   RequestBuffer,
+                                                   RequestLength,
+                                                   ResponseBuffer,
+                                                   ResponseLength,
+                                                   RequestType,
+                                                   RequestIoctl,
+                                                   RequestTimeoutMilliseconds,
+                                                   BytesWritten);
+
+    return ntStatus;
+}
+
+NTSTATUS
+DeviceInterfaceMultipleTarget_Target_Send(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _In_opt_ EVT_DMF_ContinuousRequestTarget_SendCompletion* EvtRequestSinkSingleAsynchronousRequest,
+    _In_opt_ VOID* SingleAsynchronousRequestClientContext
+    )
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(! moduleContext->ContinuousReaderMode);
+    ntStatus = DMF_RequestTarget_Send(Target->DmfModuleRequestTarget,
+                                      RequestBuffer,
+                                      RequestLength,
+                                      ResponseBuffer,
+                                      ResponseLength,
+                                      RequestType,
+                                      RequestIoctl,
+                                      RequestTimeoutMilliseconds,
+                                      EvtRequestSinkSingleAsynchronousRequest,
+                                      SingleAsynchronousRequestClientContext);
+
+    return ntStatus;
+}
+
+VOID
+DeviceInterfaceMultipleTarget_Target_IoTargetSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
+    _In_ WDFIOTARGET IoTarget
+    )
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(! moduleContext->ContinuousReaderMode);
+    DMF_RequestTarget_IoTargetSet(Target->DmfModuleRequestTarget,
+                                  IoTarget);
+}
+
+VOID
+DeviceInterfaceMultipleTarget_Target_IoTargetClear(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(! moduleContext->ContinuousReaderMode);
+    DMF_RequestTarget_IoTargetClear(Target->DmfModuleRequestTarget);
+}
+
+// General Module Support Code
+// ---------------------------
+//
+
+static
+VOID
+DeviceInterfaceMultipleTarget_IndexInitialize(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize the indexes of open targets.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    ULONG bucketIndex;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (bucketIndex = 0; bucketIndex < DeviceInterfaceMultipleTarget_IndexBucketCount; bucketIndex++)
+    {
+        InitializeListHead(&moduleContext->TargetIndexByHandle[bucketIndex]);
+        InitializeListHead(&moduleContext->TargetIndexBySymbolicLink[bucketIndex]);
+    }
+    InitializeListHead(&moduleContext->TargetList);
+    moduleContext->NumberOfTargetsInIndex = 0;
+}
+
+static
+DeviceInterfaceMultipleTarget_IoTarget*
+DeviceInterfaceMultipleTarget_IndexSymbolicLinkFind(
+    _In_ DMFMODULE DmfModule,
+    _In_ UNICODE_STRING* SymbolicLinkName,
+    _In_ ULONG SymbolicLinkNameHash
+    )
+/*++
+
+Routine Description:
+
+    Find the open target that has the given symbolic link name.
+    NOTE: Module lock must be held by the caller and the given name must be in non-paged memory.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SymbolicLinkName - The given symbolic link name.
+    SymbolicLinkNameHash - Hash of the given symbolic link name.
+
+Return Value:
+
+    The target with the given symbolic link name or NULL if there is no such target.
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    LIST_ENTRY* bucket;
+    LIST_ENTRY* listEntry;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    SIZE_T matchLength;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    bucket = &moduleContext->TargetIndexBySymbolicLink[SymbolicLinkNameHash & (DeviceInterfaceMultipleTarget_IndexBucketCount - 1)];
+    for (listEntry = bucket->Flink; listEntry != bucket; listEntry = listEntry->Flink)
+    {
+        target = CONTAINING_RECORD(listEntry,
+                                   DeviceInterfaceMultipleTarget_IoTarget,
+                                   SymbolicLinkIndexListEntry);
+        if ((target->SymbolicLinkNameHash == SymbolicLinkNameHash) &&
+            (target->SymbolicLinkName.Length == SymbolicLinkName->Length))
+        {
+            matchLength = RtlCompareMemory((VOID*)target->SymbolicLinkName.Buffer,
+                                           SymbolicLinkName->Buffer,
+                                           target->SymbolicLinkName.Length);
+            if (target->SymbolicLinkName.Length == matchLength)
+            {
+                return target;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static
+VOID
+DeviceInterfaceMultipleTarget_IndexTargetUnlink(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+/*++
+
+Routine Description:
+
+    Remove the given target from both indexes and from the list of open targets.
+    NOTE: Module lock must be held by the caller.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Target - The given target.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+
+    DmfAssert(DMF_ModuleIsLocked(DmfModule));
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    RemoveEntryList(&Target->HandleIndexListEntry);
+    InitializeListHead(&Target->HandleIndexListEntry);
+    RemoveEntryList(&Target->SymbolicLinkIndexListEntry);
+    InitializeListHead(&Target->SymbolicLinkIndexListEntry);
+    RemoveEntryList(&Target->TargetListEntry);
+    InitializeListHead(&Target->TargetListEntry);
+
+    DmfAssert(moduleContext->NumberOfTargetsInIndex > 0);
+    moduleContext->NumberOfTargetsInIndex--;
+}
+
+static
+BOOLEAN
+DeviceInterfaceMultipleTarget_IndexSymbolicLinkContains(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+/*++
+
+Routine Description:
+
+    Determine if an open target with the same symbolic link name as the given target is in the index.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Target - The given target. Its symbolic link name must have been stored.
+
+Return Value:
+
+    TRUE if an open target with the same symbolic link name exists.
+
+--*/
+{
+    BOOLEAN returnValue;
+
+    DMF_ModuleLock(DmfModule);
+
+    returnValue = (DeviceInterfaceMultipleTarget_IndexSymbolicLinkFind(DmfModule,
+                                                                       &Target->SymbolicLinkName,
+                                                                       Target->SymbolicLinkNameHash) != NULL);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return returnValue;
+}
+
+static
+BOOLEAN
+DeviceInterfaceMultipleTarget_IndexTargetInsert(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+    )
+/*++
+
+Routine Description:
+
+    Add the given target to both indexes and to the list of open targets unless a target with
+    the same symbolic link name is already present.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Target - The given target. Its handle and symbolic link name must have been set.
+
+Return Value:
+
+    TRUE if the target was added.
+    FALSE if a target with the same symbolic link name is already present.
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    ULONG handleBucket;
+    ULONG symbolicLinkBucket;
+    BOOLEAN returnValue;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(Target->DmfIoTarget != NULL);
+    DmfAssert(Target->SymbolicLinkName.Buffer != NULL);
+
+    handleBucket = DeviceInterfaceMultipleTarget_HandleBucketGet(Target->DmfIoTarget);
+    symbolicLinkBucket = Target->SymbolicLinkNameHash & (DeviceInterfaceMultipleTarget_IndexBucketCount - 1);
+
+    DMF_ModuleLock(DmfModule);
+
+    if (DeviceInterfaceMultipleTarget_IndexSymbolicLinkFind(DmfModule,
+                                                            &Target->SymbolicLinkName,
+                                                            Target->SymbolicLinkNameHash) != NULL)
+    {
+        returnValue = FALSE;
+    }
+    else
+    {
+        Target->AcceptingRequests = TRUE;
+        InsertTailList(&moduleContext->TargetIndexByHandle[handleBucket],
+                       &Target->HandleIndexListEntry);
+        InsertTailList(&moduleContext->TargetIndexBySymbolicLink[symbolicLinkBucket],
+                       &Target->SymbolicLinkIndexListEntry);
+        InsertTailList(&moduleContext->TargetList,
+                       &Target->TargetListEntry);
+        moduleContext->NumberOfTargetsInIndex++;
+        returnValue = TRUE;
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return returnValue;
+}
+
+static
+DeviceInterfaceMultipleTarget_IoTarget*
+DeviceInterfaceMultipleTarget_IndexTargetRemoveByHandle(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_Target Target
+    )
+/*++
+
+Routine Description:
+
+    Find the open target that has the given handle and remove it from both indexes.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Target - The given target handle.
+
+Return Value:
+
+    The removed target or NULL if the given handle is not an open target.
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    LIST_ENTRY* bucket;
+    LIST_ENTRY* listEntry;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    DeviceInterfaceMultipleTarget_IoTarget* targetFound;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    targetFound = NULL;
+
+    bucket = &moduleContext->TargetIndexByHandle[DeviceInterfaceMultipleTarget_HandleBucketGet(Target)];
+
+    DMF_ModuleLock(DmfModule);
+
+    for (listEntry = bucket->Flink; listEntry != bucket; listEntry = listEntry->Flink)
+    {
+        target = CONTAINING_RECORD(listEntry,
+                                   DeviceInterfaceMultipleTarget_IoTarget,
+                                   HandleIndexListEntry);
+        if (target->DmfIoTarget == Target)
+        {
+            DeviceInterfaceMultipleTarget_IndexTargetUnlink(DmfModule,
+                                                            target);
+            targetFound = target;
+            break;
+        }
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return targetFound;
+}
+
+static
+DeviceInterfaceMultipleTarget_IoTarget*
+DeviceInterfaceMultipleTarget_IndexTargetRemoveBySymbolicLink(
+    _In_ DMFMODULE DmfModule,
+    _In_ UNICODE_STRING* SymbolicLinkName
+    )
+/*++
+
+Routine Description:
+
+    Find the open target that has the given symbolic link name and remove it from both indexes.
+    NOTE: The given name must be in non-paged memory because it is compared under the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    SymbolicLinkName - The given symbolic link name.
+
+Return Value:
+
+    The removed target or NULL if no open target has the given symbolic link name.
+
+--*/
+{
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    ULONG symbolicLinkNameHash;
+
+    symbolicLinkNameHash = DeviceInterfaceMultipleTarget_SymbolicLinkNameHash(SymbolicLinkName);
+
+    DMF_ModuleLock(DmfModule);
+
+    target = DeviceInterfaceMultipleTarget_IndexSymbolicLinkFind(DmfModule,
+                                                                 SymbolicLinkName,
+                                                                 symbolicLinkNameHash);
+    if (target != NULL)
+    {
+        DeviceInterfaceMultipleTarget_IndexTargetUnlink(DmfModule,
+                                                        target);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return target;
+}
+
+static
+DeviceInterfaceMultipleTarget_IoTarget*
+DeviceInterfaceMultipleTarget_IndexTargetRemoveAny(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove any open target from both indexes. Used to clean up all the targets.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    The removed target or NULL if there are no open targets.
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    target = NULL;
+
+    DMF_ModuleLock(DmfModule);
+
+    if (! IsListEmpty(&moduleContext->TargetList))
+    {
+        target = CONTAINING_RECORD(moduleContext->TargetList.Flink,
+                                   DeviceInterfaceMultipleTarget_IoTarget,
+                                   TargetListEntry);
+        DeviceInterfaceMultipleTarget_IndexTargetUnlink(DmfModule,
+                                                        target);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return target;
+}
+
+static
+DeviceInterfaceMultipleTarget_IoTarget*
+DeviceInterfaceMultipleTarget_TargetSelect(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_TargetSelectionType TargetSelection,
+    _In_reads_opt_(NumberOfTargetsExcluded) DeviceInterfaceMultipleTarget_IoTarget** TargetsExcluded,
+    _In_ ULONG NumberOfTargetsExcluded
+    )
+/*++
+
+Routine Description:
+
+    Choose an open target that accepts Requests using the given selection method.
+    The outstanding Request count of the chosen target is incremented.
+    Round robin chooses the first eligible target in the list of open targets and moves it to the tail.
+    Least outstanding Requests chooses the eligible target with the fewest outstanding Requests.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetSelection - How the target is chosen.
+    TargetsExcluded - Optional targets that must not be chosen (because sending to them failed).
+    NumberOfTargetsExcluded - Number of entries in TargetsExcluded.
+
+Return Value:
+
+    The chosen target or NULL if no target accepts Requests.
+
+--*/
+{
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    DeviceInterfaceMultipleTarget_IoTarget* targetSelected;
+    LIST_ENTRY* listEntry;
+    ULONG excludedIndex;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    targetSelected = NULL;
+
+    DMF_ModuleLock(DmfModule);
+
+    for (listEntry = moduleContext->TargetList.Flink;
+         listEntry != &moduleContext->TargetList;
+         listEntry = listEntry->Flink)
+    {
+        target = CONTAINING_RECORD(listEntry,
+                                   DeviceInterfaceMultipleTarget_IoTarget,
+                                   TargetListEntry);
+        if (! target->AcceptingRequests)
+        {
+            continue;
+        }
+
+        for (excludedIndex = 0; excludedIndex < NumberOfTargetsExcluded; excludedIndex++)
+        {
+            if (target == TargetsExcluded[excludedIndex])
+            {
+                break;
+            }
+        }
+        if (excludedIndex < NumberOfTargetsExcluded)
+        {
+            continue;
+        }
+
+        if (DeviceInterfaceMultipleTarget_TargetSelection_RoundRobin == TargetSelection)
+        {
+            targetSelected = target;
+            break;
+        }
+
+        if ((NULL == targetSelected) ||
+            (target->OutstandingRequests < targetSelected->OutstandingRequests))
+        {
+            targetSelected = target;
+        }
+    }
+
+    if (targetSelected != NULL)
+    {
+        if (DeviceInterfaceMultipleTarget_TargetSelection_RoundRobin == TargetSelection)
+        {
+            // The targets that were skipped are now ahead of the chosen target.
+            //
+            RemoveEntryList(&targetSelected->TargetListEntry);
+            InsertTailList(&moduleContext->TargetList,
+                           &targetSelected->TargetListEntry);
+        }
+        InterlockedIncrement(&targetSelected->OutstandingRequests);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return targetSelected;
+}
+
+static
+BOOLEAN
+DeviceInterfaceMultipleTarget_IsTargetGoneStatus(
+    _In_ NTSTATUS NtStatus
+    )
+/*++
+
+Routine Description:
+
+    Indicates if the given send failure means that the target is going away (so that the
+    Request may be sent to another target) rather than that the Request itself is invalid.
+
+Arguments:
+
+    NtStatus - The status returned by the send.
+
+Return Value:
+
+    TRUE if another target may be tried.
+
+--*/
 {
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    BOOLEAN returnValue;
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    switch (NtStatus)
+    {
+        case STATUS_INVALID_DEVICE_STATE:
+        case STATUS_DEVICE_REMOVED:
+        case STATUS_DEVICE_NOT_CONNECTED:
+        case STATUS_DELETE_PENDING:
+        case STATUS_NO_SUCH_DEVICE:
+            returnValue = TRUE;
+            break;
+        default:
+            returnValue = FALSE;
+            break;
+    }
 
-    DmfAssert(moduleContext->ContinuousReaderMode);
-    DMF_ContinuousRequestTarget_IoTargetSet(Target->DmfModuleRequestTarget,
-                                            IoTarget);
+    return returnValue;
 }
 
+static
 VOID
-DeviceInterfaceMultipleTarget_Stream_IoTargetClear(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
+DeviceInterfaceMultipleTarget_BroadcastDereference(
+    _In_ DeviceInterfaceMultipleTarget_BroadcastContext* BroadcastContext
     )
-{
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+/*++
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+Routine Description:
 
-    DmfAssert(moduleContext->ContinuousReaderMode);
-    DMF_ContinuousRequestTarget_IoTargetClear(Target->DmfModuleRequestTarget);
-}
+    Release a reference to the given SendToAll context. When the last reference is released, the
+    Client is told that the Request has completed on all targets and the context is deleted.
 
-// RequestTarget Methods
-// ---------------------
-//
+Arguments:
 
-NTSTATUS
-DeviceInterfaceMultipleTarget_Target_SendSynchronously(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
-    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
-    _In_ size_t RequestLength,
-    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
-    _In_ size_t ResponseLength,
-    _In_ ContinuousRequestTarget_RequestType RequestType,
-    _In_ ULONG RequestIoctl,
-    _In_ ULONG RequestTimeoutMilliseconds,
-    _Out_opt_ size_t* BytesWritten
-    )
-{
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    BroadcastContext - The given SendToAll context.
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+Return Value:
 
-    DmfAssert(! moduleContext->ContinuousReaderMode);
-    ntStatus = DMF_RequestTarget_SendSynchronously(Target->DmfModuleRequestTarget,
-                                                   RequestBuffer,
-                                                   RequestLength,
-                                                   ResponseBuffer,
-                                                   ResponseLength,
-                                                   RequestType,
-                                                   RequestIoctl,
-                                                   RequestTimeoutMilliseconds,
-                                                   BytesWritten);
+    None
 
-    return ntStatus;
+--*/
+{
+    if (InterlockedDecrement(&BroadcastContext->NumberOfTargetsPending) == 0)
+    {
+        if (BroadcastContext->EvtBroadcastCompletion != NULL)
+        {
+            BroadcastContext->EvtBroadcastCompletion(BroadcastContext->DmfModule,
+                                                     BroadcastContext->ClientRequestContext,
+                                                     BroadcastContext->NumberOfTargetsSent,
+                                                     (ULONG)BroadcastContext->NumberOfTargetsSucceeded);
+        }
+        WdfObjectDelete(BroadcastContext->Memory);
+    }
 }
 
-NTSTATUS
-DeviceInterfaceMultipleTarget_Target_Send(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
-    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
-    _In_ size_t RequestLength,
-    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
-    _In_ size_t ResponseLength,
-    _In_ ContinuousRequestTarget_RequestType RequestType,
-    _In_ ULONG RequestIoctl,
-    _In_ ULONG RequestTimeoutMilliseconds,
-    _In_opt_ EVT_DMF_ContinuousRequestTarget_SendCompletion* EvtRequestSinkSingleAsynchronousRequest,
-    _In_opt_ VOID* SingleAsynchronousRequestClientContext
+static
+VOID
+DeviceInterfaceMultipleTarget_SendContextDestroy(
+    _In_ DeviceInterfaceMultipleTarget_SendContext* SendContext
     )
-{
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+/*++
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+Routine Description:
 
-    DmfAssert(! moduleContext->ContinuousReaderMode);
-    ntStatus = DMF_RequestTarget_Send(Target->DmfModuleRequestTarget,
-                                      RequestBuffer,
-                                      RequestLength,
-                                      ResponseBuffer,
-                                      ResponseLength,
-                                      RequestType,
-                                      RequestIoctl,
-                                      RequestTimeoutMilliseconds,
-                                      EvtRequestSinkSingleAsynchronousRequest,
-                                      SingleAsynchronousRequestClientContext);
+    Free the context of a Request sent by SendToAny or SendToAll. Contexts that have no
+    response buffer are returned to the pool they came from.
 
-    return ntStatus;
-}
+Arguments:
 
-VOID
-DeviceInterfaceMultipleTarget_Target_IoTargetSet(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target,
-    _In_ WDFIOTARGET IoTarget
-    )
-{
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    SendContext - The given context.
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+Return Value:
 
-    DmfAssert(! moduleContext->ContinuousReaderMode);
-    DMF_RequestTarget_IoTargetSet(Target->DmfModuleRequestTarget,
-                                  IoTarget);
-}
+    None
 
-VOID
-DeviceInterfaceMultipleTarget_Target_IoTargetClear(
-    _In_ DMFMODULE DmfModule,
-    _In_ DeviceInterfaceMultipleTarget_IoTarget* Target
-    )
+--*/
 {
     DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    DmfAssert(! moduleContext->ContinuousReaderMode);
-    DMF_RequestTarget_IoTargetClear(Target->DmfModuleRequestTarget);
+    if (SendContext->Memory != NULL)
+    {
+        WdfObjectDelete(SendContext->Memory);
+    }
+    else
+    {
+        moduleContext = DMF_CONTEXT_GET(SendContext->DmfModule);
+        DMF_BufferPool_Put(moduleContext->DmfModuleBufferPoolSendContext,
+                           (VOID*)SendContext);
+    }
 }
 
-// General Module Support Code
-// ---------------------------
-//
-
-_Function_class_(EVT_DMF_BufferPool_Enumeration)
+_Function_class_(EVT_DMF_ContinuousRequestTarget_SendCompletion)
 _IRQL_requires_max_(DISPATCH_LEVEL)
 _IRQL_requires_same_
-BufferPool_EnumerationDispositionType
-DeviceInterfaceMultipleTarget_FindTarget(
+VOID
+DeviceInterfaceMultipleTarget_SendCompletion(
     _In_ DMFMODULE DmfModule,
-    _In_ VOID* ClientBuffer,
-    _In_ VOID* ClientBufferContext,
-    _In_opt_ VOID* ClientDriverCallbackContext
+    _In_ VOID* ClientRequestContext,
+    _In_reads_(InputBufferBytesWritten) VOID* InputBuffer,
+    _In_ size_t InputBufferBytesWritten,
+    _In_reads_(OutputBufferBytesRead) VOID* OutputBuffer,
+    _In_ size_t OutputBufferBytesRead,
+    _In_ NTSTATUS CompletionStatus
     )
 /*++
 
 Routine Description:
 
-    Enumeration callback to check if a target is already available in the pool.
+    Completion routine of Requests sent by SendToAny and SendToAll. Updates the outstanding
+    Request count of the target and calls the Client.
 
 Arguments:
 
-    DmfModule - ContinuousRequestTarget DMFMODULE.
-    ClientBuffer - The given input buffer.
-    ClientBufferContext - Context associated with the given input buffer.
-    ClientDriverCallbackContext - Context for this enumeration.
+    DmfModule - The Child Module that sent the Request.
+    ClientRequestContext - The SendToAny/SendToAll context of the Request.
+    InputBuffer - The Request's input buffer.
+    InputBufferBytesWritten - Size of the input buffer.
+    OutputBuffer - The Request's output buffer.
+    OutputBufferBytesRead - Number of bytes returned in the output buffer.
+    CompletionStatus - Request completion status.
 
 Return Value:
 
@@ -710,122 +1556,129 @@ Return Value:
 
 --*/
 {
-    DeviceInterfaceMultipleTarget_EnumerationContext *callbackContext;
-    DeviceInterfaceMultipleTarget_IoTarget *target;
-    DeviceInterfaceMultipleTarget_IoTarget *targetToCompare;
-    BufferPool_EnumerationDispositionType returnValue;
-
-    FuncEntry(DMF_TRACE);
+    DeviceInterfaceMultipleTarget_SendContext* sendContext;
+    DeviceInterfaceMultipleTarget_BroadcastContext* broadcastContext;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
 
     UNREFERENCED_PARAMETER(DmfModule);
-    UNREFERENCED_PARAMETER(ClientBufferContext);
+    UNREFERENCED_PARAMETER(InputBuffer);
+    UNREFERENCED_PARAMETER(InputBufferBytesWritten);
 
-    target = (DeviceInterfaceMultipleTarget_IoTarget *)ClientBuffer;
-    DmfAssert(target->SymbolicLinkName.Length != 0);
-    DmfAssert(target->SymbolicLinkName.Buffer != NULL);
-    DmfAssert(target->IoTarget != NULL);
+    sendContext = (DeviceInterfaceMultipleTarget_SendContext*)ClientRequestContext;
+    broadcastContext = sendContext->BroadcastContext;
+    target = sendContext->Target;
+
+    if (sendContext->EvtSendCompletion != NULL)
+    {
+        sendContext->EvtSendCompletion(sendContext->DmfModule,
+                                       target->DmfIoTarget,
+                                       sendContext->ClientRequestContext,
+                                       OutputBuffer,
+                                       OutputBufferBytesRead,
+                                       CompletionStatus);
+    }
 
-    callbackContext = (DeviceInterfaceMultipleTarget_EnumerationContext*)ClientDriverCallbackContext;
-    // 'Dereferencing NULL pointer. 'callbackContext'
+    // Release the target only after the Client is done with its handle.
+    // The target may be destroyed as soon as this is done.
     //
-    #pragma warning(suppress:28182)
-    targetToCompare = (DeviceInterfaceMultipleTarget_IoTarget*)callbackContext->ContextData;
+    DeviceInterfaceMultipleTarget_TargetRequestDereference(target);
 
-    returnValue = BufferPool_EnumerationDisposition_ContinueEnumeration;
+    // The output buffer of SendToAll is part of the context so it is deleted only now.
+    //
+    DeviceInterfaceMultipleTarget_SendContextDestroy(sendContext);
 
-    if (target == targetToCompare)
+    if (broadcastContext != NULL)
     {
-        callbackContext->BufferFound = TRUE;
-        if (callbackContext->RemoveBuffer)
-        {
-            returnValue = BufferPool_EnumerationDisposition_RemoveAndStopEnumeration;
-        }
-        else
+        if (NT_SUCCESS(CompletionStatus))
         {
-            returnValue = BufferPool_EnumerationDisposition_StopEnumeration;
+            InterlockedIncrement(&broadcastContext->NumberOfTargetsSucceeded);
         }
+        DeviceInterfaceMultipleTarget_BroadcastDereference(broadcastContext);
     }
-
-    FuncExit(DMF_TRACE, "Enumeration Disposition=%d", returnValue);
-
-    return returnValue;
 }
 
-_Function_class_(EVT_DMF_BufferPool_Enumeration)
-_IRQL_requires_max_(DISPATCH_LEVEL)
-_IRQL_requires_same_
-BufferPool_EnumerationDispositionType
-DeviceInterfaceMultipleTarget_FindSymbolicLink(
+static
+NTSTATUS
+DeviceInterfaceMultipleTarget_SendContextCreate(
     _In_ DMFMODULE DmfModule,
-    _In_ VOID* ClientBuffer,
-    _In_ VOID* ClientBufferContext,
-    _In_opt_ VOID* ClientDriverCallbackContext
+    _In_ size_t ResponseLength,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtSendCompletion,
+    _In_opt_ VOID* ClientRequestContext,
+    _Out_ DeviceInterfaceMultipleTarget_SendContext** SendContext
     )
 /*++
 
 Routine Description:
 
-    Enumeration callback to check if a target with the same symbolic link is already available in the pool. 
+    Allocate the context of a Request sent by SendToAny or SendToAll. Contexts that have no
+    response buffer come from a pool so that no WDFMEMORY is created for them.
 
 Arguments:
 
-    DmfModule - ContinuousRequestTarget DMFMODULE.
-    ClientBuffer - The given input buffer.
-    ClientBufferContext - Context associated with the given input buffer.
-    ClientDriverCallbackContext - Context for this enumeration.
+    DmfModule - This Module's handle.
+    ResponseLength - Size of the response buffer to allocate after the context (SendToAll only).
+    EvtSendCompletion - Client's completion callback.
+    ClientRequestContext - Client's context for the callback.
+    SendContext - Where the allocated context is returned.
 
 Return Value:
 
-    None
+    NTSTATUS
 
 --*/
 {
-    DeviceInterfaceMultipleTarget_IoTarget *target;
-    DeviceInterfaceMultipleTarget_EnumerationContext* callbackContext;
-    BufferPool_EnumerationDispositionType returnValue;
-    PUNICODE_STRING symbolicLinkName;
-    SIZE_T matchLength;
-
-    FuncEntry(DMF_TRACE);
-
-    UNREFERENCED_PARAMETER(DmfModule);
-    UNREFERENCED_PARAMETER(ClientBufferContext);
-
-    target = (DeviceInterfaceMultipleTarget_IoTarget *)ClientBuffer;
-    DmfAssert(target->SymbolicLinkName.Length != 0);
-    DmfAssert(target->SymbolicLinkName.Buffer != NULL);
-    DmfAssert(target->IoTarget != NULL);
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    DeviceInterfaceMultipleTarget_SendContext* sendContext;
 
-    callbackContext = (DeviceInterfaceMultipleTarget_EnumerationContext*)ClientDriverCallbackContext;
-    // 'Dereferencing NULL pointer. 'callbackContext'
-    //
-    #pragma warning(suppress:28182)
-    symbolicLinkName = (PUNICODE_STRING)callbackContext->ContextData;
+    *SendContext = NULL;
 
-    returnValue = BufferPool_EnumerationDisposition_ContinueEnumeration;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    if (target->SymbolicLinkName.Length == symbolicLinkName->Length)
+    if (0 == ResponseLength)
     {
-        matchLength = RtlCompareMemory((VOID*)target->SymbolicLinkName.Buffer,
-                                       symbolicLinkName->Buffer,
-                                       target->SymbolicLinkName.Length);
-        if (target->SymbolicLinkName.Length == matchLength)
+        memory = NULL;
+        ntStatus = DMF_BufferPool_Get(moduleContext->DmfModuleBufferPoolSendContext,
+                                      (VOID**)&sendContext,
+                                      NULL);
+        if (! NT_SUCCESS(ntStatus))
         {
-            callbackContext->BufferFound = TRUE;
-            if (callbackContext->RemoveBuffer)
-            {
-                returnValue = BufferPool_EnumerationDisposition_RemoveAndStopEnumeration;
-            }
-            else
-            {
-                returnValue = BufferPool_EnumerationDisposition_StopEnumeration;
-            }
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_BufferPool_Get fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+    else
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        ntStatus = WdfMemoryCreate(&objectAttributes,
+                                   NonPagedPoolNx,
+                                   MemoryTag,
+                                   sizeof(DeviceInterfaceMultipleTarget_SendContext) + ResponseLength,
+                                   &memory,
+                                   (VOID**)&sendContext);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
         }
     }
 
-    FuncExit(DMF_TRACE, "Enumeration Disposition=%d", BufferPool_EnumerationDisposition_RemoveAndStopEnumeration);
+    RtlZeroMemory(sendContext,
+                  sizeof(DeviceInterfaceMultipleTarget_SendContext));
+    InitializeListHead(&sendContext->ListEntry);
+    sendContext->DmfModule = DmfModule;
+    sendContext->Memory = memory;
+    sendContext->EvtSendCompletion = EvtSendCompletion;
+    sendContext->ClientRequestContext = ClientRequestContext;
 
-    return returnValue;
+    *SendContext = sendContext;
+
+Exit:
+
+    return ntStatus;
 }
 
 DeviceInterfaceMultipleTarget_IoTarget*
@@ -1025,6 +1878,12 @@ Return Value:
                                                                     DeviceInterfaceMultipleTarget_StateType_QueryRemove);
     }
 
+    // SendToAny/SendToAll must not choose this target from now on.
+    //
+    DMF_ModuleLock(dmfModule);
+    target->AcceptingRequests = FALSE;
+    DMF_ModuleUnlock(dmfModule);
+
     // Transparently stop the stream in automatic mode.
     //
     if (moduleContext->ContinuousRequestTargetMode == ContinuousRequestTarget_Mode_Automatic)
@@ -1033,6 +1892,9 @@ Return Value:
                                                      target->DmfIoTarget);
     }
 
+    // NOTE: This waits for the Requests sent to this target to complete. Their completion
+    //       routines update the outstanding Request count of this target.
+    //
     WdfIoTargetCloseForQueryRemove(IoTarget);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
@@ -1092,6 +1954,10 @@ Return Value:
         goto Exit;
     }
 
+    DMF_ModuleLock(dmfModule);
+    target->AcceptingRequests = TRUE;
+    DMF_ModuleUnlock(dmfModule);
+
     // If the client has registered for device interface state changes, call the notification callback.
     //
     if (moduleConfig->EvtDeviceInterfaceMultipleTargetOnStateChange)
@@ -1146,7 +2012,6 @@ Return Value:
     DMF_CONFIG_DeviceInterfaceMultipleTarget* moduleConfig;
     DeviceInterfaceMultipleTarget_IoTargetContext* targetContext;
     DeviceInterfaceMultipleTarget_IoTarget* target;
-    DeviceInterfaceMultipleTarget_EnumerationContext callbackContext;
 
     FuncEntry(DMF_TRACE);
 
@@ -1158,21 +2023,16 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(dmfModule);
     moduleConfig = DMF_CONFIG_GET(dmfModule);
 
-    callbackContext.ContextData = (VOID*)targetContext->Target;
-    callbackContext.RemoveBuffer = TRUE;
-    callbackContext.BufferFound = FALSE;
-    DMF_BufferQueue_Enumerate(moduleContext->DmfModuleBufferQueue,
-                              DeviceInterfaceMultipleTarget_FindTarget,
-                              (VOID *)&callbackContext,
-                              (VOID **)&target,
-                              NULL);
-    if (! callbackContext.BufferFound)
-    {
-        // The target buffer should be in the consumer pool.
+    target = DeviceInterfaceMultipleTarget_IndexTargetRemoveByHandle(dmfModule,
+                                                                     targetContext->Target->DmfIoTarget);
+    if (NULL == target)
+    {
+        // The target should be in the index of open targets.
         // 
         DmfAssert(FALSE);
         goto Exit;
     }
+    DmfAssert(target == targetContext->Target);
 
     if (moduleConfig->EvtDeviceInterfaceMultipleTargetOnStateChange)
     {
@@ -1472,8 +2332,8 @@ Return Value:
     WDFDEVICE device;
     DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
     DMF_CONFIG_DeviceInterfaceMultipleTarget* moduleConfig;
-    DeviceInterfaceMultipleTarget_EnumerationContext enumerationCallbackContext;
     BOOLEAN ioTargetOpen;
+    BOOLEAN targetCounted;
     DeviceInterfaceMultipleTarget_IoTarget* target;
 
     PAGED_CODE();
@@ -1488,25 +2348,49 @@ Return Value:
     ioTargetOpen = TRUE;
     ntStatus = STATUS_SUCCESS;
     target = NULL;
+    targetCounted = FALSE;
 
-    enumerationCallbackContext.ContextData = (VOID*)SymbolicLinkName;
-    enumerationCallbackContext.RemoveBuffer = FALSE;
-    enumerationCallbackContext.BufferFound = FALSE;
-    DMF_BufferQueue_Enumerate(moduleContext->DmfModuleBufferQueue,
-                              DeviceInterfaceMultipleTarget_FindSymbolicLink,
-                              &enumerationCallbackContext,
-                              NULL,
-                              NULL);
-    if (enumerationCallbackContext.BufferFound)
-    {
-        // Interface already part of buffer queue.
-        // TODO: Can we return STATUS_SUCCESS?
-        //
-        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "Duplicate Arrival Interface Notification. Do Nothing");
+    ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueue,
+                                     (VOID **)&target,
+                                     NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_BufferQueue_Fetch() fails: ntStatus=%!STATUS!", ntStatus);
+        target = NULL;
+        goto Exit;
+    }
+
+    InitializeListHead(&target->HandleIndexListEntry);
+    InitializeListHead(&target->SymbolicLinkIndexListEntry);
+    InitializeListHead(&target->TargetListEntry);
+    target->OutstandingRequests = 0;
+    target->AcceptingRequests = FALSE;
+    DMF_Portable_EventCreate(&target->RequestsDrainedEvent,
+                             SynchronizationEvent,
+                             FALSE);
+
+    // Save a non-paged copy of the symbolic link name first. It is used to look up the index
+    // under the Module lock and, if the target is opened, to make sure removal is referenced
+    // to the correct interface.
+    //
+    ntStatus = DeviceInterfaceMultipleTarget_SymbolicLinkNameStore(DmfModule,
+                                                                   target,
+                                                                   SymbolicLinkName);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DeviceInterfaceMultipleTarget_SymbolicLinkNameStore() fails: ntStatus=%!STATUS!", ntStatus);
         goto Exit;
     }
 
-    if (moduleConfig->EvtDeviceInterfaceMultipleTargetOnPnpNotification != NULL)
+    if (DeviceInterfaceMultipleTarget_IndexSymbolicLinkContains(DmfModule,
+                                                                target))
+    {
+        // Interface is already open.
+        //
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "Duplicate Arrival Interface Notification. Do Nothing");
+        ioTargetOpen = FALSE;
+    }
+    else if (moduleConfig->EvtDeviceInterfaceMultipleTargetOnPnpNotification != NULL)
     {
         // Ask client if this IoTarget needs to be opened.
         //
@@ -1515,20 +2399,23 @@ Return Value:
                                                                         &ioTargetOpen);
     }
 
-    if (ioTargetOpen)
+    if (! ioTargetOpen)
+    {
+        // Return the unused target buffer.
+        //
+        DeviceInterfaceMultipleTarget_SymbolicLinkNameClear(DmfModule,
+                                                            target);
+        DMF_Portable_EventClose(&target->RequestsDrainedEvent);
+        DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                              (VOID *)target);
+        target = NULL;
+        goto Exit;
+    }
+    else
     {
         WDF_OBJECT_ATTRIBUTES objectAttributes;
         WDFMEMORY dmfIoTargetMemory;
 
-        ntStatus = DMF_BufferQueue_Fetch(moduleContext->DmfModuleBufferQueue,
-                                         (VOID **)&target,
-                                         NULL);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_BufferQueue_Fetch() fails: ntStatus=%!STATUS!", ntStatus);
-            goto Exit;
-        }
-
         WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
         objectAttributes.ParentObject = DmfModule;
 
@@ -1544,21 +2431,11 @@ Return Value:
 
         target->DmfIoTarget = (DeviceInterfaceMultipleTarget_Target)dmfIoTargetMemory;
 
-        // Iotarget will be opened. Save symbolic link name to make sure removal is referenced to correct interface.
-        //
-        ntStatus = DeviceInterfaceMultipleTarget_SymbolicLinkNameStore(DmfModule,
-                                                                       target,
-                                                                       SymbolicLinkName);
-        if (! NT_SUCCESS(ntStatus))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DeviceInterfaceMultipleTarget_SymbolicLinkNameStore() fails: ntStatus=%!STATUS!", ntStatus);
-            goto Exit;
-        }
-
         // Open the Module if its the first target.
         // No lock is used here, since the PnP callback is synchronous.
         // TODO: Optimize the callback, by queuing a workitem to do all the work. 
         //
+        targetCounted = TRUE;
         if (InterlockedIncrement(&moduleContext->NumberOfTargetsCreated) == 1)
         {
             ntStatus = DMF_ModuleOpen(DmfModule);
@@ -1596,10 +2473,16 @@ Return Value:
         }
 
         // Target was successfully created.
-        // Enqueue target buffer into consumer pool. 
+        // Add it to the index of open targets. PnP notifications for this interface are
+        // serialized so the name cannot have been added since it was checked above.
         // 
-        DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
-                                (VOID *)target);
+        if (! DeviceInterfaceMultipleTarget_IndexTargetInsert(DmfModule,
+                                                              target))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_OBJECT_NAME_COLLISION;
+            goto Exit;
+        }
     }
 
 Exit:
@@ -1608,8 +2491,18 @@ Exit:
     {
         if (target != NULL)
         {
-            DeviceInterfaceMultipleTarget_TargetDestroyAndCloseModule(DmfModule,
-                                                                      target);
+            if (targetCounted)
+            {
+                DeviceInterfaceMultipleTarget_TargetDestroyAndCloseModule(DmfModule,
+                                                                          target);
+            }
+            else
+            {
+                DeviceInterfaceMultipleTarget_TargetDestroy(DmfModule,
+                                                            target);
+                DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                                      (VOID *)target);
+            }
         }
     }
 
@@ -1645,34 +2538,58 @@ Return Value:
 
 --*/
 {
-    WDFDEVICE device;
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
-    DeviceInterfaceMultipleTarget_EnumerationContext enumerationCallbackContext;
+    NTSTATUS ntStatus;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY symbolicLinkNameMemory;
+    UNICODE_STRING symbolicLinkName;
     DeviceInterfaceMultipleTarget_IoTarget* target;
 
-    PAGED_CODE();
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    if (0 == SymbolicLinkName->Length)
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    // The given name may be in paged memory but it is compared under the Module lock.
+    // Make a non-paged copy for the lookup.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               SymbolicLinkName->Length,
+                               &symbolicLinkNameMemory,
+                               (VOID**)&symbolicLinkName.Buffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
 
-    FuncEntry(DMF_TRACE);
+    RtlCopyMemory(symbolicLinkName.Buffer,
+                  SymbolicLinkName->Buffer,
+                  SymbolicLinkName->Length);
+    symbolicLinkName.Length = SymbolicLinkName->Length;
+    symbolicLinkName.MaximumLength = SymbolicLinkName->Length;
 
-    device = DMF_ParentDeviceGet(DmfModule);
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    target = DeviceInterfaceMultipleTarget_IndexTargetRemoveBySymbolicLink(DmfModule,
+                                                                           &symbolicLinkName);
 
-    enumerationCallbackContext.ContextData = (VOID*)SymbolicLinkName;
-    enumerationCallbackContext.RemoveBuffer = TRUE;
-    enumerationCallbackContext.BufferFound = FALSE;
-    DMF_BufferQueue_Enumerate(moduleContext->DmfModuleBufferQueue,
-                              DeviceInterfaceMultipleTarget_FindSymbolicLink,
-                              &enumerationCallbackContext,
-                              (VOID **)&target,
-                              NULL);
+    WdfObjectDelete(symbolicLinkNameMemory);
 
-    if (enumerationCallbackContext.BufferFound)
+    if (target != NULL)
     {
-        DmfAssert(target != NULL);
         DeviceInterfaceMultipleTarget_TargetDestroyAndCloseModule(DmfModule,
                                                                   target);
     }
 
+Exit:
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -1700,23 +2617,17 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
     DeviceInterfaceMultipleTarget_IoTarget* target;
 
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
     // Already unregistered from PnP notification.
-    // Clean the buffer queue here since the notifications callback will no longer be called.
+    // Clean the open targets here since the notifications callback will no longer be called.
     //
-    while (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) != 0)
+    while ((target = DeviceInterfaceMultipleTarget_IndexTargetRemoveAny(DmfModule)) != NULL)
     {
-        DMF_BufferQueue_Dequeue(moduleContext->DmfModuleBufferQueue,
-                                (VOID**)&target,
-                                NULL);
         DeviceInterfaceMultipleTarget_TargetDestroyAndCloseModule(DmfModule,
                                                                   target);
     }
@@ -2289,6 +3200,7 @@ Return Value:
 {
     DMF_MODULE_ATTRIBUTES moduleAttributes;
     DMF_CONFIG_BufferQueue moduleBufferQueueConfigList;
+    DMF_CONFIG_BufferPool moduleConfigBufferPool;
     DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
 
     PAGED_CODE();
@@ -2301,6 +3213,10 @@ Return Value:
     //
     moduleContext->PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
 
+    // Targets can arrive as soon as notifications are registered, so the index must be ready now.
+    //
+    DeviceInterfaceMultipleTarget_IndexInitialize(DmfModule);
+
     // BufferQueue
     // -----------
     //
@@ -2320,6 +3236,22 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleBufferQueue);
 
+    // BufferPoolSendContext
+    // ---------------------
+    //
+    DMF_CONFIG_BufferPool_AND_ATTRIBUTES_INIT(&moduleConfigBufferPool,
+                                              &moduleAttributes);
+    moduleConfigBufferPool.BufferPoolMode = BufferPool_Mode_Source;
+    moduleConfigBufferPool.Mode.SourceSettings.EnableLookAside = TRUE;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferCount = DeviceInterfaceMultipleTarget_SendContextsPreallocated;
+    moduleConfigBufferPool.Mode.SourceSettings.PoolType = NonPagedPoolNx;
+    moduleConfigBufferPool.Mode.SourceSettings.BufferSize = sizeof(DeviceInterfaceMultipleTarget_SendContext);
+    moduleAttributes.ClientModuleInstanceName = "BufferPoolSendContext";
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     &moduleContext->DmfModuleBufferPoolSendContext);
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -2766,6 +3698,439 @@ Exit:
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_DeviceInterfaceMultipleTarget_SendToAll(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtDeviceInterfaceMultipleTargetSendCompletion,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_BroadcastCompletion* EvtDeviceInterfaceMultipleTargetBroadcastCompletion,
+    _In_opt_ VOID* ClientRequestContext,
+    _Out_opt_ ULONG* NumberOfTargetsSent
+    )
+/*++
+
+Routine Description:
+
+    Creates and sends the same Asynchronous request to every open target. Each target gets its own
+    response buffer. The Client is called as the request completes on each target and again after it
+    has completed on all the targets.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RequestBuffer - Buffer of data to attach to request to be sent. It must remain valid until
+                    EvtDeviceInterfaceMultipleTargetBroadcastCompletion is called.
+    RequestLength - Number of bytes to in RequestBuffer to send.
+    ResponseLength - Size of the response buffer allocated for each target.
+    RequestType - Read or Write or Ioctl
+    RequestIoctl - The given IOCTL.
+    RequestTimeoutMilliseconds - Timeout value in milliseconds of the transfer or zero for no timeout.
+    EvtDeviceInterfaceMultipleTargetSendCompletion - Callback called when the request completes on a target.
+    EvtDeviceInterfaceMultipleTargetBroadcastCompletion - Callback called when the request has completed on all targets.
+    ClientRequestContext - Client context sent in callbacks.
+    NumberOfTargetsSent - Number of targets the request was sent to.
+
+Return Value:
+
+    STATUS_SUCCESS if the request was sent to at least one target. In this case,
+    EvtDeviceInterfaceMultipleTargetBroadcastCompletion will be called.
+    Other NTSTATUS if there is an error.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    DeviceInterfaceMultipleTarget_BroadcastContext* broadcastContext;
+    DeviceInterfaceMultipleTarget_SendContext* sendContext;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY broadcastMemory;
+    LIST_ENTRY sendContextsFree;
+    LIST_ENTRY sendContextsToSend;
+    LIST_ENTRY* listEntry;
+    ULONG numberOfTargets;
+    ULONG targetIndex;
+    ULONG numberOfTargetsSent;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 DeviceInterfaceMultipleTarget);
+
+    if (NumberOfTargetsSent != NULL)
+    {
+        *NumberOfTargetsSent = 0;
+    }
+    numberOfTargetsSent = 0;
+    InitializeListHead(&sendContextsFree);
+    InitializeListHead(&sendContextsToSend);
+
+    ntStatus = DMF_ModuleReference(DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleReference");
+        goto Exit;
+    }
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    numberOfTargets = moduleContext->NumberOfTargetsInIndex;
+    DMF_ModuleUnlock(DmfModule);
+
+    if (0 == numberOfTargets)
+    {
+        ntStatus = STATUS_NO_SUCH_DEVICE;
+        goto ExitDereference;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(DeviceInterfaceMultipleTarget_BroadcastContext),
+                               &broadcastMemory,
+                               (VOID**)&broadcastContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto ExitDereference;
+    }
+
+    RtlZeroMemory(broadcastContext,
+                  sizeof(DeviceInterfaceMultipleTarget_BroadcastContext));
+    broadcastContext->DmfModule = DmfModule;
+    broadcastContext->Memory = broadcastMemory;
+    broadcastContext->EvtBroadcastCompletion = EvtDeviceInterfaceMultipleTargetBroadcastCompletion;
+    broadcastContext->ClientRequestContext = ClientRequestContext;
+    // This reference is held until all the requests have been sent.
+    //
+    broadcastContext->NumberOfTargetsPending = 1;
+
+    // Allocate the contexts outside the Module lock. Targets that arrive after this point
+    // do not receive the request.
+    //
+    for (targetIndex = 0; targetIndex < numberOfTargets; targetIndex++)
+    {
+        ntStatus = DeviceInterfaceMultipleTarget_SendContextCreate(DmfModule,
+                                                                   ResponseLength,
+                                                                   EvtDeviceInterfaceMultipleTargetSendCompletion,
+                                                                   ClientRequestContext,
+                                                                   &sendContext);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto ExitFree;
+        }
+        sendContext->BroadcastContext = broadcastContext;
+        InsertTailList(&sendContextsFree,
+                       &sendContext->ListEntry);
+    }
+
+    // Assign a context to every target that accepts requests.
+    //
+    DMF_ModuleLock(DmfModule);
+    for (listEntry = moduleContext->TargetList.Flink;
+         (listEntry != &moduleContext->TargetList) && (! IsListEmpty(&sendContextsFree));
+         listEntry = listEntry->Flink)
+    {
+        target = CONTAINING_RECORD(listEntry,
+                                   DeviceInterfaceMultipleTarget_IoTarget,
+                                   TargetListEntry);
+        if (! target->AcceptingRequests)
+        {
+            continue;
+        }
+
+        sendContext = CONTAINING_RECORD(RemoveHeadList(&sendContextsFree),
+                                        DeviceInterfaceMultipleTarget_SendContext,
+                                        ListEntry);
+        sendContext->Target = target;
+        InterlockedIncrement(&target->OutstandingRequests);
+        InsertTailList(&sendContextsToSend,
+                       &sendContext->ListEntry);
+    }
+    DMF_ModuleUnlock(DmfModule);
+
+    // Send without holding the Module lock since completion routines may run in this context.
+    //
+    while (! IsListEmpty(&sendContextsToSend))
+    {
+        sendContext = CONTAINING_RECORD(RemoveHeadList(&sendContextsToSend),
+                                        DeviceInterfaceMultipleTarget_SendContext,
+                                        ListEntry);
+        target = sendContext->Target;
+
+        InterlockedIncrement(&broadcastContext->NumberOfTargetsPending);
+        ntStatus = moduleContext->RequestSink_Send(DmfModule,
+                                                   target,
+                                                   RequestBuffer,
+                                                   RequestLength,
+                                                   (VOID*)(sendContext + 1),
+                                                   ResponseLength,
+                                                   RequestType,
+                                                   RequestIoctl,
+                                                   RequestTimeoutMilliseconds,
+                                                   DeviceInterfaceMultipleTarget_SendCompletion,
+                                                   (VOID*)sendContext);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // The target may have started to go away after it was chosen.
+            //
+            TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "RequestSink_Send fails: ntStatus=%!STATUS!", ntStatus);
+            DeviceInterfaceMultipleTarget_TargetRequestDereference(target);
+            InterlockedDecrement(&broadcastContext->NumberOfTargetsPending);
+            DeviceInterfaceMultipleTarget_SendContextDestroy(sendContext);
+            continue;
+        }
+
+        numberOfTargetsSent++;
+    }
+
+    if (0 == numberOfTargetsSent)
+    {
+        DmfAssert(1 == broadcastContext->NumberOfTargetsPending);
+        ntStatus = STATUS_NO_SUCH_DEVICE;
+        goto ExitFree;
+    }
+
+    if (NumberOfTargetsSent != NULL)
+    {
+        *NumberOfTargetsSent = numberOfTargetsSent;
+    }
+    broadcastContext->NumberOfTargetsSent = numberOfTargetsSent;
+    ntStatus = STATUS_SUCCESS;
+
+    // Release the sender's reference. The Client's callback may be called now.
+    //
+    DeviceInterfaceMultipleTarget_BroadcastDereference(broadcastContext);
+    broadcastContext = NULL;
+
+ExitFree:
+
+    while (! IsListEmpty(&sendContextsFree))
+    {
+        sendContext = CONTAINING_RECORD(RemoveHeadList(&sendContextsFree),
+                                        DeviceInterfaceMultipleTarget_SendContext,
+                                        ListEntry);
+        DeviceInterfaceMultipleTarget_SendContextDestroy(sendContext);
+    }
+
+    if (broadcastContext != NULL)
+    {
+        WdfObjectDelete(broadcastContext->Memory);
+    }
+
+ExitDereference:
+
+    DMF_ModuleDereference(DmfModule);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_DeviceInterfaceMultipleTarget_SendToAny(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_TargetSelectionType TargetSelection,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtDeviceInterfaceMultipleTargetSendCompletion,
+    _In_opt_ VOID* ClientRequestContext,
+    _Out_opt_ DeviceInterfaceMultipleTarget_Target* TargetSelected
+    )
+/*++
+
+Routine Description:
+
+    Creates and sends an Asynchronous request to one of the open targets. The Module chooses the target.
+    If sending to the chosen target fails because it is going away, another target is chosen. Each target
+    is tried at most once. Other failures are returned to the caller right away.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetSelection - How the target is chosen.
+    RequestBuffer - Buffer of data to attach to request to be sent.
+    RequestLength - Number of bytes to in RequestBuffer to send.
+    ResponseBuffer - Buffer of data that is returned by the request.
+    ResponseLength - Size of Response Buffer in bytes.
+    RequestType - Read or Write or Ioctl
+    RequestIoctl - The given IOCTL.
+    RequestTimeoutMilliseconds - Timeout value in milliseconds of the transfer or zero for no timeout.
+    EvtDeviceInterfaceMultipleTargetSendCompletion - Callback to be called in completion routine.
+    ClientRequestContext - Client context sent in callback.
+    TargetSelected - The target the request was sent to.
+
+Return Value:
+
+    STATUS_SUCCESS if the request was sent.
+    STATUS_NO_SUCH_DEVICE if no target accepts requests.
+    Other NTSTATUS if there is an error.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_DeviceInterfaceMultipleTarget* moduleContext;
+    DeviceInterfaceMultipleTarget_SendContext* sendContext;
+    DeviceInterfaceMultipleTarget_IoTarget* target;
+    DeviceInterfaceMultipleTarget_IoTarget** targetsFailed;
+    WDFMEMORY targetsFailedMemory;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    ULONG numberOfAttempts;
+    ULONG attemptIndex;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 DeviceInterfaceMultipleTarget);
+
+    DmfAssert((TargetSelection > DeviceInterfaceMultipleTarget_TargetSelection_Invalid) &&
+              (TargetSelection < DeviceInterfaceMultipleTarget_TargetSelection_Maximum));
+
+    if (TargetSelected != NULL)
+    {
+        *TargetSelected = NULL;
+    }
+
+    ntStatus = DMF_ModuleReference(DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleReference");
+        goto Exit;
+    }
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DeviceInterfaceMultipleTarget_SendContextCreate(DmfModule,
+                                                               0,
+                                                               EvtDeviceInterfaceMultipleTargetSendCompletion,
+                                                               ClientRequestContext,
+                                                               &sendContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto ExitDereference;
+    }
+
+    // Try each target at most once. The targets that failed are only remembered
+    // (and the memory to remember them is only allocated) when a send fails.
+    //
+    DMF_ModuleLock(DmfModule);
+    numberOfAttempts = moduleContext->NumberOfTargetsInIndex;
+    DMF_ModuleUnlock(DmfModule);
+
+    ntStatus = STATUS_NO_SUCH_DEVICE;
+    targetsFailed = NULL;
+    targetsFailedMemory = NULL;
+    for (attemptIndex = 0; attemptIndex < numberOfAttempts; attemptIndex++)
+    {
+        target = DeviceInterfaceMultipleTarget_TargetSelect(DmfModule,
+                                                            TargetSelection,
+                                                            targetsFailed,
+                                                            attemptIndex);
+        if (NULL == target)
+        {
+            ntStatus = STATUS_NO_SUCH_DEVICE;
+            break;
+        }
+
+        sendContext->Target = target;
+        if (TargetSelected != NULL)
+        {
+            *TargetSelected = target->DmfIoTarget;
+        }
+
+        ntStatus = moduleContext->RequestSink_Send(DmfModule,
+                                                   target,
+                                                   RequestBuffer,
+                                                   RequestLength,
+                                                   ResponseBuffer,
+                                                   ResponseLength,
+                                                   RequestType,
+                                                   RequestIoctl,
+                                                   RequestTimeoutMilliseconds,
+                                                   DeviceInterfaceMultipleTarget_SendCompletion,
+                                                   (VOID*)sendContext);
+        if (NT_SUCCESS(ntStatus))
+        {
+            // The completion routine owns the context now.
+            //
+            sendContext = NULL;
+            break;
+        }
+
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "RequestSink_Send fails: ntStatus=%!STATUS!", ntStatus);
+        DeviceInterfaceMultipleTarget_TargetRequestDereference(target);
+        if (TargetSelected != NULL)
+        {
+            *TargetSelected = NULL;
+        }
+
+        if (! DeviceInterfaceMultipleTarget_IsTargetGoneStatus(ntStatus))
+        {
+            // The Request itself failed. Another target would fail it the same way.
+            //
+            break;
+        }
+
+        // The target may have started to go away after it was chosen. Try another one.
+        //
+        if (NULL == targetsFailed)
+        {
+            WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+            objectAttributes.ParentObject = DmfModule;
+            if (! NT_SUCCESS(WdfMemoryCreate(&objectAttributes,
+                                             NonPagedPoolNx,
+                                             MemoryTag,
+                                             sizeof(DeviceInterfaceMultipleTarget_IoTarget*) * numberOfAttempts,
+                                             &targetsFailedMemory,
+                                             (VOID**)&targetsFailed)))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails");
+                targetsFailedMemory = NULL;
+                targetsFailed = NULL;
+                break;
+            }
+        }
+        targetsFailed[attemptIndex] = target;
+    }
+
+    if (targetsFailedMemory != NULL)
+    {
+        WdfObjectDelete(targetsFailedMemory);
+    }
+
+    if (sendContext != NULL)
+    {
+        DeviceInterfaceMultipleTarget_SendContextDestroy(sendContext);
+    }
+
+ExitDereference:
+
+    DMF_ModuleDereference(DmfModule);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 DMF_DeviceInterfaceMultipleTarget_StreamStart(
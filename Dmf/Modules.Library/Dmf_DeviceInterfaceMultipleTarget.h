@@ -53,6 +53,20 @@ typedef enum
     DeviceInterfaceMultipleTarget_PnpRegisterWhen_Create
 } DeviceInterfaceMultipleTarget_PnpRegisterWhen_Type;
 
+// Enum to specify how DMF_DeviceInterfaceMultipleTarget_SendToAny chooses a target.
+//
+typedef enum
+{
+    DeviceInterfaceMultipleTarget_TargetSelection_Invalid,
+    // Open targets are chosen in turn.
+    //
+    DeviceInterfaceMultipleTarget_TargetSelection_RoundRobin,
+    // The open target with the fewest Requests sent by this Module that have not completed is chosen.
+    //
+    DeviceInterfaceMultipleTarget_TargetSelection_LeastOutstandingRequests,
+    DeviceInterfaceMultipleTarget_TargetSelection_Maximum
+} DeviceInterfaceMultipleTarget_TargetSelectionType;
+
 // Client Driver callback to notify IoTarget State.
 //
 typedef
@@ -75,6 +89,34 @@ EVT_DMF_DeviceInterfaceMultipleTarget_OnPnpNotification(_In_ DMFMODULE DmfModule
                                                         _In_ PUNICODE_STRING SymbolicLinkName,
                                                         _Out_ BOOLEAN* IoTargetOpen);
 
+// Client Driver callback called when a Request sent by DMF_DeviceInterfaceMultipleTarget_SendToAny or
+// DMF_DeviceInterfaceMultipleTarget_SendToAll completes on a target.
+//
+typedef
+_Function_class_(EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion(_In_ DMFMODULE DmfModule,
+                                                     _In_ DeviceInterfaceMultipleTarget_Target Target,
+                                                     _In_ VOID* ClientRequestContext,
+                                                     _In_reads_(OutputBufferBytesRead) VOID* OutputBuffer,
+                                                     _In_ size_t OutputBufferBytesRead,
+                                                     _In_ NTSTATUS CompletionStatus);
+
+// Client Driver callback called when a Request sent by DMF_DeviceInterfaceMultipleTarget_SendToAll
+// has completed on all the targets it was sent to.
+//
+typedef
+_Function_class_(EVT_DMF_DeviceInterfaceMultipleTarget_BroadcastCompletion)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_DeviceInterfaceMultipleTarget_BroadcastCompletion(_In_ DMFMODULE DmfModule,
+                                                          _In_ VOID* ClientRequestContext,
+                                                          _In_ ULONG NumberOfTargetsSent,
+                                                          _In_ ULONG NumberOfTargetsSucceeded);
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -166,6 +208,39 @@ DMF_DeviceInterfaceMultipleTarget_SendSynchronously(
     _Out_opt_ size_t* BytesWritten
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_DeviceInterfaceMultipleTarget_SendToAll(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtDeviceInterfaceMultipleTargetSendCompletion,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_BroadcastCompletion* EvtDeviceInterfaceMultipleTargetBroadcastCompletion,
+    _In_opt_ VOID* ClientRequestContext,
+    _Out_opt_ ULONG* NumberOfTargetsSent
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+NTSTATUS
+DMF_DeviceInterfaceMultipleTarget_SendToAny(
+    _In_ DMFMODULE DmfModule,
+    _In_ DeviceInterfaceMultipleTarget_TargetSelectionType TargetSelection,
+    _In_reads_bytes_(RequestLength) VOID* RequestBuffer,
+    _In_ size_t RequestLength,
+    _Out_writes_bytes_(ResponseLength) VOID* ResponseBuffer,
+    _In_ size_t ResponseLength,
+    _In_ ContinuousRequestTarget_RequestType RequestType,
+    _In_ ULONG RequestIoctl,
+    _In_ ULONG RequestTimeoutMilliseconds,
+    _In_opt_ EVT_DMF_DeviceInterfaceMultipleTarget_SendCompletion* EvtDeviceInterfaceMultipleTargetSendCompletion,
+    _In_opt_ VOID* ClientRequestContext,
+    _Out_opt_ DeviceInterfaceMultipleTarget_Target* TargetSelected
+    );
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 NTSTATUS
 DMF_DeviceInterfaceMultipleTarget_StreamStart(
@@ -0,0 +1,1209 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_FrameParser.c
+
+Abstract:
+
+    Splits a byte stream into frames. The stream is passed to this Module in buffers of any
+    size, for example as they are returned by a serial port. Frames that are completely
+    contained in a buffer are decoded in place and given to the Client without copying.
+    Frames that span buffers are reassembled in a buffer owned by this Module.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+// DMF and this Module's Library specific definitions.
+//
+#include "DmfModule.h"
+#include "DmfModules.Library.h"
+#include "DmfModules.Library.Trace.h"
+
+#include "Dmf_FrameParser.tmh"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Enumerations and Structures
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// SLIP special characters (RFC 1055).
+//
+#define FRAMEPARSER_SLIP_END                0xC0
+#define FRAMEPARSER_SLIP_ESC                0xDB
+#define FRAMEPARSER_SLIP_ESC_END            0xDC
+#define FRAMEPARSER_SLIP_ESC_ESC            0xDD
+
+// COBS frame delimiter.
+//
+#define FRAMEPARSER_COBS_DELIMITER          0x00
+
+// Size of the CRC-32 that ends each FrameParser_FramingType_HeaderCrc frame.
+//
+#define FRAMEPARSER_CRC_SIZE                sizeof(ULONG)
+
+// Largest MaximumFrameSize so that the reassembly buffer size does not overflow.
+//
+#define FRAMEPARSER_MAXIMUM_FRAME_SIZE      (64 * 1024 * 1024)
+
+// Result of looking for a frame at the start of some bytes.
+//
+typedef enum
+{
+    // The bytes are the start of a frame that is not complete.
+    //
+    FrameParser_ScanResult_NeedMoreData,
+    // The bytes start with a complete frame.
+    //
+    FrameParser_ScanResult_FrameFound,
+    // The bytes cannot be the start of a frame.
+    //
+    FrameParser_ScanResult_NotFrameStart
+} FrameParser_ScanResult;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Module Private Context
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+typedef struct
+{
+    // Frames that span buffers are reassembled here.
+    //
+    WDFMEMORY AssemblyBufferMemory;
+    UCHAR* AssemblyBuffer;
+    ULONG AssemblyBufferSize;
+    // Number of bytes of a partial frame in AssemblyBuffer.
+    //
+    ULONG AssemblyLength;
+    // Delimited framing: A frame was too large, so bytes are skipped until the next delimiter.
+    //
+    BOOLEAN Discarding;
+    // Length based framing: Bytes before the payload.
+    //
+    ULONG HeaderSize;
+    // Length based framing: Bytes after the payload.
+    //
+    ULONG TrailerSize;
+    // Delimited framing: Byte that ends each frame.
+    //
+    UCHAR Delimiter;
+    // Counters returned by DMF_FrameParser_StatisticsGet().
+    //
+    FrameParser_Statistics Statistics;
+} DMF_CONTEXT_FrameParser;
+
+// This macro declares the following function:
+// DMF_CONTEXT_GET()
+//
+DMF_MODULE_DECLARE_CONTEXT(FrameParser)
+
+// This macro declares the following function:
+// DMF_CONFIG_GET()
+//
+DMF_MODULE_DECLARE_CONFIG(FrameParser)
+
+// Memory Pool Tag.
+//
+#define MemoryTag 'MrPF'
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Support Code
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) of each byte value.
+//
+static
+const
+ULONG
+FrameParser_Crc32Table[256] =
+{
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
+    0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+    0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
+    0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
+    0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+    0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
+    0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
+    0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+    0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
+    0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
+    0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+    0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
+    0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
+    0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+    0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
+    0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
+    0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+    0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
+    0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
+    0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+    0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
+    0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
+    0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+    0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
+    0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
+    0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+    0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
+    0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
+    0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+    0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
+    0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
+    0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+    0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+};
+
+static
+ULONG
+FrameParser_Crc32Compute(
+    _In_ ULONG Crc,
+    _In_reads_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    )
+/*++
+
+Routine Description:
+
+    Compute the CRC-32 of a given buffer using a lookup table.
+
+Arguments:
+
+    Crc - Zero to start a new CRC or the value returned by a previous call to continue it.
+    Buffer - The given buffer.
+    BufferLength - Size of Buffer in bytes.
+
+Return Value:
+
+    CRC-32 of all the bytes so far.
+
+--*/
+{
+    ULONG byteIndex;
+
+    Crc = ~Crc;
+    for (byteIndex = 0; byteIndex < BufferLength; byteIndex++)
+    {
+        Crc = FrameParser_Crc32Table[(Crc ^ Buffer[byteIndex]) & 0xFF] ^ (Crc >> 8);
+    }
+
+    return ~Crc;
+}
+
+static
+ULONG
+FrameParser_LittleEndianRead(
+    _In_reads_(Size) UCHAR* Buffer,
+    _In_ ULONG Size
+    )
+/*++
+
+Routine Description:
+
+    Read an unsigned value stored least significant byte first.
+
+Arguments:
+
+    Buffer - Where the value is stored.
+    Size - Number of bytes in the value.
+
+Return Value:
+
+    The value.
+
+--*/
+{
+    ULONG value;
+    ULONG byteIndex;
+
+    value = 0;
+    for (byteIndex = Size; byteIndex > 0; byteIndex--)
+    {
+        value = (value << 8) | Buffer[byteIndex - 1];
+    }
+
+    return value;
+}
+
+static
+UCHAR*
+FrameParser_DelimiterFind(
+    _In_ DMF_CONTEXT_FrameParser* ModuleContext,
+    _In_reads_(DataLength) UCHAR* Data,
+    _In_ ULONG DataLength
+    )
+/*++
+
+Routine Description:
+
+    Find the byte that ends a frame in delimited framing.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Data - The bytes to search.
+    DataLength - Number of bytes in Data.
+
+Return Value:
+
+    Address of the delimiter or NULL if Data does not contain it.
+
+--*/
+{
+    return (UCHAR*)memchr(Data,
+                          ModuleContext->Delimiter,
+                          DataLength);
+}
+
+static
+FrameParser_ScanResult
+FrameParser_FrameSizeGet(
+    _In_ DMF_CONFIG_FrameParser* ModuleConfig,
+    _In_ DMF_CONTEXT_FrameParser* ModuleContext,
+    _In_reads_(DataLength) UCHAR* Data,
+    _In_ ULONG DataLength,
+    _Out_ ULONG* FrameSize
+    )
+/*++
+
+Routine Description:
+
+    Determine if some bytes start with a complete frame.
+
+Arguments:
+
+    ModuleConfig - This Module's Config.
+    ModuleContext - This Module's context.
+    Data - The bytes.
+    DataLength - Number of bytes in Data.
+    FrameSize - Size of the frame including framing bytes. If the frame is not complete
+                and its size is not known yet, the number of bytes needed to know it.
+
+Return Value:
+
+    FrameParser_ScanResult
+
+--*/
+{
+    UCHAR* delimiter;
+    ULONG byteIndex;
+    ULONG payloadLength;
+
+    *FrameSize = 0;
+
+    if ((FrameParser_FramingType_Slip == ModuleConfig->FramingType) ||
+        (FrameParser_FramingType_Cobs == ModuleConfig->FramingType))
+    {
+        delimiter = FrameParser_DelimiterFind(ModuleContext,
+                                              Data,
+                                              DataLength);
+        if (NULL == delimiter)
+        {
+            *FrameSize = DataLength;
+            return FrameParser_ScanResult_NeedMoreData;
+        }
+        *FrameSize = (ULONG)(delimiter - Data) + 1;
+        return FrameParser_ScanResult_FrameFound;
+    }
+
+    if (FrameParser_FramingType_HeaderCrc == ModuleConfig->FramingType)
+    {
+        for (byteIndex = 0; (byteIndex < ModuleConfig->SyncByteCount) && (byteIndex < DataLength); byteIndex++)
+        {
+            if (Data[byteIndex] != ModuleConfig->SyncBytes[byteIndex])
+            {
+                return FrameParser_ScanResult_NotFrameStart;
+            }
+        }
+    }
+
+    if (DataLength < ModuleContext->HeaderSize)
+    {
+        *FrameSize = ModuleContext->HeaderSize;
+        return FrameParser_ScanResult_NeedMoreData;
+    }
+
+    payloadLength = FrameParser_LittleEndianRead(&Data[ModuleContext->HeaderSize - ModuleConfig->LengthFieldSize],
+                                                 ModuleConfig->LengthFieldSize);
+    if (payloadLength > ModuleConfig->MaximumFrameSize)
+    {
+        return FrameParser_ScanResult_NotFrameStart;
+    }
+
+    *FrameSize = ModuleContext->HeaderSize + payloadLength + ModuleContext->TrailerSize;
+    if (DataLength < *FrameSize)
+    {
+        return FrameParser_ScanResult_NeedMoreData;
+    }
+
+    return FrameParser_ScanResult_FrameFound;
+}
+
+static
+BOOLEAN
+FrameParser_SlipDecode(
+    _Inout_updates_(*Length) UCHAR* Buffer,
+    _Inout_ ULONG* Length
+    )
+/*++
+
+Routine Description:
+
+    Decode SLIP escape sequences in place. The decoded frame is never longer than the
+    encoded frame.
+
+Arguments:
+
+    Buffer - The encoded frame without its END byte.
+    Length - Size of the encoded frame on input. Size of the decoded frame on output.
+
+Return Value:
+
+    FALSE if the frame is not encoded properly.
+
+--*/
+{
+    ULONG readIndex;
+    ULONG writeIndex;
+
+    writeIndex = 0;
+    for (readIndex = 0; readIndex < *Length; readIndex++)
+    {
+        if (Buffer[readIndex] != FRAMEPARSER_SLIP_ESC)
+        {
+            Buffer[writeIndex++] = Buffer[readIndex];
+            continue;
+        }
+        readIndex++;
+        if (readIndex == *Length)
+        {
+            return FALSE;
+        }
+        if (FRAMEPARSER_SLIP_ESC_END == Buffer[readIndex])
+        {
+            Buffer[writeIndex++] = FRAMEPARSER_SLIP_END;
+        }
+        else if (FRAMEPARSER_SLIP_ESC_ESC == Buffer[readIndex])
+        {
+            Buffer[writeIndex++] = FRAMEPARSER_SLIP_ESC;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    *Length = writeIndex;
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+FrameParser_CobsDecode(
+    _Inout_updates_(*Length) UCHAR* Buffer,
+    _Inout_ ULONG* Length
+    )
+/*++
+
+Routine Description:
+
+    Decode a COBS frame in place. Each decoded byte is written before the position it is
+    read from, so decoding in place is safe.
+
+Arguments:
+
+    Buffer - The encoded frame without its delimiter.
+    Length - Size of the encoded frame on input. Size of the decoded frame on output.
+
+Return Value:
+
+    FALSE if the frame is not encoded properly.
+
+--*/
+{
+    ULONG readIndex;
+    ULONG writeIndex;
+    ULONG code;
+    ULONG blockIndex;
+
+    readIndex = 0;
+    writeIndex = 0;
+    while (readIndex < *Length)
+    {
+        code = Buffer[readIndex++];
+        if (0 == code)
+        {
+            return FALSE;
+        }
+        for (blockIndex = 1; blockIndex < code; blockIndex++)
+        {
+            if (readIndex == *Length)
+            {
+                return FALSE;
+            }
+            Buffer[writeIndex++] = Buffer[readIndex++];
+        }
+        // A block shorter than the maximum is followed by a zero unless it is the last one.
+        //
+        if ((code < 0xFF) &&
+            (readIndex < *Length))
+        {
+            Buffer[writeIndex++] = 0;
+        }
+    }
+
+    *Length = writeIndex;
+
+    return TRUE;
+}
+
+static
+VOID
+FrameParser_FrameDeliver(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(FrameSize) UCHAR* Frame,
+    _In_ ULONG FrameSize,
+    _In_ BOOLEAN Reassembled
+    )
+/*++
+
+Routine Description:
+
+    Validate and decode a complete frame in place and give its payload to the Client.
+    Caller holds the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Frame - The frame including framing bytes.
+    FrameSize - Size of Frame in bytes.
+    Reassembled - TRUE if Frame is in the reassembly buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_FrameParser* moduleContext;
+    DMF_CONFIG_FrameParser* moduleConfig;
+    UCHAR* payload;
+    ULONG payloadLength;
+    ULONG crc;
+    BOOLEAN valid;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    valid = TRUE;
+    payload = Frame;
+    payloadLength = 0;
+
+    switch (moduleConfig->FramingType)
+    {
+    case FrameParser_FramingType_LengthPrefixed:
+        payload = Frame + moduleContext->HeaderSize;
+        payloadLength = FrameSize - moduleContext->HeaderSize;
+        break;
+    case FrameParser_FramingType_HeaderCrc:
+        payload = Frame + moduleContext->HeaderSize;
+        payloadLength = FrameSize - moduleContext->HeaderSize - moduleContext->TrailerSize;
+        // The CRC covers the length field and the payload.
+        //
+        crc = FrameParser_Crc32Compute(0,
+                                       Frame + moduleConfig->SyncByteCount,
+                                       moduleConfig->LengthFieldSize + payloadLength);
+        valid = (crc == FrameParser_LittleEndianRead(payload + payloadLength,
+                                                     FRAMEPARSER_CRC_SIZE));
+        break;
+    case FrameParser_FramingType_Slip:
+        payloadLength = FrameSize - 1;
+        valid = FrameParser_SlipDecode(payload,
+                                       &payloadLength);
+        break;
+    case FrameParser_FramingType_Cobs:
+        payloadLength = FrameSize - 1;
+        valid = FrameParser_CobsDecode(payload,
+                                       &payloadLength);
+        break;
+    default:
+        DmfAssert(FALSE);
+        valid = FALSE;
+        break;
+    }
+
+    if (valid &&
+        (payloadLength > moduleConfig->MaximumFrameSize))
+    {
+        valid = FALSE;
+    }
+
+    if (! valid)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "Drop frame FrameSize=%u", FrameSize);
+        moduleContext->Statistics.FramesDropped++;
+        return;
+    }
+
+    // Delimited framing allows empty frames between delimiters, for example a SLIP END
+    // that is sent before each frame.
+    //
+    if ((0 == payloadLength) &&
+        (0 == moduleContext->HeaderSize))
+    {
+        return;
+    }
+
+    moduleContext->Statistics.FramesReceived++;
+    if (Reassembled)
+    {
+        moduleContext->Statistics.FramesReassembled++;
+    }
+
+    moduleConfig->EvtFrameParserFrameReceived(DmfModule,
+                                              payload,
+                                              payloadLength);
+}
+
+static
+VOID
+FrameParser_AssemblyAppend(
+    _In_ DMF_CONTEXT_FrameParser* ModuleContext,
+    _In_reads_(DataLength) UCHAR* Data,
+    _In_ ULONG DataLength
+    )
+/*++
+
+Routine Description:
+
+    Append bytes of a partial frame to the reassembly buffer. Caller makes sure they fit.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Data - The bytes to append.
+    DataLength - Number of bytes in Data.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(ModuleContext->AssemblyLength + DataLength <= ModuleContext->AssemblyBufferSize);
+
+    RtlCopyMemory(&ModuleContext->AssemblyBuffer[ModuleContext->AssemblyLength],
+                  Data,
+                  DataLength);
+    ModuleContext->AssemblyLength += DataLength;
+}
+
+static
+VOID
+FrameParser_AssemblyConsume(
+    _In_ DMF_CONTEXT_FrameParser* ModuleContext,
+    _In_ ULONG ByteCount
+    )
+/*++
+
+Routine Description:
+
+    Remove bytes from the start of the reassembly buffer and keep the rest so that
+    they can be scanned again.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    ByteCount - Number of bytes to remove.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DmfAssert(ByteCount <= ModuleContext->AssemblyLength);
+
+    RtlMoveMemory(ModuleContext->AssemblyBuffer,
+                  &ModuleContext->AssemblyBuffer[ByteCount],
+                  ModuleContext->AssemblyLength - ByteCount);
+    ModuleContext->AssemblyLength -= ByteCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_FrameParser_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type FrameParser.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_FrameParser* moduleContext;
+    DMF_CONFIG_FrameParser* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    if ((0 == moduleConfig->MaximumFrameSize) ||
+        (moduleConfig->MaximumFrameSize > FRAMEPARSER_MAXIMUM_FRAME_SIZE) ||
+        (NULL == moduleConfig->EvtFrameParserFrameReceived))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Size the reassembly buffer for the largest encoded frame.
+    //
+    moduleContext->HeaderSize = 0;
+    moduleContext->TrailerSize = 0;
+    switch (moduleConfig->FramingType)
+    {
+    case FrameParser_FramingType_HeaderCrc:
+        if (moduleConfig->SyncByteCount > FrameParser_SyncBytesMaximum)
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+        moduleContext->HeaderSize = moduleConfig->SyncByteCount;
+        moduleContext->TrailerSize = FRAMEPARSER_CRC_SIZE;
+        // Fall through.
+        //
+    case FrameParser_FramingType_LengthPrefixed:
+        if ((moduleConfig->LengthFieldSize != sizeof(UCHAR)) &&
+            (moduleConfig->LengthFieldSize != sizeof(USHORT)) &&
+            (moduleConfig->LengthFieldSize != sizeof(ULONG)))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+        moduleContext->HeaderSize += moduleConfig->LengthFieldSize;
+        moduleContext->AssemblyBufferSize = moduleContext->HeaderSize + moduleConfig->MaximumFrameSize + moduleContext->TrailerSize;
+        break;
+    case FrameParser_FramingType_Slip:
+        // Every byte may be escaped.
+        //
+        moduleContext->Delimiter = FRAMEPARSER_SLIP_END;
+        moduleContext->AssemblyBufferSize = (2 * moduleConfig->MaximumFrameSize) + 1;
+        break;
+    case FrameParser_FramingType_Cobs:
+        // One code byte per 254 data bytes plus the first code byte.
+        //
+        moduleContext->Delimiter = FRAMEPARSER_COBS_DELIMITER;
+        moduleContext->AssemblyBufferSize = moduleConfig->MaximumFrameSize + (moduleConfig->MaximumFrameSize / 254) + 2;
+        break;
+    default:
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               moduleContext->AssemblyBufferSize,
+                               &moduleContext->AssemblyBufferMemory,
+                               (VOID**)&moduleContext->AssemblyBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->AssemblyBufferMemory = NULL;
+        moduleContext->AssemblyBuffer = NULL;
+        goto Exit;
+    }
+
+    moduleContext->AssemblyLength = 0;
+    moduleContext->Discarding = FALSE;
+    RtlZeroMemory(&moduleContext->Statistics,
+                  sizeof(moduleContext->Statistics));
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_FrameParser_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type FrameParser.
+
+Arguments:
+
+    DmfModule - The given DMF Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_FrameParser* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->AssemblyBufferMemory != NULL)
+    {
+        WdfObjectDelete(moduleContext->AssemblyBufferMemory);
+        moduleContext->AssemblyBufferMemory = NULL;
+        moduleContext->AssemblyBuffer = NULL;
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_FrameParser_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type FrameParser.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_FrameParser;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_FrameParser;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_FrameParser);
+    dmfCallbacksDmf_FrameParser.DeviceOpen = DMF_FrameParser_Open;
+    dmfCallbacksDmf_FrameParser.DeviceClose = DMF_FrameParser_Close;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_FrameParser,
+                                            FrameParser,
+                                            DMF_CONTEXT_FrameParser,
+                                            DMF_MODULE_OPTIONS_DISPATCH_MAXIMUM,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_Create);
+
+    dmfModuleDescriptor_FrameParser.CallbacksDmf = &dmfCallbacksDmf_FrameParser;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_FrameParser,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return(ntStatus);
+}
+#pragma code_seg()
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+DMF_FrameParser_Crc32(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG Crc,
+    _In_reads_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    )
+/*++
+
+Routine Description:
+
+    Compute the CRC-32 used by FrameParser_FramingType_HeaderCrc. This allows Client to
+    build frames that this Module parses.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Crc - Zero to start a new CRC or the value returned by a previous call to continue it.
+    Buffer - The bytes to add to the CRC.
+    BufferLength - Number of bytes in Buffer.
+
+Return Value:
+
+    CRC-32 of all the bytes so far.
+
+--*/
+{
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 FrameParser);
+
+    return FrameParser_Crc32Compute(Crc,
+                                    Buffer,
+                                    BufferLength);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_Parse(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    )
+/*++
+
+Routine Description:
+
+    Parse the next bytes of the stream and call the Client's callback for each frame
+    that they complete. Frames that are completely contained in Buffer are decoded in
+    place. Bytes of a frame that is not complete are kept until the next call.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Buffer - The next bytes of the stream. This Module may modify them.
+    BufferLength - Number of bytes in Buffer.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_FrameParser* moduleContext;
+    DMF_CONFIG_FrameParser* moduleConfig;
+    FrameParser_ScanResult scanResult;
+    UCHAR* data;
+    UCHAR* delimiter;
+    ULONG dataLength;
+    ULONG frameSize;
+    ULONG bytesToCopy;
+    ULONG offset;
+    BOOLEAN delimited;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 FrameParser);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    delimited = (0 == moduleContext->HeaderSize);
+
+    DMF_ModuleLock(DmfModule);
+
+    moduleContext->Statistics.BytesParsed += BufferLength;
+
+    offset = 0;
+    while (offset < BufferLength)
+    {
+        data = &Buffer[offset];
+        dataLength = BufferLength - offset;
+
+        if (moduleContext->Discarding)
+        {
+            // Skip the rest of a frame that is too large.
+            //
+            delimiter = FrameParser_DelimiterFind(moduleContext,
+                                                  data,
+                                                  dataLength);
+            if (NULL == delimiter)
+            {
+                break;
+            }
+            offset += (ULONG)(delimiter - data) + 1;
+            moduleContext->Discarding = FALSE;
+            continue;
+        }
+
+        if (moduleContext->AssemblyLength > 0)
+        {
+            // Continue the frame that started in a previous buffer.
+            //
+            if (delimited)
+            {
+                delimiter = FrameParser_DelimiterFind(moduleContext,
+                                                      data,
+                                                      dataLength);
+                bytesToCopy = (NULL == delimiter) ? dataLength : (ULONG)(delimiter - data) + 1;
+                if (bytesToCopy > moduleContext->AssemblyBufferSize - moduleContext->AssemblyLength)
+                {
+                    moduleContext->Statistics.FramesDropped++;
+                    moduleContext->AssemblyLength = 0;
+                    moduleContext->Discarding = TRUE;
+                    continue;
+                }
+                FrameParser_AssemblyAppend(moduleContext,
+                                           data,
+                                           bytesToCopy);
+                offset += bytesToCopy;
+                if (delimiter != NULL)
+                {
+                    FrameParser_FrameDeliver(DmfModule,
+                                             moduleContext->AssemblyBuffer,
+                                             moduleContext->AssemblyLength,
+                                             TRUE);
+                    moduleContext->AssemblyLength = 0;
+                }
+                continue;
+            }
+
+            // Copy only what is needed to know the frame's size and then to complete it.
+            //
+            for (;;)
+            {
+                scanResult = FrameParser_FrameSizeGet(moduleConfig,
+                                                      moduleContext,
+                                                      moduleContext->AssemblyBuffer,
+                                                      moduleContext->AssemblyLength,
+                                                      &frameSize);
+                if (FrameParser_ScanResult_NotFrameStart == scanResult)
+                {
+                    // The partial frame was not a frame after all. Resync one byte at a
+                    // time as the zero copy path does, since a frame may start at any of
+                    // the bytes that are already in the reassembly buffer.
+                    //
+                    moduleContext->Statistics.BytesSkipped++;
+                    FrameParser_AssemblyConsume(moduleContext,
+                                                1);
+                    if (0 == moduleContext->AssemblyLength)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                if (FrameParser_ScanResult_FrameFound == scanResult)
+                {
+                    FrameParser_FrameDeliver(DmfModule,
+                                             moduleContext->AssemblyBuffer,
+                                             frameSize,
+                                             TRUE);
+                    // After a resync, bytes that follow the frame may already be in
+                    // the reassembly buffer.
+                    //
+                    FrameParser_AssemblyConsume(moduleContext,
+                                                frameSize);
+                    if (0 == moduleContext->AssemblyLength)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                if (offset == BufferLength)
+                {
+                    break;
+                }
+                bytesToCopy = min(frameSize - moduleContext->AssemblyLength,
+                                  BufferLength - offset);
+                FrameParser_AssemblyAppend(moduleContext,
+                                           &Buffer[offset],
+                                           bytesToCopy);
+                offset += bytesToCopy;
+            }
+            continue;
+        }
+
+        scanResult = FrameParser_FrameSizeGet(moduleConfig,
+                                              moduleContext,
+                                              data,
+                                              dataLength,
+                                              &frameSize);
+        if (FrameParser_ScanResult_FrameFound == scanResult)
+        {
+            // Zero copy path.
+            //
+            FrameParser_FrameDeliver(DmfModule,
+                                     data,
+                                     frameSize,
+                                     FALSE);
+            offset += frameSize;
+        }
+        else if (FrameParser_ScanResult_NotFrameStart == scanResult)
+        {
+            moduleContext->Statistics.BytesSkipped++;
+            offset++;
+        }
+        else if (dataLength > moduleContext->AssemblyBufferSize)
+        {
+            // Only delimited framing can get here.
+            //
+            DmfAssert(delimited);
+            moduleContext->Statistics.FramesDropped++;
+            moduleContext->Discarding = TRUE;
+            offset = BufferLength;
+        }
+        else
+        {
+            FrameParser_AssemblyAppend(moduleContext,
+                                       data,
+                                       dataLength);
+            offset = BufferLength;
+        }
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_Reset(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Discard the partial frame, if any. For example, Client calls this Method when the
+    stream restarts.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_FrameParser* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 FrameParser);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    moduleContext->AssemblyLength = 0;
+    moduleContext->Discarding = FALSE;
+    DMF_ModuleUnlock(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ FrameParser_Statistics* Statistics
+    )
+/*++
+
+Routine Description:
+
+    Get the counters this Module keeps about the stream.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Statistics - Where the counters are written.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_FrameParser* moduleContext;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 FrameParser);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    *Statistics = moduleContext->Statistics;
+    DMF_ModuleUnlock(DmfModule);
+}
+
+// eof: Dmf_FrameParser.c
+//
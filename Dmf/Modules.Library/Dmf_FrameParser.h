@@ -0,0 +1,147 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_FrameParser.h
+
+Abstract:
+
+    Companion file to Dmf_FrameParser.c.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// The ways frames are delimited in the byte stream.
+//
+typedef enum
+{
+    FrameParser_FramingType_Invalid = 0,
+    // [Length][Payload]
+    // Length is LengthFieldSize bytes, least significant byte first.
+    //
+    FrameParser_FramingType_LengthPrefixed,
+    // [SyncBytes][Length][Payload][CRC-32]
+    // CRC-32 (IEEE 802.3) of Length and Payload, least significant byte first.
+    //
+    FrameParser_FramingType_HeaderCrc,
+    // RFC 1055 SLIP. Each frame ends with 0xC0.
+    //
+    FrameParser_FramingType_Slip,
+    // Consistent Overhead Byte Stuffing. Each frame ends with 0x00.
+    //
+    FrameParser_FramingType_Cobs,
+    FrameParser_FramingType_Maximum
+} FrameParser_FramingType;
+
+// Maximum number of sync bytes at the start of a FrameParser_FramingType_HeaderCrc frame.
+//
+#define FrameParser_SyncBytesMaximum    4
+
+// Client Driver callback function that receives a complete frame.
+// Frame points into the Client's buffer when the whole frame was in that buffer.
+// Otherwise, it points to the Module's reassembly buffer. In both cases it is only
+// valid during the callback.
+//
+typedef
+_Function_class_(EVT_DMF_FrameParser_FrameReceived)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_FrameParser_FrameReceived(_In_ DMFMODULE DmfModule,
+                                  _In_reads_(FrameLength) UCHAR* Frame,
+                                  _In_ ULONG FrameLength);
+
+// Counters that allow Client to monitor the stream.
+//
+typedef struct
+{
+    // Bytes passed to DMF_FrameParser_Parse().
+    //
+    ULONGLONG BytesParsed;
+    // Frames passed to the Client's callback.
+    //
+    ULONGLONG FramesReceived;
+    // Of FramesReceived, frames that were reassembled from more than one buffer.
+    //
+    ULONGLONG FramesReassembled;
+    // Frames discarded because they are too large, fail CRC or are not encoded properly.
+    //
+    ULONGLONG FramesDropped;
+    // Bytes skipped while searching for the start of a frame.
+    //
+    ULONGLONG BytesSkipped;
+} FrameParser_Statistics;
+
+// Client uses this structure to configure the Module specific parameters.
+//
+typedef struct
+{
+    // How frames are delimited.
+    //
+    FrameParser_FramingType FramingType;
+    // Maximum size of a frame's payload after decoding.
+    //
+    ULONG MaximumFrameSize;
+    // LengthPrefixed and HeaderCrc: Size of the length field (1, 2 or 4).
+    //
+    ULONG LengthFieldSize;
+    // HeaderCrc: Bytes that start each frame.
+    //
+    UCHAR SyncBytes[FrameParser_SyncBytesMaximum];
+    ULONG SyncByteCount;
+    // Called for each frame.
+    //
+    EVT_DMF_FrameParser_FrameReceived* EvtFrameParserFrameReceived;
+} DMF_CONFIG_FrameParser;
+
+// This macro declares the following functions:
+// DMF_FrameParser_ATTRIBUTES_INIT()
+// DMF_CONFIG_FrameParser_AND_ATTRIBUTES_INIT()
+// DMF_FrameParser_Create()
+//
+DECLARE_DMF_MODULE(FrameParser)
+
+// Module Methods
+//
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+ULONG
+DMF_FrameParser_Crc32(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG Crc,
+    _In_reads_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_Parse(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_Reset(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+VOID
+DMF_FrameParser_StatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ FrameParser_Statistics* Statistics
+    );
+
+// eof: Dmf_FrameParser.h
+//
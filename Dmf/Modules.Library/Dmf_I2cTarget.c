@@ -38,6 +38,34 @@ Environment:
 #include <gpio.h>
 #include <spb.h>
 
+// State of each cached register.
+//
+// The cached value matches the device.
+//
+#define I2CTARGET_REGISTER_STATE_VALID          0x01
+// The cached value has not been written to the device yet.
+//
+#define I2CTARGET_REGISTER_STATE_DIRTY          0x02
+// The Client has written the register. Its value is restored when the device enters D0.
+//
+#define I2CTARGET_REGISTER_STATE_WRITTEN        0x04
+
+// A range of cacheable or read-only registers. Only declared ranges are stored so that
+// the cache stays small for sparse register maps.
+//
+typedef struct
+{
+    ULONG FirstRegister;
+    ULONG NumberOfRegisters;
+    I2cTarget_RegisterType RegisterType;
+    // Cached value of each register in the range.
+    //
+    UCHAR* Values;
+    // I2CTARGET_REGISTER_STATE_* flags of each register in the range.
+    //
+    UCHAR* States;
+} I2CTARGET_REGISTER_CACHE_RANGE;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -57,6 +85,20 @@ typedef struct
     // Resource Index.
     //
     ULONG ResourceIndex;
+    // Register cache. It is kept while the device is not in D0.
+    //
+    WDFMEMORY RegisterCacheMemory;
+    // Cached ranges sorted by FirstRegister.
+    //
+    I2CTARGET_REGISTER_CACHE_RANGE* RegisterCacheRanges;
+    ULONG NumberOfRegisterCacheRanges;
+    // Length of addresses to which the register cache applies.
+    //
+    ULONG RegisterAddressLength;
+    // Sends the batches submitted by DMF_I2cTarget_TransactionsSubmit() through I2cTarget.
+    // Only present when TransactionsOutstandingMaximum is not zero.
+    //
+    DMFMODULE DmfModuleSpbTarget;
 } DMF_CONTEXT_I2cTarget;
 
 // This macro declares the following function:
@@ -590,30 +632,19 @@ Exit:
 }
 #pragma code_seg()
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
 #pragma code_seg("PAGE")
-_Function_class_(DMF_Open)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
 static
 NTSTATUS
-DMF_I2cTarget_Open(
+I2cTarget_RegisterCacheCreate(
     _In_ DMFMODULE DmfModule
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type I2cTarget.
+    Allocate the register cache from the register ranges the Client declared.
 
 Arguments:
 
@@ -626,73 +657,142 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
-    UNICODE_STRING resourcePathString;
-    WCHAR resourcePathBuffer[RESOURCE_HUB_PATH_SIZE];
-    WDFDEVICE device;
-    WDF_OBJECT_ATTRIBUTES objectAttributes;
-    WDF_IO_TARGET_OPEN_PARAMS openParams;
     DMF_CONTEXT_I2cTarget* moduleContext;
     DMF_CONFIG_I2cTarget* moduleConfig;
+    I2CTARGET_REGISTER_CACHE_RANGE* ranges;
+    I2CTARGET_REGISTER_CACHE_RANGE rangeToInsert;
+    I2cTarget_RegisterRange* registerRange;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    UCHAR* registerBytes;
+    ULONGLONG numberOfRegisters;
+    ULONG numberOfRanges;
+    ULONG rangeIndex;
+    ULONG insertIndex;
+    size_t cacheSize;
 
     PAGED_CODE();
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
-
     moduleConfig = DMF_CONFIG_GET(DmfModule);
 
-    if (! moduleContext->I2cConnectionAssigned)
+    moduleContext->RegisterAddressLength = moduleConfig->RegisterAddressLength;
+    if (0 == moduleContext->RegisterAddressLength)
     {
-        // In some cases, the minimum number of resources is zero because the same driver
-        // is used on different platforms. In that case, this Module still loads and opens
-        // but it does nothing.
-        //
-        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No I2C Resources Found");
-        ntStatus = STATUS_SUCCESS;
+        moduleContext->RegisterAddressLength = sizeof(UCHAR);
+    }
+    if (moduleContext->RegisterAddressLength > sizeof(ULONG))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid RegisterAddressLength=%u", moduleConfig->RegisterAddressLength);
         goto Exit;
     }
 
-    device = DMF_ParentDeviceGet(DmfModule);
+    // Only cacheable and read-only ranges are stored.
+    //
+    numberOfRanges = 0;
+    numberOfRegisters = 0;
+    for (rangeIndex = 0; rangeIndex < moduleConfig->NumberOfRegisterRanges; rangeIndex++)
+    {
+        registerRange = &moduleConfig->RegisterRanges[rangeIndex];
+        if ((registerRange->RegisterType >= I2cTarget_RegisterType_Maximum) ||
+            (0 == registerRange->NumberOfRegisters) ||
+            ((ULONGLONG)registerRange->FirstRegister + registerRange->NumberOfRegisters > (1ULL << (moduleContext->RegisterAddressLength * 8))))
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid register range %u", rangeIndex);
+            goto Exit;
+        }
+        if (registerRange->RegisterType != I2cTarget_RegisterType_Volatile)
+        {
+            numberOfRanges++;
+            numberOfRegisters += registerRange->NumberOfRegisters;
+        }
+    }
 
-    RtlInitEmptyUnicodeString(&resourcePathString,
-                              resourcePathBuffer,
-                              sizeof(resourcePathBuffer));
+    if (0 == numberOfRanges)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
 
-    ntStatus = RESOURCE_HUB_CREATE_PATH_FROM_ID(&resourcePathString,
-                                                moduleContext->I2cConnection.u.Connection.IdLowPart,
-                                                moduleContext->I2cConnection.u.Connection.IdHighPart);
-    if (! NT_SUCCESS(ntStatus))
+    // Ranges are followed by the value and state of every cached register.
+    //
+    if (numberOfRegisters > MAXULONG)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RESOURCE_HUB_CREATE_PATH_FROM_ID fails: ntStatus=%!STATUS!", ntStatus);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Too many cached registers");
         goto Exit;
     }
+    cacheSize = (numberOfRanges * sizeof(I2CTARGET_REGISTER_CACHE_RANGE)) +
+                (2 * (size_t)numberOfRegisters);
 
     WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
     objectAttributes.ParentObject = DmfModule;
-
-    ntStatus = WdfIoTargetCreate(device,
-                                 &objectAttributes,
-                                 &moduleContext->I2cTarget);
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               cacheSize,
+                               &memory,
+                               (VOID**)&ranges);
     if (! NT_SUCCESS(ntStatus))
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RESOURCE_HUB_CREATE_PATH_FROM_ID fails: ntStatus=%!STATUS!", ntStatus);
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
         goto Exit;
     }
+    RtlZeroMemory(ranges,
+                  cacheSize);
 
-    WDF_IO_TARGET_OPEN_PARAMS_INIT_OPEN_BY_NAME(&openParams,
-                                                &resourcePathString,
-                                                FILE_GENERIC_READ | FILE_GENERIC_WRITE);
-
-    //  Open the IoTarget for I/O operation.
+    // Insert each range in order of FirstRegister. The table is small and this
+    // only runs once.
     //
-    ntStatus = WdfIoTargetOpen(moduleContext->I2cTarget,
-                               &openParams);
-    if (! NT_SUCCESS(ntStatus))
+    registerBytes = (UCHAR*)(ranges + numberOfRanges);
+    numberOfRanges = 0;
+    for (rangeIndex = 0; rangeIndex < moduleConfig->NumberOfRegisterRanges; rangeIndex++)
     {
-        DmfAssert(NT_SUCCESS(ntStatus));
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfIoTargetOpen fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        registerRange = &moduleConfig->RegisterRanges[rangeIndex];
+        if (I2cTarget_RegisterType_Volatile == registerRange->RegisterType)
+        {
+            continue;
+        }
+
+        rangeToInsert.FirstRegister = registerRange->FirstRegister;
+        rangeToInsert.NumberOfRegisters = registerRange->NumberOfRegisters;
+        rangeToInsert.RegisterType = registerRange->RegisterType;
+        rangeToInsert.Values = registerBytes;
+        registerBytes += registerRange->NumberOfRegisters;
+        rangeToInsert.States = registerBytes;
+        registerBytes += registerRange->NumberOfRegisters;
+
+        insertIndex = numberOfRanges;
+        while ((insertIndex > 0) &&
+               (ranges[insertIndex - 1].FirstRegister > rangeToInsert.FirstRegister))
+        {
+            ranges[insertIndex] = ranges[insertIndex - 1];
+            insertIndex--;
+        }
+        ranges[insertIndex] = rangeToInsert;
+        numberOfRanges++;
+    }
+
+    for (rangeIndex = 1; rangeIndex < numberOfRanges; rangeIndex++)
+    {
+        if ((ULONGLONG)ranges[rangeIndex - 1].FirstRegister + ranges[rangeIndex - 1].NumberOfRegisters > ranges[rangeIndex].FirstRegister)
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Register ranges overlap at register 0x%X", ranges[rangeIndex].FirstRegister);
+            WdfObjectDelete(memory);
+            goto Exit;
+        }
     }
 
+    moduleContext->RegisterCacheMemory = memory;
+    moduleContext->RegisterCacheRanges = ranges;
+    moduleContext->NumberOfRegisterCacheRanges = numberOfRanges;
+
 Exit:
 
     return ntStatus;
@@ -700,188 +800,169 @@ Exit:
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(DMF_Close)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
-VOID
-DMF_I2cTarget_Close(
-    _In_ DMFMODULE DmfModule
+BOOLEAN
+I2cTarget_RegisterAddressDecode(
+    _In_ DMF_CONTEXT_I2cTarget* ModuleContext,
+    _In_reads_(AddressLength) UCHAR* Address,
+    _In_ ULONG AddressLength,
+    _In_ ULONG BufferLength,
+    _Out_ ULONG* Register
     )
 /*++
 
 Routine Description:
 
-    Uninitialize an instance of a DMF Module of type I2cTarget.
+    Determine if an access at a given address uses the register cache and, if so,
+    the register it starts at.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    ModuleContext - This Module's context.
+    Address - The given address.
+    AddressLength - The number of bytes that make up Address.
+    BufferLength - The number of registers accessed.
+    Register - The register at Address.
 
 Return Value:
 
-    None
+    TRUE if the access uses the register cache.
 
 --*/
 {
-    DMF_CONTEXT_I2cTarget* moduleContext;
+    ULONG byteIndex;
 
     PAGED_CODE();
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    *Register = 0;
 
-    if (moduleContext->I2cTarget != NULL)
+    if ((0 == ModuleContext->NumberOfRegisterCacheRanges) ||
+        (AddressLength != ModuleContext->RegisterAddressLength))
     {
-        WdfIoTargetClose(moduleContext->I2cTarget);
-        WdfObjectDelete(moduleContext->I2cTarget);
-        moduleContext->I2cTarget = NULL;
+        return FALSE;
+    }
+
+    for (byteIndex = 0; byteIndex < AddressLength; byteIndex++)
+    {
+        *Register = (*Register << 8) | Address[byteIndex];
     }
+
+    // Accesses that wrap around the address space are not cached.
+    //
+    return ((ULONGLONG)*Register + BufferLength <= (1ULL << (AddressLength * 8)));
 }
 #pragma code_seg()
 
 #pragma code_seg("PAGE")
-_Function_class_(DMF_ResourcesAssign)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
-NTSTATUS
-DMF_I2cTarget_ResourcesAssign(
-    _In_ DMFMODULE DmfModule,
-    _In_ WDFCMRESLIST ResourcesRaw,
-    _In_ WDFCMRESLIST ResourcesTranslated
+I2CTARGET_REGISTER_CACHE_RANGE*
+I2cTarget_RegisterCacheRunGet(
+    _In_ DMF_CONTEXT_I2cTarget* ModuleContext,
+    _In_ ULONG Register,
+    _In_ ULONGLONG EndRegister,
+    _Out_ ULONG* RunLength
     )
 /*++
 
 Routine Description:
 
-    Tells this Module instance what Resources are available. This Module then extracts
-    the needed Resources and uses them as needed.
+    Find the run of registers starting at a given register that are either all in the
+    same cached range or all not cached.
 
 Arguments:
 
-    DmfModule - This Module's handle.
-    ResourcesRaw - WDF Resource Raw parameter that is passed to the given
-                   DMF Module callback.
-    ResourcesTranslated - WDF Resources Translated parameter that is passed to the given
-                          DMF Module callback.
+    ModuleContext - This Module's context.
+    Register - The first register of the run.
+    EndRegister - The register after the last register of the access.
+    RunLength - The number of registers in the run.
 
 Return Value:
 
-    STATUS_SUCCESS.
+    The cached range that contains the run or NULL if the run is not cached.
 
 --*/
 {
-    DMF_CONTEXT_I2cTarget* moduleContext;
-    ULONG i2cResourceCount;
-    ULONG resourceCount;
-    ULONG resourceIndex;
-    NTSTATUS ntStatus;
-    DMF_CONFIG_I2cTarget* moduleConfig;
-    BOOLEAN resourceAssigned;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    ULONGLONG runEnd;
+    ULONG low;
+    ULONG high;
+    ULONG middle;
 
     PAGED_CODE();
 
-    UNREFERENCED_PARAMETER(ResourcesRaw);
-
-    DmfAssert(ResourcesRaw != NULL);
-    DmfAssert(ResourcesTranslated != NULL);
-
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
-
-    // Number of valid resources.
-    //
-    i2cResourceCount = 0;
-    resourceAssigned = FALSE;
-
-    // Check the number of resources for the button device.
+    // Find the first range that ends after Register.
     //
-    resourceCount = WdfCmResourceListGetCount(ResourcesTranslated);
-    if (resourceCount == 0)
+    low = 0;
+    high = ModuleContext->NumberOfRegisterCacheRanges;
+    while (low < high)
     {
-        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "I2C resources not found");
-        ntStatus = STATUS_DEVICE_CONFIGURATION_ERROR;
-        DmfAssert(FALSE);
-        goto Exit;
+        middle = low + (high - low) / 2;
+        range = &ModuleContext->RegisterCacheRanges[middle];
+        if ((ULONGLONG)range->FirstRegister + range->NumberOfRegisters <= Register)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
     }
 
-    // Parse the resources.
-    //
-    for (resourceIndex = 0; resourceIndex < resourceCount && (! resourceAssigned); resourceIndex++)
+    runEnd = EndRegister;
+    if (low < ModuleContext->NumberOfRegisterCacheRanges)
     {
-        PCM_PARTIAL_RESOURCE_DESCRIPTOR resource;
-
-        resource = WdfCmResourceListGetDescriptor(ResourcesTranslated, resourceIndex);
-        if (NULL == resource)
+        range = &ModuleContext->RegisterCacheRanges[low];
+        if (range->FirstRegister <= Register)
         {
-            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
-            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No resources found");
-            goto Exit;
+            runEnd = min(runEnd, (ULONGLONG)range->FirstRegister + range->NumberOfRegisters);
         }
-
-        if (resource->Type == CmResourceTypeConnection)
+        else
         {
-            if ((resource->u.Connection.Class == CM_RESOURCE_CONNECTION_CLASS_SERIAL) &&
-                (resource->u.Connection.Type == CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C))
-            {
-                if (moduleConfig->I2cResourceIndex == i2cResourceCount)
-                {
-                    moduleContext->ResourceIndex = i2cResourceCount;
-                    moduleContext->I2cConnection = *resource;
-                    moduleContext->I2cConnectionAssigned = TRUE;
-                    resourceAssigned = TRUE;
-                }
-                i2cResourceCount++;
-            }
+            runEnd = min(runEnd, (ULONGLONG)range->FirstRegister);
+            range = NULL;
         }
     }
-
-    //  Validate the configuration parameters.
-    //
-    if ((moduleConfig->I2cConnectionMandatory) &&
-        (0 == i2cResourceCount || (! resourceAssigned)))
+    else
     {
-        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "I2C Resources not assigned");
-        ntStatus = STATUS_DEVICE_CONFIGURATION_ERROR;
-        DmfAssert(FALSE);
-        goto Exit;
+        range = NULL;
     }
 
-    ntStatus = STATUS_SUCCESS;
-
-Exit:
+    *RunLength = (ULONG)(runEnd - Register);
 
-    return ntStatus;
+    return range;
 }
 #pragma code_seg()
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// Public Calls by Client
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
 #pragma code_seg("PAGE")
-
 _IRQL_requires_max_(PASSIVE_LEVEL)
 _Must_inspect_result_
+static
 NTSTATUS
-DMF_I2cTarget_Create(
-    _In_ WDFDEVICE Device,
-    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
-    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
-    _Out_ DMFMODULE* DmfModule
+I2cTarget_RegisterCacheRead(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(AddressLength) UCHAR* Address,
+    _In_ ULONG AddressLength,
+    _In_ ULONG Register,
+    _Out_writes_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
     )
 /*++
 
 Routine Description:
 
-    Create an instance of a DMF Module of type I2cTarget.
+    Read registers using the register cache. The bus is only accessed if one of the
+    registers is volatile or has not been read yet.
 
 Arguments:
 
-    Device - Client driver's WDFDEVICE object.
-    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
-    ObjectAttributes - WDF object attributes for DMFMODULE.
-    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+    DmfModule - This Module's handle.
+    Address - The address to read from.
+    AddressLength - The number of bytes that make up the Address.
+    Register - The register at Address.
+    Buffer - The address where the bytes that are read should be written.
+    BufferLength - The number of bytes to read.
 
 Return Value:
 
@@ -890,33 +971,888 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
-    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_I2cTarget;
-    DMF_CALLBACKS_DMF dmfCallbacksDmf_I2cTarget;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    ULONGLONG endRegister;
+    ULONG currentRegister;
+    ULONG accessOffset;
+    ULONG runLength;
+    ULONG registerIndex;
+    ULONG rangeOffset;
+    BOOLEAN busAccessNeeded;
 
     PAGED_CODE();
 
-    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_I2cTarget);
-    dmfCallbacksDmf_I2cTarget.DeviceOpen = DMF_I2cTarget_Open;
-    dmfCallbacksDmf_I2cTarget.DeviceClose = DMF_I2cTarget_Close;
-    dmfCallbacksDmf_I2cTarget.DeviceResourcesAssign = DMF_I2cTarget_ResourcesAssign;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
 
-    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_I2cTarget,
-                                            I2cTarget,
-                                            DMF_CONTEXT_I2cTarget,
-                                            DMF_MODULE_OPTIONS_PASSIVE,
-                                            DMF_MODULE_OPEN_OPTION_OPEN_D0Entry);
+    endRegister = (ULONGLONG)Register + BufferLength;
 
-    dmfModuleDescriptor_I2cTarget.CallbacksDmf = &dmfCallbacksDmf_I2cTarget;
+    DMF_ModuleLock(DmfModule);
 
-    ntStatus = DMF_ModuleCreate(Device,
-                                DmfModuleAttributes,
-                                ObjectAttributes,
-                                &dmfModuleDescriptor_I2cTarget,
-                                DmfModule);
-    if (! NT_SUCCESS(ntStatus))
+    busAccessNeeded = FALSE;
+    for (accessOffset = 0; accessOffset < BufferLength; accessOffset += runLength)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        currentRegister = Register + accessOffset;
+        range = I2cTarget_RegisterCacheRunGet(moduleContext,
+                                              currentRegister,
+                                              endRegister,
+                                              &runLength);
+        if (NULL == range)
+        {
+            busAccessNeeded = TRUE;
+            break;
+        }
+        rangeOffset = currentRegister - range->FirstRegister;
+        for (registerIndex = 0; registerIndex < runLength; registerIndex++)
+        {
+            if (! (range->States[rangeOffset + registerIndex] & I2CTARGET_REGISTER_STATE_VALID))
+            {
+                busAccessNeeded = TRUE;
+                break;
+            }
+        }
+        if (busAccessNeeded)
+        {
+            break;
+        }
+    }
+
+    if (busAccessNeeded)
+    {
+        ntStatus = I2cTarget_SpbRead(moduleContext->I2cTarget,
+                                     Address,
+                                     AddressLength,
+                                     Buffer,
+                                     BufferLength,
+                                     moduleConfig->ReadDelayUs,
+                                     moduleConfig->ReadTimeoutMs);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            goto Exit;
+        }
+    }
+
+    // Either fill the cache from what was read or fill the Client's buffer from the
+    // cache. Registers that have not been written back yet always come from the cache.
+    //
+    for (accessOffset = 0; accessOffset < BufferLength; accessOffset += runLength)
+    {
+        currentRegister = Register + accessOffset;
+        range = I2cTarget_RegisterCacheRunGet(moduleContext,
+                                              currentRegister,
+                                              endRegister,
+                                              &runLength);
+        if (range != NULL)
+        {
+            rangeOffset = currentRegister - range->FirstRegister;
+            for (registerIndex = 0; registerIndex < runLength; registerIndex++)
+            {
+                if ((! busAccessNeeded) ||
+                    (range->States[rangeOffset + registerIndex] & I2CTARGET_REGISTER_STATE_DIRTY))
+                {
+                    Buffer[accessOffset + registerIndex] = range->Values[rangeOffset + registerIndex];
+                }
+                else
+                {
+                    range->Values[rangeOffset + registerIndex] = Buffer[accessOffset + registerIndex];
+                    range->States[rangeOffset + registerIndex] |= I2CTARGET_REGISTER_STATE_VALID;
+                }
+            }
+        }
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+I2cTarget_RegisterCacheWrite(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(AddressLength) UCHAR* Address,
+    _In_ ULONG AddressLength,
+    _In_ ULONG Register,
+    _In_reads_(BufferLength) UCHAR* Buffer,
+    _In_ ULONG BufferLength
+    )
+/*++
+
+Routine Description:
+
+    Write registers using the register cache. In write-back mode, writes that only
+    touch cacheable registers do not access the bus.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Address - The address to write to.
+    AddressLength - The number of bytes that make up the Address.
+    Register - The register at Address.
+    Buffer - The address of the bytes to write.
+    BufferLength - The number of bytes to write.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    ULONGLONG endRegister;
+    ULONG currentRegister;
+    ULONG accessOffset;
+    ULONG runLength;
+    ULONG registerIndex;
+    ULONG rangeOffset;
+    UCHAR* state;
+    BOOLEAN allCacheable;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    endRegister = (ULONGLONG)Register + BufferLength;
+
+    DMF_ModuleLock(DmfModule);
+
+    allCacheable = TRUE;
+    for (accessOffset = 0; accessOffset < BufferLength; accessOffset += runLength)
+    {
+        currentRegister = Register + accessOffset;
+        range = I2cTarget_RegisterCacheRunGet(moduleContext,
+                                              currentRegister,
+                                              endRegister,
+                                              &runLength);
+        if (NULL == range)
+        {
+            allCacheable = FALSE;
+        }
+        else if (I2cTarget_RegisterType_ReadOnly == range->RegisterType)
+        {
+            ntStatus = STATUS_ACCESS_DENIED;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Write to read-only register 0x%X", currentRegister);
+            goto Exit;
+        }
+    }
+
+    if (allCacheable &&
+        moduleConfig->RegisterCacheWriteBack)
+    {
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = I2cTarget_SpbWrite(moduleContext->I2cTarget,
+                                      Address,
+                                      AddressLength,
+                                      Buffer,
+                                      BufferLength,
+                                      moduleConfig->WriteTimeoutMs);
+    }
+
+    for (accessOffset = 0; accessOffset < BufferLength; accessOffset += runLength)
+    {
+        currentRegister = Register + accessOffset;
+        range = I2cTarget_RegisterCacheRunGet(moduleContext,
+                                              currentRegister,
+                                              endRegister,
+                                              &runLength);
+        if (range != NULL)
+        {
+            rangeOffset = currentRegister - range->FirstRegister;
+            for (registerIndex = 0; registerIndex < runLength; registerIndex++)
+            {
+                state = &range->States[rangeOffset + registerIndex];
+                if (! NT_SUCCESS(ntStatus))
+                {
+                    // The device's value is unknown. A pending write-back value is kept.
+                    //
+                    *state &= ~I2CTARGET_REGISTER_STATE_VALID;
+                    continue;
+                }
+                range->Values[rangeOffset + registerIndex] = Buffer[accessOffset + registerIndex];
+                *state |= (I2CTARGET_REGISTER_STATE_VALID | I2CTARGET_REGISTER_STATE_WRITTEN);
+                if (allCacheable &&
+                    moduleConfig->RegisterCacheWriteBack)
+                {
+                    *state |= I2CTARGET_REGISTER_STATE_DIRTY;
+                }
+                else
+                {
+                    *state &= ~I2CTARGET_REGISTER_STATE_DIRTY;
+                }
+            }
+        }
+    }
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+I2cTarget_RegisterCacheDirtyWrite(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Write every run of dirty registers to the device using one bus write per run.
+    Caller holds the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS if all dirty registers were written.
+    Otherwise the status of the first write that failed. Registers that were not
+    written stay dirty.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    NTSTATUS ntStatusWrite;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    UCHAR address[sizeof(ULONG)];
+    ULONG rangeIndex;
+    ULONG runStart;
+    ULONG runEnd;
+    ULONG registerIndex;
+    ULONG byteIndex;
+    ULONG dirtyRegister;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+
+    for (rangeIndex = 0; rangeIndex < moduleContext->NumberOfRegisterCacheRanges; rangeIndex++)
+    {
+        range = &moduleContext->RegisterCacheRanges[rangeIndex];
+        runStart = 0;
+        while (runStart < range->NumberOfRegisters)
+        {
+            if (! (range->States[runStart] & I2CTARGET_REGISTER_STATE_DIRTY))
+            {
+                runStart++;
+                continue;
+            }
+            runEnd = runStart + 1;
+            while ((runEnd < range->NumberOfRegisters) &&
+                   (range->States[runEnd] & I2CTARGET_REGISTER_STATE_DIRTY))
+            {
+                runEnd++;
+            }
+
+            dirtyRegister = range->FirstRegister + runStart;
+            for (byteIndex = 0; byteIndex < moduleContext->RegisterAddressLength; byteIndex++)
+            {
+                address[byteIndex] = (UCHAR)(dirtyRegister >> ((moduleContext->RegisterAddressLength - 1 - byteIndex) * 8));
+            }
+
+            ntStatusWrite = I2cTarget_SpbWrite(moduleContext->I2cTarget,
+                                               address,
+                                               moduleContext->RegisterAddressLength,
+                                               &range->Values[runStart],
+                                               runEnd - runStart,
+                                               moduleConfig->WriteTimeoutMs);
+            if (NT_SUCCESS(ntStatusWrite))
+            {
+                for (registerIndex = runStart; registerIndex < runEnd; registerIndex++)
+                {
+                    range->States[registerIndex] &= ~I2CTARGET_REGISTER_STATE_DIRTY;
+                    range->States[registerIndex] |= I2CTARGET_REGISTER_STATE_VALID;
+                }
+            }
+            else if (NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Write of registers 0x%X-0x%X fails: ntStatus=%!STATUS!", dirtyRegister, dirtyRegister + (runEnd - runStart) - 1, ntStatusWrite);
+                ntStatus = ntStatusWrite;
+            }
+
+            runStart = runEnd;
+        }
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+I2cTarget_RegisterCacheRestore(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Write every register the Client has written back to the device after it enters D0.
+    Registers the Client has not written are restored to their cached values by the
+    device itself, so they are not read again.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    ULONG rangeIndex;
+    ULONG registerIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    for (rangeIndex = 0; rangeIndex < moduleContext->NumberOfRegisterCacheRanges; rangeIndex++)
+    {
+        range = &moduleContext->RegisterCacheRanges[rangeIndex];
+        for (registerIndex = 0; registerIndex < range->NumberOfRegisters; registerIndex++)
+        {
+            if (range->States[registerIndex] & I2CTARGET_REGISTER_STATE_WRITTEN)
+            {
+                range->States[registerIndex] |= I2CTARGET_REGISTER_STATE_DIRTY;
+            }
+        }
+    }
+
+    ntStatus = I2cTarget_RegisterCacheDirtyWrite(DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        // Registers that failed stay dirty and are written by the next sync.
+        //
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "I2cTarget_RegisterCacheDirtyWrite fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+}
+#pragma code_seg()
+
+// The Client's completion callback of a batch submitted by DMF_I2cTarget_TransactionsSubmit().
+//
+typedef struct
+{
+    EVT_DMF_I2cTarget_TransactionsComplete* EvtI2cTargetTransactionsComplete;
+    VOID* ClientContext;
+} I2CTARGET_TRANSACTIONS_CONTEXT;
+
+EVT_DMF_SpbTarget_TransactionsComplete I2cTarget_TransactionsComplete;
+
+_Function_class_(EVT_DMF_SpbTarget_TransactionsComplete)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+I2cTarget_TransactionsComplete(
+    _In_ DMFMODULE DmfModule,
+    _In_ SpbTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_opt_ VOID* ClientContext,
+    _In_ NTSTATUS NtStatus
+    )
+/*++
+
+Routine Description:
+
+    Called by the Child SpbTarget when a batch submitted by DMF_I2cTarget_TransactionsSubmit()
+    completes. Passes the completion to the Client with this Module's handle.
+
+Arguments:
+
+    DmfModule - The Child SpbTarget Module's handle.
+    Transactions - The Client's transactions.
+    NumberOfTransactions - Number of entries in Transactions.
+    ClientContext - The WDFMEMORY that holds the Client's callback and context.
+    NtStatus - Completion status of the batch.
+
+Return Value:
+
+    None
+
+--*/
+{
+    WDFMEMORY memory;
+    I2CTARGET_TRANSACTIONS_CONTEXT* transactionsContext;
+    EVT_DMF_I2cTarget_TransactionsComplete* evtI2cTargetTransactionsComplete;
+    VOID* clientContext;
+
+    DmfAssert(ClientContext != NULL);
+    memory = (WDFMEMORY)ClientContext;
+    transactionsContext = (I2CTARGET_TRANSACTIONS_CONTEXT*)WdfMemoryGetBuffer(memory,
+                                                                              NULL);
+    evtI2cTargetTransactionsComplete = transactionsContext->EvtI2cTargetTransactionsComplete;
+    clientContext = transactionsContext->ClientContext;
+    WdfObjectDelete(memory);
+
+    evtI2cTargetTransactionsComplete(DMF_ParentModuleGet(DmfModule),
+                                     Transactions,
+                                     NumberOfTransactions,
+                                     clientContext,
+                                     NtStatus);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ChildModulesAdd)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_I2cTarget_ChildModulesAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfParentModuleAttributes,
+    _In_ PDMFMODULE_INIT DmfModuleInit
+    )
+/*++
+
+Routine Description:
+
+    Configure and add the required Child Modules to the given Parent Module.
+
+Arguments:
+
+    DmfModule - The given Parent Module.
+    DmfParentModuleAttributes - Pointer to the parent DMF_MODULE_ATTRIBUTES structure.
+    DmfModuleInit - Opaque structure to be passed to DMF_DmfModuleAdd.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_MODULE_ATTRIBUTES moduleAttributes;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    DMF_CONFIG_SpbTarget moduleConfigSpbTarget;
+
+    UNREFERENCED_PARAMETER(DmfParentModuleAttributes);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleConfig->TransactionsOutstandingMaximum > 0)
+    {
+        // SpbTarget
+        // ---------
+        // Sends batches of transactions through the IoTarget this Module opens.
+        //
+        DMF_CONFIG_SpbTarget_AND_ATTRIBUTES_INIT(&moduleConfigSpbTarget,
+                                                 &moduleAttributes);
+        moduleConfigSpbTarget.IoTargetSetByClient = TRUE;
+        moduleConfigSpbTarget.TransactionRegisterAddressLength = moduleConfig->RegisterAddressLength;
+        moduleConfigSpbTarget.TransactionsOutstandingMaximum = moduleConfig->TransactionsOutstandingMaximum;
+        moduleConfigSpbTarget.TransactionTimeoutMs = moduleConfig->TransactionTimeoutMs;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleSpbTarget);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_I2cTarget_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type I2cTarget.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    UNICODE_STRING resourcePathString;
+    WCHAR resourcePathBuffer[RESOURCE_HUB_PATH_SIZE];
+    WDFDEVICE device;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_IO_TARGET_OPEN_PARAMS openParams;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    if (! moduleContext->I2cConnectionAssigned)
+    {
+        // In some cases, the minimum number of resources is zero because the same driver
+        // is used on different platforms. In that case, this Module still loads and opens
+        // but it does nothing.
+        //
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "No I2C Resources Found");
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // The register cache is created on the first transition to D0 and kept after.
+    //
+    if ((moduleConfig->NumberOfRegisterRanges > 0) &&
+        (NULL == moduleContext->RegisterCacheMemory))
+    {
+        ntStatus = I2cTarget_RegisterCacheCreate(DmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "I2cTarget_RegisterCacheCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+
+    device = DMF_ParentDeviceGet(DmfModule);
+
+    RtlInitEmptyUnicodeString(&resourcePathString,
+                              resourcePathBuffer,
+                              sizeof(resourcePathBuffer));
+
+    ntStatus = RESOURCE_HUB_CREATE_PATH_FROM_ID(&resourcePathString,
+                                                moduleContext->I2cConnection.u.Connection.IdLowPart,
+                                                moduleContext->I2cConnection.u.Connection.IdHighPart);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RESOURCE_HUB_CREATE_PATH_FROM_ID fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+
+    ntStatus = WdfIoTargetCreate(device,
+                                 &objectAttributes,
+                                 &moduleContext->I2cTarget);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RESOURCE_HUB_CREATE_PATH_FROM_ID fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    WDF_IO_TARGET_OPEN_PARAMS_INIT_OPEN_BY_NAME(&openParams,
+                                                &resourcePathString,
+                                                FILE_GENERIC_READ | FILE_GENERIC_WRITE);
+
+    //  Open the IoTarget for I/O operation.
+    //
+    ntStatus = WdfIoTargetOpen(moduleContext->I2cTarget,
+                               &openParams);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        DmfAssert(NT_SUCCESS(ntStatus));
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfIoTargetOpen fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    if (moduleContext->DmfModuleSpbTarget != NULL)
+    {
+        DMF_SpbTarget_IoTargetSet(moduleContext->DmfModuleSpbTarget,
+                                  moduleContext->I2cTarget);
+    }
+
+    // Restore the registers the Client has written in case the device lost power.
+    //
+    if (moduleContext->NumberOfRegisterCacheRanges > 0)
+    {
+        I2cTarget_RegisterCacheRestore(DmfModule);
+    }
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_I2cTarget_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type I2cTarget.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_I2cTarget* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->I2cTarget != NULL)
+    {
+        // Batches in progress use the IoTarget.
+        //
+        if (moduleContext->DmfModuleSpbTarget != NULL)
+        {
+            DMF_SpbTarget_IoTargetClear(moduleContext->DmfModuleSpbTarget);
+        }
+        WdfIoTargetClose(moduleContext->I2cTarget);
+        WdfObjectDelete(moduleContext->I2cTarget);
+        moduleContext->I2cTarget = NULL;
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ResourcesAssign)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_I2cTarget_ResourcesAssign(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFCMRESLIST ResourcesRaw,
+    _In_ WDFCMRESLIST ResourcesTranslated
+    )
+/*++
+
+Routine Description:
+
+    Tells this Module instance what Resources are available. This Module then extracts
+    the needed Resources and uses them as needed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ResourcesRaw - WDF Resource Raw parameter that is passed to the given
+                   DMF Module callback.
+    ResourcesTranslated - WDF Resources Translated parameter that is passed to the given
+                          DMF Module callback.
+
+Return Value:
+
+    STATUS_SUCCESS.
+
+--*/
+{
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    ULONG i2cResourceCount;
+    ULONG resourceCount;
+    ULONG resourceIndex;
+    NTSTATUS ntStatus;
+    DMF_CONFIG_I2cTarget* moduleConfig;
+    BOOLEAN resourceAssigned;
+
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(ResourcesRaw);
+
+    DmfAssert(ResourcesRaw != NULL);
+    DmfAssert(ResourcesTranslated != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    // Number of valid resources.
+    //
+    i2cResourceCount = 0;
+    resourceAssigned = FALSE;
+
+    // Check the number of resources for the button device.
+    //
+    resourceCount = WdfCmResourceListGetCount(ResourcesTranslated);
+    if (resourceCount == 0)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "I2C resources not found");
+        ntStatus = STATUS_DEVICE_CONFIGURATION_ERROR;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    // Parse the resources.
+    //
+    for (resourceIndex = 0; resourceIndex < resourceCount && (! resourceAssigned); resourceIndex++)
+    {
+        PCM_PARTIAL_RESOURCE_DESCRIPTOR resource;
+
+        resource = WdfCmResourceListGetDescriptor(ResourcesTranslated, resourceIndex);
+        if (NULL == resource)
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No resources found");
+            goto Exit;
+        }
+
+        if (resource->Type == CmResourceTypeConnection)
+        {
+            if ((resource->u.Connection.Class == CM_RESOURCE_CONNECTION_CLASS_SERIAL) &&
+                (resource->u.Connection.Type == CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C))
+            {
+                if (moduleConfig->I2cResourceIndex == i2cResourceCount)
+                {
+                    moduleContext->ResourceIndex = i2cResourceCount;
+                    moduleContext->I2cConnection = *resource;
+                    moduleContext->I2cConnectionAssigned = TRUE;
+                    resourceAssigned = TRUE;
+                }
+                i2cResourceCount++;
+            }
+        }
+    }
+
+    //  Validate the configuration parameters.
+    //
+    if ((moduleConfig->I2cConnectionMandatory) &&
+        (0 == i2cResourceCount || (! resourceAssigned)))
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "I2C Resources not assigned");
+        ntStatus = STATUS_DEVICE_CONFIGURATION_ERROR;
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Public Calls by Client
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#pragma code_seg("PAGE")
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_I2cTarget_Create(
+    _In_ WDFDEVICE Device,
+    _In_ DMF_MODULE_ATTRIBUTES* DmfModuleAttributes,
+    _In_ WDF_OBJECT_ATTRIBUTES* ObjectAttributes,
+    _Out_ DMFMODULE* DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Create an instance of a DMF Module of type I2cTarget.
+
+Arguments:
+
+    Device - Client driver's WDFDEVICE object.
+    DmfModuleAttributes - Opaque structure that contains parameters DMF needs to initialize the Module.
+    ObjectAttributes - WDF object attributes for DMFMODULE.
+    DmfModule - Address of the location where the created DMFMODULE handle is returned.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_I2cTarget;
+    DMF_CALLBACKS_DMF dmfCallbacksDmf_I2cTarget;
+
+    PAGED_CODE();
+
+    DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_I2cTarget);
+    dmfCallbacksDmf_I2cTarget.ChildModulesAdd = DMF_I2cTarget_ChildModulesAdd;
+    dmfCallbacksDmf_I2cTarget.DeviceOpen = DMF_I2cTarget_Open;
+    dmfCallbacksDmf_I2cTarget.DeviceClose = DMF_I2cTarget_Close;
+    dmfCallbacksDmf_I2cTarget.DeviceResourcesAssign = DMF_I2cTarget_ResourcesAssign;
+
+    DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_I2cTarget,
+                                            I2cTarget,
+                                            DMF_CONTEXT_I2cTarget,
+                                            DMF_MODULE_OPTIONS_PASSIVE,
+                                            DMF_MODULE_OPEN_OPTION_OPEN_D0Entry);
+
+    dmfModuleDescriptor_I2cTarget.CallbacksDmf = &dmfCallbacksDmf_I2cTarget;
+
+    ntStatus = DMF_ModuleCreate(Device,
+                                DmfModuleAttributes,
+                                ObjectAttributes,
+                                &dmfModuleDescriptor_I2cTarget,
+                                DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
     }
 
 Exit:
@@ -962,6 +1898,7 @@ Return Value:
     NTSTATUS ntStatus;
     DMF_CONTEXT_I2cTarget* moduleContext;
     DMF_CONFIG_I2cTarget* moduleConfig;
+    ULONG registerAddress;
 
     PAGED_CODE();
 
@@ -969,6 +1906,21 @@ Return Value:
 
     moduleConfig = DMF_CONFIG_GET(DmfModule);
 
+    if (I2cTarget_RegisterAddressDecode(moduleContext,
+                                        Address,
+                                        AddressLength,
+                                        BufferLength,
+                                        &registerAddress))
+    {
+        ntStatus = I2cTarget_RegisterCacheRead(DmfModule,
+                                               Address,
+                                               AddressLength,
+                                               registerAddress,
+                                               (UCHAR*)Buffer,
+                                               BufferLength);
+        goto Exit;
+    }
+
     ntStatus = I2cTarget_SpbRead(moduleContext->I2cTarget,
                                  Address,
                                  AddressLength,
@@ -977,6 +1929,8 @@ Return Value:
                                  moduleConfig->ReadDelayUs,
                                  moduleConfig->ReadTimeoutMs);
 
+Exit:
+
     return ntStatus;
 }
 #pragma code_seg()
@@ -1015,6 +1969,7 @@ Return Value:
     NTSTATUS ntStatus;
     DMF_CONTEXT_I2cTarget* moduleContext;
     DMF_CONFIG_I2cTarget* moduleConfig;
+    ULONG registerAddress;
 
     PAGED_CODE();
 
@@ -1022,6 +1977,21 @@ Return Value:
 
     moduleConfig = DMF_CONFIG_GET(DmfModule);
 
+    if (I2cTarget_RegisterAddressDecode(moduleContext,
+                                        Address,
+                                        AddressLength,
+                                        BufferLength,
+                                        &registerAddress))
+    {
+        ntStatus = I2cTarget_RegisterCacheWrite(DmfModule,
+                                                Address,
+                                                AddressLength,
+                                                registerAddress,
+                                                (UCHAR*)Buffer,
+                                                BufferLength);
+        goto Exit;
+    }
+
     ntStatus = I2cTarget_SpbWrite(moduleContext->I2cTarget,
                                   Address,
                                   AddressLength,
@@ -1029,6 +1999,8 @@ Return Value:
                                   BufferLength,
                                   moduleConfig->WriteTimeoutMs);
 
+Exit:
+
     return ntStatus;
 }
 #pragma code_seg()
@@ -1170,5 +2142,222 @@ Return Value:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_I2cTarget_RegisterCacheInvalidate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Discard the cached value of every register so that the next read of each register
+    accesses the bus. For example, Client calls this Method after it resets the device.
+    Values written in write-back mode that have not been written to the device are kept.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    I2CTARGET_REGISTER_CACHE_RANGE* range;
+    ULONG rangeIndex;
+    ULONG registerIndex;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 I2cTarget);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    for (rangeIndex = 0; rangeIndex < moduleContext->NumberOfRegisterCacheRanges; rangeIndex++)
+    {
+        range = &moduleContext->RegisterCacheRanges[rangeIndex];
+        for (registerIndex = 0; registerIndex < range->NumberOfRegisters; registerIndex++)
+        {
+            if (! (range->States[registerIndex] & I2CTARGET_REGISTER_STATE_DIRTY))
+            {
+                range->States[registerIndex] &= ~I2CTARGET_REGISTER_STATE_VALID;
+            }
+        }
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_I2cTarget_RegisterCacheSync(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Write all the registers written in write-back mode that have not been written to
+    the device yet. Each run of adjacent dirty registers is written in a single transfer.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 I2cTarget);
+
+    DMF_ModuleLock(DmfModule);
+
+    ntStatus = I2cTarget_RegisterCacheDirtyWrite(DmfModule);
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_I2cTarget_TransactionsSubmit(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(NumberOfTransactions) I2cTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_ EVT_DMF_I2cTarget_TransactionsComplete* EvtI2cTargetTransactionsComplete,
+    _In_opt_ VOID* ClientContext
+    )
+/*++
+
+Routine Description:
+
+    Submit a batch of register transactions to be performed asynchronously. The batch is
+    sent through the Child SpbTarget so adjacent register reads are coalesced and up to
+    TransactionsOutstandingMaximum SPB requests are outstanding at a time.
+    NOTE: These transactions always use the bus. They do not read or update the register cache.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Transactions - The Client's transactions. Must remain valid until the batch completes.
+    NumberOfTransactions - Number of entries in Transactions.
+    EvtI2cTargetTransactionsComplete - Called with this Module's handle once all the
+                                       transactions have completed.
+    ClientContext - Passed to EvtI2cTargetTransactionsComplete.
+
+Return Value:
+
+    STATUS_SUCCESS if the batch was accepted. In that case EvtI2cTargetTransactionsComplete
+    is always called.
+    Other NTSTATUS if the batch was not accepted. In that case EvtI2cTargetTransactionsComplete
+    is not called.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_I2cTarget* moduleContext;
+    WDF_OBJECT_ATTRIBUTES memoryAttributes;
+    WDFMEMORY memory;
+    I2CTARGET_TRANSACTIONS_CONTEXT* transactionsContext;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 I2cTarget);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    memory = NULL;
+
+    if (NULL == moduleContext->DmfModuleSpbTarget)
+    {
+        // The Client must set TransactionsOutstandingMaximum to use this Method.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    if (NULL == EvtI2cTargetTransactionsComplete)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&memoryAttributes);
+    memoryAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&memoryAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(I2CTARGET_TRANSACTIONS_CONTEXT),
+                               &memory,
+                               (VOID**)&transactionsContext);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        memory = NULL;
+        goto Exit;
+    }
+
+    transactionsContext->EvtI2cTargetTransactionsComplete = EvtI2cTargetTransactionsComplete;
+    transactionsContext->ClientContext = ClientContext;
+
+    ntStatus = DMF_SpbTarget_TransactionsSubmit(moduleContext->DmfModuleSpbTarget,
+                                                Transactions,
+                                                NumberOfTransactions,
+                                                I2cTarget_TransactionsComplete,
+                                                memory);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_SpbTarget_TransactionsSubmit fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // The memory is deleted when the batch completes.
+    //
+    memory = NULL;
+
+Exit:
+
+    if (memory != NULL)
+    {
+        WdfObjectDelete(memory);
+        memory = NULL;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
 // eof: Dmf_I2cTarget.c
 //
@@ -20,6 +20,43 @@ Environment:
 
 #pragma once
 
+// Indicates how the register cache treats a range of registers.
+//
+typedef enum
+{
+    // Always accessed on the bus. This is the default for registers that are not declared.
+    //
+    I2cTarget_RegisterType_Volatile = 0,
+    // Read from the bus once, then read from the cache. Writes update the cache.
+    //
+    I2cTarget_RegisterType_Cacheable,
+    // Read from the bus once, then read from the cache. Writes fail.
+    //
+    I2cTarget_RegisterType_ReadOnly,
+    I2cTarget_RegisterType_Maximum
+} I2cTarget_RegisterType;
+
+// Declares the type of a range of byte wide registers.
+//
+typedef struct
+{
+    // First register of the range.
+    //
+    ULONG FirstRegister;
+    // Number of registers in the range.
+    //
+    ULONG NumberOfRegisters;
+    // How the register cache treats registers in the range.
+    //
+    I2cTarget_RegisterType RegisterType;
+} I2cTarget_RegisterRange;
+
+// These definitions are so that names match from Client's point of view.
+// DMF_I2cTarget_TransactionsSubmit() uses the transaction engine of DMF_SpbTarget.
+//
+typedef SpbTarget_Transaction I2cTarget_Transaction;
+typedef EVT_DMF_SpbTarget_TransactionsComplete EVT_DMF_I2cTarget_TransactionsComplete;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -39,6 +76,29 @@ typedef struct
     // Time units(ms) to wait for SPB Write operation to complete.
     //
     ULONGLONG WriteTimeoutMs;
+    // Optional register cache used by DMF_I2cTarget_AddressRead/AddressWrite.
+    // Table of register ranges that are cacheable or read-only. It is copied by the Module.
+    //
+    I2cTarget_RegisterRange* RegisterRanges;
+    ULONG NumberOfRegisterRanges;
+    // Length (1-4) of the addresses to which the register cache applies. Addresses
+    // are most significant byte first. Zero means 1.
+    // Also the length of the register addresses sent by DMF_I2cTarget_TransactionsSubmit().
+    //
+    ULONG RegisterAddressLength;
+    // FALSE: Writes to cacheable registers are sent to the bus immediately.
+    // TRUE: Writes to cacheable registers are sent by DMF_I2cTarget_RegisterCacheSync()
+    //       or when the device enters D0.
+    //
+    BOOLEAN RegisterCacheWriteBack;
+    // Maximum number of SPB requests DMF_I2cTarget_TransactionsSubmit() keeps outstanding
+    // at the controller. Zero means DMF_I2cTarget_TransactionsSubmit() is not used.
+    //
+    ULONG TransactionsOutstandingMaximum;
+    // Timeout in milliseconds of each SPB request sent by DMF_I2cTarget_TransactionsSubmit().
+    // Zero means no timeout.
+    //
+    ULONG TransactionTimeoutMs;
 } DMF_CONFIG_I2cTarget;
 
 // This macro declares the following functions:
@@ -100,5 +160,29 @@ DMF_I2cTarget_IsResourceAssigned(
     _Out_opt_ BOOLEAN* I2cConnectionAssigned
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_I2cTarget_RegisterCacheInvalidate(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_I2cTarget_RegisterCacheSync(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_I2cTarget_TransactionsSubmit(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(NumberOfTransactions) I2cTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_ EVT_DMF_I2cTarget_TransactionsComplete* EvtI2cTargetTransactionsComplete,
+    _In_opt_ VOID* ClientContext
+    );
+
 // eof: Dmf_I2cTarget.h
 //
@@ -137,6 +137,10 @@ typedef struct _DMF_INTERFACE_TRANSPORT_ComponentFirmwareUpdate_BIND_DATA
     // Payload buffer fill alignment this transport needs.
     //
     UINT TransportPayloadFillAlignment;
+    // Maximum number of payload chunks this transport can have sent but not yet responded to.
+    // 0 or 1 means the transport only supports stop-and-wait payload transfer.
+    //
+    ULONG TransportMaximumOutstandingPayloads;
 } DMF_INTERFACE_TRANSPORT_ComponentFirmwareUpdate_BIND_DATA;
 
 // Declaration Time Data.
@@ -50,6 +50,41 @@ typedef struct
     // List used to store events.
     //
     DMFMODULE DmfModuleBufferQueue;
+
+    // Batched delivery only: Delays completion of pending requests so that
+    // bursts of events are returned in a single request.
+    //
+    WDFTIMER CoalescingTimer;
+
+    // Indicates that CoalescingTimer has been started and has not yet expired.
+    // Protected by the Module lock.
+    //
+    BOOLEAN CoalescingTimerPending;
+
+#if !defined(DMF_USER_MODE)
+    // Shared ring only: The pages shared with the application and their
+    // address in system space.
+    //
+    PMDL RingMdl;
+    NOTIFY_USER_RING_HEADER* Ring;
+    size_t RingSize;
+
+    // Position of the next record written by the driver. Unlike the rest
+    // of the ring state, it is not visible to the application.
+    //
+    LONG RingWriteIndex;
+
+    // Set while an application has the ring mapped. Only one mapping exists at a time.
+    //
+    LONG RingMapped;
+
+    // The mapping of the ring in the process that called DMF_NotifyUserWithRequest_RingMap
+    // and the file object the mapping belongs to.
+    //
+    VOID* RingUserAddress;
+    PEPROCESS RingProcess;
+    WDFFILEOBJECT RingFileObject;
+#endif // !defined(DMF_USER_MODE)
 } DMF_CONTEXT_NotifyUserWithRequest;
 
 // This macro declares the following function:
@@ -226,15 +261,423 @@ Return Value:
                                   EventCallbackContext,
                                   NtStatus);
         }
-    }
-    else
-    {
-        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Cannot find request ntStatus:%!STATUS!", ntStatus);
+    }
+    else
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Cannot find request ntStatus:%!STATUS!", ntStatus);
+    }
+
+    FuncExit(DMF_TRACE, "numberOfRequestsCompleted=%d", numberOfRequestsCompleted);
+
+    return numberOfRequestsCompleted;
+}
+#pragma code_seg()
+
+#if !defined(DMF_USER_MODE)
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+NotifyUserWithRequest_RingCreate(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Allocate the pages of the ring shared with the application, map them into system space
+    and initialize the ring.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    DMF_CONFIG_NotifyUserWithRequest* moduleConfig;
+    PHYSICAL_ADDRESS lowAddress;
+    PHYSICAL_ADDRESS highAddress;
+    PHYSICAL_ADDRESS skipBytes;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    // Whole pages are allocated so that no other data is visible to the application.
+    //
+    moduleContext->RingSize = ROUND_TO_PAGES(NotifyUserRing_SizeGet((ULONG)moduleConfig->MaximumNumberOfPendingDataBuffers,
+                                                                    (ULONG)moduleConfig->SizeOfDataBuffer));
+
+    lowAddress.QuadPart = 0;
+    highAddress.QuadPart = MAXLONGLONG;
+    skipBytes.QuadPart = 0;
+    moduleContext->RingMdl = MmAllocatePagesForMdlEx(lowAddress,
+                                                     highAddress,
+                                                     skipBytes,
+                                                     moduleContext->RingSize,
+                                                     MmCached,
+                                                     MM_ALLOCATE_FULLY_REQUIRED);
+    if (NULL == moduleContext->RingMdl)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "MmAllocatePagesForMdlEx fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    moduleContext->Ring = (NOTIFY_USER_RING_HEADER*)MmGetSystemAddressForMdlSafe(moduleContext->RingMdl,
+                                                                                 NormalPagePriority | MdlMappingNoExecute);
+    if (NULL == moduleContext->Ring)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "MmGetSystemAddressForMdlSafe fails: ntStatus=%!STATUS!", ntStatus);
+        MmFreePagesFromMdl(moduleContext->RingMdl);
+        ExFreePool(moduleContext->RingMdl);
+        moduleContext->RingMdl = NULL;
+        goto Exit;
+    }
+
+    RtlZeroMemory(moduleContext->Ring,
+                  moduleContext->RingSize);
+    NotifyUserRing_Initialize(moduleContext->Ring,
+                              (ULONG)moduleConfig->MaximumNumberOfPendingDataBuffers,
+                              (ULONG)moduleConfig->SizeOfDataBuffer);
+    moduleContext->RingWriteIndex = 0;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+NotifyUserWithRequest_RingUnmap(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove the mapping of the ring from the application that mapped it, if any.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    VOID* userAddress;
+    KAPC_STATE apcState;
+    BOOLEAN attached;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Only one caller removes the mapping.
+    //
+    userAddress = InterlockedExchangePointer(&moduleContext->RingUserAddress,
+                                             NULL);
+    if (NULL == userAddress)
+    {
+        goto Exit;
+    }
+
+    // The mapping can only be removed in the context of the process that owns it.
+    //
+    attached = FALSE;
+    if (PsGetCurrentProcess() != moduleContext->RingProcess)
+    {
+        KeStackAttachProcess(moduleContext->RingProcess,
+                             &apcState);
+        attached = TRUE;
+    }
+
+    MmUnmapLockedPages(userAddress,
+                       moduleContext->RingMdl);
+
+    if (attached)
+    {
+        KeUnstackDetachProcess(&apcState);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Ring unmapped from process=0x%p", moduleContext->RingProcess);
+
+    ObDereferenceObject(moduleContext->RingProcess);
+    moduleContext->RingProcess = NULL;
+    moduleContext->RingFileObject = NULL;
+
+    InterlockedExchange(&moduleContext->RingMapped,
+                        0);
+
+Exit:
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+NotifyUserWithRequest_RingDestroy(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove all mappings of the ring and free its pages.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (moduleContext->RingMdl != NULL)
+    {
+        NotifyUserWithRequest_RingUnmap(DmfModule);
+
+        MmUnmapLockedPages(moduleContext->Ring,
+                           moduleContext->RingMdl);
+        moduleContext->Ring = NULL;
+
+        MmFreePagesFromMdl(moduleContext->RingMdl);
+        ExFreePool(moduleContext->RingMdl);
+        moduleContext->RingMdl = NULL;
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+NotifyUserWithRequest_RingDoorbellComplete(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    If the application has a record to read in the ring, complete a pending doorbell request
+    so that the application wakes up and reads the ring.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    DMF_CONFIG_NotifyUserWithRequest* moduleConfig;
+    ULONG numberOfRequestsCompleted;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    // The lock makes the check and the completion atomic with respect to a doorbell request
+    // that is being added. Either the request sees the record or the writer sees the request.
+    //
+    DMF_ModuleLock(DmfModule);
+
+    numberOfRequestsCompleted = 0;
+    if (NotifyUserRing_RecordAvailable(moduleContext->Ring,
+                                       (ULONG)moduleConfig->MaximumNumberOfPendingDataBuffers,
+                                       (ULONG)moduleConfig->SizeOfDataBuffer))
+    {
+        numberOfRequestsCompleted = NotifyUserWithRequest_EventRequestReturn(DmfModule,
+                                                                             NULL,
+                                                                             0,
+                                                                             STATUS_SUCCESS);
+    }
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "numberOfRequestsCompleted=%d", numberOfRequestsCompleted);
+
+    return STATUS_SUCCESS;
+}
+#pragma code_seg()
+
+#endif // !defined(DMF_USER_MODE)
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+NotifyUserWithRequest_CompleteRequestWithBatchedEventData(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    While both pending requests and User-mode events are available, dequeue a request and
+    complete it with as many User-mode events as fit in its output buffer. The output buffer
+    starts with NOTIFY_USER_BATCH_HEADER which is followed by the event data.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFREQUEST request;
+    VOID* clientBuffer;
+    VOID* clientBufferContext;
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    DMF_CONFIG_NotifyUserWithRequest* moduleConfig;
+    USEREVENT_ENTRY* userEventEntry;
+    NOTIFY_USER_BATCH_HEADER* batchHeader;
+    UCHAR* record;
+    size_t outputBufferSize;
+    size_t sizeOfRecord;
+    ULONG numberOfRecordsThatFit;
+    ULONG numberOfRecords;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    ntStatus = STATUS_SUCCESS;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    sizeOfRecord = (size_t)moduleConfig->SizeOfDataBuffer;
+    DmfAssert(sizeOfRecord > 0);
+
+    DMF_ModuleLock(DmfModule);
+
+    while (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) > 0)
+    {
+        ntStatus = WdfIoQueueRetrieveNextRequest(moduleContext->EventRequestQueue,
+                                                 &request);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "WdfIoQueueRetrieveNextRequest fails: ntStatus=%!STATUS!", ntStatus);
+            // Correct the error status. Events remain queued until the next request arrives.
+            //
+            ntStatus = STATUS_SUCCESS;
+            break;
+        }
+
+        // NOTE: The decrement must happen before the request returns because
+        //       the caller may immediately enqueue another request.
+        //
+        DmfAssert(moduleContext->EventCountHeld > 0);
+        InterlockedDecrement(&moduleContext->EventCountHeld);
+
+        ntStatus = WdfRequestRetrieveOutputBuffer(request,
+                                                  sizeof(NOTIFY_USER_BATCH_HEADER) + sizeOfRecord,
+                                                  (VOID**)&batchHeader,
+                                                  &outputBufferSize);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // The request cannot hold even a single event. Return it with the error and leave
+            // the events for the next request.
+            //
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRequestRetrieveOutputBuffer fails: request=0x%p ntStatus=%!STATUS!", request, ntStatus);
+            WdfRequestComplete(request,
+                               ntStatus);
+            ntStatus = STATUS_SUCCESS;
+            continue;
+        }
+
+        numberOfRecordsThatFit = (ULONG)((outputBufferSize - sizeof(NOTIFY_USER_BATCH_HEADER)) / sizeOfRecord);
+        record = (UCHAR*)(batchHeader + 1);
+        numberOfRecords = 0;
+
+        while (numberOfRecords < numberOfRecordsThatFit)
+        {
+            // Events are dequeued oldest first so that the caller receives them in order.
+            //
+            ntStatus = DMF_BufferQueue_Dequeue(moduleContext->DmfModuleBufferQueue,
+                                               &clientBuffer,
+                                               &clientBufferContext);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                ntStatus = STATUS_SUCCESS;
+                break;
+            }
+
+            userEventEntry = (USEREVENT_ENTRY*)clientBuffer;
+            RtlCopyMemory(record,
+                          userEventEntry->EventCallbackContext,
+                          sizeOfRecord);
+
+            DMF_BufferQueue_Reuse(moduleContext->DmfModuleBufferQueue,
+                                  clientBuffer);
+
+            record += sizeOfRecord;
+            numberOfRecords++;
+        }
+
+        batchHeader->NumberOfRecords = numberOfRecords;
+        batchHeader->SizeOfRecord = (ULONG)sizeOfRecord;
+
+        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Complete request=0x%p numberOfRecords=%d", request, numberOfRecords);
+        WdfRequestCompleteWithInformation(request,
+                                          STATUS_SUCCESS,
+                                          sizeof(NOTIFY_USER_BATCH_HEADER) + (numberOfRecords * sizeOfRecord));
     }
 
-    FuncExit(DMF_TRACE, "numberOfRequestsCompleted=%d", numberOfRequestsCompleted);
+    DMF_ModuleUnlock(DmfModule);
 
-    return numberOfRequestsCompleted;
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
 }
 #pragma code_seg()
 
@@ -280,6 +723,21 @@ Return Value:
     clientBufferExtracted = FALSE;
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+#if !defined(DMF_USER_MODE)
+    if (moduleConfig->SharedRingEnabled)
+    {
+        ntStatus = NotifyUserWithRequest_RingDoorbellComplete(DmfModule);
+        goto ExitNoLock;
+    }
+#endif // !defined(DMF_USER_MODE)
+
+    if (moduleConfig->BatchedDeliveryEnabled)
+    {
+        ntStatus = NotifyUserWithRequest_CompleteRequestWithBatchedEventData(DmfModule);
+        goto ExitNoLock;
+    }
 
     DMF_ModuleLock(DmfModule);
 
@@ -335,7 +793,6 @@ Return Value:
         //
         ntStatus = STATUS_INTERNAL_ERROR;
         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "NotifyUserWithRequest_EventRequestReturn fails to complete request.");
-        moduleConfig = DMF_CONFIG_GET(DmfModule);
 #if defined(DMF_USER_MODE)
         DMF_Utility_LogEmitString(DmfModule,
                                   DmfLogDataSeverity_Informational,
@@ -355,6 +812,8 @@ Exit:
 
     DMF_ModuleUnlock(DmfModule);
 
+ExitNoLock:
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -362,11 +821,114 @@ Exit:
 }
 #pragma code_seg()
 
+EVT_WDF_TIMER NotifyUserWithRequest_CoalescingTimerHandler;
+
+VOID
+NotifyUserWithRequest_CoalescingTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Completes pending requests with all the User-mode events stored since the timer was started.
+
+Arguments:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    NTSTATUS ntStatus;
+
+    // NOTE: Timer handler is set to run in PASSIVE_LEVEL.
+    //
+    #pragma warning(suppress:28118)
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    DmfAssert(dmfModule != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    // Events stored from this point on start a new coalescing period.
+    //
+    DMF_ModuleLock(dmfModule);
+    moduleContext->CoalescingTimerPending = FALSE;
+    DMF_ModuleUnlock(dmfModule);
+
+    ntStatus = NotifyUserWithRequest_CompleteRequestWithBatchedEventData(dmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "NotifyUserWithRequest_CompleteRequestWithBatchedEventData fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+#if !defined(DMF_USER_MODE)
+
+#pragma code_seg("PAGE")
+_Function_class_(DMF_ModuleFileCleanup)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+BOOLEAN
+DMF_NotifyUserWithRequest_FileCleanup(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFFILEOBJECT FileObject
+    )
+/*++
+
+Routine Description:
+
+    Remove the mapping of the ring when the application that mapped it closes its handle.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    FileObject - The file object that is being cleaned up.
+
+Return Value:
+
+    FALSE so that other Modules also see the file object.
+
+--*/
+{
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if ((moduleContext->RingFileObject != NULL) &&
+        (moduleContext->RingFileObject == FileObject))
+    {
+        NotifyUserWithRequest_RingUnmap(DmfModule);
+    }
+
+    FuncExit(DMF_TRACE, "returnValue=%d", FALSE);
+
+    return FALSE;
+}
+#pragma code_seg()
+
+#endif // !defined(DMF_USER_MODE)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Module Callbacks
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -399,18 +961,58 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    DMF_CONFIG_NotifyUserWithRequest* moduleConfig;
     WDF_IO_QUEUE_CONFIG ioQueueConfig;
     WDFDEVICE device;
     WDF_OBJECT_ATTRIBUTES queueAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES timerAttributes;
 
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
 
     device = DMF_ParentDeviceGet(DmfModule);
 
+    if (moduleConfig->BatchedDeliveryEnabled &&
+        (moduleConfig->SizeOfDataBuffer <= 0))
+    {
+        // Batched delivery returns the stored data entries themselves.
+        //
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Batched delivery requires SizeOfDataBuffer: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    if (moduleConfig->SharedRingEnabled)
+    {
+#if defined(DMF_USER_MODE)
+        // Pages cannot be shared with an application from User-mode.
+        //
+        ntStatus = STATUS_NOT_SUPPORTED;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Shared ring is not supported in User-mode: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+#else
+        // The ring stores the data entries themselves and its positions wrap at 2^32 so
+        // the number of records must be a power of two.
+        //
+        if ((moduleConfig->SizeOfDataBuffer <= 0) ||
+            (moduleConfig->MaximumNumberOfPendingDataBuffers <= 0) ||
+            ((moduleConfig->MaximumNumberOfPendingDataBuffers & (moduleConfig->MaximumNumberOfPendingDataBuffers - 1)) != 0) ||
+            moduleConfig->BatchedDeliveryEnabled)
+        {
+            DmfAssert(FALSE);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid shared ring geometry: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+#endif // defined(DMF_USER_MODE)
+    }
+
     // This queue will hold requests that are asynchronously completed.
     // 
     WDF_IO_QUEUE_CONFIG_INIT(&ioQueueConfig,
@@ -439,6 +1041,45 @@ Return Value:
     DMF_ModuleInContextSave(moduleContext->EventRequestQueue,
                             DmfModule);
 
+    if (moduleConfig->BatchedDeliveryEnabled &&
+        (moduleConfig->BatchCoalescingDelayMilliseconds > 0))
+    {
+        // Create the timer that delays completion of pending requests.
+        //
+        WDF_TIMER_CONFIG_INIT(&timerConfig,
+                              NotifyUserWithRequest_CoalescingTimerHandler);
+        timerConfig.AutomaticSerialization = FALSE;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+        timerAttributes.ParentObject = DmfModule;
+        timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+        ntStatus = WdfTimerCreate(&timerConfig,
+                                  &timerAttributes,
+                                  &moduleContext->CoalescingTimer);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            WdfObjectDelete(moduleContext->EventRequestQueue);
+            moduleContext->EventRequestQueue = NULL;
+            goto Exit;
+        }
+    }
+
+#if !defined(DMF_USER_MODE)
+    if (moduleConfig->SharedRingEnabled)
+    {
+        ntStatus = NotifyUserWithRequest_RingCreate(DmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "NotifyUserWithRequest_RingCreate fails: ntStatus=%!STATUS!", ntStatus);
+            WdfObjectDelete(moduleContext->EventRequestQueue);
+            moduleContext->EventRequestQueue = NULL;
+            goto Exit;
+        }
+    }
+#endif // !defined(DMF_USER_MODE)
+
 Exit:
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
@@ -477,6 +1118,17 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    if (moduleContext->CoalescingTimer != NULL)
+    {
+        // Wait for a running timer handler so that it does not use the queue after it is deleted.
+        //
+        WdfTimerStop(moduleContext->CoalescingTimer,
+                     TRUE);
+        WdfObjectDelete(moduleContext->CoalescingTimer);
+        moduleContext->CoalescingTimer = NULL;
+        moduleContext->CoalescingTimerPending = FALSE;
+    }
+
     // Flush any requests held by this object.
     //
     DMF_NotifyUserWithRequest_RequestReturnAll(DmfModule,
@@ -487,6 +1139,10 @@ Return Value:
     WdfObjectDelete(moduleContext->EventRequestQueue);
     moduleContext->EventRequestQueue = NULL;
 
+#if !defined(DMF_USER_MODE)
+    NotifyUserWithRequest_RingDestroy(DmfModule);
+#endif // !defined(DMF_USER_MODE)
+
     FuncExitVoid(DMF_TRACE);
 }
 
@@ -531,6 +1187,13 @@ Return Value:
     moduleConfig = DMF_CONFIG_GET(DmfModule);
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    if (moduleConfig->SharedRingEnabled)
+    {
+        // Data is written directly to the shared ring.
+        //
+        goto Exit;
+    }
+
     // BufferQueue
     // -----------
     //
@@ -555,6 +1218,8 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      &moduleContext->DmfModuleBufferQueue);
 
+Exit:
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -596,6 +1261,7 @@ Return Value:
     NTSTATUS ntStatus;
     DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_NotifyUserWithRequest;
     DMF_CALLBACKS_DMF dmfCallbacksDmf_NotifyUserWithRequest;
+    DMF_CALLBACKS_WDF dmfCallbacksWdf_NotifyUserWithRequest;
 
     PAGED_CODE();
 
@@ -606,6 +1272,11 @@ Return Value:
     dmfCallbacksDmf_NotifyUserWithRequest.DeviceOpen = DMF_NotifyUserWithRequest_Open;
     dmfCallbacksDmf_NotifyUserWithRequest.DeviceClose = DMF_NotifyUserWithRequest_Close;
 
+    DMF_CALLBACKS_WDF_INIT(&dmfCallbacksWdf_NotifyUserWithRequest);
+#if !defined(DMF_USER_MODE)
+    dmfCallbacksWdf_NotifyUserWithRequest.ModuleFileCleanup = DMF_NotifyUserWithRequest_FileCleanup;
+#endif // !defined(DMF_USER_MODE)
+
     DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_NotifyUserWithRequest,
                                             NotifyUserWithRequest,
                                             DMF_CONTEXT_NotifyUserWithRequest,
@@ -613,6 +1284,7 @@ Return Value:
                                             DMF_MODULE_OPEN_OPTION_OPEN_Create);
 
     dmfModuleDescriptor_NotifyUserWithRequest.CallbacksDmf = &dmfCallbacksDmf_NotifyUserWithRequest;
+    dmfModuleDescriptor_NotifyUserWithRequest.CallbacksWdf = &dmfCallbacksWdf_NotifyUserWithRequest;
 
     ntStatus = DMF_ModuleCreate(Device,
                                 DmfModuleAttributes,
@@ -688,6 +1360,39 @@ Return Value:
     DmfAssert(((EventCallbackContext != NULL) && moduleConfig->SizeOfDataBuffer > 0) ||
               (NULL == EventCallbackContext));
 
+#if !defined(DMF_USER_MODE)
+    if (moduleConfig->SharedRingEnabled)
+    {
+        BOOLEAN ringWasEmpty;
+
+        DmfAssert(EventCallbackContext != NULL);
+
+        // The ring is written without the Module lock. The lock is only taken when the
+        // application is waiting for this record.
+        //
+        if (! NotifyUserRing_Write(moduleContext->Ring,
+                                   (ULONG)moduleConfig->MaximumNumberOfPendingDataBuffers,
+                                   (ULONG)moduleConfig->SizeOfDataBuffer,
+                                   &moduleContext->RingWriteIndex,
+                                   EventCallbackContext,
+                                   &ringWasEmpty))
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Ring is full. Record is dropped.");
+            goto Exit;
+        }
+
+        if (ringWasEmpty)
+        {
+            ntStatus = NotifyUserWithRequest_RingDoorbellComplete(DmfModule);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "NotifyUserWithRequest_RingDoorbellComplete fails: ntStatus=%!STATUS!", ntStatus);
+            }
+        }
+        goto Exit;
+    }
+#endif // !defined(DMF_USER_MODE)
+
     DMF_ModuleLock(DmfModule);
     isLocked = TRUE;
 
@@ -740,6 +1445,23 @@ Return Value:
     DMF_BufferQueue_Enqueue(moduleContext->DmfModuleBufferQueue,
                             clientBuffer);
 
+    if (moduleContext->CoalescingTimer != NULL)
+    {
+        // Hold the event until the coalescing period ends unless stored events are
+        // about to be overwritten.
+        //
+        if (DMF_BufferQueue_Count(moduleContext->DmfModuleBufferQueue) < (ULONG)moduleConfig->MaximumNumberOfPendingDataBuffers)
+        {
+            if (! moduleContext->CoalescingTimerPending)
+            {
+                moduleContext->CoalescingTimerPending = TRUE;
+                WdfTimerStart(moduleContext->CoalescingTimer,
+                              WDF_REL_TIMEOUT_IN_MS(moduleConfig->BatchCoalescingDelayMilliseconds));
+            }
+            goto Exit;
+        }
+    }
+
     DMF_ModuleUnlock(DmfModule);
 
     isLocked = FALSE;
@@ -873,6 +1595,8 @@ Return Value:
 --*/
 {
     NTSTATUS ntStatus;
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    BOOLEAN coalescingTimerPending;
 
     PAGED_CODE();
 
@@ -881,6 +1605,8 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  NotifyUserWithRequest);
 
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
     ntStatus = DMF_ModuleReference(DmfModule);
     if (!NT_SUCCESS(ntStatus))
     {
@@ -898,6 +1624,19 @@ Return Value:
         goto Exit;
     }
 
+    if (moduleContext->CoalescingTimer != NULL)
+    {
+        // Events that are stored during a coalescing period are returned when it ends.
+        //
+        DMF_ModuleLock(DmfModule);
+        coalescingTimerPending = moduleContext->CoalescingTimerPending;
+        DMF_ModuleUnlock(DmfModule);
+        if (coalescingTimerPending)
+        {
+            goto Exit;
+        }
+    }
+
     // Complete request with user event.
     //
     ntStatus = NotifyUserWithRequest_CompleteRequestWithEventData(DmfModule);
@@ -1146,5 +1885,140 @@ Exit:
     return ntStatus;
 }
 
+#if !defined(DMF_USER_MODE)
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_NotifyUserWithRequest_RingMap(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFREQUEST Request,
+    _Out_ size_t* BytesWritten
+    )
+/*++
+
+Routine Description:
+
+    Map the shared ring into the process that sent the given request and write its address
+    to the request's output buffer as NOTIFY_USER_RING_MAP_OUTPUT. The mapping is removed when
+    the file object of the request is cleaned up. Only one mapping can exist at a time.
+    NOTE: This Method must be called in the context of the process that sent the request,
+          for example, from EvtIoInCallerContext.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Request - The request from the application. The Client completes it.
+    BytesWritten - Number of bytes written to the request's output buffer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_NotifyUserWithRequest* moduleContext;
+    NOTIFY_USER_RING_MAP_OUTPUT* mapOutput;
+    VOID* userAddress;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 NotifyUserWithRequest);
+
+    *BytesWritten = 0;
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = DMF_ModuleReference(DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_ModuleReference fails: ntStatus=%!STATUS!", ntStatus);
+        goto ExitNoDereference;
+    }
+
+    if ((NULL == moduleContext->Ring) ||
+        (WdfRequestGetRequestorMode(Request) != UserMode))
+    {
+        ntStatus = STATUS_INVALID_DEVICE_REQUEST;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Ring cannot be mapped: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    ntStatus = WdfRequestRetrieveOutputBuffer(Request,
+                                              sizeof(NOTIFY_USER_RING_MAP_OUTPUT),
+                                              (VOID**)&mapOutput,
+                                              NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRequestRetrieveOutputBuffer fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    if (InterlockedCompareExchange(&moduleContext->RingMapped,
+                                   1,
+                                   0) != 0)
+    {
+        // The ring has a single reader.
+        //
+        ntStatus = STATUS_SHARING_VIOLATION;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Ring is already mapped: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // This call raises an exception if the mapping into User-mode fails.
+    //
+    __try
+    {
+        userAddress = MmMapLockedPagesSpecifyCache(moduleContext->RingMdl,
+                                                   UserMode,
+                                                   MmCached,
+                                                   NULL,
+                                                   FALSE,
+                                                   NormalPagePriority | MdlMappingNoExecute);
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        userAddress = NULL;
+    }
+    if (NULL == userAddress)
+    {
+        InterlockedExchange(&moduleContext->RingMapped,
+                            0);
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "MmMapLockedPagesSpecifyCache fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    moduleContext->RingProcess = PsGetCurrentProcess();
+    ObReferenceObject(moduleContext->RingProcess);
+    moduleContext->RingFileObject = WdfRequestGetFileObject(Request);
+    InterlockedExchangePointer(&moduleContext->RingUserAddress,
+                               userAddress);
+
+    mapOutput->RingAddress = (ULONGLONG)(ULONG_PTR)userAddress;
+    mapOutput->RingSize = (ULONG)moduleContext->RingSize;
+    mapOutput->Reserved = 0;
+    *BytesWritten = sizeof(NOTIFY_USER_RING_MAP_OUTPUT);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Ring mapped at 0x%p in process=0x%p", userAddress, moduleContext->RingProcess);
+
+Exit:
+
+    DMF_ModuleDereference(DmfModule);
+
+ExitNoDereference:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#endif // !defined(DMF_USER_MODE)
+
 // eof: Dmf_NotifyUserWithRequest.c
 //
@@ -51,6 +51,21 @@ typedef struct
     // event logging from the Dmf_NotifyUserWithRequest Module.
     //
     PWSTR ClientDriverProviderName;
+    // If TRUE, each pending Request is completed with as many stored data entries as fit in
+    // its output buffer. The output buffer begins with NOTIFY_USER_BATCH_HEADER which is
+    // followed by the data entries.
+    //
+    BOOLEAN BatchedDeliveryEnabled;
+    // Batched delivery only. If not zero, pending Requests are completed this many milliseconds
+    // after the first data entry is stored so that bursts are returned in a single Request.
+    //
+    ULONG BatchCoalescingDelayMilliseconds;
+    // If TRUE, data is written to a ring shared with an application instead of being stored
+    // in the Module. MaximumNumberOfPendingDataBuffers (a power of two) is the number of records
+    // in the ring and SizeOfDataBuffer is the size of each record. Pending Requests are completed
+    // only when the ring goes from empty to not empty. Kernel-mode only.
+    //
+    BOOLEAN SharedRingEnabled;
 } DMF_CONFIG_NotifyUserWithRequest;
 
 // This macro declares the following functions:
@@ -115,5 +130,18 @@ DMF_NotifyUserWithRequest_RequestReturnEx(
     _In_ NTSTATUS NtStatus
     );
 
+#if !defined(DMF_USER_MODE)
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_NotifyUserWithRequest_RingMap(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFREQUEST Request,
+    _Out_ size_t* BytesWritten
+    );
+
+#endif // !defined(DMF_USER_MODE)
+
 // eof: Dmf_NotifyUserWithRequest.h
 //
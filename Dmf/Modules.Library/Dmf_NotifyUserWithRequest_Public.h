@@ -0,0 +1,298 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    Dmf_NotifyUserWithRequest_Public.h
+
+Abstract:
+
+    This Module contains the common declarations shared by driver and user applications.
+
+Environment:
+
+    Kernel-mode Driver Framework
+    User-mode Driver Framework
+
+--*/
+
+#pragma once
+
+// Output buffer layout of Requests completed by DMF_NotifyUserWithRequest when
+// BatchedDeliveryEnabled is set.
+//
+#pragma pack(push, 1)
+typedef struct
+{
+    // Number of data entries that follow this header.
+    //
+    ULONG NumberOfRecords;
+    // Size in bytes of each data entry (SizeOfDataBuffer).
+    //
+    ULONG SizeOfRecord;
+    // NumberOfRecords entries of SizeOfRecord bytes each follow.
+    //
+} NOTIFY_USER_BATCH_HEADER;
+#pragma pack(pop)
+
+// Shared ring used by DMF_NotifyUserWithRequest when SharedRingEnabled is set.
+// The driver writes records and the application reads them. Both sides use the
+// functions below so that the ring logic can be built and tested without the driver.
+//
+// Layout: NOTIFY_USER_RING_HEADER followed by NumberOfRecords records spaced RecordStride
+// bytes apart. Each record is a NOTIFY_USER_RING_RECORD followed by SizeOfRecord bytes.
+//
+// A record at position P holds data when its Sequence is P + 1. It is free for the driver
+// when its Sequence is P. After reading it, the application sets its Sequence to
+// P + NumberOfRecords so the driver can use it again. Positions increase without bound and
+// wrap at 2^32, so NumberOfRecords must be a power of two.
+//
+typedef struct
+{
+    // Number of records in the ring. Always a power of two.
+    //
+    ULONG NumberOfRecords;
+    // Size in bytes of the data in each record.
+    //
+    ULONG SizeOfRecord;
+    // Distance in bytes between consecutive records.
+    //
+    ULONG RecordStride;
+    // Offset in bytes from the start of the ring to the first record.
+    //
+    ULONG RecordsOffset;
+    // Position of the next record the application reads. Written only by the application.
+    //
+    volatile LONG ReadIndex;
+    // Number of records the driver discarded because the ring was full.
+    //
+    volatile LONG NumberOfRecordsDropped;
+} NOTIFY_USER_RING_HEADER;
+
+typedef struct
+{
+    // See the description of the ring above.
+    //
+    volatile LONG Sequence;
+    ULONG Reserved;
+    // SizeOfRecord bytes of data follow.
+    //
+} NOTIFY_USER_RING_RECORD;
+
+// Returned by DMF_NotifyUserWithRequest_RingMap.
+//
+typedef struct
+{
+    // Address of NOTIFY_USER_RING_HEADER in the calling process.
+    //
+    ULONGLONG RingAddress;
+    // Size in bytes of the mapping.
+    //
+    ULONG RingSize;
+    ULONG Reserved;
+} NOTIFY_USER_RING_MAP_OUTPUT;
+
+FORCEINLINE
+ULONG
+NotifyUserRing_RecordStrideGet(
+    _In_ ULONG SizeOfRecord
+    )
+{
+    // Keep every record's Sequence naturally aligned for interlocked access.
+    //
+    return (ULONG)((sizeof(NOTIFY_USER_RING_RECORD) + SizeOfRecord + 7) & ~((size_t)7));
+}
+
+FORCEINLINE
+size_t
+NotifyUserRing_SizeGet(
+    _In_ ULONG NumberOfRecords,
+    _In_ ULONG SizeOfRecord
+    )
+{
+    return sizeof(NOTIFY_USER_RING_HEADER) +
+           ((size_t)NumberOfRecords * NotifyUserRing_RecordStrideGet(SizeOfRecord));
+}
+
+FORCEINLINE
+NOTIFY_USER_RING_RECORD*
+NotifyUserRing_RecordGet(
+    _In_ NOTIFY_USER_RING_HEADER* Ring,
+    _In_ ULONG NumberOfRecords,
+    _In_ ULONG RecordStride,
+    _In_ ULONG Position
+    )
+{
+    // NOTE: The driver always passes its own geometry, never the values in the shared header,
+    //       so that the application cannot cause accesses outside of the ring.
+    //
+    return (NOTIFY_USER_RING_RECORD*)((UCHAR*)Ring +
+                                      sizeof(NOTIFY_USER_RING_HEADER) +
+                                      ((size_t)(Position & (NumberOfRecords - 1)) * RecordStride));
+}
+
+FORCEINLINE
+VOID
+NotifyUserRing_Initialize(
+    _Out_ NOTIFY_USER_RING_HEADER* Ring,
+    _In_ ULONG NumberOfRecords,
+    _In_ ULONG SizeOfRecord
+    )
+{
+    ULONG recordStride;
+    ULONG position;
+
+    recordStride = NotifyUserRing_RecordStrideGet(SizeOfRecord);
+
+    RtlZeroMemory(Ring,
+                  NotifyUserRing_SizeGet(NumberOfRecords,
+                                         SizeOfRecord));
+    Ring->NumberOfRecords = NumberOfRecords;
+    Ring->SizeOfRecord = SizeOfRecord;
+    Ring->RecordStride = recordStride;
+    Ring->RecordsOffset = sizeof(NOTIFY_USER_RING_HEADER);
+
+    for (position = 0; position < NumberOfRecords; position++)
+    {
+        NotifyUserRing_RecordGet(Ring,
+                                 NumberOfRecords,
+                                 recordStride,
+                                 position)->Sequence = (LONG)position;
+    }
+}
+
+FORCEINLINE
+BOOLEAN
+NotifyUserRing_RecordAvailable(
+    _In_ NOTIFY_USER_RING_HEADER* Ring,
+    _In_ ULONG NumberOfRecords,
+    _In_ ULONG SizeOfRecord
+    )
+{
+    ULONG position;
+    NOTIFY_USER_RING_RECORD* record;
+
+    position = (ULONG)Ring->ReadIndex;
+    record = NotifyUserRing_RecordGet(Ring,
+                                      NumberOfRecords,
+                                      NotifyUserRing_RecordStrideGet(SizeOfRecord),
+                                      position);
+
+    return (record->Sequence == (LONG)(position + 1));
+}
+
+// Called by the driver. Any number of callers may write at the same time. WriteIndex is private to
+// the driver. Returns FALSE if the ring is full. RingWasEmpty is set if the application is waiting
+// for the written record.
+//
+FORCEINLINE
+BOOLEAN
+NotifyUserRing_Write(
+    _Inout_ NOTIFY_USER_RING_HEADER* Ring,
+    _In_ ULONG NumberOfRecords,
+    _In_ ULONG SizeOfRecord,
+    _Inout_ volatile LONG* WriteIndex,
+    _In_reads_bytes_(SizeOfRecord) VOID* Data,
+    _Out_ BOOLEAN* RingWasEmpty
+    )
+{
+    ULONG recordStride;
+    ULONG position;
+    NOTIFY_USER_RING_RECORD* record;
+    LONG difference;
+
+    *RingWasEmpty = FALSE;
+    recordStride = NotifyUserRing_RecordStrideGet(SizeOfRecord);
+
+    for (;;)
+    {
+        position = (ULONG)*WriteIndex;
+        record = NotifyUserRing_RecordGet(Ring,
+                                          NumberOfRecords,
+                                          recordStride,
+                                          position);
+        difference = (LONG)((ULONG)record->Sequence - position);
+        if (0 == difference)
+        {
+            // The record is free. Claim it.
+            //
+            if (InterlockedCompareExchange(WriteIndex,
+                                           (LONG)(position + 1),
+                                           (LONG)position) == (LONG)position)
+            {
+                break;
+            }
+        }
+        else if ((difference < 0) ||
+                 ((ULONG)*WriteIndex == position))
+        {
+            // Either the application has not read this record yet (the ring is full) or the
+            // Sequence is not one the driver expects. In both cases the record is discarded.
+            // The position is only retried if another writer claimed it.
+            //
+            InterlockedIncrement(&Ring->NumberOfRecordsDropped);
+            return FALSE;
+        }
+    }
+
+    RtlCopyMemory(record + 1,
+                  Data,
+                  SizeOfRecord);
+
+    // Publish the record. This is a full barrier so the data is visible before the Sequence and
+    // the read of ReadIndex below is not moved ahead of it.
+    //
+    InterlockedExchange(&record->Sequence,
+                        (LONG)(position + 1));
+
+    *RingWasEmpty = ((ULONG)Ring->ReadIndex == position);
+
+    return TRUE;
+}
+
+// Called by the application. Only one caller may read at a time. Returns FALSE if the ring is empty.
+// When it returns FALSE, the application waits by sending a doorbell Request which the driver completes
+// as soon as a record is available.
+//
+FORCEINLINE
+BOOLEAN
+NotifyUserRing_Read(
+    _Inout_ NOTIFY_USER_RING_HEADER* Ring,
+    _Out_writes_bytes_(Ring->SizeOfRecord) VOID* Data
+    )
+{
+    ULONG position;
+    NOTIFY_USER_RING_RECORD* record;
+
+    position = (ULONG)Ring->ReadIndex;
+    record = NotifyUserRing_RecordGet(Ring,
+                                      Ring->NumberOfRecords,
+                                      Ring->RecordStride,
+                                      position);
+    if (record->Sequence != (LONG)(position + 1))
+    {
+        return FALSE;
+    }
+
+    // Do not read the data before the Sequence that published it.
+    //
+    MemoryBarrier();
+
+    RtlCopyMemory(Data,
+                  record + 1,
+                  Ring->SizeOfRecord);
+
+    // Return the record to the driver, then advance. Both are full barriers.
+    //
+    InterlockedExchange(&record->Sequence,
+                        (LONG)(position + Ring->NumberOfRecords));
+    InterlockedExchange(&Ring->ReadIndex,
+                        (LONG)(position + 1));
+
+    return TRUE;
+}
+
+// eof: Dmf_NotifyUserWithRequest_Public.h
+//
@@ -86,6 +86,44 @@ typedef struct
 //
 const ULONG Registry_DeferredRegistryWritePollingIntervalMs = 1000;
 
+// Number of buckets in the index of pending deferred writes. Must be a power of 2.
+//
+#define Registry_DeferredWriteBucketCount   64
+
+// A single pending deferred write. Repeated writes to the same value before the
+// pending writes are flushed only update the data so that only the latest data is written.
+//
+typedef struct
+{
+    // Used for list management of all pending writes in the order they were added.
+    //
+    LIST_ENTRY ListEntry;
+    // Used for list management of the index bucket where this write is located.
+    //
+    LIST_ENTRY BucketListEntry;
+    // Hash of the path name and value name.
+    //
+    ULONG Hash;
+    // Path name of the key where the value is written.
+    //
+    PWCHAR PathName;
+    // Name of the value.
+    //
+    PWCHAR ValueName;
+    // The registry type of the value.
+    //
+    ULONG ValueType;
+    // The latest data written to the value.
+    //
+    UCHAR* ValueData;
+    // Size in bytes of the latest data.
+    //
+    ULONG ValueDataSize;
+    // Size in bytes of the buffer that holds the data.
+    //
+    ULONG ValueDataBufferSize;
+} REGISTRY_DEFERRED_WRITE;
+
 // Context for CustomActionHandler used by this Module for Registry reads.
 //
 typedef struct
@@ -108,6 +146,67 @@ typedef struct
     NTSTATUS NtStatus;
 } Registry_CustomActionHandler_Read_Context;
 
+// Each registry key that has cached values is held open so that changes to it
+// are reported by registry change notification. When the key changes, the key and
+// all its cached values are discarded.
+//
+typedef struct
+{
+    // Used for list management.
+    //
+    LIST_ENTRY ListEntry;
+    // Memory that holds this structure and the path name.
+    // Memory of the cached values is parented to it.
+    //
+    WDFMEMORY Memory;
+    // Path name of the key.
+    //
+    PWCHAR PathName;
+    // Open handle to the key.
+    //
+    WDFKEY Key;
+    // Cached values of this key (REGISTRY_CACHE_VALUE).
+    //
+    LIST_ENTRY ListValues;
+    // Indicates that a change notification is pending on the key.
+    //
+    BOOLEAN ChangeNotificationArmed;
+#if defined(DMF_USER_MODE)
+    // Event set when the key changes.
+    //
+    HANDLE ChangeEvent;
+#else
+    // Event set when the key changes.
+    //
+    HANDLE ChangeEventHandle;
+    PKEVENT ChangeEvent;
+    // Written when the change notification completes.
+    //
+    IO_STATUS_BLOCK IoStatusBlock;
+#endif
+} REGISTRY_CACHE_KEY;
+
+// A single cached value.
+//
+typedef struct
+{
+    // Used for list management.
+    //
+    LIST_ENTRY ListEntry;
+    // Memory that holds this structure, the value name and the value data.
+    //
+    WDFMEMORY Memory;
+    // Name of the value.
+    //
+    PWCHAR ValueName;
+    // Size in bytes of the value data.
+    //
+    ULONG ValueDataSize;
+    // The value data as stored in the registry.
+    //
+    UCHAR* ValueData;
+} REGISTRY_CACHE_VALUE;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -125,7 +224,31 @@ typedef struct
     // Stores data needed to perform deferred operations.
     //
     LIST_ENTRY ListDeferredOperations;
+    // Timer that flushes pending deferred writes.
+    //
+    WDFTIMER DeferredWriteTimer;
+    // Pending deferred writes (REGISTRY_DEFERRED_WRITE) in the order they were added.
+    //
+    LIST_ENTRY ListDeferredWrites;
+    // Index of pending deferred writes by path name and value name.
+    //
+    LIST_ENTRY DeferredWriteBuckets[Registry_DeferredWriteBucketCount];
+    // How often pending deferred writes are flushed.
+    //
+    ULONG DeferredWriteIntervalMs;
+    // Indicates the timer is started to flush pending deferred writes.
+    //
+    BOOLEAN DeferredWriteTimerStarted;
 #endif
+    // Indicates that PathAndValue reads are served from the cache.
+    //
+    BOOLEAN CacheEnabled;
+    // Keys that have cached values (REGISTRY_CACHE_KEY).
+    //
+    LIST_ENTRY ListCacheKeys;
+    // Read cache counters.
+    //
+    Registry_CacheStatistics CacheStatistics;
 } DMF_CONTEXT_Registry;
 
 // This macro declares the following function:
@@ -777,6 +900,165 @@ Exit:
 }
 #endif
 
+//-----------------------------------------------------------------------------------------------------
+// Registry Tree Read
+//-----------------------------------------------------------------------------------------------------
+//
+
+static
+BOOLEAN
+Registry_ReadEntryPathNamesEqual(
+    _In_opt_ PWCHAR PathName1,
+    _In_opt_ PWCHAR PathName2
+    )
+/*++
+
+Routine Description:
+
+    Determines if two read entries refer to the same key.
+
+Arguments:
+
+    PathName1 - Path name of the first key. NULL means the device key.
+    PathName2 - Path name of the second key. NULL means the device key.
+
+Return Value:
+
+    TRUE if both path names refer to the same key.
+
+--*/
+{
+    if ((NULL == PathName1) ||
+        (NULL == PathName2))
+    {
+        return (PathName1 == PathName2);
+    }
+
+    return (0 == _wcsicmp(PathName1,
+                          PathName2));
+}
+
+static
+NTSTATUS
+Registry_ReadEntryRead(
+    _In_ DMFMODULE DmfModule,
+    _In_opt_ WDFKEY Key,
+    _In_ Registry_ReadEntry* ReadEntry,
+    _Out_writes_bytes_(ScratchBufferSize) UCHAR* ScratchBuffer,
+    _In_ ULONG ScratchBufferSize
+    )
+/*++
+
+Routine Description:
+
+    Reads a single value of a read entry table from an open key. If the value cannot be read
+    or is not valid, the entry's default value is used instead.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Key - The open key where the value is located. NULL if the key could not be opened.
+    ReadEntry - Contains information about the value that is read.
+    ScratchBuffer - Buffer that holds the value until it is validated.
+    ScratchBufferSize - Size of ScratchBuffer. It is at least the size of the entry's destination.
+
+Return Value:
+
+    STATUS_SUCCESS if the value or its default is written to the destination.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    UNICODE_STRING valueNameString;
+    ULONG valueDataSize;
+    ULONG valueType;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(ReadEntry->ValueName != NULL);
+    DmfAssert(ReadEntry->Destination != NULL);
+    DmfAssert(ReadEntry->DestinationSize <= ScratchBufferSize);
+    DmfAssert(ReadEntry->DefaultValueSize <= ReadEntry->DestinationSize);
+
+    UNREFERENCED_PARAMETER(ScratchBufferSize);
+
+    valueDataSize = 0;
+
+    if (NULL == Key)
+    {
+        ntStatus = STATUS_OBJECT_NAME_NOT_FOUND;
+        goto Default;
+    }
+
+    RtlInitUnicodeString(&valueNameString,
+                         ReadEntry->ValueName);
+    ntStatus = WdfRegistryQueryValue(Key,
+                                     &valueNameString,
+                                     ReadEntry->DestinationSize,
+                                     ScratchBuffer,
+                                     &valueDataSize,
+                                     &valueType);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        goto Default;
+    }
+
+    if ((valueType != ReadEntry->ValueType) ||
+        ((REG_DWORD == valueType) && (valueDataSize != sizeof(DWORD))) ||
+        ((REG_QWORD == valueType) && (valueDataSize != sizeof(ULONGLONG))))
+    {
+        ntStatus = STATUS_OBJECT_TYPE_MISMATCH;
+        goto Default;
+    }
+
+    if ((ReadEntry->ValueValidate != NULL) &&
+        (! ReadEntry->ValueValidate(DmfModule,
+                                    ReadEntry->ValueName,
+                                    ScratchBuffer,
+                                    valueDataSize)))
+    {
+        ntStatus = STATUS_DATA_ERROR;
+        goto Default;
+    }
+
+    RtlCopyMemory(ReadEntry->Destination,
+                  ScratchBuffer,
+                  valueDataSize);
+    goto ZeroRemainder;
+
+Default:
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Value not read: %ws ntStatus=%!STATUS!", ReadEntry->ValueName, ntStatus);
+
+    if (NULL == ReadEntry->DefaultValue)
+    {
+        // Destination is left unchanged.
+        //
+        goto Exit;
+    }
+
+    valueDataSize = ReadEntry->DefaultValueSize;
+    RtlCopyMemory(ReadEntry->Destination,
+                  ReadEntry->DefaultValue,
+                  valueDataSize);
+    ntStatus = STATUS_SUCCESS;
+
+ZeroRemainder:
+
+    // Strings that fit in the destination are always zero terminated.
+    //
+    RtlZeroMemory((UCHAR*)ReadEntry->Destination + valueDataSize,
+                  ReadEntry->DestinationSize - valueDataSize);
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
 //-----------------------------------------------------------------------------------------------------
 // Registry Enumeration
 //-----------------------------------------------------------------------------------------------------
@@ -2109,100 +2391,125 @@ Return:
 
     FuncExitVoid(DMF_TRACE);
 }
-#endif
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// WDF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-// DMF Module Callbacks
-///////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-
-#if !defined(DMF_USER_MODE)
 
-_Function_class_(DMF_Open)
 _IRQL_requires_max_(PASSIVE_LEVEL)
-_Must_inspect_result_
 static
-NTSTATUS
-DMF_Registry_Open(
-    _In_ DMFMODULE DmfModule
+ULONG
+Registry_DeferredWriteHash(
+    _In_ PWCHAR PathName,
+    _In_ PWCHAR ValueName
     )
 /*++
 
 Routine Description:
 
-    Initialize an instance of a DMF Module of type Registry.
+    Calculates the hash of a path name and value name used to index pending deferred writes.
+    Registry names are not case sensitive so neither is the hash.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    PathName - Path name of the key where the value is written.
+    ValueName - Name of the value.
 
 Return Value:
 
-    STATUS_SUCCESS
+    The hash of both names.
 
 --*/
 {
-    NTSTATUS ntStatus;
-    DMF_CONTEXT_Registry* moduleContext;
-    WDF_TIMER_CONFIG timerConfig;
-    WDF_OBJECT_ATTRIBUTES timerAttributes;
+    ULONG hash;
+    PWCHAR current;
 
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
+    // FNV-1a.
+    //
+    hash = 2166136261;
+    for (current = PathName; *current != L'\0'; current++)
+    {
+        hash = (hash ^ RtlUpcaseUnicodeChar(*current)) * 16777619;
+    }
+    hash = (hash ^ L'\\') * 16777619;
+    for (current = ValueName; *current != L'\0'; current++)
+    {
+        hash = (hash ^ RtlUpcaseUnicodeChar(*current)) * 16777619;
+    }
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    return hash;
+}
 
-    // Initialize the list to empty.
-    //
-    InitializeListHead(&moduleContext->ListDeferredOperations);
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+REGISTRY_DEFERRED_WRITE*
+Registry_DeferredWriteFind(
+    _In_ DMF_CONTEXT_Registry* ModuleContext,
+    _In_ PWCHAR PathName,
+    _In_ PWCHAR ValueName,
+    _In_ ULONG Hash
+    )
+/*++
 
-    // Create the timer for deferred operations.
-    //
-    WDF_TIMER_CONFIG_INIT(&timerConfig,
-                          Registry_DeferredOperationHandler);
-    timerConfig.AutomaticSerialization = FALSE;
+Routine Description:
 
-    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
-    timerAttributes.ParentObject = DmfModule;
-    timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+    Finds the pending deferred write of a value using the index.
+    Caller must hold the Module lock.
 
-    ntStatus = WdfTimerCreate(&timerConfig,
-                              &timerAttributes,
-                              &moduleContext->Timer);
-    if (! NT_SUCCESS(ntStatus))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
-    }
+Arguments:
 
-Exit:
+    ModuleContext - This Module's context.
+    PathName - Path name of the key where the value is written.
+    ValueName - Name of the value.
+    Hash - Hash of PathName and ValueName.
 
-    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+Return Value:
 
-    return ntStatus;
+    The pending deferred write or NULL if there is none.
+
+--*/
+{
+    REGISTRY_DEFERRED_WRITE* deferredWrite;
+    PLIST_ENTRY bucket;
+    PLIST_ENTRY listEntry;
+
+    PAGED_CODE();
+
+    bucket = &ModuleContext->DeferredWriteBuckets[Hash & (Registry_DeferredWriteBucketCount - 1)];
+    for (listEntry = bucket->Flink;
+         listEntry != bucket;
+         listEntry = listEntry->Flink)
+    {
+        deferredWrite = CONTAINING_RECORD(listEntry,
+                                          REGISTRY_DEFERRED_WRITE,
+                                          BucketListEntry);
+        if ((deferredWrite->Hash == Hash) &&
+            (0 == _wcsicmp(deferredWrite->ValueName,
+                           ValueName)) &&
+            (0 == _wcsicmp(deferredWrite->PathName,
+                           PathName)))
+        {
+            return deferredWrite;
+        }
+    }
+
+    return NULL;
 }
 
-_Function_class_(DMF_Close)
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static
 VOID
-DMF_Registry_Close(
-    _In_ DMFMODULE DmfModule
+Registry_DeferredWriteFree(
+    _In_ REGISTRY_DEFERRED_WRITE* DeferredWrite
     )
 /*++
 
 Routine Description:
 
-    Uninitialize an instance of a DMF Module of type Registry.
+    Removes a pending deferred write from the list and the index and frees it.
+    Caller must hold the Module lock.
 
 Arguments:
 
-    DmfModule - This Module's handle.
+    DeferredWrite - The pending deferred write.
 
 Return Value:
 
@@ -2210,40 +2517,1321 @@ Return Value:
 
 --*/
 {
-    DMF_CONTEXT_Registry* moduleContext;
-    PLIST_ENTRY listEntry;
-    PLIST_ENTRY nextListEntry;
-    REGISTRY_DEFERRED_CONTEXT* deferredContext;
-
     PAGED_CODE();
 
-    FuncEntry(DMF_TRACE);
-
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    if (moduleContext->Timer != NULL)
-    {
-        WdfTimerStop(moduleContext->Timer,
-                     TRUE);
-        WdfObjectDelete(moduleContext->Timer);
-        moduleContext->Timer = NULL;
-    }
-    else
+    RemoveEntryList(&DeferredWrite->ListEntry);
+    RemoveEntryList(&DeferredWrite->BucketListEntry);
+    if (DeferredWrite->ValueData != NULL)
     {
-        // This can happen in cases of partial initialization.
-        //
+        ExFreePoolWithTag(DeferredWrite->ValueData,
+                          MemoryTag);
     }
+    ExFreePoolWithTag(DeferredWrite,
+                      MemoryTag);
+}
 
-    // Remove all pending deferred operations.
-    //
-    DMF_ModuleLock(DmfModule);
-
-    // Get the first entry in the list.
-    //
-    listEntry = moduleContext->ListDeferredOperations.Flink;
-    if (NULL == listEntry)
-    {
-        // This can happen in cases of partial initialization.
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Registry_DeferredWriteAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR PathName,
+    _In_ PWCHAR ValueName,
+    _In_ ULONG ValueType,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize
+    )
+/*++
+
+Routine Description:
+
+    Adds a deferred write of a value. If a write of the same value is already pending, only
+    its data is replaced.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    PathName - Path name of the key where the value is written.
+    ValueName - Name of the value.
+    ValueType - The registry type of the value.
+    Buffer - The data that is written to the value.
+    BufferSize - Size of Buffer in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS if successful or STATUS_INSUFFICIENT_RESOURCES if there is not
+    enough memory.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_DEFERRED_WRITE* deferredWrite;
+    UCHAR* valueData;
+    ULONG hash;
+    size_t pathNameSize;
+    size_t valueNameSize;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    hash = Registry_DeferredWriteHash(PathName,
+                                      ValueName);
+    deferredWrite = Registry_DeferredWriteFind(moduleContext,
+                                               PathName,
+                                               ValueName,
+                                               hash);
+    if (NULL == deferredWrite)
+    {
+        // The names are stored right after the structure.
+        //
+        pathNameSize = (wcslen(PathName) + 1) * sizeof(WCHAR);
+        valueNameSize = (wcslen(ValueName) + 1) * sizeof(WCHAR);
+        deferredWrite = (REGISTRY_DEFERRED_WRITE*)ExAllocatePoolWithTag(PagedPool,
+                                                                        sizeof(REGISTRY_DEFERRED_WRITE) + pathNameSize + valueNameSize,
+                                                                        MemoryTag);
+        if (NULL == deferredWrite)
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ExAllocatePoolWithTag fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+
+        RtlZeroMemory(deferredWrite,
+                      sizeof(REGISTRY_DEFERRED_WRITE));
+        deferredWrite->Hash = hash;
+        deferredWrite->PathName = (PWCHAR)(deferredWrite + 1);
+        RtlCopyMemory(deferredWrite->PathName,
+                      PathName,
+                      pathNameSize);
+        deferredWrite->ValueName = (PWCHAR)((UCHAR*)deferredWrite->PathName + pathNameSize);
+        RtlCopyMemory(deferredWrite->ValueName,
+                      ValueName,
+                      valueNameSize);
+
+        InsertTailList(&moduleContext->ListDeferredWrites,
+                       &deferredWrite->ListEntry);
+        InsertTailList(&moduleContext->DeferredWriteBuckets[hash & (Registry_DeferredWriteBucketCount - 1)],
+                       &deferredWrite->BucketListEntry);
+    }
+    else
+    {
+        TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Coalesce deferred write: %ws", ValueName);
+    }
+
+    if (BufferSize > deferredWrite->ValueDataBufferSize)
+    {
+        valueData = (UCHAR*)ExAllocatePoolWithTag(PagedPool,
+                                                  BufferSize,
+                                                  MemoryTag);
+        if (NULL == valueData)
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ExAllocatePoolWithTag fails: ntStatus=%!STATUS!", ntStatus);
+            if (NULL == deferredWrite->ValueData)
+            {
+                // This write was just added and has no data.
+                //
+                Registry_DeferredWriteFree(deferredWrite);
+            }
+            goto Exit;
+        }
+        if (deferredWrite->ValueData != NULL)
+        {
+            ExFreePoolWithTag(deferredWrite->ValueData,
+                              MemoryTag);
+        }
+        deferredWrite->ValueData = valueData;
+        deferredWrite->ValueDataBufferSize = BufferSize;
+    }
+
+    RtlCopyMemory(deferredWrite->ValueData,
+                  Buffer,
+                  BufferSize);
+    deferredWrite->ValueDataSize = BufferSize;
+    deferredWrite->ValueType = ValueType;
+
+    // Pending writes are flushed when the timer expires. Do not restart the timer
+    // if it is already started so that frequent writes do not postpone the flush.
+    //
+    if (! moduleContext->DeferredWriteTimerStarted)
+    {
+        WdfTimerStart(moduleContext->DeferredWriteTimer,
+                      WDF_REL_TIMEOUT_IN_MS(moduleContext->DeferredWriteIntervalMs));
+        moduleContext->DeferredWriteTimerStarted = TRUE;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+Registry_DeferredWritesFlush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Writes all pending deferred writes to the registry. Writes that fail because the registry
+    is not ready yet remain pending. Other writes are removed whether or not they succeed.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS if all pending writes are written. Otherwise, the status of the first
+    write that failed.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    NTSTATUS ntStatusWrite;
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_DEFERRED_WRITE* deferredWrite;
+    PLIST_ENTRY listEntry;
+    PLIST_ENTRY nextListEntry;
+    HANDLE registryPathHandle;
+    PWCHAR registryPathName;
+    REGISTRY_DEFERRED_WRITE* deferredWriteKey;
+    BOOLEAN deferredWriteKeyDone;
+    UNICODE_STRING valueNameString;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    ntStatus = STATUS_SUCCESS;
+    registryPathHandle = NULL;
+    registryPathName = NULL;
+    // registryPathName points into this pending write. It is freed only after the
+    // next key is opened (or after the last write) so that registryPathName remains valid.
+    //
+    deferredWriteKey = NULL;
+    deferredWriteKeyDone = FALSE;
+
+    listEntry = moduleContext->ListDeferredWrites.Flink;
+    if (NULL == listEntry)
+    {
+        // This can happen in cases of partial initialization.
+        //
+        goto Exit;
+    }
+
+    while (listEntry != &moduleContext->ListDeferredWrites)
+    {
+        nextListEntry = listEntry->Flink;
+
+        deferredWrite = CONTAINING_RECORD(listEntry,
+                                          REGISTRY_DEFERRED_WRITE,
+                                          ListEntry);
+
+        // Consecutive writes to the same key use the same handle.
+        //
+        if ((NULL == registryPathName) ||
+            (_wcsicmp(registryPathName,
+                      deferredWrite->PathName) != 0))
+        {
+            if (registryPathHandle != NULL)
+            {
+                WdfRegistryClose((WDFKEY)registryPathHandle);
+                registryPathHandle = NULL;
+            }
+            if (deferredWriteKeyDone)
+            {
+                Registry_DeferredWriteFree(deferredWriteKey);
+                deferredWriteKeyDone = FALSE;
+            }
+            deferredWriteKey = deferredWrite;
+            registryPathName = deferredWrite->PathName;
+            ntStatusWrite = Registry_HandleOpenByNameEx(registryPathName,
+                                                        KEY_SET_VALUE,
+                                                        TRUE,
+                                                        &registryPathHandle);
+            if (! NT_SUCCESS(ntStatusWrite))
+            {
+                registryPathHandle = NULL;
+            }
+        }
+
+        if (registryPathHandle != NULL)
+        {
+            RtlInitUnicodeString(&valueNameString,
+                                 deferredWrite->ValueName);
+            ntStatusWrite = WdfRegistryAssignValue((WDFKEY)registryPathHandle,
+                                                   &valueNameString,
+                                                   deferredWrite->ValueType,
+                                                   deferredWrite->ValueDataSize,
+                                                   deferredWrite->ValueData);
+        }
+
+        if (STATUS_OBJECT_NAME_NOT_FOUND == ntStatusWrite)
+        {
+            // Leave it in the list because driver needs to try again.
+            //
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "STATUS_OBJECT_NAME_NOT_FOUND...try again");
+        }
+        else
+        {
+            if (! NT_SUCCESS(ntStatusWrite))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Deferred write fails: %ws ntStatus=%!STATUS! (no retry)", deferredWrite->ValueName, ntStatusWrite);
+            }
+            if (deferredWrite == deferredWriteKey)
+            {
+                // Its path name is still compared with the following writes.
+                //
+                deferredWriteKeyDone = TRUE;
+            }
+            else
+            {
+                Registry_DeferredWriteFree(deferredWrite);
+            }
+            deferredWrite = NULL;
+        }
+
+        if ((! NT_SUCCESS(ntStatusWrite)) &&
+            NT_SUCCESS(ntStatus))
+        {
+            ntStatus = ntStatusWrite;
+        }
+
+        listEntry = nextListEntry;
+    }
+
+    if (registryPathHandle != NULL)
+    {
+        WdfRegistryClose((WDFKEY)registryPathHandle);
+        registryPathHandle = NULL;
+    }
+
+    if (deferredWriteKeyDone)
+    {
+        Registry_DeferredWriteFree(deferredWriteKey);
+    }
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+EVT_WDF_TIMER Registry_DeferredWriteHandler;
+
+VOID
+Registry_DeferredWriteHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
+
+Routine Description:
+
+    Flushes pending deferred writes at the interval set by the Client.
+
+Parameters:
+
+    WdfTimer - The timer object whose parent is this Module.
+
+Return:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_Registry* moduleContext;
+    NTSTATUS ntStatus;
+
+    // NOTE: Timer handler is set to run in PASSIVE_LEVEL.
+    //
+    #pragma warning(suppress:28118)
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
+    DmfAssert(dmfModule != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DMF_ModuleLock(dmfModule);
+
+    moduleContext->DeferredWriteTimerStarted = FALSE;
+
+    ntStatus = Registry_DeferredWritesFlush(dmfModule);
+
+    if (! IsListEmpty(&moduleContext->ListDeferredWrites))
+    {
+        // It means there are still pending deferred writes to perform.
+        //
+        WdfTimerStart(moduleContext->DeferredWriteTimer,
+                      WDF_REL_TIMEOUT_IN_MS(moduleContext->DeferredWriteIntervalMs));
+        moduleContext->DeferredWriteTimerStarted = TRUE;
+    }
+
+    DMF_ModuleUnlock(dmfModule);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+// Registry Read Cache
+//-----------------------------------------------------------------------------------------------------
+//
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Registry_CacheKeyDestroy(
+    _In_ DMFMODULE DmfModule,
+    _In_ REGISTRY_CACHE_KEY* CacheKey
+    )
+/*++
+
+Routine Description:
+
+    Closes a cached key and discards all its cached values.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    CacheKey - The cached key to destroy.
+
+Return Value:
+
+    None
+
+--*/
+{
+    UNREFERENCED_PARAMETER(DmfModule);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    RemoveEntryList(&CacheKey->ListEntry);
+
+    // Closing the key completes the pending change notification.
+    //
+    if (CacheKey->Key != NULL)
+    {
+        WdfRegistryClose(CacheKey->Key);
+        CacheKey->Key = NULL;
+    }
+
+#if defined(DMF_USER_MODE)
+    if (CacheKey->ChangeEvent != NULL)
+    {
+        CloseHandle(CacheKey->ChangeEvent);
+        CacheKey->ChangeEvent = NULL;
+    }
+#else
+    if (CacheKey->ChangeEvent != NULL)
+    {
+        if (CacheKey->ChangeNotificationArmed)
+        {
+            // Make sure IoStatusBlock is no longer written before its memory is freed.
+            //
+            KeWaitForSingleObject(CacheKey->ChangeEvent,
+                                  Executive,
+                                  KernelMode,
+                                  FALSE,
+                                  NULL);
+        }
+        ObDereferenceObject(CacheKey->ChangeEvent);
+        CacheKey->ChangeEvent = NULL;
+    }
+    if (CacheKey->ChangeEventHandle != NULL)
+    {
+        ZwClose(CacheKey->ChangeEventHandle);
+        CacheKey->ChangeEventHandle = NULL;
+    }
+#endif
+
+    // The memory of the cached values is parented to this memory.
+    //
+    WdfObjectDelete(CacheKey->Memory);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Registry_CacheKeyCreate(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR PathName,
+    _Out_ REGISTRY_CACHE_KEY** CacheKey
+    )
+/*++
+
+Routine Description:
+
+    Opens a key, starts listening for changes to it and adds it to the list of cached keys.
+    If the change notification cannot be started the key is still returned but its values
+    are not cached.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    PathName - Path name of the key to open.
+    CacheKey - The new cached key.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_CACHE_KEY* cacheKey;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    UNICODE_STRING nameString;
+    size_t pathNameSize;
+#if defined(DMF_USER_MODE)
+    LONG errorCode;
+#else
+    OBJECT_ATTRIBUTES eventAttributes;
+#endif
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    *CacheKey = NULL;
+
+    // The path name is stored right after the structure.
+    //
+    pathNameSize = (wcslen(PathName) + 1) * sizeof(WCHAR);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(REGISTRY_CACHE_KEY) + pathNameSize,
+                               &memory,
+                               (VOID**)&cacheKey);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    RtlZeroMemory(cacheKey,
+                  sizeof(REGISTRY_CACHE_KEY));
+    cacheKey->Memory = memory;
+    cacheKey->PathName = (PWCHAR)(cacheKey + 1);
+    RtlCopyMemory(cacheKey->PathName,
+                  PathName,
+                  pathNameSize);
+    InitializeListHead(&cacheKey->ListValues);
+
+    RtlInitUnicodeString(&nameString,
+                         PathName);
+    ntStatus = WdfRegistryOpenKey(NULL,
+                                  &nameString,
+                                  KEY_READ,
+                                  WDF_NO_OBJECT_ATTRIBUTES,
+                                  &cacheKey->Key);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        cacheKey->Key = NULL;
+        WdfObjectDelete(memory);
+        goto Exit;
+    }
+
+    InsertTailList(&moduleContext->ListCacheKeys,
+                   &cacheKey->ListEntry);
+
+#if defined(DMF_USER_MODE)
+    cacheKey->ChangeEvent = CreateEvent(NULL,
+                                        TRUE,
+                                        FALSE,
+                                        NULL);
+    if (NULL == cacheKey->ChangeEvent)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "CreateEvent fails: ntStatus=%!STATUS!", NTSTATUS_FROM_WIN32(GetLastError()));
+        goto ExitSuccess;
+    }
+
+    errorCode = RegNotifyChangeKeyValue((HKEY)WdfRegistryWdmGetHandle(cacheKey->Key),
+                                        FALSE,
+                                        REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC,
+                                        cacheKey->ChangeEvent,
+                                        TRUE);
+    if (errorCode != ERROR_SUCCESS)
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "RegNotifyChangeKeyValue fails: ntStatus=%!STATUS!", NTSTATUS_FROM_WIN32(errorCode));
+        goto ExitSuccess;
+    }
+#else
+    InitializeObjectAttributes(&eventAttributes,
+                               NULL,
+                               OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    ntStatus = ZwCreateEvent(&cacheKey->ChangeEventHandle,
+                             EVENT_ALL_ACCESS,
+                             &eventAttributes,
+                             NotificationEvent,
+                             FALSE);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ZwCreateEvent fails: ntStatus=%!STATUS!", ntStatus);
+        cacheKey->ChangeEventHandle = NULL;
+        goto ExitSuccess;
+    }
+
+    ntStatus = ObReferenceObjectByHandle(cacheKey->ChangeEventHandle,
+                                         EVENT_ALL_ACCESS,
+                                         *ExEventObjectType,
+                                         KernelMode,
+                                         (VOID**)&cacheKey->ChangeEvent,
+                                         NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ObReferenceObjectByHandle fails: ntStatus=%!STATUS!", ntStatus);
+        cacheKey->ChangeEvent = NULL;
+        goto ExitSuccess;
+    }
+
+    ntStatus = ZwNotifyChangeKey(WdfRegistryWdmGetHandle(cacheKey->Key),
+                                 cacheKey->ChangeEventHandle,
+                                 NULL,
+                                 NULL,
+                                 &cacheKey->IoStatusBlock,
+                                 REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+                                 FALSE,
+                                 NULL,
+                                 0,
+                                 TRUE);
+    if (ntStatus != STATUS_PENDING)
+    {
+        // The key changed already or notification is not possible.
+        //
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ZwNotifyChangeKey fails: ntStatus=%!STATUS!", ntStatus);
+        goto ExitSuccess;
+    }
+#endif
+
+    cacheKey->ChangeNotificationArmed = TRUE;
+
+ExitSuccess:
+
+    // The key is usable even if its values cannot be cached.
+    //
+    *CacheKey = cacheKey;
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+REGISTRY_CACHE_KEY*
+Registry_CacheKeyFind(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR PathName
+    )
+/*++
+
+Routine Description:
+
+    Finds a cached key by path name. If the key has changed since it was cached,
+    it is discarded together with its cached values.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    PathName - Path name of the key to find.
+
+Return Value:
+
+    The cached key or NULL if it is not cached.
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_CACHE_KEY* cacheKey;
+    PLIST_ENTRY listEntry;
+    BOOLEAN keyChanged;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    for (listEntry = moduleContext->ListCacheKeys.Flink;
+         listEntry != &moduleContext->ListCacheKeys;
+         listEntry = listEntry->Flink)
+    {
+        cacheKey = CONTAINING_RECORD(listEntry,
+                                     REGISTRY_CACHE_KEY,
+                                     ListEntry);
+        if (_wcsicmp(cacheKey->PathName,
+                     PathName) != 0)
+        {
+            continue;
+        }
+
+        if (! cacheKey->ChangeNotificationArmed)
+        {
+            keyChanged = TRUE;
+        }
+        else
+        {
+#if defined(DMF_USER_MODE)
+            keyChanged = (WaitForSingleObject(cacheKey->ChangeEvent,
+                                              0) == WAIT_OBJECT_0);
+#else
+            keyChanged = (KeReadStateEvent(cacheKey->ChangeEvent) != 0);
+#endif
+        }
+
+        if (keyChanged)
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Cached key changed: %ws", PathName);
+            moduleContext->CacheStatistics.Invalidations++;
+            Registry_CacheKeyDestroy(DmfModule,
+                                     cacheKey);
+            return NULL;
+        }
+
+        return cacheKey;
+    }
+
+    return NULL;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+REGISTRY_CACHE_VALUE*
+Registry_CacheValueFind(
+    _In_ REGISTRY_CACHE_KEY* CacheKey,
+    _In_ PWCHAR ValueName
+    )
+/*++
+
+Routine Description:
+
+    Finds a cached value of a cached key by value name.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    CacheKey - The cached key where the value is located.
+    ValueName - The name of the value.
+
+Return Value:
+
+    The cached value or NULL if it is not cached.
+
+--*/
+{
+    REGISTRY_CACHE_VALUE* cacheValue;
+    PLIST_ENTRY listEntry;
+
+    PAGED_CODE();
+
+    for (listEntry = CacheKey->ListValues.Flink;
+         listEntry != &CacheKey->ListValues;
+         listEntry = listEntry->Flink)
+    {
+        cacheValue = CONTAINING_RECORD(listEntry,
+                                       REGISTRY_CACHE_VALUE,
+                                       ListEntry);
+        if (0 == _wcsicmp(cacheValue->ValueName,
+                          ValueName))
+        {
+            return cacheValue;
+        }
+    }
+
+    return NULL;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Registry_CacheValueAdd(
+    _In_ REGISTRY_CACHE_KEY* CacheKey,
+    _In_ PWCHAR ValueName,
+    _Out_ REGISTRY_CACHE_VALUE** CacheValue
+    )
+/*++
+
+Routine Description:
+
+    Reads a value of a cached key from the registry and caches it.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    CacheKey - The cached key where the value is located.
+    ValueName - The name of the value to read.
+    CacheValue - The new cached value.
+
+Return Value:
+
+    STATUS_SUCCESS if the value is cached. Otherwise, the value is not cached and
+    the caller should read it directly.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    REGISTRY_CACHE_VALUE* cacheValue;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY memory;
+    UNICODE_STRING valueNameString;
+    ULONG valueDataSize;
+    ULONG valueType;
+    size_t valueNameSize;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    *CacheValue = NULL;
+
+    if (! CacheKey->ChangeNotificationArmed)
+    {
+        // Changes to this key cannot be detected.
+        //
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    RtlInitUnicodeString(&valueNameString,
+                         ValueName);
+
+    // Find out how much memory is needed to hold the value.
+    //
+    valueDataSize = 0;
+    ntStatus = WdfRegistryQueryValue(CacheKey->Key,
+                                     &valueNameString,
+                                     0,
+                                     NULL,
+                                     &valueDataSize,
+                                     &valueType);
+    if (ntStatus != STATUS_BUFFER_OVERFLOW)
+    {
+        // Value does not exist or is empty.
+        //
+        if (NT_SUCCESS(ntStatus))
+        {
+            ntStatus = STATUS_NOT_SUPPORTED;
+        }
+        goto Exit;
+    }
+
+    // The value name and data are stored right after the structure.
+    //
+    valueNameSize = (wcslen(ValueName) + 1) * sizeof(WCHAR);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = CacheKey->Memory;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               sizeof(REGISTRY_CACHE_VALUE) + valueNameSize + valueDataSize,
+                               &memory,
+                               (VOID**)&cacheValue);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    RtlZeroMemory(cacheValue,
+                  sizeof(REGISTRY_CACHE_VALUE));
+    cacheValue->Memory = memory;
+    cacheValue->ValueName = (PWCHAR)(cacheValue + 1);
+    RtlCopyMemory(cacheValue->ValueName,
+                  ValueName,
+                  valueNameSize);
+    cacheValue->ValueData = (UCHAR*)cacheValue->ValueName + valueNameSize;
+    cacheValue->ValueDataSize = valueDataSize;
+
+    ntStatus = WdfRegistryQueryValue(CacheKey->Key,
+                                     &valueNameString,
+                                     valueDataSize,
+                                     cacheValue->ValueData,
+                                     &valueDataSize,
+                                     NULL);
+    if ((! NT_SUCCESS(ntStatus)) ||
+        (valueDataSize != cacheValue->ValueDataSize))
+    {
+        // Value changed between the two queries.
+        //
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRegistryQueryValue fails: %ws...ntStatus=%!STATUS!", ValueName, ntStatus);
+        WdfObjectDelete(memory);
+        ntStatus = STATUS_NOT_SUPPORTED;
+        goto Exit;
+    }
+
+    InsertTailList(&CacheKey->ListValues,
+                   &cacheValue->ListEntry);
+    *CacheValue = cacheValue;
+
+Exit:
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+Registry_CacheRead(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR RegistryPathName,
+    _In_ PWCHAR ValueName,
+    _In_ ULONG RegistryType,
+    _Out_writes_opt_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize,
+    _Out_opt_ ULONG* BytesRead
+    )
+/*++
+
+Routine Description:
+
+    Reads a value given a registry path and value name from the cache. If the value is not
+    in the cache it is read from the registry and added to the cache.
+    Returns the same results as reading the value directly from the registry.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RegistryPathName - Registry path to ValueName.
+    ValueName - Name of registry value to read.
+    RegistryType - The registry type of value to read.
+    Buffer - Where the read data is written.
+    BufferSize - Size of buffer in bytes.
+    BytesRead - Number of bytes read from registry and written to Buffer.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_CACHE_KEY* cacheKey;
+    REGISTRY_CACHE_VALUE* cacheValue;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+
+    cacheValue = NULL;
+    cacheKey = Registry_CacheKeyFind(DmfModule,
+                                     RegistryPathName);
+    if (cacheKey != NULL)
+    {
+        cacheValue = Registry_CacheValueFind(cacheKey,
+                                             ValueName);
+    }
+
+    if (cacheValue != NULL)
+    {
+        moduleContext->CacheStatistics.Hits++;
+    }
+    else
+    {
+        moduleContext->CacheStatistics.Misses++;
+
+        if (NULL == cacheKey)
+        {
+            ntStatus = Registry_CacheKeyCreate(DmfModule,
+                                               RegistryPathName,
+                                               &cacheKey);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                if (BytesRead != NULL)
+                {
+                    *BytesRead = 0;
+                }
+                goto Exit;
+            }
+        }
+
+        if (moduleContext->CacheEnabled)
+        {
+            ntStatus = Registry_CacheValueAdd(cacheKey,
+                                              ValueName,
+                                              &cacheValue);
+        }
+        else
+        {
+            // Caching was disabled while waiting for the lock.
+            //
+            ntStatus = STATUS_NOT_SUPPORTED;
+        }
+        if (! NT_SUCCESS(ntStatus))
+        {
+            // The value cannot be cached. Read it using the key that is already open.
+            //
+            ntStatus = DMF_Registry_ValueRead(DmfModule,
+                                              (HANDLE)cacheKey->Key,
+                                              ValueName,
+                                              RegistryType,
+                                              Buffer,
+                                              BufferSize,
+                                              BytesRead);
+            if ((! cacheKey->ChangeNotificationArmed) ||
+                (! moduleContext->CacheEnabled))
+            {
+                Registry_CacheKeyDestroy(DmfModule,
+                                         cacheKey);
+            }
+            goto Exit;
+        }
+    }
+
+    // Return the value the same way Registry_CustomActionHandler_Read does.
+    //
+    if (BytesRead != NULL)
+    {
+        *BytesRead = cacheValue->ValueDataSize;
+    }
+
+    if (cacheValue->ValueDataSize <= BufferSize)
+    {
+        DmfAssert(Buffer != NULL);
+        RtlCopyMemory(Buffer,
+                      cacheValue->ValueData,
+                      cacheValue->ValueDataSize);
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+    }
+
+Exit:
+
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+Registry_CacheFlush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Discards all cached keys and values.
+    Caller must hold the Module lock.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+    REGISTRY_CACHE_KEY* cacheKey;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (NULL == moduleContext->ListCacheKeys.Flink)
+    {
+        // This can happen in cases of partial initialization.
+        //
+        return;
+    }
+
+    while (! IsListEmpty(&moduleContext->ListCacheKeys))
+    {
+        cacheKey = CONTAINING_RECORD(moduleContext->ListCacheKeys.Flink,
+                                     REGISTRY_CACHE_KEY,
+                                     ListEntry);
+        Registry_CacheKeyDestroy(DmfModule,
+                                 cacheKey);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// WDF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+#if !defined(DMF_USER_MODE)
+
+_Function_class_(DMF_ModuleD0Exit)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+NTSTATUS
+DMF_Registry_ModuleD0Exit(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDF_POWER_DEVICE_STATE TargetState
+    )
+/*++
+
+Routine Description:
+
+    Registry callback for ModuleD0Exit for a given DMF Module.
+    Pending deferred writes are flushed so they are not lost if the device is removed.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    TargetState - The WDF Power State that the given DMF Module will enter.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    UNREFERENCED_PARAMETER(TargetState);
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMF_ModuleLock(DmfModule);
+    ntStatus = Registry_DeferredWritesFlush(DmfModule);
+    DMF_ModuleUnlock(DmfModule);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Registry_DeferredWritesFlush fails: ntStatus=%!STATUS!", ntStatus);
+    }
+
+    FuncExitVoid(DMF_TRACE);
+
+    // Failure to write the registry does not prevent the device from leaving D0.
+    //
+    return STATUS_SUCCESS;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// DMF Module Callbacks
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+_Function_class_(DMF_Open)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_Must_inspect_result_
+static
+NTSTATUS
+DMF_Registry_Open(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Initialize an instance of a DMF Module of type Registry.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_Registry* moduleContext;
+#if !defined(DMF_USER_MODE)
+    WDF_TIMER_CONFIG timerConfig;
+    WDF_OBJECT_ATTRIBUTES timerAttributes;
+#endif
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Initialize the read cache to empty.
+    //
+    InitializeListHead(&moduleContext->ListCacheKeys);
+
+#if defined(DMF_USER_MODE)
+    ntStatus = STATUS_SUCCESS;
+#else
+    // Initialize the list to empty.
+    //
+    InitializeListHead(&moduleContext->ListDeferredOperations);
+
+    // Initialize the pending deferred writes and their index to empty.
+    //
+    InitializeListHead(&moduleContext->ListDeferredWrites);
+    for (ULONG bucketIndex = 0; bucketIndex < Registry_DeferredWriteBucketCount; bucketIndex++)
+    {
+        InitializeListHead(&moduleContext->DeferredWriteBuckets[bucketIndex]);
+    }
+    moduleContext->DeferredWriteIntervalMs = Registry_DeferredRegistryWritePollingIntervalMs;
+
+    // Create the timer for deferred operations.
+    //
+    WDF_TIMER_CONFIG_INIT(&timerConfig,
+                          Registry_DeferredOperationHandler);
+    timerConfig.AutomaticSerialization = FALSE;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+    timerAttributes.ParentObject = DmfModule;
+    timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+    ntStatus = WdfTimerCreate(&timerConfig,
+                              &timerAttributes,
+                              &moduleContext->Timer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // Create the timer for deferred writes.
+    //
+    WDF_TIMER_CONFIG_INIT(&timerConfig,
+                          Registry_DeferredWriteHandler);
+    timerConfig.AutomaticSerialization = FALSE;
+
+    ntStatus = WdfTimerCreate(&timerConfig,
+                              &timerAttributes,
+                              &moduleContext->DeferredWriteTimer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+Exit:
+#endif
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_Function_class_(DMF_Close)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+DMF_Registry_Close(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Uninitialize an instance of a DMF Module of type Registry.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+#if !defined(DMF_USER_MODE)
+    PLIST_ENTRY listEntry;
+    PLIST_ENTRY nextListEntry;
+    REGISTRY_DEFERRED_CONTEXT* deferredContext;
+#endif
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Discard all cached keys and values.
+    //
+    DMF_ModuleLock(DmfModule);
+    moduleContext->CacheEnabled = FALSE;
+    Registry_CacheFlush(DmfModule);
+    DMF_ModuleUnlock(DmfModule);
+
+#if !defined(DMF_USER_MODE)
+    if (moduleContext->Timer != NULL)
+    {
+        WdfTimerStop(moduleContext->Timer,
+                     TRUE);
+        WdfObjectDelete(moduleContext->Timer);
+        moduleContext->Timer = NULL;
+    }
+    else
+    {
+        // This can happen in cases of partial initialization.
+        //
+    }
+
+    // Remove all pending deferred operations.
+    //
+    DMF_ModuleLock(DmfModule);
+
+    // Get the first entry in the list.
+    //
+    listEntry = moduleContext->ListDeferredOperations.Flink;
+    if (NULL == listEntry)
+    {
+        // This can happen in cases of partial initialization.
         //
         goto SkipListIteration;
     }
@@ -2279,9 +3867,35 @@ SkipListIteration:
 
     DMF_ModuleUnlock(DmfModule);
 
+    if (moduleContext->DeferredWriteTimer != NULL)
+    {
+        WdfTimerStop(moduleContext->DeferredWriteTimer,
+                     TRUE);
+        WdfObjectDelete(moduleContext->DeferredWriteTimer);
+        moduleContext->DeferredWriteTimer = NULL;
+    }
+
+    // Write pending deferred writes one last time and remove all that remain.
+    //
+    DMF_ModuleLock(DmfModule);
+
+    if (moduleContext->ListDeferredWrites.Flink != NULL)
+    {
+        (VOID)Registry_DeferredWritesFlush(DmfModule);
+        while (! IsListEmpty(&moduleContext->ListDeferredWrites))
+        {
+            Registry_DeferredWriteFree(CONTAINING_RECORD(moduleContext->ListDeferredWrites.Flink,
+                                                         REGISTRY_DEFERRED_WRITE,
+                                                         ListEntry));
+        }
+    }
+    moduleContext->DeferredWriteTimerStarted = FALSE;
+
+    DMF_ModuleUnlock(DmfModule);
+#endif
+
     FuncExitVoid(DMF_TRACE);
 }
-#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Public Calls by Client
@@ -2318,20 +3932,26 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_MODULE_DESCRIPTOR dmfModuleDescriptor_Registry;
-#if !defined(DMF_USER_MODE)
     DMF_CALLBACKS_DMF dmfCallbacksDmf_Registry;
+#if !defined(DMF_USER_MODE)
+    DMF_CALLBACKS_WDF dmfCallbacksWdf_Registry;
 #endif
 
     PAGED_CODE();
 
     FuncEntry(DMF_TRACE);
 
-    // For user mode, Open and Close are not needed as the deferred TreeWrite is not supported.
+    // For user mode, Open and Close only manage the read cache as the deferred TreeWrite is not supported.
     //
-#if !defined(DMF_USER_MODE)
     DMF_CALLBACKS_DMF_INIT(&dmfCallbacksDmf_Registry);
     dmfCallbacksDmf_Registry.DeviceOpen = DMF_Registry_Open;
     dmfCallbacksDmf_Registry.DeviceClose = DMF_Registry_Close;
+
+#if !defined(DMF_USER_MODE)
+    // Pending deferred writes are flushed when the device leaves D0.
+    //
+    DMF_CALLBACKS_WDF_INIT(&dmfCallbacksWdf_Registry);
+    dmfCallbacksWdf_Registry.ModuleD0Exit = DMF_Registry_ModuleD0Exit;
 #endif
     DMF_MODULE_DESCRIPTOR_INIT_CONTEXT_TYPE(dmfModuleDescriptor_Registry,
                                             Registry,
@@ -2339,8 +3959,9 @@ Return Value:
                                             DMF_MODULE_OPTIONS_PASSIVE,
                                             DMF_MODULE_OPEN_OPTION_OPEN_Create);
 
-#if !defined(DMF_USER_MODE)
     dmfModuleDescriptor_Registry.CallbacksDmf = &dmfCallbacksDmf_Registry;
+#if !defined(DMF_USER_MODE)
+    dmfModuleDescriptor_Registry.CallbacksWdf = &dmfCallbacksWdf_Registry;
 #endif
     ntStatus = DMF_ModuleCreate(Device,
                                 DmfModuleAttributes,
@@ -2360,35 +3981,165 @@ Return Value:
 // Module Methods
 //
 
-_Must_inspect_result_
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+BOOLEAN
+DMF_Registry_AllSubKeysFromHandleEnumerate(
+    _In_ DMFMODULE DmfModule,
+    _In_ HANDLE Handle,
+    _In_ EVT_DMF_Registry_KeyEnumerationCallback* ClientCallback,
+    _In_ VOID* ClientCallbackContext
+    )
+/*++
+
+Routine Description:
+
+    Given a registry handle, enumerate all the sub keys and call an enumeration function for each of them.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Handle - An open registry key.
+    RegistryEnumerationFunction - The client's enumeration callback function.
+
+Return Value:
+
+    TRUE on success, FALSE on error.
+
+--*/
+{
+    RegistryKeyEnumerationContextType context;
+    BOOLEAN returnValue;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+   // There is nothing to pass in this context. (All subkeys are presented to enumerator callback.)
+   //
+    context.FilterEnumeratorContext = NULL;
+    // For each subkey of the current key, this function will be called. It will actually create the entries.
+    //
+    context.RegistryKeyEnumerationFunction = ClientCallback;
+    context.ClientCallbackContext = ClientCallbackContext;
+
+    returnValue = Registry_SubKeysFromHandleEnumerate(Handle,
+                                                      Registry_KeyEnumerationFilterAllSubkeys,
+                                                      &context);
+
+    FuncExit(DMF_TRACE, "returnValue=%d", returnValue);
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_CacheDisable(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Stops caching values read using DMF_Registry_PathAndValueRead* Methods and discards
+    all values that are cached.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    moduleContext->CacheEnabled = FALSE;
+    Registry_CacheFlush(DmfModule);
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_CacheEnable(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Starts caching values read using DMF_Registry_PathAndValueRead* Methods. Cached values
+    are discarded when the key where they are located changes.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DMF_ModuleLock(DmfModule);
+    moduleContext->CacheEnabled = TRUE;
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
-BOOLEAN
-DMF_Registry_AllSubKeysFromHandleEnumerate(
+VOID
+DMF_Registry_CacheStatisticsGet(
     _In_ DMFMODULE DmfModule,
-    _In_ HANDLE Handle,
-    _In_ EVT_DMF_Registry_KeyEnumerationCallback* ClientCallback,
-    _In_ VOID* ClientCallbackContext
+    _Out_ Registry_CacheStatistics* CacheStatistics
     )
 /*++
 
 Routine Description:
 
-    Given a registry handle, enumerate all the sub keys and call an enumeration function for each of them.
+    Returns the number of cache hits, misses and invalidations since this Module was opened.
 
 Arguments:
 
     DmfModule - This Module's handle.
-    Handle - An open registry key.
-    RegistryEnumerationFunction - The client's enumeration callback function.
+    CacheStatistics - Where the statistics are written.
 
 Return Value:
 
-    TRUE on success, FALSE on error.
+    None
 
 --*/
 {
-    RegistryKeyEnumerationContextType context;
-    BOOLEAN returnValue;
+    DMF_CONTEXT_Registry* moduleContext;
 
     PAGED_CODE();
 
@@ -2397,21 +4148,13 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  Registry);
 
-   // There is nothing to pass in this context. (All subkeys are presented to enumerator callback.)
-   //
-    context.FilterEnumeratorContext = NULL;
-    // For each subkey of the current key, this function will be called. It will actually create the entries.
-    //
-    context.RegistryKeyEnumerationFunction = ClientCallback;
-    context.ClientCallbackContext = ClientCallbackContext;
-
-    returnValue = Registry_SubKeysFromHandleEnumerate(Handle,
-                                                      Registry_KeyEnumerationFilterAllSubkeys,
-                                                      &context);
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    FuncExit(DMF_TRACE, "returnValue=%d", returnValue);
+    DMF_ModuleLock(DmfModule);
+    *CacheStatistics = moduleContext->CacheStatistics;
+    DMF_ModuleUnlock(DmfModule);
 
-    return returnValue;
+    FuncExitVoid(DMF_TRACE);
 }
 
 _Must_inspect_result_
@@ -2545,6 +4288,94 @@ Return Value:
     return ntStatus;
 }
 
+#if !defined(DMF_USER_MODE)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_DeferredWriteFlush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Writes all values pending from DMF_Registry_PathAndValueWriteDeferred() to the registry now.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    STATUS_SUCCESS if all pending writes are written. Otherwise, the status of the first
+    write that failed.
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    DMF_ModuleLock(DmfModule);
+    ntStatus = Registry_DeferredWritesFlush(DmfModule);
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_DeferredWriteIntervalSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG IntervalMs
+    )
+/*++
+
+Routine Description:
+
+    Sets how long values written with DMF_Registry_PathAndValueWriteDeferred() remain pending
+    before they are written to the registry.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    IntervalMs - The interval in milliseconds.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_Registry* moduleContext;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    DmfAssert(IntervalMs > 0);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // The new interval is used the next time the timer is started.
+    //
+    DMF_ModuleLock(DmfModule);
+    moduleContext->DeferredWriteIntervalMs = IntervalMs;
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#endif
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 BOOLEAN
@@ -3011,6 +4842,7 @@ Return Value:
 {
     NTSTATUS ntStatus;
     HANDLE registryPathHandle;
+    DMF_CONTEXT_Registry* moduleContext;
 
     PAGED_CODE();
 
@@ -3026,6 +4858,24 @@ Return Value:
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  Registry);
 
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Only values under an explicit path are cached. The device key is opened by handle.
+    // NOTE: CacheEnabled is checked again under the Module lock.
+    //
+    if ((moduleContext->CacheEnabled) &&
+        (RegistryPathName != NULL))
+    {
+        ntStatus = Registry_CacheRead(DmfModule,
+                                      RegistryPathName,
+                                      ValueName,
+                                      RegistryType,
+                                      Buffer,
+                                      BufferSize,
+                                      BytesRead);
+        goto Exit;
+    }
+
     ntStatus = DMF_Registry_HandleOpenByNameEx(DmfModule,
                                                RegistryPathName,
                                                KEY_READ,
@@ -3650,6 +5500,70 @@ Return Value:
     return ntStatus;
 }
 
+#if !defined(DMF_USER_MODE)
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_PathAndValueWriteDeferred(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR RegistryPathName,
+    _In_ PWCHAR ValueName,
+    _In_ ULONG RegistryType,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize
+    )
+/*++
+
+Routine Description:
+
+    Write a value (of any REG_* type) given a registry path and value name at a later time.
+    If a write of the same value is already pending, only the latest data is written.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    RegistryPathName - Registry path to ValueName.
+    ValueName - Name of registry value to write.
+    RegistryType - The registry type of the value.
+    Buffer - The data that is written to the value.
+    BufferSize - Size of buffer in bytes.
+
+Return Value:
+
+    STATUS_SUCCESS if the write is pending or STATUS_INSUFFICIENT_RESOURCES if there is not
+    enough memory.
+
+--*/
+{
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DmfAssert(RegistryPathName != NULL);
+    DmfAssert(ValueName != NULL);
+    DmfAssert(*ValueName != L'\0');
+    DmfAssert(Buffer != NULL);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    DMF_ModuleLock(DmfModule);
+    ntStatus = Registry_DeferredWriteAdd(DmfModule,
+                                         RegistryPathName,
+                                         ValueName,
+                                         RegistryType,
+                                         Buffer,
+                                         BufferSize);
+    DMF_ModuleUnlock(DmfModule);
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+#endif
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -4116,6 +6030,166 @@ Return Value:
     return returnValue;
 }
 
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_TreeRead(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfReadEntries) Registry_ReadEntry* ReadEntries,
+    _In_ ULONG NumberOfReadEntries
+    )
+/*++
+
+Routine Description:
+
+    Reads a table of registry values into Client buffers. Each distinct key in the table is
+    opened once and all the values in that key are read using that handle.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    ReadEntries - The table of values to read.
+    NumberOfReadEntries - The number of entries in the table.
+
+Return Value:
+
+    STATUS_SUCCESS if every entry's destination is written with either the value or its default.
+    Otherwise, the status of the first entry that could not be written. All entries are
+    processed in either case.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    NTSTATUS ntStatusEntry;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDFMEMORY scratchMemory;
+    UCHAR* scratchBuffer;
+    ULONG scratchBufferSize;
+    ULONG entryIndex;
+    ULONG keyEntryIndex;
+    ULONG previousEntryIndex;
+    HANDLE registryPathHandle;
+    Registry_ReadEntry* readEntry;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 Registry);
+
+    DmfAssert(ReadEntries != NULL);
+    DmfAssert(NumberOfReadEntries > 0);
+
+    scratchMemory = NULL;
+
+    // Each value is read into a scratch buffer so that the destination is only written
+    // after the value is validated.
+    //
+    scratchBufferSize = 0;
+    for (entryIndex = 0; entryIndex < NumberOfReadEntries; entryIndex++)
+    {
+        if (ReadEntries[entryIndex].DestinationSize > scratchBufferSize)
+        {
+            scratchBufferSize = ReadEntries[entryIndex].DestinationSize;
+        }
+    }
+    if (0 == scratchBufferSize)
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               PagedPool,
+                               MemoryTag,
+                               scratchBufferSize,
+                               &scratchMemory,
+                               (VOID**)&scratchBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        scratchMemory = NULL;
+        goto Exit;
+    }
+
+    for (keyEntryIndex = 0; keyEntryIndex < NumberOfReadEntries; keyEntryIndex++)
+    {
+        // Skip entries whose key has already been read with an earlier entry.
+        //
+        for (previousEntryIndex = 0; previousEntryIndex < keyEntryIndex; previousEntryIndex++)
+        {
+            if (Registry_ReadEntryPathNamesEqual(ReadEntries[previousEntryIndex].RegistryPath,
+                                                 ReadEntries[keyEntryIndex].RegistryPath))
+            {
+                break;
+            }
+        }
+        if (previousEntryIndex < keyEntryIndex)
+        {
+            continue;
+        }
+
+        // Open the key once for all the entries located in it.
+        // If it cannot be opened, all these entries use their default value.
+        //
+        ntStatusEntry = DMF_Registry_HandleOpenByNameEx(DmfModule,
+                                                        ReadEntries[keyEntryIndex].RegistryPath,
+                                                        KEY_READ,
+                                                        FALSE,
+                                                        &registryPathHandle);
+        if (! NT_SUCCESS(ntStatusEntry))
+        {
+            TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "DMF_Registry_HandleOpenByNameEx fails: ntStatus=%!STATUS!", ntStatusEntry);
+            registryPathHandle = NULL;
+        }
+
+        for (entryIndex = keyEntryIndex; entryIndex < NumberOfReadEntries; entryIndex++)
+        {
+            readEntry = &ReadEntries[entryIndex];
+            if (! Registry_ReadEntryPathNamesEqual(readEntry->RegistryPath,
+                                                   ReadEntries[keyEntryIndex].RegistryPath))
+            {
+                continue;
+            }
+
+            ntStatusEntry = Registry_ReadEntryRead(DmfModule,
+                                                   (WDFKEY)registryPathHandle,
+                                                   readEntry,
+                                                   scratchBuffer,
+                                                   scratchBufferSize);
+            if ((! NT_SUCCESS(ntStatusEntry)) &&
+                NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Registry_ReadEntryRead fails: %ws ntStatus=%!STATUS!", readEntry->ValueName, ntStatusEntry);
+                ntStatus = ntStatusEntry;
+            }
+        }
+
+        if (registryPathHandle != NULL)
+        {
+            DMF_Registry_HandleClose(DmfModule,
+                                     registryPathHandle);
+            registryPathHandle = NULL;
+        }
+    }
+
+Exit:
+
+    if (scratchMemory != NULL)
+    {
+        WdfObjectDelete(scratchMemory);
+        scratchMemory = NULL;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
 #if !defined(DMF_USER_MODE)
 NTSTATUS
 DMF_Registry_TreeWriteDeferred(
@@ -147,6 +147,65 @@ EVT_DMF_Registry_ValueComparisonCallback(_In_ DMFMODULE DmfModule,
                                          _In_opt_ VOID* ClientDataInRegistry,
                                          _In_ ULONG ClientDataInRegistrySize);
 
+typedef
+_Function_class_(EVT_DMF_Registry_ValueValidate)
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+_IRQL_requires_same_
+BOOLEAN
+EVT_DMF_Registry_ValueValidate(_In_ DMFMODULE DmfModule,
+                               _In_ PWCHAR ValueName,
+                               _In_reads_bytes_(ValueDataSize) VOID* ValueData,
+                               _In_ ULONG ValueDataSize);
+
+// Holds information for a single value read by DMF_Registry_TreeRead().
+//
+typedef struct
+{
+    // Path of the key where the value is located. NULL for the device key.
+    // All entries with the same path are read using a single open of the key.
+    //
+    PWCHAR RegistryPath;
+    // Name of the value.
+    //
+    PWCHAR ValueName;
+    // Supported types are: 
+    // REG_DWORD, REG_QWORD, REG_SZ, REG_MULTI_SZ, REG_BINARY.
+    // The value is not read if its type in the registry is different.
+    //
+    ULONG ValueType;
+    // Where the value is written.
+    //
+    VOID* Destination;
+    // Size of the buffer pointed to by Destination.
+    //
+    ULONG DestinationSize;
+    // Optional. Written to Destination when the value cannot be read or is not valid.
+    //
+    VOID* DefaultValue;
+    // Size of the data pointed to by DefaultValue. Must not exceed DestinationSize.
+    //
+    ULONG DefaultValueSize;
+    // Optional. Called to validate the value read from the registry.
+    //
+    EVT_DMF_Registry_ValueValidate* ValueValidate;
+} Registry_ReadEntry;
+
+// Statistics of the read cache used by DMF_Registry_PathAndValueRead* Methods.
+//
+typedef struct
+{
+    // Number of reads returned from the cache.
+    //
+    ULONG64 Hits;
+    // Number of reads that were not in the cache.
+    //
+    ULONG64 Misses;
+    // Number of times a cached key was discarded because it changed.
+    //
+    ULONG64 Invalidations;
+} Registry_CacheStatistics;
+
 // This macro declares the following functions:
 // DMF_Registry_ATTRIBUTES_INIT()
 // DMF_Registry_Create()
@@ -166,6 +225,25 @@ DMF_Registry_AllSubKeysFromHandleEnumerate(
     _In_ VOID* ClientCallbackContext
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_CacheDisable(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_CacheEnable(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_CacheStatisticsGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ Registry_CacheStatistics* CacheStatistics
+    );
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -188,6 +266,21 @@ DMF_Registry_CustomAction(
     _In_opt_ VOID* ComparisonCallbackContext
     );
 
+#if !defined(DMF_USER_MODE)
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_DeferredWriteFlush(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_Registry_DeferredWriteIntervalSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG IntervalMs
+    );
+#endif
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 BOOLEAN
@@ -376,6 +469,20 @@ DMF_Registry_PathAndValueWriteBinary(
     _In_ ULONG BufferSize
     );
 
+#if !defined(DMF_USER_MODE)
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_PathAndValueWriteDeferred(
+    _In_ DMFMODULE DmfModule,
+    _In_ PWCHAR RegistryPathName,
+    _In_ PWCHAR ValueName,
+    _In_ ULONG RegistryType,
+    _In_reads_(BufferSize) UCHAR* Buffer,
+    _In_ ULONG BufferSize
+    );
+#endif
+
 _Must_inspect_result_
 _IRQL_requires_max_(PASSIVE_LEVEL)
 NTSTATUS
@@ -455,6 +562,15 @@ DMF_Registry_SubKeysFromPathNameContainingStringEnumerate(
     _In_ VOID* ClientCallbackContext
     );
 
+_Must_inspect_result_
+_IRQL_requires_max_(PASSIVE_LEVEL)
+NTSTATUS
+DMF_Registry_TreeRead(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(NumberOfReadEntries) Registry_ReadEntry* ReadEntries,
+    _In_ ULONG NumberOfReadEntries
+    );
+
 #if !defined(DMF_USER_MODE)
 NTSTATUS
 DMF_Registry_TreeWriteDeferred(
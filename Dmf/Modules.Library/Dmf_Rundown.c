@@ -40,16 +40,24 @@ Environment:
 
 typedef struct
 {
-    // Reference counter for DMF Object references.
+#if defined(DMF_USER_MODE)
+    // Rundown word. Bit 0 is set when new references are not allowed. The remaining bits
+    // hold the number of references. It is only updated with interlocked operations.
     //
-    volatile LONG ReferenceCount;
-    
-    // Flag indicating that the resource close is pending.
-    // This is necessary to synchronize close with methods that might still be
-    // using the resource.
+    volatile LONG RundownWord;
+    // Set when the last reference is released while waiting for rundown.
     //
-    BOOLEAN WaitingForRundown;
-
+    DMF_PORTABLE_EVENT RundownCompleteEvent;
+#else
+    // Rundown protection that is split across processors so that references taken on
+    // different processors do not contend on the same cache line.
+    //
+    PEX_RUNDOWN_REF_CACHE_AWARE RundownReference;
+#endif
+    // Indicates that DMF_Rundown_Start() has been called and DMF_Rundown_EndAndWait() has not.
+    // It is only accessed by Start, EndAndWait and Close while holding the Module lock.
+    //
+    BOOLEAN Started;
 } DMF_CONTEXT_Rundown;
 
 // This macro declares the following function:
@@ -62,89 +70,25 @@ DMF_MODULE_DECLARE_CONTEXT(Rundown)
 //
 DMF_MODULE_DECLARE_NO_CONFIG(Rundown)
 
+// Memory Pool Tag.
+//
+#define MemoryTag 'MnuR'
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // DMF Module Support Code
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
-_IRQL_requires_max_(DISPATCH_LEVEL)
-LONG
-Rundown_ReferenceAdd(
-    _In_ DMFMODULE DmfModule
-    )
-/*++
-
-Routine Description:
-
-    Increment the Module's Reference Count.
-
-Arguments:
-
-    DmfModule - This Module's handle.
-
-Return Value:
-
-    The updated reference count.
-
---*/
-{
-    LONG returnValue;
-    DMF_CONTEXT_Rundown* moduleContext;
+#if defined(DMF_USER_MODE)
 
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    FuncEntryArguments(DMF_TRACE, "DmfModule=0x%p", DmfModule);
-
-    // This routine must always be called in locked state.
-    //
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
-
-    returnValue = InterlockedIncrement(&moduleContext->ReferenceCount);
-
-    FuncExit(DMF_TRACE, "DmfModule=0x%p returnValue=%d", DmfModule, returnValue);
-
-    return returnValue;
-}
-
-_IRQL_requires_max_(DISPATCH_LEVEL)
-LONG
-Rundown_ReferenceDelete(
-    _In_ DMFMODULE DmfModule
-    )
-/*++
-
-Routine Description:
-
-    Decrement the Module's Reference Count.
-
-Arguments:
-
-    DmfModule - This Module's handle.
-
-Return Value:
-
-    The updated reference count.
-
---*/
-{
-    LONG returnValue;
-    DMF_CONTEXT_Rundown* moduleContext;
-
-    moduleContext = DMF_CONTEXT_GET(DmfModule);
-
-    FuncEntryArguments(DMF_TRACE, "DmfModule=0x%p", DmfModule);
-
-    // This routine must always be called in locked state.
-    //
-    DmfAssert(DMF_ModuleIsLocked(DmfModule));
-    DmfAssert(moduleContext->ReferenceCount > 0);
-
-    returnValue = InterlockedDecrement(&moduleContext->ReferenceCount);
+// Set in the rundown word when new references are not allowed.
+//
+#define Rundown_RundownActive       1
+// Amount added to the rundown word for each reference.
+//
+#define Rundown_ReferenceIncrement  2
 
-    FuncExit(DMF_TRACE, "DmfModule=0x%p returnValue=%d", DmfModule, returnValue);
-
-    return returnValue;
-}
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // WDF Module Callbacks
@@ -190,9 +134,35 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    DmfAssert(! moduleContext->Started);
+
+#if defined(DMF_USER_MODE)
+    // References are not allowed until the Client calls DMF_Rundown_Start().
+    //
+    moduleContext->RundownWord = Rundown_RundownActive;
+    DMF_Portable_EventCreate(&moduleContext->RundownCompleteEvent,
+                             NotificationEvent,
+                             FALSE);
+    ntStatus = STATUS_SUCCESS;
+#else
+    moduleContext->RundownReference = ExAllocateCacheAwareRundownProtection(NonPagedPoolNx,
+                                                                            MemoryTag);
+    if (NULL == moduleContext->RundownReference)
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ExAllocateCacheAwareRundownProtection fails: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    // References are not allowed until the Client calls DMF_Rundown_Start().
+    // There are no references yet so this does not wait.
+    //
+    ExWaitForRundownProtectionReleaseCacheAware(moduleContext->RundownReference);
+    ExRundownCompletedCacheAware(moduleContext->RundownReference);
     ntStatus = STATUS_SUCCESS;
 
-    DmfAssert(0 == moduleContext->ReferenceCount);
+Exit:
+#endif
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
@@ -236,20 +206,13 @@ Return Value:
 
     DMF_ModuleLock(DmfModule);
 
-    if ((! moduleContext->WaitingForRundown) &&
-        (moduleContext->ReferenceCount >= 1))
+    if (moduleContext->Started)
     {
         // This path should be avoided. Client did not call DMF_Rundown_EndAndWait().
         //
         DmfAssert(FALSE);
         endForClient = TRUE;
     }
-    else
-    {
-        // This is the normal path that should execute.
-        //
-        DmfAssert(0 == moduleContext->ReferenceCount);
-    }
 
     DMF_ModuleUnlock(DmfModule);
 
@@ -260,6 +223,22 @@ Return Value:
         DMF_Rundown_EndAndWait(DmfModule);
     }
 
+#if defined(DMF_USER_MODE)
+    DmfAssert(Rundown_RundownActive == moduleContext->RundownWord);
+    DMF_Portable_EventClose(&moduleContext->RundownCompleteEvent);
+#else
+    if (moduleContext->RundownReference != NULL)
+    {
+        ExFreeCacheAwareRundownProtection(moduleContext->RundownReference);
+        moduleContext->RundownReference = NULL;
+    }
+    else
+    {
+        // This can happen in cases of partial initialization.
+        //
+    }
+#endif
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -359,23 +338,31 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_Rundown* moduleContext;
+#if defined(DMF_USER_MODE)
+    LONG rundownWord;
+#endif
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  Rundown);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_ModuleLock(DmfModule);
-
-    Rundown_ReferenceDelete(DmfModule);
-    // The reference count should never reach zero if Client is using this
+#if defined(DMF_USER_MODE)
+    rundownWord = InterlockedExchangeAdd(&moduleContext->RundownWord,
+                                         -Rundown_ReferenceIncrement) - Rundown_ReferenceIncrement;
+    // The reference count should never go below zero if Client is using this
     // Module's Methods correctly.
-    // Start sets REference to 1.
-    // Reference will always increment to 2 minimum.
     //
-    DmfAssert(moduleContext->ReferenceCount >= 1);
-
-    DMF_ModuleUnlock(DmfModule);
+    DmfAssert(rundownWord >= 0);
+    if (Rundown_RundownActive == rundownWord)
+    {
+        // This was the last reference and DMF_Rundown_EndAndWait() is waiting for it.
+        //
+        DMF_Portable_EventSet(&moduleContext->RundownCompleteEvent);
+    }
+#else
+    ExReleaseRundownProtectionCacheAware(moduleContext->RundownReference);
+#endif
 }
 
 _IRQL_requires_max_(PASSIVE_LEVEL)
@@ -403,11 +390,10 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_Rundown* moduleContext;
-    LONG referenceCount;
-    // This value is chosen to give running thread time to execute,
-    // but short enough to allow fast response.
-    //
-    const ULONG referenceCountPollingIntervalMs = 100;
+    BOOLEAN started;
+#if defined(DMF_USER_MODE)
+    LONG rundownWord;
+#endif
 
     DMFMODULE_VALIDATE_IN_METHOD_CLOSING_OK(DmfModule,
                                             Rundown);
@@ -415,43 +401,46 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
     DMF_ModuleLock(DmfModule);
-
-    // Set WaitingForRundown to TRUE, to avoid Module Method from acquiring
-    // a reference to the Module infinitely and blocking the Module from closing.
-    //
-    moduleContext->WaitingForRundown = TRUE;
-    referenceCount = moduleContext->ReferenceCount;
-
+    started = moduleContext->Started;
+    moduleContext->Started = FALSE;
     DMF_ModuleUnlock(DmfModule);
 
-    while (referenceCount > 0)
+    if (! started)
     {
-        DMF_ModuleLock(DmfModule);
-
-        if (referenceCount == 1)
-        {
-            // Module Method is not running. Prevent any Module Method from starting because call Acquire will fail.
-            //
-            moduleContext->ReferenceCount = 0;
-            // For modules which open on notification callback, ReferenceCount = 0 means the Module is now closed.
-            //
-            moduleContext->WaitingForRundown = FALSE;
-        }
-        referenceCount = moduleContext->ReferenceCount;
-
-        DMF_ModuleUnlock(DmfModule);
+        // Rundown is not started or has already ended.
+        //
+        goto Exit;
+    }
 
-        if (referenceCount == 0)
-        {
-            break;
-        }
+#if defined(DMF_USER_MODE)
+    // Reset the event before new references are stopped so that the last
+    // Dereference after this point is not missed.
+    //
+    DMF_Portable_EventReset(&moduleContext->RundownCompleteEvent);
 
-        // Reference count > 1 means a Module Method is running.
-        // Wait for Reference count to run down to 0.
+    // Prevent any Module Method from starting because DMF_Rundown_Reference() will fail.
+    //
+    rundownWord = InterlockedOr(&moduleContext->RundownWord,
+                                Rundown_RundownActive);
+    DmfAssert(0 == (rundownWord & Rundown_RundownActive));
+    if (rundownWord != 0)
+    {
+        // A Module Method is running. Wait for it to call DMF_Rundown_Dereference().
         //
-        DMF_Utility_DelayMilliseconds(referenceCountPollingIntervalMs);
         TraceInformation(DMF_TRACE, "DmfModule=0x%p Waiting to close", DmfModule);
+        DMF_Portable_EventWaitForSingleObject(&moduleContext->RundownCompleteEvent,
+                                              NULL,
+                                              FALSE);
     }
+    DmfAssert(Rundown_RundownActive == moduleContext->RundownWord);
+#else
+    // Prevent any Module Method from starting and wait for the running ones to finish.
+    //
+    ExWaitForRundownProtectionReleaseCacheAware(moduleContext->RundownReference);
+    ExRundownCompletedCacheAware(moduleContext->RundownReference);
+#endif
+
+Exit:
 
     FuncExitVoid(DMF_TRACE);
 }
@@ -481,34 +470,53 @@ Return Value:
 {
     NTSTATUS ntStatus;
     DMF_CONTEXT_Rundown* moduleContext;
+#if defined(DMF_USER_MODE)
+    LONG rundownWord;
+    LONG previousRundownWord;
+#endif
 
     DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
                                  Rundown);
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    DMF_ModuleLock(DmfModule);
-
-    // Increase reference only if Module is open (ReferenceCount >= 1) and if the Module close is not pending.
+    // Increase reference only if rundown is started and has not ended.
     // This is to stop new Module method callers from repeatedly accessing the Module when it should be closing.
     //
-    if ((moduleContext->ReferenceCount >= 1) &&
-        (! moduleContext->WaitingForRundown))
+#if defined(DMF_USER_MODE)
+    rundownWord = moduleContext->RundownWord;
+    ntStatus = STATUS_SUCCESS;
+    for (;;)
     {
-        // Increase reference count to ensure that Module will not be closed while a Module method is running.
+        if (rundownWord & Rundown_RundownActive)
+        {
+            ntStatus = STATUS_INVALID_DEVICE_STATE;
+            break;
+        }
+        previousRundownWord = InterlockedCompareExchange(&moduleContext->RundownWord,
+                                                         rundownWord + Rundown_ReferenceIncrement,
+                                                         rundownWord);
+        if (previousRundownWord == rundownWord)
+        {
+            break;
+        }
+        // Another reference was taken or released at the same time. Try again.
         //
-        Rundown_ReferenceAdd(DmfModule);
+        rundownWord = previousRundownWord;
+    }
+#else
+    if (ExAcquireRundownProtectionCacheAware(moduleContext->RundownReference))
+    {
         ntStatus = STATUS_SUCCESS;
     }
     else
     {
-        // Tell caller that this Module has not started and that Module Method should not do anything.
-        //
         ntStatus = STATUS_INVALID_DEVICE_STATE;
     }
+#endif
 
-    DMF_ModuleUnlock(DmfModule);
-
+    // If it fails, tell caller that this Module has not started and that Module Method should not do anything.
+    //
     return ntStatus;
 }
 
@@ -521,7 +529,7 @@ DMF_Rundown_Start(
 
 Routine Description: 
 
-    Used to set initial reference count at the start of the Rundown lifetime to 1.
+    Allows references to be acquired until DMF_Rundown_EndAndWait() is called.
     Needs to be called by the Client before the Rundown Reference and Dereference use. 
 
 Arguments:
@@ -543,10 +551,24 @@ Return Value:
 
     DMF_ModuleLock(DmfModule);
 
-    // This is a reference that will be dereferenced in DMF_Rundown_EndAndWait().
-    //
-    moduleContext->WaitingForRundown = FALSE;
-    moduleContext->ReferenceCount = 1;
+    if (moduleContext->Started)
+    {
+        // Client called Start twice without calling EndAndWait.
+        //
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+#if defined(DMF_USER_MODE)
+    DmfAssert(Rundown_RundownActive == moduleContext->RundownWord);
+    InterlockedExchange(&moduleContext->RundownWord,
+                        0);
+#else
+    ExReInitializeCacheAwareRundownProtection(moduleContext->RundownReference);
+#endif
+    moduleContext->Started = TRUE;
+
+Exit:
 
     DMF_ModuleUnlock(DmfModule);
 
@@ -31,6 +31,80 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Maximum number of instances that can use the shared scheduler of a single WDFDEVICE.
+//
+#define ScheduledTask_SchedulerMaximumTasks         64
+// Indicates that an instance is not in the shared scheduler's heap.
+//
+#define ScheduledTask_SchedulerHeapIndexInvalid     ((ULONG)-1)
+// Name of the registry value that holds TimesRun of all instances that use the shared scheduler.
+//
+#define ScheduledTask_SchedulerTimesRunValueName    L"ScheduledTaskTimesRun"
+
+// An instance that is waiting in the shared scheduler for its deferred callback to execute.
+//
+typedef struct
+{
+    // Time in milliseconds when the deferred callback should execute.
+    //
+    ULONGLONG DeadlineMs;
+    // The deferred callback may execute this many milliseconds before DeadlineMs.
+    //
+    ULONG ToleranceMs;
+    // The instance.
+    //
+    DMFMODULE DmfModule;
+} SCHEDULEDTASK_SCHEDULER_ENTRY;
+
+// TimesRun of a single instance that uses the shared scheduler.
+//
+typedef struct
+{
+    ULONG TaskId;
+    ULONG TimesRun;
+} SCHEDULEDTASK_TIMES_RUN_RECORD;
+
+// Shared scheduler. A single instance of this structure is attached to each WDFDEVICE
+// that has instances that set UseSharedScheduler.
+//
+typedef struct
+{
+    // Protects all the fields below. Set once by the first instance that opens.
+    //
+    WDFWAITLOCK Lock;
+    // The single timer that services all the instances. Set once by the first instance that opens.
+    //
+    WDFTIMER Timer;
+    // Number of open instances that use this scheduler. Each one has a reserved
+    // entry in Heap.
+    //
+    ULONG NumberOfTasks;
+    // Min-heap of waiting instances ordered by DeadlineMs.
+    //
+    SCHEDULEDTASK_SCHEDULER_ENTRY Heap[ScheduledTask_SchedulerMaximumTasks];
+    ULONG HeapCount;
+    // Deadline the timer is currently set for.
+    //
+    ULONGLONG TimerDeadlineMs;
+    BOOLEAN TimerIsSet;
+    // Number of timer callbacks that are executing deferred callbacks. The timer is
+    // not restarted while this is not zero because the timer callback restarts it
+    // when it finishes.
+    //
+    ULONG DispatchCount;
+    // TimesRun of all the instances. It is read from the registry once and written back
+    // as a single value.
+    //
+    SCHEDULEDTASK_TIMES_RUN_RECORD TimesRunRecords[ScheduledTask_SchedulerMaximumTasks];
+    ULONG TimesRunRecordCount;
+    BOOLEAN TimesRunLoaded;
+    // TimesRun was changed while deferred callbacks were executing. It is written
+    // once after they have all executed.
+    //
+    BOOLEAN TimesRunDirty;
+} SCHEDULEDTASK_SCHEDULER;
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(SCHEDULEDTASK_SCHEDULER, ScheduledTask_SchedulerContextGet)
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -78,6 +152,21 @@ typedef struct
     // routine will execute.
     //
     LONG NumberOfPendingCalls;
+
+    // Shared scheduler support.
+    // -------------------------
+    // The shared scheduler of this Module's WDFDEVICE if UseSharedScheduler is set.
+    //
+    SCHEDULEDTASK_SCHEDULER* Scheduler;
+    // Index of this instance in the shared scheduler's heap.
+    //
+    ULONG SchedulerHeapIndex;
+    // Indicates that the shared scheduler is executing this instance's deferred callback.
+    //
+    BOOLEAN SchedulerDispatching;
+    // Set when the shared scheduler is not executing this instance's deferred callback.
+    //
+    DMF_PORTABLE_EVENT SchedulerDispatchCompleteEvent;
 } DMF_CONTEXT_ScheduledTask;
 
 // This macro declares the following function:
@@ -99,6 +188,761 @@ DMF_MODULE_DECLARE_CONFIG(ScheduledTask)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Shared Scheduler
+// ----------------
+//
+
+static
+ULONGLONG
+ScheduledTask_CurrentTimeMsGet(
+    VOID
+    )
+/*++
+
+Routine Description:
+
+    Returns a monotonic time in milliseconds used for shared scheduler deadlines.
+
+Parameters:
+
+    None
+
+Return:
+
+    Current time in milliseconds.
+
+--*/
+{
+#if defined(DMF_USER_MODE)
+    return GetTickCount64();
+#else
+    // Interrupt time is in 100 nanosecond units.
+    //
+    return KeQueryInterruptTime() / 10000;
+#endif // defined(DMF_USER_MODE)
+}
+
+static
+VOID
+ScheduledTask_SchedulerHeapSwap(
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler,
+    _In_ ULONG FirstIndex,
+    _In_ ULONG SecondIndex
+    )
+/*++
+
+Routine Description:
+
+    Swap two entries of the shared scheduler's heap and update the indexes saved in
+    the corresponding instances.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Scheduler - The shared scheduler.
+    FirstIndex - Index of the first entry.
+    SecondIndex - Index of the second entry.
+
+Return:
+
+    None
+
+--*/
+{
+    SCHEDULEDTASK_SCHEDULER_ENTRY entry;
+
+    entry = Scheduler->Heap[FirstIndex];
+    Scheduler->Heap[FirstIndex] = Scheduler->Heap[SecondIndex];
+    Scheduler->Heap[SecondIndex] = entry;
+
+    DMF_CONTEXT_GET(Scheduler->Heap[FirstIndex].DmfModule)->SchedulerHeapIndex = FirstIndex;
+    DMF_CONTEXT_GET(Scheduler->Heap[SecondIndex].DmfModule)->SchedulerHeapIndex = SecondIndex;
+}
+
+static
+VOID
+ScheduledTask_SchedulerHeapSiftUp(
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler,
+    _In_ ULONG HeapIndex
+    )
+/*++
+
+Routine Description:
+
+    Move an entry of the shared scheduler's heap toward the root until its parent's
+    deadline is not later than its own.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Scheduler - The shared scheduler.
+    HeapIndex - Index of the entry to move.
+
+Return:
+
+    None
+
+--*/
+{
+    ULONG parentIndex;
+
+    while (HeapIndex > 0)
+    {
+        parentIndex = (HeapIndex - 1) / 2;
+        if (Scheduler->Heap[parentIndex].DeadlineMs <= Scheduler->Heap[HeapIndex].DeadlineMs)
+        {
+            break;
+        }
+        ScheduledTask_SchedulerHeapSwap(Scheduler,
+                                        parentIndex,
+                                        HeapIndex);
+        HeapIndex = parentIndex;
+    }
+}
+
+static
+VOID
+ScheduledTask_SchedulerHeapSiftDown(
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler,
+    _In_ ULONG HeapIndex
+    )
+/*++
+
+Routine Description:
+
+    Move an entry of the shared scheduler's heap away from the root until neither of
+    its children has an earlier deadline.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Scheduler - The shared scheduler.
+    HeapIndex - Index of the entry to move.
+
+Return:
+
+    None
+
+--*/
+{
+    ULONG childIndex;
+    ULONG smallestIndex;
+
+    for (;;)
+    {
+        smallestIndex = HeapIndex;
+        childIndex = (2 * HeapIndex) + 1;
+        if ((childIndex < Scheduler->HeapCount) &&
+            (Scheduler->Heap[childIndex].DeadlineMs < Scheduler->Heap[smallestIndex].DeadlineMs))
+        {
+            smallestIndex = childIndex;
+        }
+        childIndex++;
+        if ((childIndex < Scheduler->HeapCount) &&
+            (Scheduler->Heap[childIndex].DeadlineMs < Scheduler->Heap[smallestIndex].DeadlineMs))
+        {
+            smallestIndex = childIndex;
+        }
+        if (smallestIndex == HeapIndex)
+        {
+            break;
+        }
+        ScheduledTask_SchedulerHeapSwap(Scheduler,
+                                        HeapIndex,
+                                        smallestIndex);
+        HeapIndex = smallestIndex;
+    }
+}
+
+static
+VOID
+ScheduledTask_SchedulerHeapRemove(
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler,
+    _In_ ULONG HeapIndex
+    )
+/*++
+
+Routine Description:
+
+    Remove an entry from the shared scheduler's heap.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Scheduler - The shared scheduler.
+    HeapIndex - Index of the entry to remove.
+
+Return:
+
+    None
+
+--*/
+{
+    ULONG lastIndex;
+
+    DmfAssert(HeapIndex < Scheduler->HeapCount);
+
+    DMF_CONTEXT_GET(Scheduler->Heap[HeapIndex].DmfModule)->SchedulerHeapIndex = ScheduledTask_SchedulerHeapIndexInvalid;
+
+    lastIndex = Scheduler->HeapCount - 1;
+    Scheduler->HeapCount = lastIndex;
+    if (HeapIndex != lastIndex)
+    {
+        // Move the last entry into the hole and restore the heap order.
+        //
+        Scheduler->Heap[HeapIndex] = Scheduler->Heap[lastIndex];
+        DMF_CONTEXT_GET(Scheduler->Heap[HeapIndex].DmfModule)->SchedulerHeapIndex = HeapIndex;
+        ScheduledTask_SchedulerHeapSiftDown(Scheduler,
+                                            HeapIndex);
+        ScheduledTask_SchedulerHeapSiftUp(Scheduler,
+                                          HeapIndex);
+    }
+}
+
+static
+VOID
+ScheduledTask_SchedulerTimerSet(
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler
+    )
+/*++
+
+Routine Description:
+
+    Start the shared scheduler's timer so that it expires at the earliest deadline in the
+    heap. The timer is not restarted if it is already set to expire at or before that deadline.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Scheduler - The shared scheduler.
+
+Return:
+
+    None
+
+--*/
+{
+    ULONGLONG deadlineMs;
+    ULONGLONG currentTimeMs;
+    ULONGLONG timeoutMs;
+
+    if ((Scheduler->DispatchCount > 0) ||
+        (0 == Scheduler->HeapCount))
+    {
+        // The timer callback will set the timer when it finishes, or there is nothing to wait for.
+        //
+        goto Exit;
+    }
+
+    deadlineMs = Scheduler->Heap[0].DeadlineMs;
+    if ((Scheduler->TimerIsSet) &&
+        (Scheduler->TimerDeadlineMs <= deadlineMs))
+    {
+        goto Exit;
+    }
+
+    currentTimeMs = ScheduledTask_CurrentTimeMsGet();
+    if (deadlineMs > currentTimeMs)
+    {
+        timeoutMs = deadlineMs - currentTimeMs;
+    }
+    else
+    {
+        timeoutMs = 0;
+    }
+
+    Scheduler->TimerIsSet = TRUE;
+    Scheduler->TimerDeadlineMs = deadlineMs;
+    WdfTimerStart(Scheduler->Timer,
+                  WDF_REL_TIMEOUT_IN_MS(timeoutMs));
+
+Exit:
+    ;
+}
+
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_SchedulerAdd(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMs
+    )
+/*++
+
+Routine Description:
+
+    Add an instance to the shared scheduler so that its deferred callback executes after
+    the given timeout.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+    TimeoutMs - Time in milliseconds before the deferred callback executes.
+
+Return:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    DMF_CONFIG_ScheduledTask* moduleConfig;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    ULONG heapIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    scheduler = moduleContext->Scheduler;
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+
+    // Every open instance reserves an entry so the heap cannot be full.
+    //
+    DmfAssert(ScheduledTask_SchedulerHeapIndexInvalid == moduleContext->SchedulerHeapIndex);
+    DmfAssert(scheduler->HeapCount < scheduler->NumberOfTasks);
+
+    heapIndex = scheduler->HeapCount;
+    scheduler->HeapCount++;
+    scheduler->Heap[heapIndex].DeadlineMs = ScheduledTask_CurrentTimeMsGet() + TimeoutMs;
+    scheduler->Heap[heapIndex].ToleranceMs = moduleConfig->SharedSchedulerToleranceMs;
+    scheduler->Heap[heapIndex].DmfModule = DmfModule;
+    moduleContext->SchedulerHeapIndex = heapIndex;
+    ScheduledTask_SchedulerHeapSiftUp(scheduler,
+                                      heapIndex);
+
+    ScheduledTask_SchedulerTimerSet(scheduler);
+
+    WdfWaitLockRelease(scheduler->Lock);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_SchedulerRemove(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Remove an instance from the shared scheduler and wait for its deferred callback to
+    finish if it is executing. This is the equivalent of stopping the instance's timer
+    and waiting for its callback.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+
+Return:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    BOOLEAN dispatching;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    scheduler = moduleContext->Scheduler;
+
+    // The deferred callback may add the instance again while it executes, so repeat
+    // until the instance is neither waiting nor executing.
+    //
+    do
+    {
+        WdfWaitLockAcquire(scheduler->Lock,
+                           NULL);
+
+        if (moduleContext->SchedulerHeapIndex != ScheduledTask_SchedulerHeapIndexInvalid)
+        {
+            ScheduledTask_SchedulerHeapRemove(scheduler,
+                                              moduleContext->SchedulerHeapIndex);
+        }
+        dispatching = moduleContext->SchedulerDispatching;
+
+        WdfWaitLockRelease(scheduler->Lock);
+
+        if (dispatching)
+        {
+            DMF_Portable_EventWaitForSingleObject(&moduleContext->SchedulerDispatchCompleteEvent,
+                                                  NULL,
+                                                  FALSE);
+        }
+    } while (dispatching);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_SchedulerTimesRunLoad(
+    _In_ WDFDEVICE Device,
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler
+    )
+/*++
+
+Routine Description:
+
+    Read TimesRun of all the instances that use the shared scheduler from the registry
+    if it has not been read yet.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Device - WDFDEVICE the shared scheduler is attached to.
+    Scheduler - The shared scheduler.
+
+Return:
+
+    None
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFKEY wdfKey;
+    WDFDRIVER driver;
+    UNICODE_STRING valueNameString;
+    ULONG valueLength;
+
+    PAGED_CODE();
+
+    if (Scheduler->TimesRunLoaded)
+    {
+        goto Exit;
+    }
+
+    // If the value cannot be read, all instances start with TimesRun of zero.
+    //
+    Scheduler->TimesRunLoaded = TRUE;
+    Scheduler->TimesRunRecordCount = 0;
+
+    wdfKey = NULL;
+    driver = WdfDeviceGetDriver(Device);
+
+    // KEY_READ is OK for both Kernel-mode and User-mode.
+    //
+    ntStatus = WdfDriverOpenParametersRegistryKey(driver,
+                                                  KEY_READ,
+                                                  WDF_NO_OBJECT_ATTRIBUTES,
+                                                  &wdfKey);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfDriverOpenParametersRegistryKey ntStatus=%!STATUS!", ntStatus);
+        wdfKey = NULL;
+        goto Exit;
+    }
+
+    valueLength = 0;
+    RtlInitUnicodeString(&valueNameString,
+                         ScheduledTask_SchedulerTimesRunValueName);
+    ntStatus = WdfRegistryQueryValue(wdfKey,
+                                     &valueNameString,
+                                     sizeof(Scheduler->TimesRunRecords),
+                                     Scheduler->TimesRunRecords,
+                                     &valueLength,
+                                     NULL);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "WdfRegistryQueryValue ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    Scheduler->TimesRunRecordCount = valueLength / sizeof(SCHEDULEDTASK_TIMES_RUN_RECORD);
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Read TimesRunRecordCount=%u", Scheduler->TimesRunRecordCount);
+
+Exit:
+
+    if (wdfKey != NULL)
+    {
+        WdfRegistryClose(wdfKey);
+        wdfKey = NULL;
+    }
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+ScheduledTask_SchedulerTimesRunWrite(
+    _In_ WDFDEVICE Device,
+    _Inout_ SCHEDULEDTASK_SCHEDULER* Scheduler
+    )
+/*++
+
+Routine Description:
+
+    Write TimesRun of all the instances that use the shared scheduler to the registry
+    as a single value.
+    NOTE: Scheduler lock must be held.
+
+Parameters:
+
+    Device - WDFDEVICE the shared scheduler is attached to.
+    Scheduler - The shared scheduler.
+
+Return:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    WDFKEY wdfKey;
+    WDFDRIVER driver;
+    UNICODE_STRING valueNameString;
+    ACCESS_MASK accessMask;
+
+    PAGED_CODE();
+
+    wdfKey = NULL;
+    driver = WdfDeviceGetDriver(Device);
+
+    // Whether or not the write succeeds, do not try again until the next change.
+    //
+    Scheduler->TimesRunDirty = FALSE;
+
+#if !defined(DMF_USER_MODE)
+    accessMask = KEY_WRITE;
+#else
+    accessMask = KEY_SET_VALUE;
+#endif // !defined(DMF_USER_MODE)
+
+    ntStatus = WdfDriverOpenParametersRegistryKey(driver,
+                                                  accessMask,
+                                                  WDF_NO_OBJECT_ATTRIBUTES,
+                                                  &wdfKey);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfDriverOpenParametersRegistryKey ntStatus=%!STATUS!", ntStatus);
+        wdfKey = NULL;
+        goto Exit;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Write TimesRunRecordCount=%u", Scheduler->TimesRunRecordCount);
+
+    RtlInitUnicodeString(&valueNameString,
+                         ScheduledTask_SchedulerTimesRunValueName);
+    ntStatus = WdfRegistryAssignValue(wdfKey,
+                                      &valueNameString,
+                                      REG_BINARY,
+                                      Scheduler->TimesRunRecordCount * sizeof(SCHEDULEDTASK_TIMES_RUN_RECORD),
+                                      Scheduler->TimesRunRecords);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfRegistryAssignValue ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+Exit:
+
+    if (wdfKey != NULL)
+    {
+        WdfRegistryClose(wdfKey);
+        wdfKey = NULL;
+    }
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+ScheduledTask_SchedulerTimesRunGet(
+    _In_ DMFMODULE DmfModule,
+    _Out_ ULONG* TimesRun
+    )
+/*++
+
+Routine Description:
+
+    Get this instance's TimesRun from the shared scheduler.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+    TimesRun - Value that is read.
+
+Return:
+
+    STATUS_SUCCESS - TimesRun has been read.
+    STATUS_NOT_FOUND - TimesRun has never been written for this instance.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    DMF_CONFIG_ScheduledTask* moduleConfig;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    ULONG recordIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    scheduler = moduleContext->Scheduler;
+
+    *TimesRun = 0;
+    ntStatus = STATUS_NOT_FOUND;
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+
+    ScheduledTask_SchedulerTimesRunLoad(DMF_ParentDeviceGet(DmfModule),
+                                        scheduler);
+
+    for (recordIndex = 0; recordIndex < scheduler->TimesRunRecordCount; recordIndex++)
+    {
+        if (scheduler->TimesRunRecords[recordIndex].TaskId == moduleConfig->SharedSchedulerTaskId)
+        {
+            *TimesRun = scheduler->TimesRunRecords[recordIndex].TimesRun;
+            ntStatus = STATUS_SUCCESS;
+            break;
+        }
+    }
+
+    WdfWaitLockRelease(scheduler->Lock);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+NTSTATUS
+ScheduledTask_SchedulerTimesRunSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimesRun
+    )
+/*++
+
+Routine Description:
+
+    Set this instance's TimesRun in the shared scheduler. If deferred callbacks are
+    executing, the registry is written once after they have all executed. Otherwise,
+    it is written now.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+    TimesRun - Value to write.
+
+Return:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    DMF_CONFIG_ScheduledTask* moduleConfig;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    ULONG recordIndex;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+    scheduler = moduleContext->Scheduler;
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+
+    ScheduledTask_SchedulerTimesRunLoad(DMF_ParentDeviceGet(DmfModule),
+                                        scheduler);
+
+    for (recordIndex = 0; recordIndex < scheduler->TimesRunRecordCount; recordIndex++)
+    {
+        if (scheduler->TimesRunRecords[recordIndex].TaskId == moduleConfig->SharedSchedulerTaskId)
+        {
+            break;
+        }
+    }
+    if (recordIndex == scheduler->TimesRunRecordCount)
+    {
+        if (recordIndex == ScheduledTask_SchedulerMaximumTasks)
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "No space for TaskId=%u", moduleConfig->SharedSchedulerTaskId);
+            goto Exit;
+        }
+        scheduler->TimesRunRecords[recordIndex].TaskId = moduleConfig->SharedSchedulerTaskId;
+        scheduler->TimesRunRecordCount++;
+    }
+    scheduler->TimesRunRecords[recordIndex].TimesRun = TimesRun;
+
+    if (scheduler->DispatchCount > 0)
+    {
+        scheduler->TimesRunDirty = TRUE;
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = ScheduledTask_SchedulerTimesRunWrite(DMF_ParentDeviceGet(DmfModule),
+                                                        scheduler);
+    }
+
+Exit:
+
+    WdfWaitLockRelease(scheduler->Lock);
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_TimerStart(
+    _In_ DMFMODULE DmfModule,
+    _In_ ULONG TimeoutMs
+    )
+/*++
+
+Routine Description:
+
+    Cause the deferred callback to execute after the given timeout using either this
+    instance's timer or the shared scheduler.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+    TimeoutMs - Time in milliseconds before the deferred callback executes.
+
+Return:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    DmfAssert(moduleContext->TimerIsStarted);
+
+    if (moduleContext->Scheduler != NULL)
+    {
+        ScheduledTask_SchedulerAdd(DmfModule,
+                                   TimeoutMs);
+    }
+    else
+    {
+        WdfTimerStart(moduleContext->Timer,
+                      WDF_REL_TIMEOUT_IN_MS(TimeoutMs));
+    }
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 ScheduledTask_Result_Type
 ScheduledTask_ClientWorkDo(
@@ -221,8 +1065,8 @@ Return:
             {
                 TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Timer RESTART");
                 moduleContext->TimerIsStarted = TRUE;
-                WdfTimerStart(moduleContext->Timer,
-                              WDF_REL_TIMEOUT_IN_MS(moduleConfig->TimerPeriodMsOnSuccess));
+                ScheduledTask_TimerStart(DmfModule,
+                                         moduleConfig->TimerPeriodMsOnSuccess);
             }
             else
             {
@@ -251,8 +1095,8 @@ Return:
             {
                 TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Timer RESTART");
                 moduleContext->TimerIsStarted = TRUE;
-                WdfTimerStart(moduleContext->Timer,
-                              WDF_REL_TIMEOUT_IN_MS(moduleConfig->TimerPeriodMsOnFail));
+                ScheduledTask_TimerStart(DmfModule,
+                                         moduleConfig->TimerPeriodMsOnFail);
             }
             else
             {
@@ -277,6 +1121,48 @@ Exit:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_TimerExpired(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Execute the deferred work the Client wants to perform one time.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+
+Return:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Timer has executed. Remember this.
+    //
+    DmfAssert(moduleContext->TimerIsStarted);
+    moduleContext->TimerIsStarted = FALSE;
+
+    // Deferred operations do not return the result.
+    // If the Client needs the result of the operation, then the deferred option
+    // cannot be used.
+    //
+    ScheduledTask_ClientWorkDo(DmfModule,
+                               WdfPowerDeviceInvalid);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_WDF_TIMER)
 VOID
@@ -300,8 +1186,6 @@ Return:
 --*/
 {
     DMFMODULE dmfModule;
-    DMF_CONTEXT_ScheduledTask* moduleContext;
-    DMF_CONFIG_ScheduledTask* moduleConfig;
 
     PAGED_CODE();
 
@@ -312,26 +1196,304 @@ Return:
     dmfModule = (DMFMODULE)WdfTimerGetParentObject(WdfTimer);
     DmfAssert(dmfModule != NULL);
 
-    moduleContext = DMF_CONTEXT_GET(dmfModule);
+    ScheduledTask_TimerExpired(dmfModule);
 
-    moduleConfig = DMF_CONFIG_GET(dmfModule);
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
 
-    // Timer has executed. Remember this.
-    //
-    DmfAssert(moduleContext->TimerIsStarted);
-    moduleContext->TimerIsStarted = FALSE;
+#pragma code_seg("PAGE")
+_Function_class_(EVT_WDF_TIMER)
+VOID
+ScheduledTask_SchedulerTimerHandler(
+    _In_ WDFTIMER WdfTimer
+    )
+/*++
 
-    // Deferred operations do not return the result.
-    // If the Client needs the result of the operation, then the deferred option
-    // cannot be used.
+Routine Description:
+
+    Execute the deferred work of all the instances using the shared scheduler whose
+    deadlines have passed or are within their tolerance. Then, set the timer for the
+    next earliest deadline.
+
+Parameters:
+
+    WdfTimer - Timer object that spawns this call.
+
+Return:
+
+    None
+
+--*/
+{
+    WDFDEVICE device;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    DMFMODULE dueModules[ScheduledTask_SchedulerMaximumTasks];
+    ULONG dueModuleCount;
+    ULONG dueModuleIndex;
+    ULONGLONG currentTimeMs;
+    NTSTATUS ntStatus;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    device = (WDFDEVICE)WdfTimerGetParentObject(WdfTimer);
+    scheduler = ScheduledTask_SchedulerContextGet(device);
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+
+    scheduler->TimerIsSet = FALSE;
+    scheduler->DispatchCount++;
+
+    // Remove all the due instances from the heap. Instances that are added again
+    // while their callbacks execute wait for the next timer expiration.
     //
-    ScheduledTask_ClientWorkDo(dmfModule,
-                               WdfPowerDeviceInvalid);
+    currentTimeMs = ScheduledTask_CurrentTimeMsGet();
+    dueModuleCount = 0;
+    while ((scheduler->HeapCount > 0) &&
+           (scheduler->Heap[0].DeadlineMs <= currentTimeMs + scheduler->Heap[0].ToleranceMs))
+    {
+        dueModules[dueModuleCount] = scheduler->Heap[0].DmfModule;
+        moduleContext = DMF_CONTEXT_GET(dueModules[dueModuleCount]);
+        ScheduledTask_SchedulerHeapRemove(scheduler,
+                                          0);
+        moduleContext->SchedulerDispatching = TRUE;
+        DMF_Portable_EventReset(&moduleContext->SchedulerDispatchCompleteEvent);
+        dueModuleCount++;
+    }
+
+    WdfWaitLockRelease(scheduler->Lock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "ScheduledTask shared timer expires: dueModuleCount=%u", dueModuleCount);
+
+    for (dueModuleIndex = 0; dueModuleIndex < dueModuleCount; dueModuleIndex++)
+    {
+        moduleContext = DMF_CONTEXT_GET(dueModules[dueModuleIndex]);
+
+        ScheduledTask_TimerExpired(dueModules[dueModuleIndex]);
+
+        // Once the event is set, the instance may close. Do not use it after that.
+        //
+        WdfWaitLockAcquire(scheduler->Lock,
+                           NULL);
+        moduleContext->SchedulerDispatching = FALSE;
+        DMF_Portable_EventSet(&moduleContext->SchedulerDispatchCompleteEvent);
+        WdfWaitLockRelease(scheduler->Lock);
+    }
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+
+    DmfAssert(scheduler->DispatchCount > 0);
+    scheduler->DispatchCount--;
+    if (0 == scheduler->DispatchCount)
+    {
+        // Write all the TimesRun changes made by the callbacks at once.
+        //
+        if (scheduler->TimesRunDirty)
+        {
+            ntStatus = ScheduledTask_SchedulerTimesRunWrite(device,
+                                                            scheduler);
+            if (! NT_SUCCESS(ntStatus))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ScheduledTask_SchedulerTimesRunWrite fails: ntStatus=%!STATUS!", ntStatus);
+            }
+        }
+        ScheduledTask_SchedulerTimerSet(scheduler);
+    }
+
+    WdfWaitLockRelease(scheduler->Lock);
 
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_Must_inspect_result_
+static
+NTSTATUS
+ScheduledTask_SchedulerOpen(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Attach this instance to the shared scheduler of its WDFDEVICE. The shared scheduler is
+    created by the first instance that uses it. Instances may be opened at the same time
+    (see DMF_MODULE_ATTRIBUTES.OpenInParallel), so the lock and the timer of the scheduler
+    are published atomically. An instance that loses the race deletes the object it created.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+
+Return:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    WDFDEVICE device;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    WDF_TIMER_CONFIG timerConfig;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+    WDFWAITLOCK lock;
+    WDFTIMER timer;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    device = DMF_ParentDeviceGet(DmfModule);
+
+    // WDF allocates the context once. If the scheduler already exists, its address is returned.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&objectAttributes,
+                                            SCHEDULEDTASK_SCHEDULER);
+    ntStatus = WdfObjectAllocateContext(device,
+                                        &objectAttributes,
+                                        (VOID**)&scheduler);
+    if ((! NT_SUCCESS(ntStatus)) ||
+        (NULL == scheduler))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfObjectAllocateContext fails: ntStatus=%!STATUS!", ntStatus);
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        goto Exit;
+    }
+
+    if (NULL == scheduler->Lock)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = device;
+        ntStatus = WdfWaitLockCreate(&objectAttributes,
+                                     &lock);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfWaitLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        if (InterlockedCompareExchangePointer((PVOID volatile*)&scheduler->Lock,
+                                              lock,
+                                              NULL) != NULL)
+        {
+            WdfObjectDelete(lock);
+        }
+    }
+
+    if (NULL == scheduler->Timer)
+    {
+        // The timer serves instances of many Modules, so it is not serialized with any
+        // of them. The scheduler lock is used instead.
+        //
+        WDF_TIMER_CONFIG_INIT(&timerConfig,
+                              ScheduledTask_SchedulerTimerHandler);
+        timerConfig.AutomaticSerialization = FALSE;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = device;
+        objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+        ntStatus = WdfTimerCreate(&timerConfig,
+                                  &objectAttributes,
+                                  &timer);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+        if (InterlockedCompareExchangePointer((PVOID volatile*)&scheduler->Timer,
+                                              timer,
+                                              NULL) != NULL)
+        {
+            // The timer has never been started.
+            //
+            WdfObjectDelete(timer);
+        }
+    }
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+    if (scheduler->NumberOfTasks < ScheduledTask_SchedulerMaximumTasks)
+    {
+        // Reserve an entry in the heap for this instance.
+        //
+        scheduler->NumberOfTasks++;
+        ntStatus = STATUS_SUCCESS;
+    }
+    else
+    {
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+    }
+    WdfWaitLockRelease(scheduler->Lock);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Too many instances use the shared scheduler: ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    DMF_Portable_EventCreate(&moduleContext->SchedulerDispatchCompleteEvent,
+                             NotificationEvent,
+                             TRUE);
+    moduleContext->SchedulerDispatching = FALSE;
+    moduleContext->SchedulerHeapIndex = ScheduledTask_SchedulerHeapIndexInvalid;
+    moduleContext->Scheduler = scheduler;
+
+Exit:
+
+    return ntStatus;
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+static
+VOID
+ScheduledTask_SchedulerClose(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Detach this instance from the shared scheduler of its WDFDEVICE after waiting for
+    its deferred callback to finish. The shared scheduler remains until the WDFDEVICE
+    is deleted.
+
+Parameters:
+
+    DmfModule - This Module's handle.
+
+Return:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_ScheduledTask* moduleContext;
+    SCHEDULEDTASK_SCHEDULER* scheduler;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    scheduler = moduleContext->Scheduler;
+
+    ScheduledTask_SchedulerRemove(DmfModule);
+
+    WdfWaitLockAcquire(scheduler->Lock,
+                       NULL);
+    DmfAssert(scheduler->NumberOfTasks > 0);
+    scheduler->NumberOfTasks--;
+    WdfWaitLockRelease(scheduler->Lock);
+
+    DMF_Portable_EventClose(&moduleContext->SchedulerDispatchCompleteEvent);
+    moduleContext->Scheduler = NULL;
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _Function_class_(EVT_WDF_WORKITEM)
 VOID
@@ -472,8 +1634,8 @@ Return Value:
                         //
                         TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Timer START");
                         moduleContext->TimerIsStarted = TRUE;
-                        WdfTimerStart(moduleContext->Timer,
-                                      WDF_REL_TIMEOUT_IN_MS(moduleConfig->TimeMsBeforeInitialCall));
+                        ScheduledTask_TimerStart(DmfModule,
+                                                 moduleConfig->TimeMsBeforeInitialCall);
                     }
                     break;
                 }
@@ -625,8 +1787,8 @@ Return Value:
                         //
                         TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Timer START");
                         moduleContext->TimerIsStarted = TRUE;
-                        WdfTimerStart(moduleContext->Timer,
-                                      WDF_REL_TIMEOUT_IN_MS(moduleConfig->TimeMsBeforeInitialCall));
+                        ScheduledTask_TimerStart(DmfModule,
+                                                 moduleConfig->TimeMsBeforeInitialCall);
                     }
                     break;
                 }
@@ -760,24 +1922,39 @@ Return Value:
     moduleContext->ModuleClosing = FALSE;
     moduleContext->TimerIsStarted = FALSE;
 
-    // Create a timer so that the run once callback can be executed in deferred mode.
-    // NOTE: Deferred calls can happen in immediate mode when callback returns a retry.
-    //
-    WDF_TIMER_CONFIG_INIT(&timerConfig,
-                          ScheduledTask_TimerHandler);
-    timerConfig.AutomaticSerialization = TRUE;
-
-    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
-    objectAttributes.ParentObject = DmfModule;
-    objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
-
-    ntStatus = WdfTimerCreate(&timerConfig,
-                              &objectAttributes,
-                              &moduleContext->Timer);
-    if (! NT_SUCCESS(ntStatus))
+    if (moduleConfig->UseSharedScheduler)
     {
-        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
-        goto Exit;
+        // Use the single timer of this device instead of creating a timer.
+        // NOTE: Deferred calls can happen in immediate mode when callback returns a retry.
+        //
+        ntStatus = ScheduledTask_SchedulerOpen(DmfModule);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "ScheduledTask_SchedulerOpen fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
+    }
+    else
+    {
+        // Create a timer so that the run once callback can be executed in deferred mode.
+        // NOTE: Deferred calls can happen in immediate mode when callback returns a retry.
+        //
+        WDF_TIMER_CONFIG_INIT(&timerConfig,
+                              ScheduledTask_TimerHandler);
+        timerConfig.AutomaticSerialization = TRUE;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+        objectAttributes.ParentObject = DmfModule;
+        objectAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+        ntStatus = WdfTimerCreate(&timerConfig,
+                                  &objectAttributes,
+                                  &moduleContext->Timer);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfTimerCreate fails: ntStatus=%!STATUS!", ntStatus);
+            goto Exit;
+        }
     }
 
     // Create a workitem for possible on demand calls.
@@ -808,6 +1985,14 @@ Return Value:
 
 Exit:
 
+    if ((! NT_SUCCESS(ntStatus)) &&
+        (moduleContext->Scheduler != NULL))
+    {
+        // Close is not called when Open fails.
+        //
+        ScheduledTask_SchedulerClose(DmfModule);
+    }
+
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
 
     return ntStatus;
@@ -839,7 +2024,6 @@ Return Value:
 --*/
 {
     DMF_CONTEXT_ScheduledTask* moduleContext;
-    DMF_CONFIG_ScheduledTask* moduleConfig;
 
     PAGED_CODE();
 
@@ -847,8 +2031,6 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
-    moduleConfig = DMF_CONFIG_GET(DmfModule);
-
     // Don't let more deferred calls start.
     // There is no need to lock because asynchronous calls should
     // not be happening.
@@ -868,22 +2050,26 @@ Return Value:
     WdfObjectDelete(moduleContext->DeferredOnDemand);
     moduleContext->DeferredOnDemand = NULL;
 
-    // Since ModuleClosing flag is only set in PrepareHardware or D0Exit, set it now
-    // if necessary to allow the rest of the code to use the flag.
+    // ModuleClosing flag is only set in ReleaseHardware or D0Exit. Set it now so that
+    // the deferred callback does not restart the timer while it is stopped. This is
+    // necessary for ExecuteWhen_Other and when the Client closes the Module manually.
     //
-    if (moduleConfig->ExecuteWhen == ScheduledTask_ExecuteWhen_Other)
-    {
-        TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Set ModuleClosing");
-        moduleContext->ModuleClosing = TRUE;
-    }
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "Set ModuleClosing");
+    moduleContext->ModuleClosing = TRUE;
 
     // Stop the timer and wait for any pending call to finish.
     //
-    DmfAssert(moduleContext->ModuleClosing);
-    WdfTimerStop(moduleContext->Timer,
-                 TRUE);
-    WdfObjectDelete(moduleContext->Timer);
-    moduleContext->Timer = NULL;
+    if (moduleContext->Scheduler != NULL)
+    {
+        ScheduledTask_SchedulerClose(DmfModule);
+    }
+    else
+    {
+        WdfTimerStop(moduleContext->Timer,
+                     TRUE);
+        WdfObjectDelete(moduleContext->Timer);
+        moduleContext->Timer = NULL;
+    }
     moduleContext->TimerIsStarted = FALSE;
 
     FuncExitNoReturn(DMF_TRACE);
@@ -1126,6 +2312,7 @@ Return Value:
     WDFDRIVER driver;
     ULONG value;
     UNICODE_STRING valueNameString;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
 
     PAGED_CODE();
 
@@ -1136,6 +2323,17 @@ Return Value:
                                  ScheduledTask);
 
     wdfKey = NULL;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    if (moduleContext->Scheduler != NULL)
+    {
+        // TimesRun of all instances that use the shared scheduler is kept in a single value.
+        //
+        ntStatus = ScheduledTask_SchedulerTimesRunGet(DmfModule,
+                                                      TimesRun);
+        goto Exit;
+    }
+
     device = DMF_ParentDeviceGet(DmfModule);
     driver = WdfDeviceGetDriver(device);
 
@@ -1280,6 +2478,7 @@ Return Value:
     WDFDRIVER driver;
     UNICODE_STRING valueNameString;
     ACCESS_MASK accessMask;
+    DMF_CONTEXT_ScheduledTask* moduleContext;
 
     PAGED_CODE();
 
@@ -1287,6 +2486,17 @@ Return Value:
                                  ScheduledTask);
 
     wdfKey = NULL;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    if (moduleContext->Scheduler != NULL)
+    {
+        // TimesRun of all instances that use the shared scheduler is kept in a single value.
+        //
+        ntStatus = ScheduledTask_SchedulerTimesRunSet(DmfModule,
+                                                      TimesRun);
+        goto Exit;
+    }
+
     device = DMF_ParentDeviceGet(DmfModule);
     driver = WdfDeviceGetDriver(device);
 
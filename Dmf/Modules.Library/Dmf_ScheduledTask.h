@@ -111,6 +111,19 @@ typedef struct
     // Delay before initial deferred call begins.
     //
     ULONG TimeMsBeforeInitialCall;
+    // If TRUE, this instance does not create its own timer. Instead, a single timer
+    // per WDFDEVICE services all the instances that set this flag.
+    //
+    BOOLEAN UseSharedScheduler;
+    // Used with UseSharedScheduler. The deferred callback may execute up to this many
+    // milliseconds early so that it executes together with other instances whose
+    // deadlines are nearby.
+    //
+    ULONG SharedSchedulerToleranceMs;
+    // Used with UseSharedScheduler. Identifies this instance's entry in the single
+    // registry value that holds TimesRun for all instances that use the shared scheduler.
+    //
+    ULONG SharedSchedulerTaskId;
 } DMF_CONFIG_ScheduledTask;
 
 // This macro declares the following functions:
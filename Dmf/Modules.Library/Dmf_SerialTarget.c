@@ -57,6 +57,12 @@ typedef struct
     // Redirect Output buffer callback from ContinuousRequestTarget to this callback.
     //
     EVT_DMF_ContinuousRequestTarget_BufferOutput* EvtContinuousRequestTargetBufferOutput;
+    // Child FrameParser DMF Module. NULL when the stream is not framed.
+    //
+    DMFMODULE DmfModuleFrameParser;
+    // Redirect frames from FrameParser to this callback.
+    //
+    EVT_DMF_SerialTarget_FrameReceived* EvtSerialTargetFrameReceived;
 } DMF_CONTEXT_SerialTarget;
 
 // This macro declares the following function:
@@ -166,7 +172,20 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(dmfModule);
 
-    if (moduleContext->EvtContinuousRequestTargetBufferOutput != NULL)
+    if (moduleContext->DmfModuleFrameParser != NULL)
+    {
+        // Frames are given to Client by SerialTarget_FrameReceived(). The buffer is
+        // not needed after parsing, so it is always returned to the stream.
+        //
+        if (NT_SUCCESS(CompletionStatus))
+        {
+            DMF_FrameParser_Parse(moduleContext->DmfModuleFrameParser,
+                                  (UCHAR*)OutputBuffer,
+                                  (ULONG)OutputBufferSize);
+        }
+        bufferDisposition = ContinuousRequestTarget_BufferDisposition_ContinuousRequestTargetAndContinueStreaming;
+    }
+    else if (moduleContext->EvtContinuousRequestTargetBufferOutput != NULL)
     {
         bufferDisposition = moduleContext->EvtContinuousRequestTargetBufferOutput(dmfModule,
                                                                                   OutputBuffer,
@@ -184,6 +203,47 @@ Return Value:
     return bufferDisposition;
 }
 
+_Function_class_(EVT_DMF_FrameParser_FrameReceived)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+SerialTarget_FrameReceived(
+    _In_ DMFMODULE DmfModule,
+    _In_reads_(FrameLength) UCHAR* Frame,
+    _In_ ULONG FrameLength
+    )
+/*++
+
+Routine Description:
+
+    Redirect frames from FrameParser to Parent Module/Device.
+
+Arguments:
+
+    DmfModule - FrameParser DMFMODULE.
+    Frame - The frame's payload.
+    FrameLength - Size of the frame's payload.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModule;
+    DMF_CONTEXT_SerialTarget* moduleContext;
+
+    dmfModule = DMF_ParentModuleGet(DmfModule);
+    DmfAssert(dmfModule != NULL);
+
+    moduleContext = DMF_CONTEXT_GET(dmfModule);
+
+    DmfAssert(moduleContext->EvtSerialTargetFrameReceived != NULL);
+    moduleContext->EvtSerialTargetFrameReceived(dmfModule,
+                                                Frame,
+                                                FrameLength);
+}
+
 EVT_WDF_IO_TARGET_QUERY_REMOVE SerialTarget_EvtIoTargetQueryRemove;
 
 _Use_decl_annotations_
@@ -974,6 +1034,29 @@ Return Value:
     //
     moduleContext->ContinuousRequestTargetMode = moduleConfig->ContinuousRequestTargetModuleConfig.ContinuousRequestTargetMode;
 
+    // FrameParser
+    // -----------
+    //
+    if (moduleConfig->FrameParserModuleConfig.FramingType != FrameParser_FramingType_Invalid)
+    {
+        // Store FrameParser callback from config into SerialTarget context for redirection.
+        //
+        moduleContext->EvtSerialTargetFrameReceived = moduleConfig->FrameParserModuleConfig.EvtFrameParserFrameReceived;
+
+        // Replace FrameParser callback in config with SerialTarget callback.
+        //
+        moduleConfig->FrameParserModuleConfig.EvtFrameParserFrameReceived = SerialTarget_FrameReceived;
+
+        DMF_FrameParser_ATTRIBUTES_INIT(&moduleAttributes);
+        moduleAttributes.ModuleConfigPointer = &moduleConfig->FrameParserModuleConfig;
+        moduleAttributes.SizeOfModuleSpecificConfig = sizeof(moduleConfig->FrameParserModuleConfig);
+        moduleAttributes.PassiveLevel = DmfParentModuleAttributes->PassiveLevel;
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         &moduleContext->DmfModuleFrameParser);
+    }
+
     FuncExitVoid(DMF_TRACE);
 }
 #pragma code_seg()
@@ -1323,6 +1406,13 @@ Return Value:
 
     DmfAssert(moduleContext->IoTarget != NULL);
 
+    // Bytes of a partial frame from before the stream stopped are not valid anymore.
+    //
+    if (moduleContext->DmfModuleFrameParser != NULL)
+    {
+        DMF_FrameParser_Reset(moduleContext->DmfModuleFrameParser);
+    }
+
     ntStatus = DMF_ContinuousRequestTarget_Start(moduleContext->DmfModuleContinuousRequestTarget);
 
     FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
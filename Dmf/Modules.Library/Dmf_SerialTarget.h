@@ -82,6 +82,11 @@ BOOLEAN
 EVT_DMF_SerialTarget_CustomConfiguration(_In_ DMFMODULE DmfModule,
                                          _Out_ SerialTarget_Configuration* ConfigurationParameters);
 
+// Client Driver callback function that receives each frame when FrameParserModuleConfig
+// is set. DmfModule is the SerialTarget Module.
+//
+typedef EVT_DMF_FrameParser_FrameReceived EVT_DMF_SerialTarget_FrameReceived;
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -101,6 +106,11 @@ typedef struct
     // Child Request Stream Module.
     //
     DMF_CONFIG_ContinuousRequestTarget ContinuousRequestTargetModuleConfig;
+    // Optional framing of the stream. When FramingType is not FrameParser_FramingType_Invalid,
+    // streamed output buffers are parsed and EvtFrameParserFrameReceived is called for each frame
+    // instead of calling EvtContinuousRequestTargetBufferOutput.
+    //
+    DMF_CONFIG_FrameParser FrameParserModuleConfig;
 } DMF_CONFIG_SerialTarget;
 
 // This macro declares the following functions:
@@ -31,6 +31,26 @@ Environment:
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
+// Number of possible SMBIOS structure types.
+//
+#define SMBIOSWMI_NUMBER_OF_TYPES           256
+
+// Location of a structure in the raw SMBIOS table.
+//
+typedef struct
+{
+    UCHAR Type;
+    UCHAR Length;
+    USHORT Handle;
+    // Offset of the structure from the start of the structure table.
+    //
+    ULONG Offset;
+    // Index in StringOffsets of the structure's first string.
+    //
+    ULONG FirstString;
+    ULONG NumberOfStrings;
+} SMBIOSWMI_STRUCTURE_ENTRY;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +86,28 @@ typedef struct
     // Size of the raw SMBIOS table (including WMI header).
     //
     ULONG SmbiosTableDataSizeIncludesWmiContainer;
+
+    // The SMBIOS structures (without any header) inside the raw SMBIOS table.
+    //
+    UCHAR* StructureTableData;
+    ULONG StructureTableDataSize;
+
+    // Index of the structures, built once in Open so that Methods find structures and
+    // their strings without parsing the table.
+    //
+    WDFMEMORY MemoryStructureIndex;
+    // Structures in the order they appear in the table.
+    //
+    SMBIOSWMI_STRUCTURE_ENTRY* Structures;
+    ULONG NumberOfStructures;
+    // Offset of each string from the start of the structure table.
+    //
+    ULONG* StringOffsets;
+    // Indexes in Structures sorted by type. Structures of type T are listed from
+    // StructuresByType[StructureTypeStart[T]] to StructuresByType[StructureTypeStart[T + 1] - 1].
+    //
+    ULONG* StructuresByType;
+    ULONG StructureTypeStart[SMBIOSWMI_NUMBER_OF_TYPES + 1];
 } DMF_CONTEXT_SmbiosWmi;
 
 // This macro declares the following function:
@@ -359,6 +401,266 @@ Exit:
     return ntStatus;
 }
 
+VOID
+SmbiosWmi_StructureTableSet(
+    _In_ DMF_CONTEXT_SmbiosWmi* ModuleContext,
+    _In_ RAW_SMBIOS_HEADER* RawSmbiosHeader,
+    _In_ ULONG RawSmbiosLength
+    )
+/*++
+
+Routine Description:
+
+    Store the location of the SMBIOS structures that follow a given raw SMBIOS header.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    RawSmbiosHeader - The given raw SMBIOS header.
+    RawSmbiosLength - Size of the raw SMBIOS data including its header.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG maximumLength;
+
+    maximumLength = RawSmbiosLength - FIELD_OFFSET(RAW_SMBIOS_HEADER, SMBIOSTableData);
+
+    ModuleContext->StructureTableData = RawSmbiosHeader->SMBIOSTableData;
+    ModuleContext->StructureTableDataSize = min(RawSmbiosHeader->Length,
+                                                maximumLength);
+}
+
+BOOLEAN
+SmbiosWmi_StructureParse(
+    _In_ DMF_CONTEXT_SmbiosWmi* ModuleContext,
+    _In_ ULONG Offset,
+    _Out_ ULONG* NumberOfStrings,
+    _Out_ ULONG* NextOffset,
+    _Out_writes_opt_(*NumberOfStrings) ULONG* StringOffsets
+    )
+/*++
+
+Routine Description:
+
+    Find the strings of the structure at a given offset in the structure table and the
+    offset of the next structure.
+
+Arguments:
+
+    ModuleContext - This Module's context.
+    Offset - The given offset.
+    NumberOfStrings - Number of strings in the structure's string set.
+    NextOffset - Offset of the next structure.
+    StringOffsets - Optional. The offset of each string is written here.
+
+Return Value:
+
+    FALSE if the structure does not fit in the table.
+
+--*/
+{
+    UCHAR* data;
+    ULONG dataSize;
+    ULONG position;
+
+    data = ModuleContext->StructureTableData;
+    dataSize = ModuleContext->StructureTableDataSize;
+
+    *NumberOfStrings = 0;
+    *NextOffset = dataSize;
+
+    if ((dataSize - Offset < FIELD_OFFSET(SMBIOS_TABLE_HEADER, TableData)) ||
+        (data[Offset + 1] < FIELD_OFFSET(SMBIOS_TABLE_HEADER, TableData)) ||
+        (dataSize - Offset < data[Offset + 1]))
+    {
+        return FALSE;
+    }
+
+    // The string set follows the formatted area. It ends with an empty string. If there
+    // are no strings, it is two zeros.
+    //
+    position = Offset + data[Offset + 1];
+    if ((position < dataSize) &&
+        (0 == data[position]))
+    {
+        *NextOffset = min(position + 2,
+                          dataSize);
+        return TRUE;
+    }
+
+    while (position < dataSize)
+    {
+        if (0 == data[position])
+        {
+            *NextOffset = position + 1;
+            return TRUE;
+        }
+        if (StringOffsets != NULL)
+        {
+            StringOffsets[*NumberOfStrings] = position;
+        }
+        (*NumberOfStrings)++;
+        while ((position < dataSize) &&
+               (data[position] != 0))
+        {
+            position++;
+        }
+        // Skip the string's zero.
+        //
+        position++;
+    }
+
+    return FALSE;
+}
+
+_Must_inspect_result_
+NTSTATUS
+SmbiosWmi_StructureIndexBuild(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Build the index of the structures in the SMBIOS table. The table is parsed twice: once
+    to size the index and once to fill it.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_SmbiosWmi* moduleContext;
+    WDF_OBJECT_ATTRIBUTES objectAttributes;
+    SMBIOSWMI_STRUCTURE_ENTRY* structure;
+    ULONG typeCount[SMBIOSWMI_NUMBER_OF_TYPES];
+    ULONG numberOfStructures;
+    ULONG numberOfStrings;
+    ULONG structureNumberOfStrings;
+    ULONG offset;
+    ULONG nextOffset;
+    ULONG structureIndex;
+    ULONG typeIndex;
+    size_t indexSize;
+    UCHAR* indexBuffer;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    // Count the structures and strings.
+    //
+    numberOfStructures = 0;
+    numberOfStrings = 0;
+    offset = 0;
+    while (offset < moduleContext->StructureTableDataSize)
+    {
+        if (! SmbiosWmi_StructureParse(moduleContext,
+                                       offset,
+                                       &structureNumberOfStrings,
+                                       &nextOffset,
+                                       NULL))
+        {
+            TraceEvents(TRACE_LEVEL_WARNING, DMF_TRACE, "Truncated structure at offset=%u", offset);
+            break;
+        }
+        numberOfStructures++;
+        numberOfStrings += structureNumberOfStrings;
+        if (SMBIOS_TABLE_127 == moduleContext->StructureTableData[offset])
+        {
+            break;
+        }
+        offset = nextOffset;
+    }
+
+    RtlZeroMemory(moduleContext->StructureTypeStart,
+                  sizeof(moduleContext->StructureTypeStart));
+
+    if (0 == numberOfStructures)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
+    // Structures, then structures sorted by type, then string offsets. All are
+    // allocated together.
+    //
+    indexSize = (numberOfStructures * sizeof(SMBIOSWMI_STRUCTURE_ENTRY)) +
+                (numberOfStructures * sizeof(ULONG)) +
+                (numberOfStrings * sizeof(ULONG));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&objectAttributes);
+    objectAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&objectAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               indexSize,
+                               &moduleContext->MemoryStructureIndex,
+                               (VOID**)&indexBuffer);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate ntStatus=%!STATUS!", ntStatus);
+        goto Exit;
+    }
+
+    moduleContext->Structures = (SMBIOSWMI_STRUCTURE_ENTRY*)indexBuffer;
+    moduleContext->StructuresByType = (ULONG*)&moduleContext->Structures[numberOfStructures];
+    moduleContext->StringOffsets = &moduleContext->StructuresByType[numberOfStructures];
+
+    // Fill the index.
+    //
+    RtlZeroMemory(typeCount,
+                  sizeof(typeCount));
+    numberOfStrings = 0;
+    offset = 0;
+    for (structureIndex = 0; structureIndex < numberOfStructures; structureIndex++)
+    {
+        structure = &moduleContext->Structures[structureIndex];
+        structure->Type = moduleContext->StructureTableData[offset];
+        structure->Length = moduleContext->StructureTableData[offset + 1];
+        structure->Handle = (USHORT)(moduleContext->StructureTableData[offset + 2] | (moduleContext->StructureTableData[offset + 3] << 8));
+        structure->Offset = offset;
+        structure->FirstString = numberOfStrings;
+        SmbiosWmi_StructureParse(moduleContext,
+                                 offset,
+                                 &structure->NumberOfStrings,
+                                 &nextOffset,
+                                 &moduleContext->StringOffsets[numberOfStrings]);
+        numberOfStrings += structure->NumberOfStrings;
+        typeCount[structure->Type]++;
+        offset = nextOffset;
+    }
+
+    // Sort by type. Structures of the same type stay in table order.
+    //
+    for (typeIndex = 0; typeIndex < SMBIOSWMI_NUMBER_OF_TYPES; typeIndex++)
+    {
+        moduleContext->StructureTypeStart[typeIndex + 1] = moduleContext->StructureTypeStart[typeIndex] + typeCount[typeIndex];
+        typeCount[typeIndex] = moduleContext->StructureTypeStart[typeIndex];
+    }
+    for (structureIndex = 0; structureIndex < numberOfStructures; structureIndex++)
+    {
+        typeIndex = moduleContext->Structures[structureIndex].Type;
+        moduleContext->StructuresByType[typeCount[typeIndex]++] = structureIndex;
+    }
+
+    moduleContext->NumberOfStructures = numberOfStructures;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "SMBIOS index: NumberOfStructures=%u NumberOfStrings=%u", numberOfStructures, numberOfStrings);
+
+Exit:
+
+    return ntStatus;
+}
+
 #if !defined(DMF_USER_MODE)
 
 #pragma code_seg("PAGE")
@@ -493,6 +795,10 @@ Return Value:
     //
     moduleContext->SmbiosTableDataSizeIncludesWmiContainer = bufferSize;
 
+    SmbiosWmi_StructureTableSet(moduleContext,
+                                rawSmbiosHeader,
+                                smbiosLength);
+
     TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "SMBIOS Tables Read successfully: SmbiosTableDataSize=%u", moduleContext->SmbiosTableDataSize);
     ntStatus = STATUS_SUCCESS;
 
@@ -604,6 +910,17 @@ Return Value:
     // It means the table was read successfully.
     // 
     moduleContext->SmbiosTableDataSize = neededBufferSize;
+
+    // The returned data starts with the same header as the WMI data.
+    //
+    if (neededBufferSize < sizeof(RAW_SMBIOS_HEADER))
+    {
+        ntStatus = STATUS_UNSUCCESSFUL;
+        goto Exit;
+    }
+    SmbiosWmi_StructureTableSet(moduleContext,
+                                (RAW_SMBIOS_HEADER*)moduleContext->SmbiosTableData,
+                                neededBufferSize);
     TraceEvents(TRACE_LEVEL_INFORMATION, DMF_TRACE, "SMBIOS Tables Read successfully: SmbiosTableDataSize=%u", moduleContext->SmbiosTableDataSize);
     ntStatus = STATUS_SUCCESS;
 
@@ -667,6 +984,14 @@ Return Value:
         goto Exit;
     }
 
+    // Index the structures for DMF_SmbiosWmi_StructureFind().
+    //
+    ntStatus = SmbiosWmi_StructureIndexBuild(DmfModule);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        goto Exit;
+    }
+
     // Parse the raw table to get component tables. Save them in the Module Context for
     // later use by Methods.
     //
@@ -746,6 +1071,129 @@ Return Value:
 // Module Methods
 //
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+CHAR*
+DMF_SmbiosWmi_StringGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ SmbiosWmi_Structure* Structure,
+    _In_ UCHAR StringNumber
+    )
+/*++
+
+Routine Description:
+
+    Get a string of a structure returned by DMF_SmbiosWmi_StructureFind(). No data is copied.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Structure - The structure returned by DMF_SmbiosWmi_StructureFind().
+    StringNumber - The string number as stored in the structure's formatted area (starts at 1).
+
+Return Value:
+
+    Address of the string in the Module's copy of the SMBIOS table.
+    NULL if StringNumber is zero or the structure does not have that string.
+
+--*/
+{
+    DMF_CONTEXT_SmbiosWmi* moduleContext;
+    SMBIOSWMI_STRUCTURE_ENTRY* structure;
+    CHAR* returnValue;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 SmbiosWmi);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    returnValue = NULL;
+
+    if (Structure->StructureIndex >= moduleContext->NumberOfStructures)
+    {
+        DmfAssert(FALSE);
+        goto Exit;
+    }
+
+    structure = &moduleContext->Structures[Structure->StructureIndex];
+    if ((0 == StringNumber) ||
+        (StringNumber > structure->NumberOfStrings))
+    {
+        goto Exit;
+    }
+
+    returnValue = (CHAR*)&moduleContext->StructureTableData[moduleContext->StringOffsets[structure->FirstString + StringNumber - 1]];
+
+Exit:
+
+    return returnValue;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_SmbiosWmi_StructureFind(
+    _In_ DMFMODULE DmfModule,
+    _In_ UCHAR Type,
+    _In_ ULONG Instance,
+    _Out_ SmbiosWmi_Structure* Structure
+    )
+/*++
+
+Routine Description:
+
+    Find a structure of a given type in the SMBIOS table. The structure is found using the
+    index built when the Module opened. No data is copied.
+
+Arguments:
+
+    DmfModule - This Module's handle.
+    Type - The given type.
+    Instance - Zero for the first structure of the given type, one for the second, etc.
+    Structure - Information about the structure is written here.
+
+Return Value:
+
+    STATUS_SUCCESS if the structure is found.
+    STATUS_NOT_FOUND if the table has fewer than Instance + 1 structures of the given type.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_SmbiosWmi* moduleContext;
+    SMBIOSWMI_STRUCTURE_ENTRY* structure;
+    ULONG structureIndex;
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 SmbiosWmi);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    RtlZeroMemory(Structure,
+                  sizeof(SmbiosWmi_Structure));
+
+    if (Instance >= moduleContext->StructureTypeStart[Type + 1] - moduleContext->StructureTypeStart[Type])
+    {
+        ntStatus = STATUS_NOT_FOUND;
+        goto Exit;
+    }
+
+    structureIndex = moduleContext->StructuresByType[moduleContext->StructureTypeStart[Type] + Instance];
+    structure = &moduleContext->Structures[structureIndex];
+
+    Structure->Type = structure->Type;
+    Structure->Length = structure->Length;
+    Structure->Handle = structure->Handle;
+    Structure->Data = &moduleContext->StructureTableData[structure->Offset];
+    Structure->NumberOfStrings = structure->NumberOfStrings;
+    Structure->StructureIndex = structureIndex;
+
+    ntStatus = STATUS_SUCCESS;
+
+Exit:
+
+    return ntStatus;
+}
+
 NTSTATUS
 DMF_SmbiosWmi_TableType01Get(
     _In_ DMFMODULE DmfModule,
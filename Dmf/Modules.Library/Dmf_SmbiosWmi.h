@@ -41,6 +41,31 @@ typedef struct
     CHAR* Family;
 } SmbiosWmi_TableType01;
 
+// An SMBIOS structure returned by DMF_SmbiosWmi_StructureFind().
+// Data points into the Module's copy of the SMBIOS table. Do not write to it.
+//
+typedef struct
+{
+    // Structure type (for example, 1 for System Information).
+    //
+    UCHAR Type;
+    // Length of the formatted area, including the structure header.
+    //
+    UCHAR Length;
+    // Structure handle.
+    //
+    USHORT Handle;
+    // Formatted area, starting with the structure header.
+    //
+    UCHAR* Data;
+    // Number of strings that follow the formatted area.
+    //
+    ULONG NumberOfStrings;
+    // For use by DMF_SmbiosWmi_StringGet().
+    //
+    ULONG StructureIndex;
+} SmbiosWmi_Structure;
+
 // This macro declares the following functions:
 // DMF_SmbiosWmi_ATTRIBUTES_INIT()
 // DMF_SmbiosWmi_Create()
@@ -50,6 +75,24 @@ DECLARE_DMF_MODULE_NO_CONFIG(SmbiosWmi)
 // Module Methods
 //
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+CHAR*
+DMF_SmbiosWmi_StringGet(
+    _In_ DMFMODULE DmfModule,
+    _In_ SmbiosWmi_Structure* Structure,
+    _In_ UCHAR StringNumber
+    );
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_SmbiosWmi_StructureFind(
+    _In_ DMFMODULE DmfModule,
+    _In_ UCHAR Type,
+    _In_ ULONG Instance,
+    _Out_ SmbiosWmi_Structure* Structure
+    );
+
 NTSTATUS
 DMF_SmbiosWmi_TableType01Get(
     _In_ DMFMODULE DmfModule,
@@ -37,6 +37,66 @@ Environment:
 #include <reshub.h>
 #include <spb.h>
 
+// A run of transactions from a Client's batch that is sent to the controller as a single
+// SPB sequence. Adjacent register reads are coalesced into one write-read whose read
+// transfer scatters directly into each Client buffer.
+//
+typedef struct _SPBTARGET_TRANSACTION_BATCH SPBTARGET_TRANSACTION_BATCH;
+
+typedef struct
+{
+    // The batch this group belongs to.
+    //
+    SPBTARGET_TRANSACTION_BATCH* Batch;
+    // Index of the first transaction of this group in the Client's array.
+    //
+    ULONG FirstTransactionIndex;
+    // Number of Client transactions in this group.
+    //
+    ULONG NumberOfTransactions;
+    // Register address in bus byte order.
+    //
+    UCHAR RegisterAddress[sizeof(ULONG)];
+    // Size of the used part of Sequence in bytes.
+    //
+    ULONG SequenceLength;
+    // The SPB sequence sent to the controller.
+    //
+    SPB_TRANSFER_LIST_AND_ENTRIES(2) Sequence;
+} SPBTARGET_TRANSACTION_GROUP;
+
+struct _SPBTARGET_TRANSACTION_BATCH
+{
+    // Batches that still have groups to send.
+    //
+    LIST_ENTRY ListEntry;
+    // Memory that holds this structure, its groups and buffer lists.
+    //
+    WDFMEMORY Memory;
+    // This Module's handle.
+    //
+    DMFMODULE DmfModule;
+    // The Client's transactions and completion callback.
+    //
+    SpbTarget_Transaction* Transactions;
+    ULONG NumberOfTransactions;
+    EVT_DMF_SpbTarget_TransactionsComplete* EvtSpbTargetTransactionsComplete;
+    VOID* ClientContext;
+    // Groups built from Transactions.
+    //
+    SPBTARGET_TRANSACTION_GROUP* Groups;
+    ULONG NumberOfGroups;
+    // Index of the next group to send. Protected by TransactionLock.
+    //
+    ULONG NextGroupIndex;
+    // Number of groups that have not completed. Protected by TransactionLock.
+    //
+    ULONG GroupsPending;
+    // First failure of any group in the batch.
+    //
+    NTSTATUS NtStatus;
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
 // Module Private Context
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -69,6 +129,34 @@ typedef struct
     //
     DMFMODULE DmfModuleRequestTarget;
 
+    // Asynchronous transaction engine.
+    // --------------------------------
+    //
+    // Protects all the fields below. Completion routines may run at DISPATCH_LEVEL.
+    //
+    WDFSPINLOCK TransactionLock;
+    // Batches that still have groups to send, in submission order.
+    //
+    LIST_ENTRY TransactionBatchList;
+    // Number of groups sent to the controller that have not completed.
+    //
+    ULONG TransactionGroupsOutstanding;
+    // Maximum value of TransactionGroupsOutstanding.
+    //
+    ULONG TransactionGroupsOutstandingMaximum;
+    // Number of batches submitted that have not completed plus the number of threads
+    // that are sending groups. Close waits for it to reach zero before it deletes
+    // TransactionLock.
+    //
+    ULONG TransactionBatchesActive;
+    // Set during Close, and while the Client has not set an IoTarget, so that no more
+    // batches are accepted.
+    //
+    BOOLEAN TransactionsClosing;
+    // Set when TransactionBatchesActive reaches zero during Close.
+    //
+    DMF_PORTABLE_EVENT TransactionBatchesDoneEvent;
+
     // InterruptResource.
     //
     DMFMODULE DmfModuleInterruptResource;
@@ -249,6 +337,433 @@ Return Value:
     return ntStatus;
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+SpbTarget_TransactionsDereference(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Release a count taken in TransactionBatchesActive by a batch or by a thread that sends
+    groups. Tell Close when the last one is released.
+    NOTE: TransactionLock may be deleted as soon as this function releases it.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    DmfAssert(moduleContext->TransactionBatchesActive > 0);
+    moduleContext->TransactionBatchesActive--;
+    if ((0 == moduleContext->TransactionBatchesActive) &&
+        moduleContext->TransactionsClosing)
+    {
+        DMF_Portable_EventSet(&moduleContext->TransactionBatchesDoneEvent);
+    }
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+SpbTarget_TransactionBatchComplete(
+    _In_ DMFMODULE DmfModule,
+    _In_ SPBTARGET_TRANSACTION_BATCH* Batch
+    )
+/*++
+
+Routine Description:
+
+    Tell the Client that all the transactions in a given batch have completed and
+    free the batch.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+    Batch - The given batch.
+
+Return Value:
+
+    None
+
+--*/
+{
+    WDFMEMORY memory;
+
+    Batch->EvtSpbTargetTransactionsComplete(DmfModule,
+                                            Batch->Transactions,
+                                            Batch->NumberOfTransactions,
+                                            Batch->ClientContext,
+                                            Batch->NtStatus);
+
+    // Free the batch before it is no longer counted so that Close never returns
+    // while the batch memory still exists.
+    //
+    memory = Batch->Memory;
+    WdfObjectDelete(memory);
+
+    SpbTarget_TransactionsDereference(DmfModule);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+SpbTarget_TransactionGroupDone(
+    _In_ DMFMODULE DmfModule,
+    _In_ SPBTARGET_TRANSACTION_GROUP* Group,
+    _In_ BOOLEAN GroupWasSent,
+    _In_ NTSTATUS NtStatus
+    )
+/*++
+
+Routine Description:
+
+    Record the status of a given group and complete its batch if it is the last
+    group of the batch to finish.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+    Group - The given group.
+    GroupWasSent - TRUE if the group was counted as outstanding at the controller.
+    NtStatus - Completion status of the group.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    SPBTARGET_TRANSACTION_BATCH* batch;
+    ULONG transactionIndex;
+    BOOLEAN batchComplete;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    batch = Group->Batch;
+
+    for (transactionIndex = 0; transactionIndex < Group->NumberOfTransactions; transactionIndex++)
+    {
+        batch->Transactions[Group->FirstTransactionIndex + transactionIndex].NtStatus = NtStatus;
+    }
+
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    if (GroupWasSent)
+    {
+        DmfAssert(moduleContext->TransactionGroupsOutstanding > 0);
+        moduleContext->TransactionGroupsOutstanding--;
+    }
+    if ((! NT_SUCCESS(NtStatus)) &&
+        NT_SUCCESS(batch->NtStatus))
+    {
+        batch->NtStatus = NtStatus;
+    }
+    DmfAssert(batch->GroupsPending > 0);
+    batch->GroupsPending--;
+    batchComplete = (0 == batch->GroupsPending);
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    if (batchComplete)
+    {
+        SpbTarget_TransactionBatchComplete(DmfModule,
+                                           batch);
+    }
+}
+
+EVT_DMF_RequestTarget_SendCompletion SpbTarget_TransactionGroupSendComplete;
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+VOID
+SpbTarget_TransactionGroupsSend(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Send queued groups to the controller, in submission order, until the number of
+    outstanding groups reaches the configured maximum.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    DMF_CONFIG_SpbTarget* moduleConfig;
+    SPBTARGET_TRANSACTION_BATCH* batch;
+    SPBTARGET_TRANSACTION_GROUP* group;
+    NTSTATUS ntStatus;
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    for (;;)
+    {
+        WdfSpinLockAcquire(moduleContext->TransactionLock);
+        if (IsListEmpty(&moduleContext->TransactionBatchList) ||
+            (moduleContext->TransactionGroupsOutstanding >= moduleContext->TransactionGroupsOutstandingMaximum))
+        {
+            WdfSpinLockRelease(moduleContext->TransactionLock);
+            break;
+        }
+        batch = CONTAINING_RECORD(moduleContext->TransactionBatchList.Flink,
+                                  SPBTARGET_TRANSACTION_BATCH,
+                                  ListEntry);
+        group = &batch->Groups[batch->NextGroupIndex];
+        batch->NextGroupIndex++;
+        if (batch->NextGroupIndex == batch->NumberOfGroups)
+        {
+            RemoveEntryList(&batch->ListEntry);
+            InitializeListHead(&batch->ListEntry);
+        }
+        moduleContext->TransactionGroupsOutstanding++;
+        WdfSpinLockRelease(moduleContext->TransactionLock);
+
+        ntStatus = DMF_RequestTarget_SendEx(moduleContext->DmfModuleRequestTarget,
+                                            &group->Sequence,
+                                            group->SequenceLength,
+                                            NULL,
+                                            0,
+                                            ContinuousRequestTarget_RequestType_Ioctl,
+                                            IOCTL_SPB_EXECUTE_SEQUENCE,
+                                            moduleConfig->TransactionTimeoutMs,
+                                            SpbTarget_TransactionGroupSendComplete,
+                                            group,
+                                            NULL);
+        if (! NT_SUCCESS(ntStatus))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "DMF_RequestTarget_SendEx fails: ntStatus=%!STATUS!", ntStatus);
+            SpbTarget_TransactionGroupDone(DmfModule,
+                                           group,
+                                           TRUE,
+                                           ntStatus);
+        }
+    }
+}
+
+_Function_class_(EVT_DMF_RequestTarget_SendCompletion)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+SpbTarget_TransactionGroupSendComplete(
+    _In_ DMFMODULE DmfModule,
+    _In_ VOID* ClientRequestContext,
+    _In_reads_(InputBufferBytesWritten) VOID* InputBuffer,
+    _In_ size_t InputBufferBytesWritten,
+    _In_reads_(OutputBufferBytesRead) VOID* OutputBuffer,
+    _In_ size_t OutputBufferBytesRead,
+    _In_ NTSTATUS CompletionStatus
+    )
+/*++
+
+Routine Description:
+
+    Called by the Child RequestTarget when the SPB sequence of a group completes.
+    Completes the group and keeps the pipeline to the controller full.
+
+Arguments:
+
+    DmfModule - The Child RequestTarget Module's handle.
+    ClientRequestContext - The group that completed.
+    InputBuffer - The SPB sequence that was sent.
+    InputBufferBytesWritten - Size of InputBuffer.
+    OutputBuffer - Not used.
+    OutputBufferBytesRead - Not used.
+    CompletionStatus - Status of the SPB sequence.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMFMODULE dmfModuleSpbTarget;
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    SPBTARGET_TRANSACTION_GROUP* group;
+    BOOLEAN closing;
+
+    UNREFERENCED_PARAMETER(InputBuffer);
+    UNREFERENCED_PARAMETER(InputBufferBytesWritten);
+    UNREFERENCED_PARAMETER(OutputBuffer);
+    UNREFERENCED_PARAMETER(OutputBufferBytesRead);
+
+    dmfModuleSpbTarget = DMF_ParentModuleGet(DmfModule);
+    moduleContext = DMF_CONTEXT_GET(dmfModuleSpbTarget);
+    group = (SPBTARGET_TRANSACTION_GROUP*)ClientRequestContext;
+
+    if (! NT_SUCCESS(CompletionStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "SPB sequence fails: ntStatus=%!STATUS!", CompletionStatus);
+    }
+
+    // The batch of this group is still counted so Close has not deleted TransactionLock.
+    // Count this thread too so that Close waits until the pipeline is refilled even if
+    // this group completes the last batch.
+    //
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    moduleContext->TransactionBatchesActive++;
+    closing = moduleContext->TransactionsClosing;
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    SpbTarget_TransactionGroupDone(dmfModuleSpbTarget,
+                                   group,
+                                   TRUE,
+                                   CompletionStatus);
+
+    if (! closing)
+    {
+        SpbTarget_TransactionGroupsSend(dmfModuleSpbTarget);
+    }
+
+    SpbTarget_TransactionsDereference(dmfModuleSpbTarget);
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static
+BOOLEAN
+SpbTarget_TransactionIsCoalescable(
+    _In_ SpbTarget_Transaction* PreviousTransaction,
+    _In_ SpbTarget_Transaction* Transaction
+    )
+/*++
+
+Routine Description:
+
+    Determine if a given transaction can be read in the same transfer as the
+    transaction before it. This is the case for register reads that start where the
+    previous read ends (devices that auto-increment the register address).
+
+Arguments:
+
+    PreviousTransaction - The transaction before Transaction in the Client's batch.
+    Transaction - The given transaction.
+
+Return Value:
+
+    TRUE if Transaction can be coalesced with PreviousTransaction.
+
+--*/
+{
+    return ((SpbTarget_TransactionType_RegisterRead == PreviousTransaction->TransactionType) &&
+            (SpbTarget_TransactionType_RegisterRead == Transaction->TransactionType) &&
+            ((ULONGLONG)PreviousTransaction->RegisterAddress + PreviousTransaction->BufferLength == (ULONGLONG)Transaction->RegisterAddress));
+}
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static
+VOID
+SpbTarget_TransactionsFlush(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Stop accepting new batches, cancel the groups that have not been sent and wait
+    for all the batches that were submitted to complete. Batches are accepted again
+    after DMF_SpbTarget_IoTargetSet().
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    LIST_ENTRY batchList;
+    LIST_ENTRY* listEntry;
+    SPBTARGET_TRANSACTION_BATCH* batch;
+    SPBTARGET_TRANSACTION_GROUP* groups;
+    ULONG firstGroupIndex;
+    ULONG numberOfGroups;
+    ULONG groupIndex;
+    BOOLEAN waitForBatches;
+
+    PAGED_CODE();
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+
+    if (NULL == moduleContext->TransactionLock)
+    {
+        goto Exit;
+    }
+
+    InitializeListHead(&batchList);
+
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    moduleContext->TransactionsClosing = TRUE;
+    while (! IsListEmpty(&moduleContext->TransactionBatchList))
+    {
+        listEntry = RemoveHeadList(&moduleContext->TransactionBatchList);
+        InsertTailList(&batchList,
+                       listEntry);
+    }
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    // Groups that were never sent are completed here. The last one may free its batch
+    // so nothing in the batch is accessed after it.
+    //
+    while (! IsListEmpty(&batchList))
+    {
+        listEntry = RemoveHeadList(&batchList);
+        batch = CONTAINING_RECORD(listEntry,
+                                  SPBTARGET_TRANSACTION_BATCH,
+                                  ListEntry);
+        groups = batch->Groups;
+        firstGroupIndex = batch->NextGroupIndex;
+        numberOfGroups = batch->NumberOfGroups;
+        batch->NextGroupIndex = numberOfGroups;
+        for (groupIndex = firstGroupIndex; groupIndex < numberOfGroups; groupIndex++)
+        {
+            SpbTarget_TransactionGroupDone(DmfModule,
+                                           &groups[groupIndex],
+                                           FALSE,
+                                           STATUS_CANCELLED);
+        }
+    }
+
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    waitForBatches = (moduleContext->TransactionBatchesActive > 0);
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    if (waitForBatches)
+    {
+        DMF_Portable_EventWaitForSingleObject(&moduleContext->TransactionBatchesDoneEvent,
+                                              NULL,
+                                              FALSE);
+    }
+
+Exit:
+
+    return;
+}
+#pragma code_seg()
+
 EVT_DMF_InterruptResource_InterruptIsr SpbTarget_InterruptIsr;
 
 _Function_class_(EVT_DMF_InterruptResource_InterruptIsr)
@@ -510,6 +1025,15 @@ Return Value:
 
     moduleContext->SpbConnectionAssigned = FALSE;
 
+    if (moduleConfig->IoTargetSetByClient)
+    {
+        // The Client gives this Module its IoTarget.
+        //
+        DmfAssert(! moduleConfig->SpbConnectionMandatory);
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
     // Check the number of resources for the button device.
     //
     resourceCount = WdfCmResourceListGetCount(ResourcesTranslated);
@@ -629,6 +1153,43 @@ Return Value:
     moduleContext = DMF_CONTEXT_GET(DmfModule);
     moduleConfig = DMF_CONFIG_GET(DmfModule);
 
+    // Create the lock used by the asynchronous transaction engine. It is used by
+    // completion routines that may run at DISPATCH_LEVEL.
+    //
+    WDF_OBJECT_ATTRIBUTES lockAttributes;
+    WDF_OBJECT_ATTRIBUTES_INIT(&lockAttributes);
+    lockAttributes.ParentObject = DmfModule;
+    ntStatus = WdfSpinLockCreate(&lockAttributes,
+                                 &moduleContext->TransactionLock);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfSpinLockCreate fails: ntStatus=%!STATUS!", ntStatus);
+        moduleContext->TransactionLock = NULL;
+        goto Exit;
+    }
+
+    InitializeListHead(&moduleContext->TransactionBatchList);
+    moduleContext->TransactionGroupsOutstanding = 0;
+    moduleContext->TransactionBatchesActive = 0;
+    moduleContext->TransactionsClosing = FALSE;
+    moduleContext->TransactionGroupsOutstandingMaximum = moduleConfig->TransactionsOutstandingMaximum;
+    if (0 == moduleContext->TransactionGroupsOutstandingMaximum)
+    {
+        moduleContext->TransactionGroupsOutstandingMaximum = SpbTarget_TransactionsOutstandingDefault;
+    }
+    DMF_Portable_EventCreate(&moduleContext->TransactionBatchesDoneEvent,
+                             NotificationEvent,
+                             FALSE);
+
+    if (moduleConfig->IoTargetSetByClient)
+    {
+        // Batches are accepted once the Client sets the IoTarget.
+        //
+        moduleContext->TransactionsClosing = TRUE;
+        ntStatus = STATUS_SUCCESS;
+        goto Exit;
+    }
+
     // Create the SPB target.
     //
     WDF_OBJECT_ATTRIBUTES targetAttributes;
@@ -696,6 +1257,17 @@ Return Value:
 
     moduleContext = DMF_CONTEXT_GET(DmfModule);
 
+    // Batches in progress use the SPB controller target.
+    //
+    SpbTarget_TransactionsFlush(DmfModule);
+
+    if (moduleContext->TransactionLock != NULL)
+    {
+        DMF_Portable_EventClose(&moduleContext->TransactionBatchesDoneEvent);
+        WdfObjectDelete(moduleContext->TransactionLock);
+        moduleContext->TransactionLock = NULL;
+    }
+
     if (moduleContext->Interrupt != nullptr)
     {
         WdfObjectDelete(moduleContext->Interrupt);
@@ -1168,6 +1740,109 @@ Return Value:
 }
 #pragma code_seg()
 
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_SpbTarget_IoTargetClear(
+    _In_ DMFMODULE DmfModule
+    )
+/*++
+
+Routine Description:
+
+    Stop using the IoTarget set by DMF_SpbTarget_IoTargetSet(). Batches that have not been
+    sent are cancelled and batches in progress are allowed to complete before this Method
+    returns. The Client may close the IoTarget after that.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    DMF_CONFIG_SpbTarget* moduleConfig;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 SpbTarget);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DmfAssert(moduleConfig->IoTargetSetByClient);
+
+    SpbTarget_TransactionsFlush(DmfModule);
+
+    DMF_RequestTarget_IoTargetClear(moduleContext->DmfModuleRequestTarget);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
+#pragma code_seg("PAGE")
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_SpbTarget_IoTargetSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFIOTARGET IoTarget
+    )
+/*++
+
+Routine Description:
+
+    Give this Module an open IoTarget to an SPB controller. Used when the Module is
+    configured with IoTargetSetByClient, for example by a Parent Module that opens the
+    connection itself. The IoTarget must remain open until DMF_SpbTarget_IoTargetClear().
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+    IoTarget - The given IoTarget.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    DMF_CONFIG_SpbTarget* moduleConfig;
+
+    PAGED_CODE();
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 SpbTarget);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    DmfAssert(moduleConfig->IoTargetSetByClient);
+
+    DMF_RequestTarget_IoTargetSet(moduleContext->DmfModuleRequestTarget,
+                                  IoTarget);
+
+    // No batches are active because the Module was not accepting them.
+    //
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    DmfAssert(0 == moduleContext->TransactionBatchesActive);
+    DMF_Portable_EventReset(&moduleContext->TransactionBatchesDoneEvent);
+    moduleContext->TransactionsClosing = FALSE;
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    FuncExitVoid(DMF_TRACE);
+}
+#pragma code_seg()
+
 #pragma code_seg("PAGE")
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
@@ -1221,5 +1896,258 @@ Return Value:
 }
 #pragma code_seg()
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_SpbTarget_TransactionsSubmit(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(NumberOfTransactions) SpbTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_ EVT_DMF_SpbTarget_TransactionsComplete* EvtSpbTargetTransactionsComplete,
+    _In_opt_ VOID* ClientContext
+    )
+/*++
+
+Routine Description:
+
+    Submit a batch of register transactions to be performed asynchronously. Adjacent
+    register reads are coalesced into a single SPB sequence. Transactions are sent to
+    the controller in order, with up to TransactionsOutstandingMaximum SPB requests
+    outstanding at a time across all batches.
+
+Arguments:
+
+    DmfModule - This Module's Module handle.
+    Transactions - The Client's transactions. Must remain valid until the batch completes.
+    NumberOfTransactions - Number of entries in Transactions.
+    EvtSpbTargetTransactionsComplete - Called once all the transactions have completed.
+    ClientContext - Passed to EvtSpbTargetTransactionsComplete.
+
+Return Value:
+
+    STATUS_SUCCESS if the batch was accepted. In that case EvtSpbTargetTransactionsComplete
+    is always called.
+    Other NTSTATUS if the batch was not accepted. In that case EvtSpbTargetTransactionsComplete
+    is not called.
+
+--*/
+{
+    NTSTATUS ntStatus;
+    DMF_CONTEXT_SpbTarget* moduleContext;
+    DMF_CONFIG_SpbTarget* moduleConfig;
+    WDF_OBJECT_ATTRIBUTES memoryAttributes;
+    WDFMEMORY memory;
+    SPBTARGET_TRANSACTION_BATCH* batch;
+    SPBTARGET_TRANSACTION_GROUP* group;
+    SPB_TRANSFER_BUFFER_LIST_ENTRY* bufferListEntries;
+    SpbTarget_Transaction* transaction;
+    ULONG registerAddressLength;
+    ULONG numberOfGroups;
+    ULONG transactionIndex;
+    ULONG byteIndex;
+    size_t batchSize;
+    BOOLEAN closing;
+
+    FuncEntry(DMF_TRACE);
+
+    DMFMODULE_VALIDATE_IN_METHOD(DmfModule,
+                                 SpbTarget);
+
+    moduleContext = DMF_CONTEXT_GET(DmfModule);
+    moduleConfig = DMF_CONFIG_GET(DmfModule);
+
+    memory = NULL;
+
+    registerAddressLength = moduleConfig->TransactionRegisterAddressLength;
+    if (0 == registerAddressLength)
+    {
+        registerAddressLength = sizeof(UCHAR);
+    }
+
+    if ((0 == NumberOfTransactions) ||
+        (registerAddressLength > sizeof(ULONG)) ||
+        (NULL == EvtSpbTargetTransactionsComplete))
+    {
+        DmfAssert(FALSE);
+        ntStatus = STATUS_INVALID_PARAMETER;
+        goto Exit;
+    }
+
+    // Validate the transactions and count the groups they are coalesced into.
+    //
+    numberOfGroups = 0;
+    for (transactionIndex = 0; transactionIndex < NumberOfTransactions; transactionIndex++)
+    {
+        transaction = &Transactions[transactionIndex];
+        if ((transaction->TransactionType <= SpbTarget_TransactionType_Invalid) ||
+            (transaction->TransactionType >= SpbTarget_TransactionType_Maximum) ||
+            (NULL == transaction->Buffer) ||
+            (0 == transaction->BufferLength) ||
+            ((registerAddressLength < sizeof(ULONG)) &&
+             (transaction->RegisterAddress >> (registerAddressLength * 8) != 0)))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "Invalid transaction %u", transactionIndex);
+            ntStatus = STATUS_INVALID_PARAMETER;
+            goto Exit;
+        }
+        transaction->NtStatus = STATUS_PENDING;
+
+        if ((0 == transactionIndex) ||
+            (! SpbTarget_TransactionIsCoalescable(&Transactions[transactionIndex - 1],
+                                                  transaction)))
+        {
+            numberOfGroups++;
+        }
+    }
+
+    // The batch, its groups and the buffer lists of all the groups are allocated at once.
+    // Each transaction uses at most two buffer list entries: its address and its data.
+    //
+    batchSize = sizeof(SPBTARGET_TRANSACTION_BATCH) +
+                (numberOfGroups * sizeof(SPBTARGET_TRANSACTION_GROUP)) +
+                (2 * (size_t)NumberOfTransactions * sizeof(SPB_TRANSFER_BUFFER_LIST_ENTRY));
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&memoryAttributes);
+    memoryAttributes.ParentObject = DmfModule;
+    ntStatus = WdfMemoryCreate(&memoryAttributes,
+                               NonPagedPoolNx,
+                               MemoryTag,
+                               batchSize,
+                               &memory,
+                               (VOID**)&batch);
+    if (! NT_SUCCESS(ntStatus))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, DMF_TRACE, "WdfMemoryCreate fails: ntStatus=%!STATUS!", ntStatus);
+        memory = NULL;
+        goto Exit;
+    }
+    RtlZeroMemory(batch,
+                  batchSize);
+
+    batch->Memory = memory;
+    batch->DmfModule = DmfModule;
+    batch->Transactions = Transactions;
+    batch->NumberOfTransactions = NumberOfTransactions;
+    batch->EvtSpbTargetTransactionsComplete = EvtSpbTargetTransactionsComplete;
+    batch->ClientContext = ClientContext;
+    batch->Groups = (SPBTARGET_TRANSACTION_GROUP*)(batch + 1);
+    batch->NumberOfGroups = numberOfGroups;
+    batch->GroupsPending = numberOfGroups;
+    batch->NtStatus = STATUS_SUCCESS;
+    InitializeListHead(&batch->ListEntry);
+    bufferListEntries = (SPB_TRANSFER_BUFFER_LIST_ENTRY*)(batch->Groups + numberOfGroups);
+
+    // Build the SPB sequence of each group.
+    //
+    group = NULL;
+    for (transactionIndex = 0; transactionIndex < NumberOfTransactions; transactionIndex++)
+    {
+        transaction = &Transactions[transactionIndex];
+
+        if ((group != NULL) &&
+            SpbTarget_TransactionIsCoalescable(&Transactions[transactionIndex - 1],
+                                               transaction))
+        {
+            // Extend the read of the current group into this transaction's buffer.
+            //
+            bufferListEntries[0].Buffer = transaction->Buffer;
+            bufferListEntries[0].BufferCb = transaction->BufferLength;
+            bufferListEntries++;
+            group->NumberOfTransactions++;
+            // Transfers[1] exists because only read groups are extended.
+            //
+            #pragma warning(suppress: 6201)
+            group->Sequence.List.Transfers[1].Buffer.BufferList.ListCe++;
+            continue;
+        }
+
+        group = (NULL == group) ? batch->Groups : (group + 1);
+        group->Batch = batch;
+        group->FirstTransactionIndex = transactionIndex;
+        group->NumberOfTransactions = 1;
+        for (byteIndex = 0; byteIndex < registerAddressLength; byteIndex++)
+        {
+            group->RegisterAddress[byteIndex] = (UCHAR)(transaction->RegisterAddress >> ((registerAddressLength - 1 - byteIndex) * 8));
+        }
+
+        if (SpbTarget_TransactionType_RegisterRead == transaction->TransactionType)
+        {
+            // Write the address, then read into the list of Client buffers.
+            //
+            SPB_TRANSFER_LIST_INIT(&(group->Sequence.List), 2);
+            ULONG index = 0;
+            group->Sequence.List.Transfers[index] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(SpbTransferDirectionToDevice,
+                                                                                        0,
+                                                                                        group->RegisterAddress,
+                                                                                        registerAddressLength);
+            bufferListEntries[0].Buffer = transaction->Buffer;
+            bufferListEntries[0].BufferCb = transaction->BufferLength;
+            group->Sequence.List.Transfers[index + 1] = SPB_TRANSFER_LIST_ENTRY_INIT_BUFFER_LIST(SpbTransferDirectionFromDevice,
+                                                                                                 0,
+                                                                                                 &bufferListEntries[0],
+                                                                                                 1);
+            bufferListEntries++;
+            group->SequenceLength = sizeof(group->Sequence);
+        }
+        else
+        {
+            // Write the address followed by the data without copying either.
+            //
+            SPB_TRANSFER_LIST_INIT(&(group->Sequence.List), 1);
+            bufferListEntries[0].Buffer = group->RegisterAddress;
+            bufferListEntries[0].BufferCb = registerAddressLength;
+            bufferListEntries[1].Buffer = transaction->Buffer;
+            bufferListEntries[1].BufferCb = transaction->BufferLength;
+            group->Sequence.List.Transfers[0] = SPB_TRANSFER_LIST_ENTRY_INIT_BUFFER_LIST(SpbTransferDirectionToDevice,
+                                                                                         0,
+                                                                                         &bufferListEntries[0],
+                                                                                         2);
+            bufferListEntries += 2;
+            group->SequenceLength = sizeof(SPB_TRANSFER_LIST);
+        }
+    }
+    DmfAssert(group == &batch->Groups[numberOfGroups - 1]);
+
+    WdfSpinLockAcquire(moduleContext->TransactionLock);
+    closing = moduleContext->TransactionsClosing;
+    if (! closing)
+    {
+        InsertTailList(&moduleContext->TransactionBatchList,
+                       &batch->ListEntry);
+        // One count for the batch and one for this thread while it sends groups.
+        //
+        moduleContext->TransactionBatchesActive += 2;
+    }
+    WdfSpinLockRelease(moduleContext->TransactionLock);
+
+    if (closing)
+    {
+        ntStatus = STATUS_INVALID_DEVICE_STATE;
+        goto Exit;
+    }
+
+    // The batch now belongs to the engine.
+    //
+    memory = NULL;
+
+    TraceEvents(TRACE_LEVEL_VERBOSE, DMF_TRACE, "Batch=0x%p Transactions=%u Groups=%u", batch, NumberOfTransactions, numberOfGroups);
+
+    SpbTarget_TransactionGroupsSend(DmfModule);
+
+    SpbTarget_TransactionsDereference(DmfModule);
+
+Exit:
+
+    if (memory != NULL)
+    {
+        WdfObjectDelete(memory);
+        memory = NULL;
+    }
+
+    FuncExit(DMF_TRACE, "ntStatus=%!STATUS!", ntStatus);
+
+    return ntStatus;
+}
+
 // eof: Dmf_SpbTarget.c
 //
@@ -27,6 +27,55 @@ typedef EVT_DMF_InterruptResource_InterruptIsr EVT_DMF_SpbTarget_InterruptIsr;
 typedef EVT_DMF_InterruptResource_InterruptDpc EVT_DMF_SpbTarget_InterruptDpc;
 typedef EVT_DMF_InterruptResource_InterruptPassive EVT_DMF_SpbTarget_InterruptPassive;
 
+// Types of transactions that can be submitted using DMF_SpbTarget_TransactionsSubmit().
+//
+typedef enum
+{
+    SpbTarget_TransactionType_Invalid = 0,
+    // Write the register address, then read BufferLength bytes.
+    //
+    SpbTarget_TransactionType_RegisterRead,
+    // Write the register address followed by BufferLength bytes.
+    //
+    SpbTarget_TransactionType_RegisterWrite,
+    SpbTarget_TransactionType_Maximum
+} SpbTarget_TransactionType;
+
+// A single register transaction in a batch submitted using DMF_SpbTarget_TransactionsSubmit().
+//
+typedef struct
+{
+    // Read or write.
+    //
+    SpbTarget_TransactionType TransactionType;
+    // The register to read from or write to.
+    //
+    ULONG RegisterAddress;
+    // Bytes read from the device or bytes to write to the device.
+    // Must remain valid until the batch completes.
+    //
+    UCHAR* Buffer;
+    // Size of Buffer in bytes.
+    //
+    ULONG BufferLength;
+    // Completion status of this transaction. Set by the Module.
+    //
+    NTSTATUS NtStatus;
+} SpbTarget_Transaction;
+
+// Callback that tells the Client that all the transactions in a batch have completed.
+//
+typedef
+_Function_class_(EVT_DMF_SpbTarget_TransactionsComplete)
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_IRQL_requires_same_
+VOID
+EVT_DMF_SpbTarget_TransactionsComplete(_In_ DMFMODULE DmfModule,
+                                       _In_ SpbTarget_Transaction* Transactions,
+                                       _In_ ULONG NumberOfTransactions,
+                                       _In_opt_ VOID* ClientContext,
+                                       _In_ NTSTATUS NtStatus);
+
 // Client uses this structure to configure the Module specific parameters.
 //
 typedef struct
@@ -46,8 +95,29 @@ typedef struct
     // Interrupt Resource
     //
     DMF_CONFIG_InterruptResource InterruptResource;
+    // Number of bytes (1-4) in the register address sent by DMF_SpbTarget_TransactionsSubmit().
+    // The address is sent most significant byte first. Zero means 1.
+    //
+    ULONG TransactionRegisterAddressLength;
+    // Maximum number of SPB requests DMF_SpbTarget_TransactionsSubmit() keeps outstanding
+    // at the controller. Zero means SpbTarget_TransactionsOutstandingDefault.
+    //
+    ULONG TransactionsOutstandingMaximum;
+    // Timeout in milliseconds of each SPB request sent by DMF_SpbTarget_TransactionsSubmit().
+    // Zero means no timeout.
+    //
+    ULONG TransactionTimeoutMs;
+    // FALSE: The Module opens the SPB connection at SpbConnectionIndex.
+    // TRUE: The Module does not look for an SPB connection. The Client gives it an open
+    //       IoTarget using DMF_SpbTarget_IoTargetSet().
+    //
+    BOOLEAN IoTargetSetByClient;
 } DMF_CONFIG_SpbTarget;
 
+// Used when TransactionsOutstandingMaximum is zero.
+//
+#define SpbTarget_TransactionsOutstandingDefault    2
+
 // This macro declares the following functions:
 // DMF_SpbTarget_ATTRIBUTES_INIT()
 // DMF_CONFIG_SpbTarget_AND_ATTRIBUTES_INIT()
@@ -129,6 +199,19 @@ DMF_SpbTarget_InterruptTryToAcquireLock(
     _In_ DMFMODULE DmfModule
     );
 
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_SpbTarget_IoTargetClear(
+    _In_ DMFMODULE DmfModule
+    );
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+VOID
+DMF_SpbTarget_IoTargetSet(
+    _In_ DMFMODULE DmfModule,
+    _In_ WDFIOTARGET IoTarget
+    );
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 VOID
 DMF_SpbTarget_IsResourceAssigned(
@@ -137,5 +220,16 @@ DMF_SpbTarget_IsResourceAssigned(
     _Out_opt_ BOOLEAN* InterruptAssigned
     );
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+_Must_inspect_result_
+NTSTATUS
+DMF_SpbTarget_TransactionsSubmit(
+    _In_ DMFMODULE DmfModule,
+    _Inout_updates_(NumberOfTransactions) SpbTarget_Transaction* Transactions,
+    _In_ ULONG NumberOfTransactions,
+    _In_ EVT_DMF_SpbTarget_TransactionsComplete* EvtSpbTargetTransactionsComplete,
+    _In_opt_ VOID* ClientContext
+    );
+
 // eof: Dmf_SpbTarget.h
 //
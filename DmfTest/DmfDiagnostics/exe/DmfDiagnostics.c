@@ -0,0 +1,358 @@
+/*++
+
+    Copyright (c) Microsoft Corporation. All rights reserved.
+    Licensed under the MIT license.
+
+Module Name:
+
+    DmfDiagnostics.c
+
+Abstract:
+
+    Dumps the diagnostic data collected by DMF in every driver that exposes
+    GUID_DEVINTERFACE_DmfDiagnostics.
+
+    Usage: DmfDiagnostics methods|locks
+
+    methods: Call count and latency of Module Methods (USE_DMF_METHOD_INSTRUMENTATION).
+    locks: Acquisitions, contention and hold time of Module locks (USE_DMF_LOCK_PROFILING).
+
+Environment:
+
+    User-mode
+
+--*/
+
+#include <windows.h>
+#include <winioctl.h>
+#include <initguid.h>
+#include <cfgmgr32.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Contains the Interface Guid and IOCTL information.
+//
+#include "..\..\..\Dmf\Framework\DmfDiagnostics_Public.h"
+
+// Initial size of the buffer that receives the diagnostics. It grows as needed.
+//
+#define INITIAL_OUTPUT_BUFFER_SIZE  (64 * 1024)
+
+DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA*
+DiagnosticsQuery(
+    _In_ HANDLE Device,
+    _In_ DWORD Type
+    )
+/*++
+
+Routine Description:
+
+    Send IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION to a device. The output buffer is
+    enlarged until all the entries fit.
+
+Arguments:
+
+    Device - Handle to the device.
+    Type - The type of diagnostics to query.
+
+Return Value:
+
+    Buffer with the diagnostics (free with free()) or NULL on failure.
+
+--*/
+{
+    DMF_DIAGNOSTICS_REQUEST_INPUT_DATA inputData;
+    DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* outputData;
+    DWORD outputBufferSize;
+    DWORD bytesReturned;
+    BOOL status;
+
+    inputData.Type = Type;
+    outputBufferSize = INITIAL_OUTPUT_BUFFER_SIZE;
+
+    for (;;)
+    {
+        outputData = (DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA*)malloc(outputBufferSize);
+        if (NULL == outputData)
+        {
+            printf("Unable to allocate %u bytes\n", outputBufferSize);
+            break;
+        }
+
+        status = DeviceIoControl(Device,
+                                 IOCTL_DMF_DIAGNOSTICS_QUERY_INFORMATION,
+                                 &inputData,
+                                 sizeof(inputData),
+                                 outputData,
+                                 outputBufferSize,
+                                 &bytesReturned,
+                                 NULL);
+        if (status)
+        {
+            break;
+        }
+
+        if ((GetLastError() != ERROR_MORE_DATA) ||
+            (outputBufferSize >= (MAXDWORD / 2)))
+        {
+            printf("  IOCTL fails: error=%u\n", GetLastError());
+            free(outputData);
+            outputData = NULL;
+            break;
+        }
+
+        free(outputData);
+        outputData = NULL;
+        outputBufferSize *= 2;
+    }
+
+    return outputData;
+}
+
+VOID
+HistogramPrint(
+    _In_reads_(DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS) ULONGLONG* Histogram
+    )
+/*++
+
+Routine Description:
+
+    Print the non-empty buckets of a time histogram.
+
+Arguments:
+
+    Histogram - The histogram to print.
+
+Return Value:
+
+    None
+
+--*/
+{
+    ULONG bucketIndex;
+
+    printf("    ");
+    for (bucketIndex = 0; bucketIndex < DMF_DIAGNOSTICS_HISTOGRAM_BUCKETS; bucketIndex++)
+    {
+        if (Histogram[bucketIndex] != 0)
+        {
+            printf(" [<2^%uns]=%llu", bucketIndex + 1, Histogram[bucketIndex]);
+        }
+    }
+    printf("\n");
+}
+
+VOID
+MethodsPrint(
+    _In_ HANDLE Device
+    )
+/*++
+
+Routine Description:
+
+    Print the Method instrumentation data of a device.
+
+Arguments:
+
+    Device - Handle to the device.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* outputData;
+    DWORD entryIndex;
+
+    outputData = DiagnosticsQuery(Device,
+                                  DMF_DIAGNOSTICS_REQUEST_TYPE_METHODS);
+    if (NULL == outputData)
+    {
+        return;
+    }
+
+    printf("  %-32s %-40s %14s %14s\n", "Module", "Method", "Calls", "Average(ns)");
+    for (entryIndex = 0; entryIndex < outputData->NumberOfEntries; entryIndex++)
+    {
+        DMF_DIAGNOSTICS_METHOD_ENTRY* entry;
+
+        entry = &outputData->Response.Methods[entryIndex];
+        printf("  %-32s %-40s %14llu %14llu\n",
+               entry->ModuleInstanceName,
+               entry->MethodName,
+               entry->CallCount,
+               (entry->CallCount > 0) ? (entry->TotalLatencyNs / entry->CallCount) : 0);
+        HistogramPrint(entry->LatencyHistogram);
+    }
+
+    free(outputData);
+}
+
+VOID
+LocksPrint(
+    _In_ HANDLE Device
+    )
+/*++
+
+Routine Description:
+
+    Print the lock profiling data of a device.
+
+Arguments:
+
+    Device - Handle to the device.
+
+Return Value:
+
+    None
+
+--*/
+{
+    DMF_DIAGNOSTICS_REQUEST_OUTPUT_DATA* outputData;
+    DWORD entryIndex;
+
+    outputData = DiagnosticsQuery(Device,
+                                  DMF_DIAGNOSTICS_REQUEST_TYPE_LOCKS);
+    if (NULL == outputData)
+    {
+        return;
+    }
+
+    printf("  %-32s %5s %-8s %14s %14s %14s %18s\n", "Module", "Lock", "Type", "Acquired", "Contended", "MaxHold(ns)", "MaxHoldOwner");
+    for (entryIndex = 0; entryIndex < outputData->NumberOfEntries; entryIndex++)
+    {
+        DMF_DIAGNOSTICS_LOCK_ENTRY* entry;
+
+        entry = &outputData->Response.Locks[entryIndex];
+        printf("  %-32s %5u %-8s %14llu %14llu %14llu     Driver+0x%llx\n",
+               entry->ModuleInstanceName,
+               entry->LockIndex,
+               entry->Passive ? "Passive" : "Dispatch",
+               entry->AcquireCount,
+               entry->ContendedCount,
+               entry->MaximumHoldNs,
+               entry->MaximumHoldOwnerOffset);
+        HistogramPrint(entry->HoldHistogram);
+    }
+
+    free(outputData);
+}
+
+// Prints one type of diagnostics for a device.
+//
+typedef
+VOID
+DiagnosticsPrint(
+    _In_ HANDLE Device
+    );
+
+int
+__cdecl
+main(
+    _In_ ULONG argc,
+    _In_reads_(argc) PCHAR argv[]
+    )
+{
+    CONFIGRET configRet;
+    ULONG deviceInterfaceListLength;
+    WCHAR* deviceInterfaceList;
+    WCHAR* deviceInterface;
+    DiagnosticsPrint* diagnosticsPrint;
+    int returnValue;
+
+    deviceInterfaceList = NULL;
+    diagnosticsPrint = NULL;
+    returnValue = 1;
+
+    if (argc == 2)
+    {
+        if (_stricmp(argv[1], "methods") == 0)
+        {
+            diagnosticsPrint = MethodsPrint;
+        }
+        else if (_stricmp(argv[1], "locks") == 0)
+        {
+            diagnosticsPrint = LocksPrint;
+        }
+    }
+
+    if (NULL == diagnosticsPrint)
+    {
+        printf("Usage: DmfDiagnostics methods|locks\n");
+        goto Exit;
+    }
+
+    configRet = CM_Get_Device_Interface_List_SizeW(&deviceInterfaceListLength,
+                                                   (LPGUID)&GUID_DEVINTERFACE_DmfDiagnostics,
+                                                   NULL,
+                                                   CM_GET_DEVICE_INTERFACE_LIST_PRESENT);
+    if (configRet != CR_SUCCESS)
+    {
+        printf("CM_Get_Device_Interface_List_Size fails: configRet=0x%x\n", configRet);
+        goto Exit;
+    }
+
+    deviceInterfaceList = (WCHAR*)calloc(deviceInterfaceListLength,
+                                         sizeof(WCHAR));
+    if (NULL == deviceInterfaceList)
+    {
+        goto Exit;
+    }
+
+    configRet = CM_Get_Device_Interface_ListW((LPGUID)&GUID_DEVINTERFACE_DmfDiagnostics,
+                                              NULL,
+                                              deviceInterfaceList,
+                                              deviceInterfaceListLength,
+                                              CM_GET_DEVICE_INTERFACE_LIST_PRESENT);
+    if (configRet != CR_SUCCESS)
+    {
+        printf("CM_Get_Device_Interface_List fails: configRet=0x%x\n", configRet);
+        goto Exit;
+    }
+
+    if (L'\0' == deviceInterfaceList[0])
+    {
+        printf("No devices expose DMF diagnostics.\n");
+        goto Exit;
+    }
+
+    for (deviceInterface = deviceInterfaceList; *deviceInterface != L'\0'; deviceInterface += wcslen(deviceInterface) + 1)
+    {
+        HANDLE device;
+
+        printf("%S\n", deviceInterface);
+
+        device = CreateFileW(deviceInterface,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             NULL,
+                             OPEN_EXISTING,
+                             0,
+                             NULL);
+        if (INVALID_HANDLE_VALUE == device)
+        {
+            printf("  CreateFile fails: error=%u\n", GetLastError());
+            continue;
+        }
+
+        diagnosticsPrint(device);
+
+        CloseHandle(device);
+    }
+
+    returnValue = 0;
+
+Exit:
+
+    if (deviceInterfaceList != NULL)
+    {
+        free(deviceInterfaceList);
+    }
+
+    return returnValue;
+}
+
+// eof: DmfDiagnostics.c
+//
@@ -166,6 +166,8 @@ Return Value:
 {
     DMF_MODULE_ATTRIBUTES moduleAttributes;
     BOOLEAN isFunctionDriver;
+    DMF_CONFIG_Tests_ParallelOpen moduleConfigTests_ParallelOpen;
+    LONG parallelOpenIndex;
 
     UNREFERENCED_PARAMETER(Device);
     UNREFERENCED_PARAMETER(DmfModuleInit);
@@ -243,6 +245,78 @@ Return Value:
                      WDF_NO_OBJECT_ATTRIBUTES,
                      NULL);
 
+    // Tests_Rundown
+    // -------------
+    //
+    DMF_Tests_Rundown_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_FrameParser
+    // -----------------
+    //
+    DMF_Tests_FrameParser_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_ModuleValidation
+    // ----------------------
+    //
+    DMF_Tests_ModuleValidation_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_ModuleCreate
+    // ------------------
+    //
+    DMF_Tests_ModuleCreate_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_Interface
+    // ---------------
+    //
+    DMF_Tests_Interface_ATTRIBUTES_INIT(&moduleAttributes);
+    DMF_DmfModuleAdd(DmfModuleInit,
+                     &moduleAttributes,
+                     WDF_NO_OBJECT_ATTRIBUTES,
+                     NULL);
+
+    // Tests_ParallelOpen
+    // ------------------
+    // Five instances. The first two may be opened at the same time. The third one does not
+    // set OpenInParallel so it is opened alone after them. The last two may be opened at the
+    // same time after the third one. The other Modules do not set OpenInParallel.
+    //
+    for (parallelOpenIndex = 0; parallelOpenIndex < 5; parallelOpenIndex++)
+    {
+        DMF_CONFIG_Tests_ParallelOpen_AND_ATTRIBUTES_INIT(&moduleConfigTests_ParallelOpen,
+                                                          &moduleAttributes);
+        moduleConfigTests_ParallelOpen.OpenDelayMs = 100;
+        if (2 == parallelOpenIndex)
+        {
+            moduleConfigTests_ParallelOpen.ModulesOpenBefore = 2;
+            moduleConfigTests_ParallelOpen.OpensAlone = TRUE;
+        }
+        else
+        {
+            moduleConfigTests_ParallelOpen.ModulesOpenBefore = (parallelOpenIndex < 2) ? 0 : 3;
+            moduleAttributes.OpenInParallel = TRUE;
+        }
+        DMF_DmfModuleAdd(DmfModuleInit,
+                         &moduleAttributes,
+                         WDF_NO_OBJECT_ATTRIBUTES,
+                         NULL);
+    }
+
     if (isFunctionDriver)
     {
         // Tests_DefaultTarget